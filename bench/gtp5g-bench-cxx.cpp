@@ -0,0 +1,277 @@
+/* Request builders of the C++ header against the C ones */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5g.hpp>
+
+/* Not exported, reached through libgtp5gnl-core */
+extern "C" {
+int gtp5g_build_pdr_payload(struct nlmsghdr *nlh, size_t size, struct gtp5g_dev *dev,
+                            struct gtp5g_pdr *pdr);
+int gtp5g_build_far_payload(struct nlmsghdr *nlh, size_t size, struct gtp5g_dev *dev,
+                            struct gtp5g_far *far);
+}
+
+/* Each benchmark is run for at least this long */
+#define MIN_TIME        0.2
+
+/* Messages never reach a socket, any family id will do */
+#define FAMILY_ID       0x100
+#define MSG_SIZE        8192
+
+using UplinkPdr = gtp5g::FixedPdr<gtp5g::ie::Precedence, gtp5g::ie::OuterHeaderRemoval,
+                                  gtp5g::ie::FarId, gtp5g::ie::QerId, gtp5g::ie::UeAddr,
+                                  gtp5g::ie::FTeid>;
+using DownlinkFar = gtp5g::FixedFar<gtp5g::ie::ApplyAction, gtp5g::ie::OuterHeaderCreation>;
+
+static struct gtp5g_dev *dev;
+static struct gtp5g_pdr *pdr;
+static struct gtp5g_far *far;
+
+static gtp5g::Device cxx_dev;
+static gtp5g::Pdr cxx_pdr;
+static gtp5g::Far cxx_far;
+
+static char scratch[MSG_SIZE];
+
+/* Keeps the messages built from being optimized out */
+static volatile uint32_t msg_len;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The PDR and FAR of gtp5g-bench-micro, without the SDF filter */
+static void fill(void)
+{
+    struct in_addr ue, gtpu, peer;
+
+    inet_pton(AF_INET, "10.60.0.1", &ue);
+    inet_pton(AF_INET, "10.0.0.1", &gtpu);
+    inet_pton(AF_INET, "10.0.0.2", &peer);
+
+    dev = gtp5g_dev_alloc();
+    gtp5g_dev_set_ifidx(dev, 1);
+    cxx_dev.ifidx = 1;
+
+    pdr = gtp5g_pdr_alloc();
+    gtp5g_pdr_set_id(pdr, 1);
+    gtp5g_pdr_set_precedence(pdr, 255);
+    gtp5g_pdr_set_far_id(pdr, 1);
+    gtp5g_pdr_set_qer_id(pdr, 1);
+    gtp5g_pdr_set_outer_header_removal(pdr, 0);
+    gtp5g_pdr_set_ue_addr_ipv4(pdr, &ue);
+    gtp5g_pdr_set_local_f_teid(pdr, 1, &gtpu);
+
+    cxx_pdr.id = 1;
+    cxx_pdr.precedence = 255;
+    cxx_pdr.far_id = 1;
+    cxx_pdr.qer_id = 1;
+    cxx_pdr.outer_header_removal = 0;
+    cxx_pdr.pdi.emplace();
+    cxx_pdr.pdi->ue_addr = ue;
+    cxx_pdr.pdi->f_teid = gtp5g::FTeid{1, gtpu};
+
+    far = gtp5g_far_alloc();
+    gtp5g_far_set_id(far, 1);
+    gtp5g_far_set_apply_action(far, 2);
+    gtp5g_far_set_outer_header_creation(far, 1, 1, &peer, 2152);
+
+    cxx_far.id = 1;
+    cxx_far.apply_action = 2;
+    cxx_far.fwd_param.emplace();
+    cxx_far.fwd_param->hdr_creation = gtp5g::OuterHeaderCreation{1, 1, peer, 2152};
+}
+
+static struct nlmsghdr *build_hdr(uint8_t cmd)
+{
+    return genl_nlmsg_build_hdr(scratch, FAMILY_ID, NLM_F_EXCL | NLM_F_ACK, 1, cmd);
+}
+
+static void bench_c_pdr(void)
+{
+    struct nlmsghdr *nlh = build_hdr(GTP5G_CMD_ADD_PDR);
+
+    gtp5g_build_pdr_payload(nlh, MSG_SIZE, dev, pdr);
+    msg_len = nlh->nlmsg_len;
+}
+
+static void bench_cxx_pdr(void)
+{
+    struct nlmsghdr *nlh = build_hdr(GTP5G_CMD_ADD_PDR);
+
+    cxx_dev.put(nlh);
+    cxx_pdr.put(nlh);
+    msg_len = nlh->nlmsg_len;
+}
+
+static void bench_fixed_pdr(void)
+{
+    struct nlmsghdr *nlh = build_hdr(GTP5G_CMD_ADD_PDR);
+
+    cxx_dev.put(nlh);
+    UplinkPdr(cxx_pdr).put(nlh);
+    msg_len = nlh->nlmsg_len;
+}
+
+static void bench_c_far(void)
+{
+    struct nlmsghdr *nlh = build_hdr(GTP5G_CMD_ADD_FAR);
+
+    gtp5g_build_far_payload(nlh, MSG_SIZE, dev, far);
+    msg_len = nlh->nlmsg_len;
+}
+
+static void bench_cxx_far(void)
+{
+    struct nlmsghdr *nlh = build_hdr(GTP5G_CMD_ADD_FAR);
+
+    cxx_dev.put(nlh);
+    cxx_far.put(nlh);
+    msg_len = nlh->nlmsg_len;
+}
+
+static void bench_fixed_far(void)
+{
+    struct nlmsghdr *nlh = build_hdr(GTP5G_CMD_ADD_FAR);
+
+    cxx_dev.put(nlh);
+    DownlinkFar(cxx_far).put(nlh);
+    msg_len = nlh->nlmsg_len;
+}
+
+static const struct {
+    const char *name;
+    void (*fn)(void);
+} benches[] = {
+    { "c_build_pdr",            bench_c_pdr },
+    { "cxx_build_pdr",          bench_cxx_pdr },
+    { "fixed_build_pdr",        bench_fixed_pdr },
+    { "c_build_far",            bench_c_far },
+    { "cxx_build_far",          bench_cxx_far },
+    { "fixed_build_far",        bench_fixed_far },
+};
+
+/* The builders of a rule must agree to the byte, but for the padding
+ * mnl_attr_put() leaves as it was */
+static int check(const char *what, void (*ref)(void), void (*fn)(void))
+{
+    static char expect[MSG_SIZE];
+    uint32_t len;
+
+    memset(scratch, 0, sizeof(scratch));
+    ref();
+    len = msg_len;
+    memcpy(expect, scratch, len);
+
+    memset(scratch, 0, sizeof(scratch));
+    fn();
+    if (msg_len == len && !memcmp(expect, scratch, len))
+        return 0;
+
+    fprintf(stderr, "%s: message differs from the C builder\n", what);
+    return -1;
+}
+
+static void run(const char *name, void (*fn)(void))
+{
+    unsigned long iters = 1, i;
+    double start, elapsed;
+
+    /* Warm up, then double the iterations until the run is long enough */
+    fn();
+    for (;;) {
+        start = now();
+        for (i = 0; i < iters; i++)
+            fn();
+        elapsed = now() - start;
+
+        if (elapsed >= MIN_TIME)
+            break;
+        iters *= 2;
+    }
+
+    printf("%-24s %12lu %10.1f ns/op\n", name, iters, elapsed * 1e9 / iters);
+}
+
+static void usage(const char *name)
+{
+    unsigned int i;
+
+    printf("%s [-f <filter>] [-l]\n", name);
+    printf("\t-f <filter>\trun only the benchmarks whose name contains <filter>\n");
+    printf("\t-l\t\tlist the benchmarks\n");
+    printf("benchmarks:\n");
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+        printf("\t%s\n", benches[i].name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filter = NULL;
+    unsigned int i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:l")) != -1) {
+        switch (opt) {
+        case 'f':
+            filter = optarg;
+            break;
+        case 'l':
+            for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+                printf("%s\n", benches[i].name);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fill();
+
+    if (check("cxx_build_pdr", bench_c_pdr, bench_cxx_pdr) < 0 ||
+        check("fixed_build_pdr", bench_c_pdr, bench_fixed_pdr) < 0 ||
+        check("cxx_build_far", bench_c_far, bench_cxx_far) < 0 ||
+        check("fixed_build_far", bench_c_far, bench_fixed_far) < 0)
+        exit(EXIT_FAILURE);
+
+    printf("%-24s %12s %13s\n", "benchmark", "iterations", "time");
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (filter && !strstr(benches[i].name, filter))
+            continue;
+        run(benches[i].name, benches[i].fn);
+    }
+
+    gtp5g_far_free(far);
+    gtp5g_pdr_free(pdr);
+    gtp5g_dev_free(dev);
+
+    return EXIT_SUCCESS;
+}
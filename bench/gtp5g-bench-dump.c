@@ -0,0 +1,275 @@
+/* Benchmark of PDR dump throughput */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+
+#include <libmnl/libmnl.h>
+
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "gtp5g-fake.h"
+
+/* PDR IDs are 16 bits wide, larger tables are spread over several devices */
+#define PDR_PER_DEV     65535
+#define MAX_DEV         16
+
+static uint32_t ifidx[MAX_DEV];
+static int num_dev;
+
+static void usage(const char *name)
+{
+    printf("%s [-n <entries>] [-r <runs>] [-b <batch,...>] [-p] <gtp device>[,<gtp device>...]\n", name);
+    printf("%s -F [-n <entries>] [-r <runs>]\n", name);
+    printf("\t-n <entries>\tPDRs expected in the table (default 100000)\n");
+    printf("\t-r <runs>\tdumps per batch size (default 5)\n");
+    printf("\t-b <batch,...>\tdatagrams per receive syscall to compare (default 1,8,32)\n");
+    printf("\t-p\t\tadd the PDRs before and delete them after the run\n");
+    printf("\t-F\t\trun against the in-process fake gtp5g instead of the kernel, implies -p,\n"
+           "\t\t\tits replies are read one datagram at a time\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int parse_devs(char *list)
+{
+    char *name;
+
+    for (name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        if (num_dev == MAX_DEV) {
+            fprintf(stderr, "too many devices\n");
+            return -1;
+        }
+        ifidx[num_dev] = if_nametoindex(name);
+        if (!ifidx[num_dev]) {
+            fprintf(stderr, "wrong GTP interface %s\n", name);
+            return -1;
+        }
+        num_dev++;
+    }
+
+    return num_dev ? 0 : -1;
+}
+
+static struct gtp5g_dev *dev_of(int i, struct gtp5g_dev *dev)
+{
+    gtp5g_dev_set_ifidx(dev, ifidx[i / PDR_PER_DEV]);
+    return dev;
+}
+
+static int populate(int genl_id, struct mnl_socket *nl, int entries, int add)
+{
+    struct gtp5g_dev *dev = gtp5g_dev_alloc();
+    struct gtp5g_far *far = gtp5g_far_alloc();
+    struct gtp5g_pdr *pdr = gtp5g_pdr_alloc();
+    struct in_addr ue, gtpu;
+    int i, d, ret = 0;
+
+    inet_pton(AF_INET, "10.0.0.1", &gtpu);
+
+    gtp5g_far_set_id(far, 1);
+    gtp5g_far_set_apply_action(far, 2);
+    for (d = 0; d < num_dev && add; d++) {
+        gtp5g_dev_set_ifidx(dev, ifidx[d]);
+        if (gtp5g_add_far(genl_id, nl, dev, far) < 0) {
+            ret = -1;
+            goto out;
+        }
+    }
+
+    for (i = 0; i < entries; i++) {
+        gtp5g_pdr_set_id(pdr, i % PDR_PER_DEV + 1);
+        dev_of(i, dev);
+
+        if (!add) {
+            gtp5g_del_pdr(genl_id, nl, dev, pdr);
+            continue;
+        }
+
+        ue.s_addr = htonl(0x0a800000 + i);
+        gtp5g_pdr_set_precedence(pdr, 255);
+        gtp5g_pdr_set_far_id(pdr, 1);
+        gtp5g_pdr_set_ue_addr_ipv4(pdr, &ue);
+        gtp5g_pdr_set_local_f_teid(pdr, i + 1, &gtpu);
+        if (gtp5g_add_pdr(genl_id, nl, dev, pdr) < 0) {
+            ret = -1;
+            goto out;
+        }
+    }
+
+    for (d = 0; d < num_dev && !add; d++) {
+        gtp5g_dev_set_ifidx(dev, ifidx[d]);
+        gtp5g_del_far(genl_id, nl, dev, far);
+    }
+out:
+    gtp5g_pdr_free(pdr);
+    gtp5g_far_free(far);
+    gtp5g_dev_free(dev);
+    return ret;
+}
+
+static int count_cb(const struct nlmsghdr *nlh, void *data)
+{
+    (*(int *)data)++;
+    return MNL_CB_OK;
+}
+
+static int dump(int genl_id, struct mnl_socket *nl)
+{
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    struct nlmsghdr *nlh;
+    int count = 0;
+
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_DUMP, 0, GTP5G_CMD_GET_PDR);
+    if (genl_socket_talk(nl, nlh, 0, count_cb, &count) < 0)
+        return -1;
+
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    struct gtp5g_fake *fake = NULL;
+    struct mnl_socket *nl;
+    char batches[64] = "1,8,32";
+    int entries = 100000, runs = 5, pop = 0, batch = 0;
+    int32_t genl_id;
+    char *b;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "n:r:b:pF")) != -1) {
+        switch (opt) {
+        case 'n':
+            entries = atoi(optarg);
+            break;
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        case 'b':
+            snprintf(batches, sizeof(batches), "%s", optarg);
+            batch = 1;
+            break;
+        case 'p':
+            pop = 1;
+            break;
+        case 'F':
+            fake = gtp5g_fake_create();
+            pop = 1;
+            break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (fake && batch) {
+        fprintf(stderr, "-b has no effect with -F\n");
+        exit(EXIT_FAILURE);
+    }
+    if (fake) {
+        /* Not a socket, there is a single row */
+        snprintf(batches, sizeof(batches), "fake");
+
+        /* Any ifindex is a gtp5g device to the fake */
+        while (num_dev < MAX_DEV && num_dev * PDR_PER_DEV < entries) {
+            ifidx[num_dev] = num_dev + 1;
+            num_dev++;
+        }
+    }
+    else if (optind >= argc || parse_devs(argv[optind]) < 0) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (pop && entries > num_dev * PDR_PER_DEV) {
+        fprintf(stderr, "%d entries need %d devices\n", entries,
+                (entries + PDR_PER_DEV - 1) / PDR_PER_DEV);
+        exit(EXIT_FAILURE);
+    }
+
+    nl = genl_socket_open();
+    if (nl == NULL) {
+        perror("genl_socket_open");
+        exit(EXIT_FAILURE);
+    }
+    genl_socket_set_rcvbuf(nl, 4 << 20, 1);
+    if (fake)
+        gtp5g_fake_install(fake);
+
+    genl_id = genl_lookup_family(nl, "gtp5g");
+    if (genl_id < 0) {
+        printf("not found gtp genl family\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pop && populate(genl_id, nl, entries, 1) < 0) {
+        fprintf(stderr, "populate: %s\n", strerror(errno));
+        populate(genl_id, nl, entries, 0);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%-8s %10s %12s %14s\n", "batch", "entries", "best (ms)", "entries/s");
+    for (b = strtok(batches, ","); b; b = strtok(NULL, ",")) {
+        double best = 0, t;
+        int count = 0;
+
+        if (!fake)
+            genl_set_recv_batch(atoi(b));
+        for (i = 0; i < runs; i++) {
+            t = now();
+            count = dump(genl_id, nl);
+            t = now() - t;
+            if (count < 0) {
+                fprintf(stderr, "dump: %s\n", strerror(errno));
+                break;
+            }
+            if (!i || t < best)
+                best = t;
+        }
+        if (count < 0)
+            break;
+
+        if (count != entries)
+            fprintf(stderr, "warning: dumped %d of %d entries\n", count, entries);
+        printf("%-8s %10d %12.2f %14.0f\n", b, count, best * 1e3, count / best);
+    }
+
+    if (pop)
+        populate(genl_id, nl, entries, 0);
+
+    if (fake) {
+        gtp5g_fake_uninstall();
+        gtp5g_fake_destroy(fake);
+    }
+    genl_socket_close(nl);
+    return 0;
+}
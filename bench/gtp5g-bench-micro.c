@@ -0,0 +1,402 @@
+/* Micro-benchmarks of the request builders, reply parsers and helpers */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include <libmnl/libmnl.h>
+
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+#include "tools.h"
+
+/* Each benchmark is run for at least this long */
+#define MIN_TIME        0.2
+
+/* Messages never reach a socket, any family id will do */
+#define FAMILY_ID       0x100
+#define MSG_SIZE        8192
+
+#define SDF_DESC        "permit out ip from 10.60.0.0/16 8000-8100,9000 to assigned 80,443"
+#define PORT_LIST       "80,443,1000-2000,8080,30000-40000"
+
+/* Every allocation of the process goes through these, including the ones
+ * libc makes on our behalf such as regcomp() */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long allocs;
+
+void *malloc(size_t size)
+{
+    allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+        allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+static struct gtp5g_dev *dev;
+static struct gtp5g_pdr *pdr;
+static struct gtp5g_far *far;
+static struct gtp5g_qer *qer;
+
+static char pdr_msg[MSG_SIZE];
+static char far_msg[MSG_SIZE];
+static char qer_msg[MSG_SIZE];
+static char scratch[MSG_SIZE];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_pdr(struct gtp5g_pdr *p, int sdf)
+{
+    struct in_addr ue, gtpu;
+
+    inet_pton(AF_INET, "10.60.0.1", &ue);
+    inet_pton(AF_INET, "10.0.0.1", &gtpu);
+
+    gtp5g_pdr_set_id(p, 1);
+    gtp5g_pdr_set_precedence(p, 255);
+    gtp5g_pdr_set_far_id(p, 1);
+    gtp5g_pdr_set_qer_id(p, 1);
+    gtp5g_pdr_set_outer_header_removal(p, 0);
+    gtp5g_pdr_set_ue_addr_ipv4(p, &ue);
+    gtp5g_pdr_set_local_f_teid(p, 1, &gtpu);
+    if (sdf)
+        gtp5g_pdr_set_sdf_filter_description(p, SDF_DESC);
+}
+
+static void fill_far(struct gtp5g_far *f)
+{
+    struct in_addr peer;
+
+    inet_pton(AF_INET, "10.0.0.2", &peer);
+
+    gtp5g_far_set_id(f, 1);
+    gtp5g_far_set_apply_action(f, 2);
+    gtp5g_far_set_outer_header_creation(f, 1, 1, &peer, 2152);
+}
+
+static void fill_qer(struct gtp5g_qer *q)
+{
+    gtp5g_qer_set_id(q, 1);
+    gtp5g_qer_set_gate_status(q, 0);
+    gtp5g_qer_set_mbr_uhigh(q, 1000);
+    gtp5g_qer_set_mbr_ulow(q, 0);
+    gtp5g_qer_set_mbr_dhigh(q, 1000);
+    gtp5g_qer_set_mbr_dlow(q, 0);
+    gtp5g_qer_set_qfi(q, 9);
+}
+
+static void bench_alloc_pdr(void)
+{
+    struct gtp5g_pdr *p = gtp5g_pdr_alloc();
+
+    fill_pdr(p, 0);
+    gtp5g_pdr_free(p);
+}
+
+static void bench_alloc_far(void)
+{
+    struct gtp5g_far *f = gtp5g_far_alloc();
+
+    fill_far(f);
+    gtp5g_far_free(f);
+}
+
+static void bench_alloc_qer(void)
+{
+    struct gtp5g_qer *q = gtp5g_qer_alloc();
+
+    fill_qer(q);
+    gtp5g_qer_free(q);
+}
+
+static void bench_build_pdr(void)
+{
+    struct nlmsghdr *nlh;
+
+    nlh = genl_nlmsg_build_hdr(scratch, FAMILY_ID, NLM_F_EXCL | NLM_F_ACK, 1, GTP5G_CMD_ADD_PDR);
+    gtp5g_build_pdr_payload(nlh, MSG_SIZE, dev, pdr);
+}
+
+static void bench_build_far(void)
+{
+    struct nlmsghdr *nlh;
+
+    nlh = genl_nlmsg_build_hdr(scratch, FAMILY_ID, NLM_F_EXCL | NLM_F_ACK, 1, GTP5G_CMD_ADD_FAR);
+    gtp5g_build_far_payload(nlh, MSG_SIZE, dev, far);
+}
+
+static void bench_build_qer(void)
+{
+    struct nlmsghdr *nlh;
+
+    nlh = genl_nlmsg_build_hdr(scratch, FAMILY_ID, NLM_F_EXCL | NLM_F_ACK, 1, GTP5G_CMD_ADD_QER);
+    gtp5g_build_qer_payload(nlh, MSG_SIZE, dev, qer);
+}
+
+static void bench_parse_pdr(void)
+{
+    struct gtp5g_pdr *p;
+
+    genl_gtp5g_pdr_attr_cb((struct nlmsghdr *) pdr_msg, &p);
+    gtp5g_pdr_free(p);
+}
+
+static void bench_parse_far(void)
+{
+    struct gtp5g_far *f;
+
+    genl_gtp5g_far_attr_cb((struct nlmsghdr *) far_msg, &f);
+    gtp5g_far_free(f);
+}
+
+static void bench_parse_qer(void)
+{
+    struct gtp5g_qer *q;
+
+    genl_gtp5g_qer_attr_cb((struct nlmsghdr *) qer_msg, &q);
+    gtp5g_qer_free(q);
+}
+
+/* Into one object for the whole run, as a dump does */
+static void bench_parse_pdr_into(void)
+{
+    static struct gtp5g_pdr *p;
+
+    if (!p)
+        p = gtp5g_pdr_alloc();
+    genl_gtp5g_pdr_attr_into_cb((struct nlmsghdr *) pdr_msg, p);
+}
+
+static void bench_parse_far_into(void)
+{
+    static struct gtp5g_far *f;
+
+    if (!f)
+        f = gtp5g_far_alloc();
+    genl_gtp5g_far_attr_into_cb((struct nlmsghdr *) far_msg, f);
+}
+
+static void bench_parse_qer_into(void)
+{
+    static struct gtp5g_qer *q;
+
+    if (!q)
+        q = gtp5g_qer_alloc();
+    genl_gtp5g_qer_attr_into_cb((struct nlmsghdr *) qer_msg, q);
+}
+
+/* What a view-based dump does per rule: parse and read a few fields */
+static volatile uint32_t view_sum;
+
+static void bench_view_pdr(void)
+{
+    struct gtp5g_pdr_view v;
+    const uint32_t *teid;
+    int num;
+
+    genl_gtp5g_pdr_view_parse((struct nlmsghdr *) pdr_msg, &v);
+    teid = gtp5g_pdr_view_get_local_f_teid_teid(&v);
+    view_sum += *gtp5g_pdr_view_get_id(&v) + (teid ? *teid : 0);
+    gtp5g_pdr_view_get_sdf_dest_ports(&v, &num);
+    view_sum += num;
+}
+
+static void bench_view_far(void)
+{
+    struct gtp5g_far_view v;
+    const uint32_t *teid;
+
+    genl_gtp5g_far_view_parse((struct nlmsghdr *) far_msg, &v);
+    teid = gtp5g_far_view_get_outer_header_creation_teid(&v);
+    view_sum += *gtp5g_far_view_get_id(&v) + (teid ? *teid : 0);
+}
+
+static void bench_view_qer(void)
+{
+    struct gtp5g_qer_view v;
+    const uint8_t *qfi;
+
+    genl_gtp5g_qer_view_parse((struct nlmsghdr *) qer_msg, &v);
+    qfi = gtp5g_qer_view_get_qfi(&v);
+    view_sum += *gtp5g_qer_view_get_id(&v) + (qfi ? *qfi : 0);
+}
+
+static void bench_sdf_description(void)
+{
+    struct gtp5g_pdr *p = gtp5g_pdr_alloc();
+
+    gtp5g_pdr_set_sdf_filter_description(p, SDF_DESC);
+    gtp5g_pdr_free(p);
+}
+
+static void bench_port_list(void)
+{
+    char list[] = PORT_LIST;
+    int num;
+
+    gtp5g_free(gtp5g_allocator, port_list_create(gtp5g_allocator, list, &num));
+}
+
+static const struct {
+    const char *name;
+    void (*fn)(void);
+} benches[] = {
+    { "pdr_alloc_set_free",     bench_alloc_pdr },
+    { "far_alloc_set_free",     bench_alloc_far },
+    { "qer_alloc_set_free",     bench_alloc_qer },
+    { "build_pdr_payload",      bench_build_pdr },
+    { "build_far_payload",      bench_build_far },
+    { "build_qer_payload",      bench_build_qer },
+    { "parse_pdr",              bench_parse_pdr },
+    { "parse_far",              bench_parse_far },
+    { "parse_qer",              bench_parse_qer },
+    { "parse_pdr_into",         bench_parse_pdr_into },
+    { "parse_far_into",         bench_parse_far_into },
+    { "parse_qer_into",         bench_parse_qer_into },
+    { "view_pdr",               bench_view_pdr },
+    { "view_far",               bench_view_far },
+    { "view_qer",               bench_view_qer },
+    { "sdf_filter_description", bench_sdf_description },
+    { "port_list_create",       bench_port_list },
+};
+
+static void run(const char *name, void (*fn)(void))
+{
+    unsigned long iters = 1, i, a;
+    double start, elapsed;
+
+    /* Warm up, then double the iterations until the run is long enough */
+    fn();
+    for (;;) {
+        a = allocs;
+        start = now();
+        for (i = 0; i < iters; i++)
+            fn();
+        elapsed = now() - start;
+        a = allocs - a;
+
+        if (elapsed >= MIN_TIME)
+            break;
+        iters *= 2;
+    }
+
+    printf("%-24s %12lu %10.1f ns/op %8.2f allocs/op\n",
+           name, iters, elapsed * 1e9 / iters, (double) a / iters);
+}
+
+static void usage(const char *name)
+{
+    unsigned int i;
+
+    printf("%s [-f <filter>] [-l]\n", name);
+    printf("\t-f <filter>\trun only the benchmarks whose name contains <filter>\n");
+    printf("\t-l\t\tlist the benchmarks\n");
+    printf("benchmarks:\n");
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+        printf("\t%s\n", benches[i].name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filter = NULL;
+    struct nlmsghdr *nlh;
+    unsigned int i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:l")) != -1) {
+        switch (opt) {
+        case 'f':
+            filter = optarg;
+            break;
+        case 'l':
+            for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+                printf("%s\n", benches[i].name);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    dev = gtp5g_dev_alloc();
+    gtp5g_dev_set_ifidx(dev, 1);
+
+    pdr = gtp5g_pdr_alloc();
+    fill_pdr(pdr, 1);
+    far = gtp5g_far_alloc();
+    fill_far(far);
+    qer = gtp5g_qer_alloc();
+    fill_qer(qer);
+
+    /* A request carries the same attributes as the kernel reply, the
+     * parsers skip the ones they do not know */
+    nlh = genl_nlmsg_build_hdr(pdr_msg, FAMILY_ID, 0, 1, GTP5G_CMD_GET_PDR);
+    gtp5g_build_pdr_payload(nlh, MSG_SIZE, dev, pdr);
+    nlh = genl_nlmsg_build_hdr(far_msg, FAMILY_ID, 0, 1, GTP5G_CMD_GET_FAR);
+    gtp5g_build_far_payload(nlh, MSG_SIZE, dev, far);
+    nlh = genl_nlmsg_build_hdr(qer_msg, FAMILY_ID, 0, 1, GTP5G_CMD_GET_QER);
+    gtp5g_build_qer_payload(nlh, MSG_SIZE, dev, qer);
+
+    printf("%-24s %12s %13s %18s\n", "benchmark", "iterations", "time", "allocations");
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (filter && !strstr(benches[i].name, filter))
+            continue;
+        run(benches[i].name, benches[i].fn);
+    }
+
+    gtp5g_qer_free(qer);
+    gtp5g_far_free(far);
+    gtp5g_pdr_free(pdr);
+    gtp5g_dev_free(dev);
+
+    return EXIT_SUCCESS;
+}
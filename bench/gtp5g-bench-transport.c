@@ -0,0 +1,217 @@
+/* Benchmark of PDR add/delete rate per netlink transport */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+
+#include <libmnl/libmnl.h>
+
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "gtp5g-fake.h"
+
+static const struct {
+    const char *name;
+    enum genl_transport transport;
+} transports[] = {
+    { "socket",   GENL_TRANSPORT_SOCKET },
+    { "io_uring", GENL_TRANSPORT_IO_URING },
+    { "fake",     GENL_TRANSPORT_CUSTOM },
+};
+
+static void usage(const char *name)
+{
+    printf("%s [-n <rules>] [-r <runs>] <gtp device>\n", name);
+    printf("%s -F [-n <rules>] [-r <runs>]\n", name);
+    printf("\t-n <rules>\tPDRs added and deleted per run (default 10000, at most 65535)\n");
+    printf("\t-r <runs>\truns per transport (default 5)\n");
+    printf("\t-F\t\tonly run against the in-process fake gtp5g, no device needed\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Add and delete rules PDRs, returns the number of requests done */
+static int churn(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, int rules)
+{
+    struct gtp5g_pdr *pdr = gtp5g_pdr_alloc();
+    struct in_addr ue, gtpu;
+    int i, done = 0;
+
+    inet_pton(AF_INET, "10.0.0.1", &gtpu);
+    gtp5g_pdr_set_precedence(pdr, 255);
+    gtp5g_pdr_set_far_id(pdr, 1);
+
+    for (i = 0; i < rules; i++) {
+        ue.s_addr = htonl(0x0a800000 + i);
+        gtp5g_pdr_set_id(pdr, i + 1);
+        gtp5g_pdr_set_ue_addr_ipv4(pdr, &ue);
+        gtp5g_pdr_set_local_f_teid(pdr, i + 1, &gtpu);
+        if (gtp5g_add_pdr(genl_id, nl, dev, pdr) < 0)
+            goto out;
+        done++;
+    }
+    for (i = 0; i < rules; i++) {
+        gtp5g_pdr_set_id(pdr, i + 1);
+        if (gtp5g_del_pdr(genl_id, nl, dev, pdr) < 0)
+            goto out;
+        done++;
+    }
+out:
+    gtp5g_pdr_free(pdr);
+    return done;
+}
+
+static int add_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev,
+                   struct gtp5g_far *far)
+{
+    if (gtp5g_add_far(genl_id, nl, dev, far) < 0) {
+        fprintf(stderr, "add FAR: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct gtp5g_fake *fake;
+    struct gtp5g_dev *dev;
+    struct gtp5g_far *far;
+    struct mnl_socket *nl;
+    int rules = 10000, runs = 5, fake_only = 0;
+    int32_t genl_id = -1;
+    uint32_t ifidx = 1;
+    unsigned int t;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "n:r:F")) != -1) {
+        switch (opt) {
+        case 'n':
+            rules = atoi(optarg);
+            break;
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        case 'F':
+            fake_only = 1;
+            break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((!fake_only && optind >= argc) || rules < 1 || rules > 65535) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!fake_only) {
+        ifidx = if_nametoindex(argv[optind]);
+        if (!ifidx) {
+            fprintf(stderr, "wrong GTP interface %s\n", argv[optind]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    nl = genl_socket_open();
+    if (nl == NULL) {
+        perror("genl_socket_open");
+        exit(EXIT_FAILURE);
+    }
+
+    dev = gtp5g_dev_alloc();
+    gtp5g_dev_set_ifidx(dev, ifidx);
+
+    far = gtp5g_far_alloc();
+    gtp5g_far_set_id(far, 1);
+    gtp5g_far_set_apply_action(far, 2);
+
+    if (!fake_only) {
+        genl_id = genl_lookup_family(nl, "gtp5g");
+        if (genl_id < 0) {
+            printf("not found gtp genl family\n");
+            exit(EXIT_FAILURE);
+        }
+        if (add_far(genl_id, nl, dev, far) < 0)
+            exit(EXIT_FAILURE);
+    }
+
+    /* The fake runs as a reference of what the library itself costs */
+    fake = gtp5g_fake_create();
+    gtp5g_fake_install(fake);
+    if (add_far(GTP5G_FAKE_FAMILY_ID, nl, dev, far) < 0)
+        exit(EXIT_FAILURE);
+
+    printf("%-10s %10s %12s %14s\n", "transport", "requests", "best (ms)", "rules/s");
+    for (t = 0; t < sizeof(transports) / sizeof(transports[0]); t++) {
+        int32_t id = genl_id;
+        double best = 0, start;
+        int done = 0;
+
+        if (transports[t].transport == GENL_TRANSPORT_CUSTOM)
+            id = GTP5G_FAKE_FAMILY_ID;
+        else if (fake_only)
+            continue;
+
+        if (genl_set_transport(transports[t].transport) < 0) {
+            printf("%-10s %s\n", transports[t].name, strerror(errno));
+            continue;
+        }
+
+        for (i = 0; i < runs; i++) {
+            start = now();
+            done = churn(id, nl, dev, rules);
+            start = now() - start;
+            if (done != 2 * rules) {
+                fprintf(stderr, "%s: %s\n", transports[t].name, strerror(errno));
+                break;
+            }
+            if (!i || start < best)
+                best = start;
+        }
+        if (done != 2 * rules)
+            continue;
+
+        printf("%-10s %10d %12.2f %14.0f\n", transports[t].name, done,
+               best * 1e3, done / best);
+    }
+
+    gtp5g_fake_uninstall();
+    if (!fake_only)
+        gtp5g_del_far(genl_id, nl, dev, far);
+    gtp5g_fake_destroy(fake);
+
+    gtp5g_far_free(far);
+    gtp5g_dev_free(dev);
+    genl_socket_close(nl);
+    return 0;
+}
@@ -0,0 +1,1097 @@
+/* In-process stand-in for the gtp5g kernel module */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/genetlink.h>
+
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "gtp5g-fake.h"
+
+#define FAKE_NIL		UINT32_MAX
+#define FAKE_ATTR_MAX		16
+
+/* The kernel does not build dump skbs larger than this */
+#define FAKE_DUMP_SIZE		32768
+
+/* Receive buffer of the sockets replies are written to, most of it takes
+ * a whole dump of a test table */
+#define FAKE_SOCK_RCVBUF	(1 << 20)
+
+/* gtp5g reports at most this many related PDRs of a FAR/QER */
+#define FAKE_RELATED_MAX	0xff
+
+struct fake_entry {
+	uint32_t	ifidx;
+	uint32_t	id;
+	uint32_t	next;		/* hash chain, or free list when unused */
+	int		used;
+
+	/* Rules: the attributes of the request, without the device */
+	void		*attrs;
+	uint32_t	len;
+	uint32_t	far_id;		/* PDR only, 0 if none */
+	uint32_t	qer_id;
+
+	/* References: IDs of the PDRs pointing at a FAR/QER */
+	uint16_t	*ids;
+	uint32_t	num;
+	uint32_t	cap;
+};
+
+/* Entries live in a slot array so that dumps can walk them by position,
+ * a chained hash on (ifidx, id) points into it */
+struct fake_table {
+	struct fake_entry	*entry;
+	uint32_t		nr;		/* slots ever used */
+	uint32_t		cap;
+	uint32_t		free;
+	uint32_t		*bucket;
+	uint32_t		nbucket;	/* power of two */
+	uint32_t		count;
+};
+
+struct fake_msg {
+	struct fake_msg	*next;
+	uint32_t	portid;		/* of the socket it is for */
+	size_t		len;
+	char		buf[];
+};
+
+struct fake_dump {
+	int		active;
+	int		done;		/* only NLMSG_DONE is left */
+	enum gtp5g_fake_table table;
+	uint32_t	pos;
+	uint32_t	gen;
+	int		intr;
+	uint32_t	seq;
+	uint32_t	portid;
+};
+
+struct gtp5g_fake {
+	struct fake_table	rules[__GTP5G_FAKE_TABLE_MAX];
+	struct fake_table	refs[__GTP5G_FAKE_TABLE_MAX];	/* FAR and QER */
+	uint32_t		gen;
+	unsigned int		dump_intr;
+	struct fake_dump	dump;
+	uint32_t		portid;
+	struct fake_msg		*head;
+	struct fake_msg		**tail;
+	int			sdf_list;
+	int			sock;		/* writes replies, or -1 */
+};
+
+struct fake_kind {
+	uint8_t		add;
+	uint8_t		del;
+	uint8_t		get;
+	int		id_type;	/* MNL_TYPE_U16 or MNL_TYPE_U32 */
+	int		attr_max;
+	int		related;	/* attribute carrying the PDR references */
+};
+
+static const struct fake_kind fake_kinds[__GTP5G_FAKE_TABLE_MAX] = {
+	[GTP5G_FAKE_PDR] = {
+		.add		= GTP5G_CMD_ADD_PDR,
+		.del		= GTP5G_CMD_DEL_PDR,
+		.get		= GTP5G_CMD_GET_PDR,
+		.id_type	= MNL_TYPE_U16,
+		.attr_max	= GTP5G_PDR_ATTR_MAX,
+	},
+	[GTP5G_FAKE_FAR] = {
+		.add		= GTP5G_CMD_ADD_FAR,
+		.del		= GTP5G_CMD_DEL_FAR,
+		.get		= GTP5G_CMD_GET_FAR,
+		.id_type	= MNL_TYPE_U32,
+		.attr_max	= GTP5G_FAR_ATTR_MAX,
+		.related	= GTP5G_FAR_RELATED_TO_PDR,
+	},
+	[GTP5G_FAKE_QER] = {
+		.add		= GTP5G_CMD_ADD_QER,
+		.del		= GTP5G_CMD_DEL_QER,
+		.get		= GTP5G_CMD_GET_QER,
+		.id_type	= MNL_TYPE_U32,
+		.attr_max	= GTP5G_QER_ATTR_MAX,
+		.related	= GTP5G_QER_RELATED_TO_PDR,
+	},
+};
+
+static uint32_t fake_hash(uint32_t ifidx, uint32_t id)
+{
+	return (ifidx * 0x9e3779b1u) ^ (id * 0x85ebca6bu);
+}
+
+static struct fake_entry *fake_table_find(struct fake_table *t, uint32_t ifidx,
+					  uint32_t id)
+{
+	struct fake_entry *e;
+	uint32_t i;
+
+	if (!t->nbucket)
+		return NULL;
+
+	for (i = t->bucket[fake_hash(ifidx, id) & (t->nbucket - 1)];
+	     i != FAKE_NIL; i = e->next) {
+		e = &t->entry[i];
+		if (e->ifidx == ifidx && e->id == id)
+			return e;
+	}
+
+	return NULL;
+}
+
+static int fake_table_rehash(struct fake_table *t, uint32_t nbucket)
+{
+	uint32_t *bucket, i, h;
+
+	bucket = malloc(nbucket * sizeof(*bucket));
+	if (!bucket)
+		return -1;
+	for (i = 0; i < nbucket; i++)
+		bucket[i] = FAKE_NIL;
+
+	for (i = 0; i < t->nr; i++) {
+		if (!t->entry[i].used)
+			continue;
+		h = fake_hash(t->entry[i].ifidx, t->entry[i].id) & (nbucket - 1);
+		t->entry[i].next = bucket[h];
+		bucket[h] = i;
+	}
+
+	free(t->bucket);
+	t->bucket = bucket;
+	t->nbucket = nbucket;
+	return 0;
+}
+
+static struct fake_entry *fake_table_insert(struct fake_table *t, uint32_t ifidx,
+					    uint32_t id)
+{
+	struct fake_entry *e;
+	uint32_t i, h;
+
+	if (t->count >= t->nbucket &&
+	    fake_table_rehash(t, t->nbucket ? t->nbucket * 2 : 64) < 0)
+		return NULL;
+
+	if (t->free != FAKE_NIL) {
+		i = t->free;
+		t->free = t->entry[i].next;
+	}
+	else {
+		if (t->nr == t->cap) {
+			uint32_t cap = t->cap ? t->cap * 2 : 64;
+
+			e = realloc(t->entry, cap * sizeof(*e));
+			if (!e)
+				return NULL;
+			t->entry = e;
+			t->cap = cap;
+		}
+		i = t->nr++;
+	}
+
+	e = &t->entry[i];
+	memset(e, 0, sizeof(*e));
+	e->ifidx = ifidx;
+	e->id = id;
+	e->used = 1;
+
+	h = fake_hash(ifidx, id) & (t->nbucket - 1);
+	e->next = t->bucket[h];
+	t->bucket[h] = i;
+	t->count++;
+
+	return e;
+}
+
+static void fake_table_remove(struct fake_table *t, struct fake_entry *e)
+{
+	uint32_t i = e - t->entry;
+	uint32_t *p = &t->bucket[fake_hash(e->ifidx, e->id) & (t->nbucket - 1)];
+
+	while (*p != i)
+		p = &t->entry[*p].next;
+	*p = e->next;
+
+	free(e->attrs);
+	free(e->ids);
+	e->used = 0;
+	e->next = t->free;
+	t->free = i;
+	t->count--;
+}
+
+static void fake_table_free(struct fake_table *t)
+{
+	uint32_t i;
+
+	for (i = 0; i < t->nr; i++) {
+		if (t->entry[i].used) {
+			free(t->entry[i].attrs);
+			free(t->entry[i].ids);
+		}
+	}
+	free(t->entry);
+	free(t->bucket);
+}
+
+static void fake_ref_add(struct fake_table *t, uint32_t ifidx, uint32_t id,
+			 uint16_t pdr_id)
+{
+	struct fake_entry *e;
+	uint16_t *ids;
+
+	if (!id)
+		return;
+
+	e = fake_table_find(t, ifidx, id);
+	if (!e)
+		e = fake_table_insert(t, ifidx, id);
+	if (!e)
+		return;
+
+	if (e->num == e->cap) {
+		ids = realloc(e->ids, (e->cap ? e->cap * 2 : 4) * sizeof(*ids));
+		if (!ids)
+			return;
+		e->ids = ids;
+		e->cap = e->cap ? e->cap * 2 : 4;
+	}
+	e->ids[e->num++] = pdr_id;
+}
+
+static void fake_ref_del(struct fake_table *t, uint32_t ifidx, uint32_t id,
+			 uint16_t pdr_id)
+{
+	struct fake_entry *e;
+	uint32_t i;
+
+	if (!id)
+		return;
+
+	e = fake_table_find(t, ifidx, id);
+	if (!e)
+		return;
+
+	for (i = 0; i < e->num; i++) {
+		if (e->ids[i] == pdr_id) {
+			e->ids[i] = e->ids[--e->num];
+			break;
+		}
+	}
+	if (!e->num)
+		fake_table_remove(t, e);
+}
+
+static struct fake_msg *fake_msg_alloc(size_t len)
+{
+	struct fake_msg *msg;
+
+	msg = calloc(1, sizeof(*msg) + len);
+	if (msg)
+		msg->len = len;
+	return msg;
+}
+
+static void fake_msg_queue(struct gtp5g_fake *fake, struct fake_msg *msg)
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr *)msg->buf;
+
+	msg->len = nlh->nlmsg_len;
+	msg->portid = fake->portid;
+	*fake->tail = msg;
+	fake->tail = &msg->next;
+}
+
+/* Queue a copy of a message built on the stack, at its length */
+static void fake_msg_queue_copy(struct gtp5g_fake *fake, const struct nlmsghdr *nlh)
+{
+	struct fake_msg *msg = fake_msg_alloc(nlh->nlmsg_len);
+
+	if (!msg)
+		return;
+	memcpy(msg->buf, nlh, nlh->nlmsg_len);
+	fake_msg_queue(fake, msg);
+}
+
+static struct nlmsghdr *fake_put_header(char *buf, uint16_t type, uint16_t flags,
+					uint32_t seq, uint32_t portid)
+{
+	struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+
+	nlh->nlmsg_type = type;
+	nlh->nlmsg_flags = flags;
+	nlh->nlmsg_seq = seq;
+	nlh->nlmsg_pid = portid;
+	return nlh;
+}
+
+/* Error and ACK messages, as with NETLINK_CAP_ACK and NETLINK_EXT_ACK */
+static void fake_ack(struct gtp5g_fake *fake, const struct nlmsghdr *req,
+		     int err, const char *text, const struct nlattr *attr)
+{
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nlmsghdr *nlh;
+	struct nlmsgerr *e;
+	uint16_t flags = NLM_F_CAPPED;
+
+	if (!err && !(req->nlmsg_flags & NLM_F_ACK))
+		return;
+
+	if (err && (text || attr))
+		flags |= NLM_F_ACK_TLVS;
+
+	nlh = fake_put_header(buf, NLMSG_ERROR, flags, req->nlmsg_seq, fake->portid);
+	e = mnl_nlmsg_put_extra_header(nlh, sizeof(*e));
+	e->error = -err;
+	e->msg = *req;
+
+	if (err && text)
+		mnl_attr_put_strz(nlh, NLMSGERR_ATTR_MSG, text);
+	if (err && attr)
+		mnl_attr_put_u32(nlh, NLMSGERR_ATTR_OFFS,
+				 (const char *)attr - (const char *)req);
+
+	fake_msg_queue_copy(fake, nlh);
+}
+
+struct fake_parse {
+	const struct fake_kind	*kind;
+	const struct nlattr	**tb;
+	const struct nlattr	*bad;
+};
+
+static int fake_validate_cb(const struct nlattr *attr, void *data)
+{
+	struct fake_parse *p = data;
+	int type = mnl_attr_get_type(attr);
+	int ret = 0;
+
+	if (mnl_attr_type_valid(attr, p->kind->attr_max) < 0)
+		return MNL_CB_OK;
+
+	switch (type) {
+	case GTP5G_LINK:
+	case GTP5G_NET_NS_FD:
+		ret = mnl_attr_validate(attr, MNL_TYPE_U32);
+		break;
+	case GTP5G_PDR_ID:	/* same value for FAR and QER */
+		ret = mnl_attr_validate(attr, p->kind->id_type);
+		break;
+	}
+
+	if (p->kind == &fake_kinds[GTP5G_FAKE_PDR]) {
+		switch (type) {
+		case GTP5G_PDR_PRECEDENCE:
+		case GTP5G_PDR_FAR_ID:
+		case GTP5G_PDR_QER_ID:
+			ret = mnl_attr_validate(attr, MNL_TYPE_U32);
+			break;
+		case GTP5G_PDR_PDI:
+			ret = mnl_attr_validate(attr, MNL_TYPE_NESTED);
+			break;
+		}
+	}
+
+	if (ret < 0) {
+		p->bad = attr;
+		return MNL_CB_ERROR;
+	}
+
+	p->tb[type] = attr;
+	return MNL_CB_OK;
+}
+
+static uint32_t fake_get_id(const struct fake_kind *kind, const struct nlattr *attr)
+{
+	return kind->id_type == MNL_TYPE_U16 ? mnl_attr_get_u16(attr) :
+					       mnl_attr_get_u32(attr);
+}
+
+/* Stored attributes of e, with those of tb taking precedence */
+static int fake_store(struct fake_entry *e, const struct fake_kind *kind,
+		      const struct nlattr **tb)
+{
+	const struct nlattr *old[FAKE_ATTR_MAX + 1] = {};
+	const struct nlattr *attr;
+	size_t len = 0;
+	char *buf, *p;
+	int type;
+
+	if (e->attrs) {
+		mnl_attr_for_each_payload(e->attrs, e->len) {
+			if (mnl_attr_get_type(attr) <= kind->attr_max)
+				old[mnl_attr_get_type(attr)] = attr;
+		}
+	}
+
+	for (type = GTP5G_NET_NS_FD + 1; type <= kind->attr_max; type++) {
+		if (type == kind->related)
+			continue;
+		attr = tb[type] ? tb[type] : old[type];
+		if (attr)
+			len += MNL_ALIGN(attr->nla_len);
+	}
+
+	buf = p = malloc(len ? len : 1);
+	if (!buf)
+		return -1;
+
+	for (type = GTP5G_NET_NS_FD + 1; type <= kind->attr_max; type++) {
+		if (type == kind->related)
+			continue;
+		attr = tb[type] ? tb[type] : old[type];
+		if (attr) {
+			memcpy(p, attr, attr->nla_len);
+			memset(p + attr->nla_len, 0, MNL_ALIGN(attr->nla_len) - attr->nla_len);
+			p += MNL_ALIGN(attr->nla_len);
+		}
+	}
+
+	free(e->attrs);
+	e->attrs = buf;
+	e->len = len;
+	return 0;
+}
+
+static void fake_pdr_refs(struct gtp5g_fake *fake, struct fake_entry *e, int add)
+{
+	void (*ref)(struct fake_table *, uint32_t, uint32_t, uint16_t);
+
+	ref = add ? fake_ref_add : fake_ref_del;
+	ref(&fake->refs[GTP5G_FAKE_FAR], e->ifidx, e->far_id, e->id);
+	ref(&fake->refs[GTP5G_FAKE_QER], e->ifidx, e->qer_id, e->id);
+}
+
+static uint32_t fake_related_num(const struct fake_entry *refs)
+{
+	return refs->num < FAKE_RELATED_MAX ? refs->num : FAKE_RELATED_MAX;
+}
+
+static size_t fake_entry_size(struct gtp5g_fake *fake, enum gtp5g_fake_table table,
+			      struct fake_entry *e, struct fake_entry **refs)
+{
+	size_t len = MNL_NLMSG_HDRLEN + MNL_ALIGN(GENL_HDRLEN) + e->len;
+
+	*refs = NULL;
+	if (fake_kinds[table].related) {
+		*refs = fake_table_find(&fake->refs[table], e->ifidx, e->id);
+		if (*refs)
+			len += MNL_ATTR_HDRLEN +
+			       MNL_ALIGN(fake_related_num(*refs) * sizeof(uint16_t));
+	}
+
+	return len;
+}
+
+static void fake_put_entry(char *buf, enum gtp5g_fake_table table,
+			   struct fake_entry *e, struct fake_entry *refs,
+			   uint16_t flags, uint32_t seq, uint32_t portid)
+{
+	struct genlmsghdr *genl;
+	struct nlmsghdr *nlh;
+
+	nlh = fake_put_header(buf, GTP5G_FAKE_FAMILY_ID, flags, seq, portid);
+	genl = mnl_nlmsg_put_extra_header(nlh, sizeof(*genl));
+	genl->cmd = fake_kinds[table].get;
+
+	memcpy(mnl_nlmsg_get_payload_tail(nlh), e->attrs, e->len);
+	nlh->nlmsg_len += e->len;
+
+	if (refs)
+		mnl_attr_put(nlh, fake_kinds[table].related,
+			     fake_related_num(refs) * sizeof(uint16_t), refs->ids);
+}
+
+static void fake_doit(struct gtp5g_fake *fake, const struct nlmsghdr *req,
+		      enum gtp5g_fake_table table, uint8_t cmd)
+{
+	const struct fake_kind *kind = &fake_kinds[table];
+	const struct nlattr *tb[FAKE_ATTR_MAX + 1] = {};
+	struct fake_parse p = {
+		.kind	= kind,
+		.tb	= tb,
+	};
+	struct fake_table *t = &fake->rules[table];
+	struct fake_entry *e, *refs;
+	struct fake_msg *msg;
+	uint32_t ifidx, id;
+	int replace = 0;
+
+	if (mnl_attr_parse(req, GENL_HDRLEN, fake_validate_cb, &p) < 0) {
+		fake_ack(fake, req, EINVAL, "Attribute failed policy validation", p.bad);
+		return;
+	}
+
+	if (!tb[GTP5G_LINK] || !(ifidx = mnl_attr_get_u32(tb[GTP5G_LINK]))) {
+		fake_ack(fake, req, ENODEV, "Missing GTP5G_LINK", NULL);
+		return;
+	}
+	if (!tb[GTP5G_PDR_ID]) {
+		fake_ack(fake, req, EINVAL, "Missing rule ID", NULL);
+		return;
+	}
+	id = fake_get_id(kind, tb[GTP5G_PDR_ID]);
+	e = fake_table_find(t, ifidx, id);
+
+	if (cmd == kind->get) {
+		if (!e) {
+			fake_ack(fake, req, ENOENT, NULL, tb[GTP5G_PDR_ID]);
+			return;
+		}
+		msg = fake_msg_alloc(fake_entry_size(fake, table, e, &refs));
+		if (!msg) {
+			fake_ack(fake, req, ENOMEM, NULL, NULL);
+			return;
+		}
+		fake_put_entry(msg->buf, table, e, refs, 0, req->nlmsg_seq, fake->portid);
+		fake_msg_queue(fake, msg);
+		fake_ack(fake, req, 0, NULL, NULL);
+		return;
+	}
+
+	if (cmd == kind->del) {
+		if (!e) {
+			fake_ack(fake, req, ENOENT, NULL, tb[GTP5G_PDR_ID]);
+			return;
+		}
+		if (table == GTP5G_FAKE_PDR)
+			fake_pdr_refs(fake, e, 0);
+		fake_table_remove(t, e);
+		fake->gen++;
+		fake_ack(fake, req, 0, NULL, NULL);
+		return;
+	}
+
+	/* Same rules for existing entries as gtp5g */
+	if (e) {
+		if (req->nlmsg_flags & NLM_F_EXCL) {
+			fake_ack(fake, req, EEXIST, NULL, tb[GTP5G_PDR_ID]);
+			return;
+		}
+		if (!(req->nlmsg_flags & NLM_F_REPLACE)) {
+			fake_ack(fake, req, EOPNOTSUPP, NULL, NULL);
+			return;
+		}
+		replace = 1;
+	}
+	else {
+		if (req->nlmsg_flags & NLM_F_REPLACE) {
+			fake_ack(fake, req, ENOENT, NULL, tb[GTP5G_PDR_ID]);
+			return;
+		}
+		if (req->nlmsg_flags & NLM_F_APPEND) {
+			fake_ack(fake, req, EOPNOTSUPP, NULL, NULL);
+			return;
+		}
+		e = fake_table_insert(t, ifidx, id);
+		if (!e) {
+			fake_ack(fake, req, ENOMEM, NULL, NULL);
+			return;
+		}
+	}
+
+	if (table == GTP5G_FAKE_PDR && replace)
+		fake_pdr_refs(fake, e, 0);
+
+	if (fake_store(e, kind, tb) < 0) {
+		if (!replace)
+			fake_table_remove(t, e);
+		fake_ack(fake, req, ENOMEM, NULL, NULL);
+		return;
+	}
+
+	if (table == GTP5G_FAKE_PDR) {
+		if (tb[GTP5G_PDR_FAR_ID])
+			e->far_id = mnl_attr_get_u32(tb[GTP5G_PDR_FAR_ID]);
+		if (tb[GTP5G_PDR_QER_ID])
+			e->qer_id = mnl_attr_get_u32(tb[GTP5G_PDR_QER_ID]);
+		fake_pdr_refs(fake, e, 1);
+	}
+
+	fake->gen++;
+	fake_ack(fake, req, 0, NULL, NULL);
+}
+
+static void fake_dump_start(struct gtp5g_fake *fake, const struct nlmsghdr *req,
+			    enum gtp5g_fake_table table)
+{
+	struct fake_dump *d = &fake->dump;
+
+	memset(d, 0, sizeof(*d));
+	d->active = 1;
+	d->table = table;
+	d->gen = fake->gen;
+	d->seq = req->nlmsg_seq;
+	d->portid = fake->portid;
+	if (fake->dump_intr) {
+		fake->dump_intr--;
+		d->intr = 1;
+	}
+}
+
+/* Fill buf with the next part of the dump, like netlink_dump() does */
+static ssize_t fake_dump_fill(struct gtp5g_fake *fake, char *buf, size_t len)
+{
+	struct fake_dump *d = &fake->dump;
+	struct fake_table *t = &fake->rules[d->table];
+	struct fake_entry *e, *refs;
+	struct nlmsghdr *nlh;
+	uint16_t flags = NLM_F_MULTI;
+	size_t off = 0, size;
+
+	if (len > FAKE_DUMP_SIZE)
+		len = FAKE_DUMP_SIZE;
+
+	for (; !d->done && d->pos < t->nr; d->pos++) {
+		e = &t->entry[d->pos];
+		if (!e->used)
+			continue;
+
+		if (d->intr || d->gen != fake->gen)
+			flags |= NLM_F_DUMP_INTR;
+
+		size = fake_entry_size(fake, d->table, e, &refs);
+		if (off + size > len) {
+			if (off)
+				return off;
+			errno = ENOSPC;
+			return -1;
+		}
+		fake_put_entry(buf + off, d->table, e, refs, flags, d->seq, d->portid);
+		off += size;
+	}
+	d->done = 1;
+
+	if (off + MNL_NLMSG_HDRLEN + sizeof(int) > len)
+		return off;
+
+	if (d->intr || d->gen != fake->gen)
+		flags |= NLM_F_DUMP_INTR;
+	nlh = fake_put_header(buf + off, NLMSG_DONE, flags, d->seq, d->portid);
+	*(int *)mnl_nlmsg_put_extra_header(nlh, sizeof(int)) = 0;
+	off += nlh->nlmsg_len;
+	d->active = 0;
+
+	return off;
+}
+
+#if HAVE_DECL_CTRL_ATTR_OP
+static struct nlmsghdr *fake_policy_header(struct gtp5g_fake *fake,
+					   const struct nlmsghdr *req, char *buf)
+{
+	struct nlmsghdr *nlh;
+	struct genlmsghdr *rgenl;
+
+	nlh = fake_put_header(buf, GENL_ID_CTRL, NLM_F_MULTI, req->nlmsg_seq, fake->portid);
+	rgenl = mnl_nlmsg_put_extra_header(nlh, sizeof(*rgenl));
+	rgenl->cmd = CTRL_CMD_GETPOLICY;
+	rgenl->version = 2;
+	mnl_attr_put_u16(nlh, CTRL_ATTR_FAMILY_ID, GTP5G_FAKE_FAMILY_ID);
+	return nlh;
+}
+
+/* Policy of GTP5G_CMD_ADD_PDR, as far as the library asks for it: policy 0
+ * has the PDI nest, policy 1 its attributes */
+static void fake_ctrl_policy(struct gtp5g_fake *fake, const struct nlmsghdr *req)
+{
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nlmsghdr *nlh;
+	struct nlattr *n1, *n2, *n3;
+
+	nlh = fake_policy_header(fake, req, buf);
+	n1 = mnl_attr_nest_start(nlh, CTRL_ATTR_OP_POLICY);
+	n2 = mnl_attr_nest_start(nlh, GTP5G_CMD_ADD_PDR);
+	mnl_attr_put_u32(nlh, CTRL_ATTR_POLICY_DO, 0);
+	mnl_attr_nest_end(nlh, n2);
+	mnl_attr_nest_end(nlh, n1);
+	fake_msg_queue_copy(fake, nlh);
+
+	nlh = fake_policy_header(fake, req, buf);
+	n1 = mnl_attr_nest_start(nlh, CTRL_ATTR_POLICY);
+	n2 = mnl_attr_nest_start(nlh, 0);
+	n3 = mnl_attr_nest_start(nlh, GTP5G_PDR_PDI);
+	mnl_attr_put_u32(nlh, NL_POLICY_TYPE_ATTR_TYPE, NL_ATTR_TYPE_NESTED);
+	mnl_attr_put_u32(nlh, NL_POLICY_TYPE_ATTR_POLICY_IDX, 1);
+	mnl_attr_put_u32(nlh, NL_POLICY_TYPE_ATTR_POLICY_MAXTYPE, GTP5G_PDI_ATTR_MAX);
+	mnl_attr_nest_end(nlh, n3);
+	mnl_attr_nest_end(nlh, n2);
+	mnl_attr_nest_end(nlh, n1);
+	fake_msg_queue_copy(fake, nlh);
+
+	nlh = fake_policy_header(fake, req, buf);
+	n1 = mnl_attr_nest_start(nlh, CTRL_ATTR_POLICY);
+	n2 = mnl_attr_nest_start(nlh, 1);
+	n3 = mnl_attr_nest_start(nlh, GTP5G_PDI_SDF_FILTER);
+	mnl_attr_put_u32(nlh, NL_POLICY_TYPE_ATTR_TYPE, NL_ATTR_TYPE_NESTED);
+	mnl_attr_nest_end(nlh, n3);
+	if (fake->sdf_list) {
+		n3 = mnl_attr_nest_start(nlh, GTP5G_PDI_SDF_FILTER_LIST);
+		mnl_attr_put_u32(nlh, NL_POLICY_TYPE_ATTR_TYPE, NL_ATTR_TYPE_NESTED_ARRAY);
+		mnl_attr_nest_end(nlh, n3);
+	}
+	mnl_attr_nest_end(nlh, n2);
+	mnl_attr_nest_end(nlh, n1);
+	fake_msg_queue_copy(fake, nlh);
+
+	nlh = fake_put_header(buf, NLMSG_DONE, NLM_F_MULTI, req->nlmsg_seq, fake->portid);
+	*(int *)mnl_nlmsg_put_extra_header(nlh, sizeof(int)) = 0;
+	fake_msg_queue_copy(fake, nlh);
+}
+#endif
+
+static void fake_ctrl(struct gtp5g_fake *fake, const struct nlmsghdr *req)
+{
+	const struct genlmsghdr *genl = mnl_nlmsg_get_payload(req);
+	const struct nlattr *attr;
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct genlmsghdr *rgenl;
+	struct nlmsghdr *nlh;
+	const char *name = NULL;
+	int dump = (req->nlmsg_flags & NLM_F_DUMP) == NLM_F_DUMP;
+
+#if HAVE_DECL_CTRL_ATTR_OP
+	if (genl->cmd == CTRL_CMD_GETPOLICY && dump && fake->sdf_list >= 0) {
+		fake_ctrl_policy(fake, req);
+		return;
+	}
+#endif
+	if (genl->cmd != CTRL_CMD_GETFAMILY) {
+		fake_ack(fake, req, EOPNOTSUPP, NULL, NULL);
+		return;
+	}
+
+	mnl_attr_for_each(attr, req, GENL_HDRLEN) {
+		if (mnl_attr_get_type(attr) == CTRL_ATTR_FAMILY_NAME &&
+		    mnl_attr_validate(attr, MNL_TYPE_NUL_STRING) == 0)
+			name = mnl_attr_get_str(attr);
+	}
+	if (!dump && (!name || strcmp(name, "gtp5g"))) {
+		fake_ack(fake, req, ENOENT, NULL, NULL);
+		return;
+	}
+
+	nlh = fake_put_header(buf, GENL_ID_CTRL, dump ? NLM_F_MULTI : 0,
+			      req->nlmsg_seq, fake->portid);
+	rgenl = mnl_nlmsg_put_extra_header(nlh, sizeof(*rgenl));
+	rgenl->cmd = CTRL_CMD_NEWFAMILY;
+	rgenl->version = 2;
+	mnl_attr_put_u16(nlh, CTRL_ATTR_FAMILY_ID, GTP5G_FAKE_FAMILY_ID);
+	mnl_attr_put_strz(nlh, CTRL_ATTR_FAMILY_NAME, "gtp5g");
+	fake_msg_queue_copy(fake, nlh);
+
+	if (dump) {
+		nlh = fake_put_header(buf, NLMSG_DONE, NLM_F_MULTI,
+				      req->nlmsg_seq, fake->portid);
+		*(int *)mnl_nlmsg_put_extra_header(nlh, sizeof(int)) = 0;
+		fake_msg_queue_copy(fake, nlh);
+		return;
+	}
+
+	fake_ack(fake, req, 0, NULL, NULL);
+}
+
+static void fake_rcv_msg(struct gtp5g_fake *fake, const struct nlmsghdr *req)
+{
+	const struct genlmsghdr *genl;
+	enum gtp5g_fake_table table;
+	int dump = (req->nlmsg_flags & NLM_F_DUMP) == NLM_F_DUMP;
+
+	if (!(req->nlmsg_flags & NLM_F_REQUEST) || req->nlmsg_type < NLMSG_MIN_TYPE)
+		return;
+
+	if (mnl_nlmsg_get_payload_len(req) < GENL_HDRLEN) {
+		fake_ack(fake, req, EINVAL, NULL, NULL);
+		return;
+	}
+	genl = mnl_nlmsg_get_payload(req);
+
+	if (req->nlmsg_type == GENL_ID_CTRL) {
+		fake_ctrl(fake, req);
+		return;
+	}
+	if (req->nlmsg_type != GTP5G_FAKE_FAMILY_ID) {
+		fake_ack(fake, req, ENOENT, NULL, NULL);
+		return;
+	}
+
+	for (table = 0; table < __GTP5G_FAKE_TABLE_MAX; table++) {
+		const struct fake_kind *kind = &fake_kinds[table];
+
+		if (genl->cmd == kind->get && dump) {
+			fake_dump_start(fake, req, table);
+			return;
+		}
+		if (genl->cmd == kind->add || genl->cmd == kind->del ||
+		    genl->cmd == kind->get) {
+			fake_doit(fake, req, table, genl->cmd);
+			return;
+		}
+	}
+
+	fake_ack(fake, req, EOPNOTSUPP, NULL, NULL);
+}
+
+static int fake_send(struct mnl_socket *nl, const void *buf, size_t len, void *data)
+{
+	struct gtp5g_fake *fake = data;
+	const struct nlmsghdr *nlh = buf;
+	int rem = len;
+
+	/* Replies go to the port of the sender, whatever the request says */
+	fake->portid = mnl_socket_get_portid(nl);
+
+	/* Batches are processed message by message, as by the kernel */
+	while (mnl_nlmsg_ok(nlh, rem)) {
+		fake_rcv_msg(fake, nlh);
+		nlh = mnl_nlmsg_next(nlh, &rem);
+	}
+
+	return 0;
+}
+
+/* Each socket reads the replies to its own requests only */
+static ssize_t fake_recv(struct mnl_socket *nl, void *buf, size_t len, void *data)
+{
+	struct gtp5g_fake *fake = data;
+	uint32_t portid = mnl_socket_get_portid(nl);
+	struct fake_msg *msg, **pmsg;
+
+	for (pmsg = &fake->head; *pmsg; pmsg = &(*pmsg)->next) {
+		if ((*pmsg)->portid == portid)
+			break;
+	}
+
+	msg = *pmsg;
+	if (msg) {
+		*pmsg = msg->next;
+		if (!*pmsg)
+			fake->tail = pmsg;
+
+		if (msg->len > len) {
+			free(msg);
+			errno = ENOSPC;
+			return -1;
+		}
+		len = msg->len;
+		memcpy(buf, msg->buf, len);
+		free(msg);
+		return len;
+	}
+
+	if (fake->dump.active && fake->dump.portid == portid)
+		return fake_dump_fill(fake, buf, len);
+
+	/* A real socket would block forever */
+	errno = EAGAIN;
+	return -1;
+}
+
+static const struct genl_transport_ops fake_ops = {
+	.send	= fake_send,
+	.recv	= fake_recv,
+};
+
+/* Put a NETLINK_USERSOCK socket in place of the one of nl, which anyone may
+ * write to. Returns its port, or 0 on failure. */
+static uint32_t fake_sock_port(struct mnl_socket *nl)
+{
+	struct sockaddr_nl addr = { .nl_family = AF_NETLINK };
+	int fd = mnl_socket_get_fd(nl);
+	int proto, size = FAKE_SOCK_RCVBUF, fl, sock;
+	socklen_t len = sizeof(proto);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PROTOCOL, &proto, &len) < 0)
+		return 0;
+
+	if (proto != NETLINK_USERSOCK) {
+		sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_USERSOCK);
+		if (sock < 0)
+			return 0;
+		fl = fcntl(fd, F_GETFL);
+		if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		    fl < 0 || fcntl(sock, F_SETFL, fl) < 0 ||
+		    dup2(sock, fd) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+			close(sock);
+			return 0;
+		}
+		close(sock);
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	}
+
+	len = sizeof(addr);
+	if (getsockname(fd, (struct sockaddr *)&addr, &len) < 0)
+		return 0;
+	return addr.nl_pid;
+}
+
+static void fake_sock_write(struct gtp5g_fake *fake, uint32_t port,
+			    const void *buf, size_t len)
+{
+	struct sockaddr_nl addr = {
+		.nl_family	= AF_NETLINK,
+		.nl_pid		= port,
+	};
+
+	/* What does not fit is lost and the socket gets ENOBUFS, as with
+	 * the kernel */
+	sendto(fake->sock, buf, len, MSG_DONTWAIT, (struct sockaddr *)&addr,
+	       sizeof(addr));
+}
+
+/* Processes the requests like fake_send(), then writes their replies to
+ * the socket, all parts of a dump at once */
+static int fake_sock_send(struct mnl_socket *nl, const void *buf, size_t len,
+			  void *data)
+{
+	struct gtp5g_fake *fake = data;
+	uint32_t port = fake_sock_port(nl);
+	struct fake_msg *msg, **pmsg;
+	char *dump;
+	ssize_t ret;
+
+	if (!port) {
+		errno = ENOTCONN;
+		return -1;
+	}
+
+	fake_send(nl, buf, len, fake);
+
+	for (pmsg = &fake->head; (msg = *pmsg); ) {
+		if (msg->portid != fake->portid) {
+			pmsg = &msg->next;
+			continue;
+		}
+		*pmsg = msg->next;
+		fake_sock_write(fake, port, msg->buf, msg->len);
+		free(msg);
+	}
+	fake->tail = pmsg;
+
+	if (!fake->dump.active || fake->dump.portid != fake->portid)
+		return 0;
+
+	dump = malloc(FAKE_DUMP_SIZE);
+	if (!dump) {
+		errno = ENOMEM;
+		return -1;
+	}
+	while (fake->dump.active) {
+		ret = fake_dump_fill(fake, dump, FAKE_DUMP_SIZE);
+		if (ret < 0) {
+			fake->dump.active = 0;
+			break;
+		}
+		fake_sock_write(fake, port, dump, ret);
+	}
+	free(dump);
+	return 0;
+}
+
+static const struct genl_transport_ops fake_sock_ops = {
+	.send	= fake_sock_send,
+};
+
+struct gtp5g_fake *gtp5g_fake_create(void)
+{
+	struct gtp5g_fake *fake;
+	int i;
+
+	fake = calloc(1, sizeof(*fake));
+	if (!fake)
+		return NULL;
+
+	for (i = 0; i < __GTP5G_FAKE_TABLE_MAX; i++) {
+		fake->rules[i].free = FAKE_NIL;
+		fake->refs[i].free = FAKE_NIL;
+	}
+	fake->tail = &fake->head;
+	fake->sock = -1;
+
+	return fake;
+}
+
+void gtp5g_fake_destroy(struct gtp5g_fake *fake)
+{
+	struct fake_msg *msg, *next;
+	int i;
+
+	if (!fake)
+		return;
+
+	for (i = 0; i < __GTP5G_FAKE_TABLE_MAX; i++) {
+		fake_table_free(&fake->rules[i]);
+		fake_table_free(&fake->refs[i]);
+	}
+	for (msg = fake->head; msg; msg = next) {
+		next = msg->next;
+		free(msg);
+	}
+	if (fake->sock >= 0)
+		close(fake->sock);
+	free(fake);
+}
+
+int gtp5g_fake_install(struct gtp5g_fake *fake)
+{
+	return genl_set_transport_ops(&fake_ops, fake);
+}
+
+int gtp5g_fake_install_socket(struct gtp5g_fake *fake)
+{
+	if (fake->sock < 0) {
+		fake->sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_USERSOCK);
+		if (fake->sock < 0)
+			return -1;
+	}
+
+	return genl_set_transport_ops(&fake_sock_ops, fake);
+}
+
+void gtp5g_fake_uninstall(void)
+{
+	genl_set_transport(GENL_TRANSPORT_SOCKET);
+}
+
+uint32_t gtp5g_fake_count(const struct gtp5g_fake *fake, enum gtp5g_fake_table table)
+{
+	return table < __GTP5G_FAKE_TABLE_MAX ? fake->rules[table].count : 0;
+}
+
+void gtp5g_fake_set_dump_intr(struct gtp5g_fake *fake, unsigned int n)
+{
+	fake->dump_intr = n;
+}
+
+void gtp5g_fake_set_sdf_filter_list(struct gtp5g_fake *fake, int on)
+{
+	fake->sdf_list = on;
+}
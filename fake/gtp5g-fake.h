@@ -0,0 +1,63 @@
+#ifndef _GTP5G_FAKE_H_
+#define _GTP5G_FAKE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * In-process stand-in for the gtp5g kernel module
+ *
+ * Once installed, genl_socket_talk() and all gtp5g_* requests of the calling
+ * process are answered from hash tables in user space instead of the kernel.
+ * The "gtp5g" family resolves to GTP5G_FAKE_FAMILY_ID, any non-zero ifindex
+ * stands for a gtp5g device. Sockets still have to come from
+ * genl_socket_open(), which needs neither root nor the module.
+ *
+ * Not thread safe, a fake serves one thread at a time.
+ */
+#define GTP5G_FAKE_FAMILY_ID	0x100
+
+enum gtp5g_fake_table {
+	GTP5G_FAKE_PDR,
+	GTP5G_FAKE_FAR,
+	GTP5G_FAKE_QER,
+	__GTP5G_FAKE_TABLE_MAX,
+};
+
+struct gtp5g_fake;
+
+struct gtp5g_fake *gtp5g_fake_create(void);
+void gtp5g_fake_destroy(struct gtp5g_fake *fake);
+
+int gtp5g_fake_install(struct gtp5g_fake *fake);
+void gtp5g_fake_uninstall(void);
+
+/* Same as gtp5g_fake_install(), but replies are written to the socket of
+ * the request, so that the library reads them with recvfrom() and
+ * recvmmsg() as from the kernel. A socket pair would not do, replies have
+ * to come with a netlink address: each socket is swapped for a
+ * NETLINK_USERSOCK one, which anyone may write to, on its first request.
+ * Replies are written right away, a dump has to fit in the receive buffer
+ * of the socket. */
+int gtp5g_fake_install_socket(struct gtp5g_fake *fake);
+
+uint32_t gtp5g_fake_count(const struct gtp5g_fake *fake, enum gtp5g_fake_table table);
+
+/* Flag the next n dumps with NLM_F_DUMP_INTR, as if the table changed
+ * while they ran */
+void gtp5g_fake_set_dump_intr(struct gtp5g_fake *fake, unsigned int n);
+
+/* Advertise GTP5G_PDI_SDF_FILTER_LIST in the policy dump of
+ * GTP5G_CMD_ADD_PDR, off by default like free5GC's gtp5g. Below 0, refuse
+ * policy dumps like kernels before 5.10. Takes effect on the next
+ * gtp5g_fake_install(). */
+void gtp5g_fake_set_sdf_filter_list(struct gtp5g_fake *fake, int on);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GTP5G_FAKE_H_ */
@@ -4,6 +4,10 @@
 #include <stdint.h>
 #include <netinet/ip.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct gtp5g_dev;
 struct gtp5g_pdr;
 struct gtp5g_far;
@@ -38,6 +42,8 @@ void gtp5g_pdr_set_role_addr_ipv4(struct gtp5g_pdr *pdr, struct in_addr *role_ad
 /* Not in 3GPP spec, just used for buffering */
 void gtp5g_pdr_set_unix_sock_path(struct gtp5g_pdr *pdr, const char *unix_sock_path);
 
+/* The SDF filter setters fill the last filter, this starts a new one */
+void gtp5g_pdr_add_sdf_filter(struct gtp5g_pdr *pdr);
 void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rule_str);
 void gtp5g_pdr_set_tos_traffic_class(struct gtp5g_pdr *pdr, uint16_t tos_traffic_class);
 void gtp5g_pdr_set_security_param_idx(struct gtp5g_pdr *pdr, uint32_t security_param_idx);
@@ -99,4 +105,8 @@ void gtp5g_qer_set_rcsr(struct gtp5g_qer *qer, uint8_t rcsr);
 
 uint32_t *gtp5g_qer_get_id(struct gtp5g_qer *qer);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
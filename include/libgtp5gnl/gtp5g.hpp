@@ -0,0 +1,1197 @@
+#ifndef _LIBGTP5GNL_HPP_
+#define _LIBGTP5GNL_HPP_
+
+/*
+ * C++17 wrapper, header only
+ *
+ * Pdr, Far and Qer are plain values: their optional IEs are held in place
+ * by std::optional and fixed-capacity members, nothing is allocated per
+ * field, and they are written straight into the netlink request instead of
+ * going through the gtp5g_*_set_*() objects. Socket, Batch and Handle own
+ * the C object they wrap and are move-only, as is Async, whose requests
+ * are awaited from C++20 coroutines.
+ *
+ * Nothing throws. Calls fail as their C counterpart does, returning -1 with
+ * the cause in gtp5g_get_err(); the kernel is left to reject an incomplete
+ * rule, such as a PDR added without precedence.
+ */
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+#endif
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <libmnl/libmnl.h>
+
+#include <libgtp5gnl/gtp5gnl.h>
+#if __has_include(<libgtp5gnl/linux/gtp5g.h>)
+#include <libgtp5gnl/linux/gtp5g.h>
+#else
+#include <linux/gtp5g.h>
+#endif
+
+namespace gtp5g {
+
+/* Up to N bytes held in place with a terminating NUL, which view() leaves
+ * out and c_str() keeps */
+template <std::size_t N>
+class FixedString {
+public:
+	FixedString() = default;
+
+	/* false, and unchanged, when s is longer than N */
+	bool assign(std::string_view s)
+	{
+		if (s.size() > N)
+			return false;
+		std::memcpy(buf_, s.data(), s.size());
+		buf_[s.size()] = '\0';
+		len_ = s.size();
+		return true;
+	}
+
+	std::string_view view() const { return {buf_, len_}; }
+	const char *c_str() const { return buf_; }
+
+private:
+	char buf_[N + 1] = {};
+	std::size_t len_ = 0;
+};
+
+/* Contiguous rules for the batch functions, read only, from a pointer and
+ * a count or from any container with std::data() and std::size() */
+template <typename T>
+class Span {
+public:
+	Span(const T *p, std::size_t n) : p_(p), n_(n) {}
+
+	template <typename C, typename = decltype(std::data(std::declval<const C &>()))>
+	Span(const C &c) : p_(std::data(c)), n_(std::size(c)) {}
+
+	const T *begin() const { return p_; }
+	const T *end() const { return p_ + n_; }
+	std::size_t size() const { return n_; }
+
+private:
+	const T *p_;
+	std::size_t n_;
+};
+
+template <typename C>
+Span(const C &) -> Span<std::remove_cv_t<std::remove_pointer_t<decltype(std::data(std::declval<const C &>()))>>>;
+
+namespace detail {
+
+inline void put(struct nlmsghdr *nlh, uint16_t type, uint8_t v)
+{
+	mnl_attr_put_u8(nlh, type, v);
+}
+
+inline void put(struct nlmsghdr *nlh, uint16_t type, uint16_t v)
+{
+	mnl_attr_put_u16(nlh, type, v);
+}
+
+inline void put(struct nlmsghdr *nlh, uint16_t type, uint32_t v)
+{
+	mnl_attr_put_u32(nlh, type, v);
+}
+
+inline void put(struct nlmsghdr *nlh, uint16_t type, const struct in_addr &v)
+{
+	mnl_attr_put_u32(nlh, type, v.s_addr);
+}
+
+template <typename T>
+inline void put(struct nlmsghdr *nlh, uint16_t type, const std::optional<T> &v)
+{
+	if (v)
+		put(nlh, type, *v);
+}
+
+/* Decimal number of s, at most max */
+inline bool parse_uint(std::string_view s, uint32_t max, uint32_t &v)
+{
+	auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+
+	return !s.empty() && r.ec == std::errc() && r.ptr == s.data() + s.size() &&
+	       v <= max;
+}
+
+/* "any" or "a.b.c.d", with "/prefix" for the latter */
+inline bool parse_addr(std::string_view s, struct in_addr &addr, struct in_addr &mask)
+{
+	char buf[INET_ADDRSTRLEN];
+	std::size_t slash;
+	uint32_t prefix = 32;
+
+	if (s == "any") {
+		addr.s_addr = 0;
+		mask.s_addr = 0;
+		return true;
+	}
+
+	slash = s.find('/');
+	if (slash != std::string_view::npos) {
+		if (!parse_uint(s.substr(slash + 1), 32, prefix))
+			return false;
+		s = s.substr(0, slash);
+	}
+	if (s.size() >= sizeof(buf))
+		return false;
+	std::memcpy(buf, s.data(), s.size());
+	buf[s.size()] = '\0';
+	if (inet_pton(AF_INET, buf, &addr) != 1)
+		return false;
+
+	mask.s_addr = htonl(prefix ? UINT32_MAX << (32 - prefix) : 0);
+	return true;
+}
+
+/* Words of s separated by single spaces */
+class Words {
+public:
+	explicit Words(std::string_view s) : s_(s) {}
+
+	bool done() const { return !more_; }
+
+	std::string_view next()
+	{
+		std::size_t sp = s_.find(' ');
+		std::string_view w = s_.substr(0, sp);
+
+		if (sp == std::string_view::npos) {
+			more_ = false;
+			s_ = {};
+		} else {
+			s_ = s_.substr(sp + 1);
+		}
+		return w;
+	}
+
+private:
+	std::string_view s_;
+	bool more_ = true;
+};
+
+} // namespace detail
+
+/* Port ranges of a flow description, packed as low | high << 16 */
+class Ports {
+public:
+	static constexpr std::size_t max = 16;
+
+	bool add(uint16_t low, uint16_t high)
+	{
+		if (num_ == max)
+			return false;
+		if (low > high)
+			std::swap(low, high);
+		list_[num_++] = low | (uint32_t)high << 16;
+		return true;
+	}
+
+	/* "80,8000-8080" */
+	bool parse(std::string_view s)
+	{
+		uint32_t low, high;
+		std::size_t comma, dash;
+		std::string_view r;
+
+		num_ = 0;
+		do {
+			comma = s.find(',');
+			r = s.substr(0, comma);
+			dash = r.find('-');
+			if (!detail::parse_uint(r.substr(0, dash), UINT16_MAX, low))
+				return false;
+			high = low;
+			if (dash != std::string_view::npos &&
+			    !detail::parse_uint(r.substr(dash + 1), UINT16_MAX, high))
+				return false;
+			if (!add(low, high))
+				return false;
+			s = comma == std::string_view::npos ? std::string_view() : s.substr(comma + 1);
+		} while (comma != std::string_view::npos);
+		return true;
+	}
+
+	bool empty() const { return !num_; }
+	std::size_t size() const { return num_; }
+	const uint32_t *data() const { return list_.data(); }
+
+	void put(struct nlmsghdr *nlh, uint16_t type) const
+	{
+		if (num_)
+			mnl_attr_put(nlh, type, num_ * sizeof(uint32_t), list_.data());
+	}
+
+private:
+	std::array<uint32_t, max> list_{};
+	std::size_t num_ = 0;
+};
+
+struct FlowDescription {
+	uint8_t action = GTP5G_SDF_FILTER_PERMIT;
+	uint8_t direction = GTP5G_SDF_FILTER_OUT;
+	uint8_t proto = 0xff;			/* 0xff for "ip" */
+	struct in_addr src{}, smask{};
+	struct in_addr dest{}, dmask{};
+	Ports sport, dport;
+
+	/* The form gtp5g_pdr_set_sdf_filter_description() takes,
+	 * "permit out 17 from 10.0.0.0/8 2152 to any", std::nullopt when s is
+	 * not of that form */
+	static std::optional<FlowDescription> parse(std::string_view s)
+	{
+		detail::Words w(s);
+		FlowDescription r;
+		std::string_view t;
+		uint32_t proto;
+
+		if (w.next() != "permit")
+			return std::nullopt;
+		r.action = GTP5G_SDF_FILTER_PERMIT;
+
+		t = w.next();
+		if (t == "in")
+			r.direction = GTP5G_SDF_FILTER_IN;
+		else if (t == "out")
+			r.direction = GTP5G_SDF_FILTER_OUT;
+		else
+			return std::nullopt;
+
+		t = w.next();
+		if (t == "ip")
+			r.proto = 0xff;
+		else if (detail::parse_uint(t, 0xff, proto))
+			r.proto = proto;
+		else
+			return std::nullopt;
+
+		if (w.next() != "from" || !detail::parse_addr(w.next(), r.src, r.smask))
+			return std::nullopt;
+		t = w.next();
+		if (t != "to") {
+			if (!r.sport.parse(t))
+				return std::nullopt;
+			t = w.next();
+		}
+		if (t != "to" || w.done() || !detail::parse_addr(w.next(), r.dest, r.dmask))
+			return std::nullopt;
+		if (!w.done() && !r.dport.parse(w.next()))
+			return std::nullopt;
+		if (!w.done())
+			return std::nullopt;
+
+		return r;
+	}
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		detail::put(nlh, GTP5G_FLOW_DESCRIPTION_ACTION, action);
+		detail::put(nlh, GTP5G_FLOW_DESCRIPTION_DIRECTION, direction);
+		detail::put(nlh, GTP5G_FLOW_DESCRIPTION_PROTOCOL, proto);
+		detail::put(nlh, GTP5G_FLOW_DESCRIPTION_SRC_IPV4, src);
+		detail::put(nlh, GTP5G_FLOW_DESCRIPTION_SRC_MASK, smask);
+		detail::put(nlh, GTP5G_FLOW_DESCRIPTION_DEST_IPV4, dest);
+		detail::put(nlh, GTP5G_FLOW_DESCRIPTION_DEST_MASK, dmask);
+		sport.put(nlh, GTP5G_FLOW_DESCRIPTION_SRC_PORT);
+		dport.put(nlh, GTP5G_FLOW_DESCRIPTION_DEST_PORT);
+	}
+};
+
+struct SdfFilter {
+	std::optional<FlowDescription> rule;
+	std::optional<uint16_t> tos_traffic_class;
+	std::optional<uint32_t> security_param_idx;
+	std::optional<uint32_t> flow_label;
+	std::optional<uint32_t> id;
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		struct nlattr *nest;
+
+		if (rule) {
+			nest = mnl_attr_nest_start(nlh, GTP5G_SDF_FILTER_FLOW_DESCRIPTION);
+			rule->put(nlh);
+			mnl_attr_nest_end(nlh, nest);
+		}
+		detail::put(nlh, GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS, tos_traffic_class);
+		detail::put(nlh, GTP5G_SDF_FILTER_SECURITY_PARAMETER_INDEX, security_param_idx);
+		detail::put(nlh, GTP5G_SDF_FILTER_FLOW_LABEL, flow_label);
+		detail::put(nlh, GTP5G_SDF_FILTER_SDF_FILTER_ID, id);
+	}
+};
+
+struct FTeid {
+	uint32_t teid = 0;
+	struct in_addr gtpu_addr{};
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		detail::put(nlh, GTP5G_F_TEID_I_TEID, teid);
+		detail::put(nlh, GTP5G_F_TEID_GTPU_ADDR_IPV4, gtpu_addr);
+	}
+};
+
+struct Pdi {
+	std::optional<struct in_addr> ue_addr;
+	std::optional<FTeid> f_teid;
+	std::optional<SdfFilter> sdf;
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		struct nlattr *nest;
+
+		detail::put(nlh, GTP5G_PDI_UE_ADDR_IPV4, ue_addr);
+		if (f_teid) {
+			nest = mnl_attr_nest_start(nlh, GTP5G_PDI_F_TEID);
+			f_teid->put(nlh);
+			mnl_attr_nest_end(nlh, nest);
+		}
+		if (sdf) {
+			nest = mnl_attr_nest_start(nlh, GTP5G_PDI_SDF_FILTER);
+			sdf->put(nlh);
+			mnl_attr_nest_end(nlh, nest);
+		}
+	}
+};
+
+struct Pdr {
+	static constexpr uint8_t add_cmd = GTP5G_CMD_ADD_PDR;
+	static constexpr uint8_t del_cmd = GTP5G_CMD_DEL_PDR;
+
+	uint16_t id = 0;
+	std::optional<uint32_t> precedence;
+	std::optional<uint8_t> outer_header_removal;
+	std::optional<uint32_t> far_id;
+	std::optional<uint32_t> qer_id;
+	std::optional<struct in_addr> role_addr;		/* not in 3GPP, for routing */
+	std::optional<FixedString<107>> unix_sock_path;	/* not in 3GPP, for buffering, sun_path sized */
+	std::optional<Pdi> pdi;
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		struct nlattr *nest;
+
+		detail::put(nlh, GTP5G_PDR_ID, id);
+		detail::put(nlh, GTP5G_PDR_PRECEDENCE, precedence);
+		detail::put(nlh, GTP5G_OUTER_HEADER_REMOVAL, outer_header_removal);
+		detail::put(nlh, GTP5G_PDR_FAR_ID, far_id);
+		detail::put(nlh, GTP5G_PDR_QER_ID, qer_id);
+		detail::put(nlh, GTP5G_PDR_ROLE_ADDR_IPV4, role_addr);
+		if (unix_sock_path)
+			mnl_attr_put_strz(nlh, GTP5G_PDR_UNIX_SOCKET_PATH, unix_sock_path->c_str());
+		if (pdi) {
+			nest = mnl_attr_nest_start(nlh, GTP5G_PDR_PDI);
+			pdi->put(nlh);
+			mnl_attr_nest_end(nlh, nest);
+		}
+	}
+};
+
+struct OuterHeaderCreation {
+	uint16_t desp = 0;
+	uint32_t teid = 0;
+	struct in_addr peer_addr{};
+	uint16_t port = 0;
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		detail::put(nlh, GTP5G_OUTER_HEADER_CREATION_DESCRIPTION, desp);
+		detail::put(nlh, GTP5G_OUTER_HEADER_CREATION_O_TEID, teid);
+		detail::put(nlh, GTP5G_OUTER_HEADER_CREATION_PEER_ADDR_IPV4, peer_addr);
+		detail::put(nlh, GTP5G_OUTER_HEADER_CREATION_PORT, port);
+	}
+};
+
+struct ForwardingParameter {
+	std::optional<OuterHeaderCreation> hdr_creation;
+	std::optional<FixedString<255>> fwd_policy;
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		struct nlattr *nest;
+
+		if (hdr_creation) {
+			nest = mnl_attr_nest_start(nlh, GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION);
+			hdr_creation->put(nlh);
+			mnl_attr_nest_end(nlh, nest);
+		}
+		if (fwd_policy)
+			mnl_attr_put(nlh, GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY,
+				     fwd_policy->view().size(), fwd_policy->view().data());
+	}
+};
+
+struct Far {
+	static constexpr uint8_t add_cmd = GTP5G_CMD_ADD_FAR;
+	static constexpr uint8_t del_cmd = GTP5G_CMD_DEL_FAR;
+
+	uint32_t id = 0;
+	uint8_t apply_action = 0;		/* put when not 0 */
+	std::optional<ForwardingParameter> fwd_param;
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		struct nlattr *nest;
+
+		detail::put(nlh, GTP5G_FAR_ID, id);
+		if (apply_action)
+			detail::put(nlh, GTP5G_FAR_APPLY_ACTION, apply_action);
+		if (fwd_param) {
+			nest = mnl_attr_nest_start(nlh, GTP5G_FAR_FORWARDING_PARAMETER);
+			fwd_param->put(nlh);
+			mnl_attr_nest_end(nlh, nest);
+		}
+	}
+};
+
+/* MBR and GBR, in kbps as high 32 and low 8 bits */
+struct BitRate {
+	uint32_t ul_high = 0;
+	uint8_t ul_low = 0;
+	uint32_t dl_high = 0;
+	uint8_t dl_low = 0;
+
+	/* The attributes of MBR and GBR nests are numbered alike */
+	void put(struct nlmsghdr *nlh, uint16_t type) const
+	{
+		struct nlattr *nest = mnl_attr_nest_start(nlh, type);
+
+		detail::put(nlh, GTP5G_QER_MBR_UL_HIGH32, ul_high);
+		detail::put(nlh, GTP5G_QER_MBR_UL_LOW8, ul_low);
+		detail::put(nlh, GTP5G_QER_MBR_DL_HIGH32, dl_high);
+		detail::put(nlh, GTP5G_QER_MBR_DL_LOW8, dl_low);
+		mnl_attr_nest_end(nlh, nest);
+	}
+};
+
+struct Qer {
+	static constexpr uint8_t add_cmd = GTP5G_CMD_ADD_QER;
+	static constexpr uint8_t del_cmd = GTP5G_CMD_DEL_QER;
+
+	uint32_t id = 0;
+	uint8_t ul_dl_gate = 0;
+	BitRate mbr, gbr;
+	uint32_t qer_corr_id = 0;
+	uint8_t rqi = 0;
+	uint8_t qfi = 0;
+	uint8_t ppi = 0;
+	uint8_t rcsr = 0;
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		detail::put(nlh, GTP5G_QER_ID, id);
+		detail::put(nlh, GTP5G_QER_GATE, ul_dl_gate);
+		detail::put(nlh, GTP5G_QER_CORR_ID, qer_corr_id);
+		detail::put(nlh, GTP5G_QER_RQI, rqi);
+		detail::put(nlh, GTP5G_QER_QFI, qfi);
+		detail::put(nlh, GTP5G_QER_PPI, ppi);
+		detail::put(nlh, GTP5G_QER_RCSR, rcsr);
+		mbr.put(nlh, GTP5G_QER_MBR);
+		gbr.put(nlh, GTP5G_QER_GBR);
+	}
+};
+
+/* The gtp5g device a request is for, ifns -1 for the socket's namespace */
+struct Device {
+	int ifns = -1;
+	uint32_t ifidx = 0;
+
+	void put(struct nlmsghdr *nlh) const
+	{
+		if (ifns >= 0)
+			detail::put(nlh, GTP5G_NET_NS_FD, (uint32_t)ifns);
+		detail::put(nlh, GTP5G_LINK, ifidx);
+	}
+};
+
+/*
+ * Builders of a fixed IE set
+ *
+ * FixedPdr<ie::...> and FixedFar<ie::...> put a Pdr or a Far with exactly
+ * the IEs listed, in any order, which must be set in the value; the others
+ * are ignored. Which attributes go in, their offsets and the length of
+ * the whole are constants, so the message is written without a branch
+ * after at most one check of the room. They take the place of the rule in
+ * Socket, Batch and Async calls:
+ *
+ *	using UplinkPdr = FixedPdr<ie::Precedence, ie::FTeid, ie::OuterHeaderRemoval,
+ *				   ie::FarId, ie::QerId>;
+ *	batch.add(dev, UplinkPdr(pdr));
+ */
+namespace ie {
+
+struct Precedence {};
+struct OuterHeaderRemoval {};
+struct FarId {};
+struct QerId {};
+struct RoleAddr {};
+struct UeAddr {};			/* in the PDI */
+struct FTeid {};			/* in the PDI */
+
+struct ApplyAction {};
+struct OuterHeaderCreation {};		/* in the forwarding parameter */
+
+} // namespace ie
+
+namespace detail {
+
+/* The smallest MNL_SOCKET_BUFFER_SIZE, less the headers of a request */
+constexpr std::size_t request_room = 4096 - MNL_NLMSG_HDRLEN - MNL_ALIGN(4);
+
+constexpr std::size_t attr_size(std::size_t len)
+{
+	return MNL_ALIGN(MNL_ATTR_HDRLEN + len);
+}
+
+constexpr std::size_t attr_size_if(bool has, std::size_t len)
+{
+	return has ? attr_size(len) : 0;
+}
+
+/* An attribute at p, whose padding was cleared, returns the end of it */
+template <typename T>
+inline char *put_at(char *p, uint16_t type, T v)
+{
+	struct nlattr attr = {(uint16_t)(MNL_ATTR_HDRLEN + sizeof(T)), type};
+
+	std::memcpy(p, &attr, sizeof(attr));
+	std::memcpy(p + MNL_ATTR_HDRLEN, &v, sizeof(T));
+	return p + attr_size(sizeof(T));
+}
+
+/* The header of a nest of len bytes at p, returns where they go */
+inline char *nest_at(char *p, uint16_t type, std::size_t len)
+{
+	struct nlattr attr = {(uint16_t)(MNL_ATTR_HDRLEN + len), (uint16_t)(type | NLA_F_NESTED)};
+
+	std::memcpy(p, &attr, sizeof(attr));
+	return p + MNL_ATTR_HDRLEN;
+}
+
+template <typename Ie, typename... Ies>
+constexpr bool has_ie = (std::is_same_v<Ie, Ies> || ...);
+
+/* put() of the Fixed* builders, with Rule::put_fixed(p) writing size bytes */
+template <typename Rule>
+struct FixedPut {
+	/* Into a request of gtp5g_batch_put() or the like, which leaves room for
+	 * the largest one */
+	void put(struct nlmsghdr *nlh) const
+	{
+		static_assert(Rule::size <= request_room, "IE set larger than a request");
+
+		char *p = static_cast<char *>(mnl_nlmsg_get_payload_tail(nlh));
+
+		std::memset(p, 0, Rule::size);
+		static_cast<const Rule *>(this)->put_fixed(p);
+		nlh->nlmsg_len += Rule::size;
+	}
+
+	/* Into a request at the start of len bytes, false when it does not fit */
+	bool put(struct nlmsghdr *nlh, std::size_t len) const
+	{
+		if (len < nlh->nlmsg_len + Rule::size)
+			return false;
+		put(nlh);
+		return true;
+	}
+};
+
+} // namespace detail
+
+template <typename... Ies>
+class FixedPdr : public detail::FixedPut<FixedPdr<Ies...>> {
+	template <typename Ie>
+	static constexpr bool has = detail::has_ie<Ie, Ies...>;
+
+	static constexpr std::size_t f_teid_len = detail::attr_size(4) * 2;
+	static constexpr std::size_t pdi_len =
+		detail::attr_size_if(has<ie::UeAddr>, 4) +
+		(has<ie::FTeid> ? MNL_ATTR_HDRLEN + f_teid_len : 0);
+	static constexpr bool has_pdi = has<ie::UeAddr> || has<ie::FTeid>;
+
+public:
+	static constexpr uint8_t add_cmd = Pdr::add_cmd;
+	static constexpr uint8_t del_cmd = Pdr::del_cmd;
+
+	/* Bytes the PDR adds to the request */
+	static constexpr std::size_t size =
+		detail::attr_size(2) +
+		detail::attr_size_if(has<ie::Precedence>, 4) +
+		detail::attr_size_if(has<ie::OuterHeaderRemoval>, 1) +
+		detail::attr_size_if(has<ie::FarId>, 4) +
+		detail::attr_size_if(has<ie::QerId>, 4) +
+		detail::attr_size_if(has<ie::RoleAddr>, 4) +
+		(has_pdi ? MNL_ATTR_HDRLEN + pdi_len : 0);
+
+	explicit FixedPdr(const Pdr &pdr) : id(pdr.id), pdr_(pdr) {}
+
+	uint16_t id;
+
+	/* In the order of Pdr::put() */
+	void put_fixed(char *p) const
+	{
+		p = detail::put_at(p, GTP5G_PDR_ID, pdr_.id);
+		if constexpr (has<ie::Precedence>)
+			p = detail::put_at(p, GTP5G_PDR_PRECEDENCE, *pdr_.precedence);
+		if constexpr (has<ie::OuterHeaderRemoval>)
+			p = detail::put_at(p, GTP5G_OUTER_HEADER_REMOVAL, *pdr_.outer_header_removal);
+		if constexpr (has<ie::FarId>)
+			p = detail::put_at(p, GTP5G_PDR_FAR_ID, *pdr_.far_id);
+		if constexpr (has<ie::QerId>)
+			p = detail::put_at(p, GTP5G_PDR_QER_ID, *pdr_.qer_id);
+		if constexpr (has<ie::RoleAddr>)
+			p = detail::put_at(p, GTP5G_PDR_ROLE_ADDR_IPV4, pdr_.role_addr->s_addr);
+		if constexpr (has_pdi) {
+			p = detail::nest_at(p, GTP5G_PDR_PDI, pdi_len);
+			if constexpr (has<ie::UeAddr>)
+				p = detail::put_at(p, GTP5G_PDI_UE_ADDR_IPV4, pdr_.pdi->ue_addr->s_addr);
+			if constexpr (has<ie::FTeid>) {
+				p = detail::nest_at(p, GTP5G_PDI_F_TEID, f_teid_len);
+				p = detail::put_at(p, GTP5G_F_TEID_I_TEID, pdr_.pdi->f_teid->teid);
+				p = detail::put_at(p, GTP5G_F_TEID_GTPU_ADDR_IPV4,
+						   pdr_.pdi->f_teid->gtpu_addr.s_addr);
+			}
+		}
+	}
+
+private:
+	const Pdr &pdr_;
+};
+
+template <typename... Ies>
+class FixedFar : public detail::FixedPut<FixedFar<Ies...>> {
+	template <typename Ie>
+	static constexpr bool has = detail::has_ie<Ie, Ies...>;
+
+	static constexpr std::size_t hdr_creation_len =
+		detail::attr_size(2) + detail::attr_size(4) * 2 + detail::attr_size(2);
+	static constexpr std::size_t fwd_param_len = MNL_ATTR_HDRLEN + hdr_creation_len;
+
+public:
+	static constexpr uint8_t add_cmd = Far::add_cmd;
+	static constexpr uint8_t del_cmd = Far::del_cmd;
+
+	/* Bytes the FAR adds to the request */
+	static constexpr std::size_t size =
+		detail::attr_size(4) +
+		detail::attr_size_if(has<ie::ApplyAction>, 1) +
+		(has<ie::OuterHeaderCreation> ? MNL_ATTR_HDRLEN + fwd_param_len : 0);
+
+	explicit FixedFar(const Far &far) : id(far.id), far_(far) {}
+
+	uint32_t id;
+
+	/* In the order of Far::put(), apply_action is put even when 0 */
+	void put_fixed(char *p) const
+	{
+		p = detail::put_at(p, GTP5G_FAR_ID, far_.id);
+		if constexpr (has<ie::ApplyAction>)
+			p = detail::put_at(p, GTP5G_FAR_APPLY_ACTION, far_.apply_action);
+		if constexpr (has<ie::OuterHeaderCreation>) {
+			const OuterHeaderCreation &h = *far_.fwd_param->hdr_creation;
+
+			p = detail::nest_at(p, GTP5G_FAR_FORWARDING_PARAMETER, fwd_param_len);
+			p = detail::nest_at(p, GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION,
+					    hdr_creation_len);
+			p = detail::put_at(p, GTP5G_OUTER_HEADER_CREATION_DESCRIPTION, h.desp);
+			p = detail::put_at(p, GTP5G_OUTER_HEADER_CREATION_O_TEID, h.teid);
+			p = detail::put_at(p, GTP5G_OUTER_HEADER_CREATION_PEER_ADDR_IPV4,
+					   h.peer_addr.s_addr);
+			p = detail::put_at(p, GTP5G_OUTER_HEADER_CREATION_PORT, h.port);
+		}
+	}
+
+private:
+	const Far &far_;
+};
+
+namespace detail {
+
+/* MNL_SOCKET_BUFFER_SIZE at most, which is not a constant expression */
+constexpr std::size_t request_size = 8192;
+
+/* One request on a stack buffer, as gtp5g_add_pdr() and the others do */
+template <typename Rule>
+inline int talk(struct mnl_socket *nl, int genl_id, uint16_t flags, uint8_t cmd,
+		const Device &dev, const Rule &rule)
+{
+	char buf[request_size];
+	uint32_t seq = time(nullptr);
+	struct nlmsghdr *nlh;
+
+	nlh = genl_nlmsg_build_hdr(buf, genl_id, flags | NLM_F_ACK, seq, cmd);
+	dev.put(nlh);
+	rule.put(nlh);
+	return genl_socket_talk(nl, nlh, seq, nullptr, nullptr) < 0 ? -1 : 0;
+}
+
+} // namespace detail
+
+/* A genetlink socket with the gtp5g family ID looked up */
+class Socket {
+public:
+	Socket() = default;
+	~Socket() { reset(); }
+
+	Socket(const Socket &) = delete;
+	Socket &operator=(const Socket &) = delete;
+
+	Socket(Socket &&o) noexcept
+		: nl_(std::exchange(o.nl_, nullptr)), genl_id_(std::exchange(o.genl_id_, -1)) {}
+
+	Socket &operator=(Socket &&o) noexcept
+	{
+		if (this != &o) {
+			reset();
+			nl_ = std::exchange(o.nl_, nullptr);
+			genl_id_ = std::exchange(o.genl_id_, -1);
+		}
+		return *this;
+	}
+
+	/* Empty when the socket or the family cannot be had */
+	static Socket open()
+	{
+		Socket s;
+
+		s.nl_ = genl_socket_open();
+		if (!s.nl_)
+			return s;
+		s.genl_id_ = genl_lookup_family(s.nl_, "gtp5g");
+		if (s.genl_id_ < 0)
+			s.reset();
+		return s;
+	}
+
+	explicit operator bool() const { return nl_; }
+	struct mnl_socket *get() const { return nl_; }
+	int genl_id() const { return genl_id_; }
+
+	template <typename Rule>
+	int add(const Device &dev, const Rule &rule)
+	{
+		return detail::talk(nl_, genl_id_, NLM_F_EXCL, Rule::add_cmd, dev, rule);
+	}
+
+	template <typename Rule>
+	int mod(const Device &dev, const Rule &rule)
+	{
+		return detail::talk(nl_, genl_id_, NLM_F_REPLACE, Rule::add_cmd, dev, rule);
+	}
+
+	template <typename Rule>
+	int del(const Device &dev, const Rule &rule)
+	{
+		return detail::talk(nl_, genl_id_, 0, Rule::del_cmd, dev, rule);
+	}
+
+private:
+	void reset()
+	{
+		if (nl_)
+			genl_socket_close(nl_);
+		nl_ = nullptr;
+		genl_id_ = -1;
+	}
+
+	struct mnl_socket *nl_ = nullptr;
+	int genl_id_ = -1;
+};
+
+/* Requests queued and sent as gtp5g_batch_*() do. Queueing a span stops at
+ * the first rule failing, the ones before it stay queued. */
+class Batch {
+public:
+	Batch() = default;
+	explicit Batch(struct gtp5g_batch *b) : b_(b) {}
+	~Batch() { gtp5g_batch_free(b_); }
+
+	Batch(const Batch &) = delete;
+	Batch &operator=(const Batch &) = delete;
+
+	Batch(Batch &&o) noexcept : b_(std::exchange(o.b_, nullptr)) {}
+
+	Batch &operator=(Batch &&o) noexcept
+	{
+		if (this != &o) {
+			gtp5g_batch_free(b_);
+			b_ = std::exchange(o.b_, nullptr);
+		}
+		return *this;
+	}
+
+	/* Empty when out of memory */
+	static Batch alloc(const Socket &s) { return Batch(gtp5g_batch_alloc(s.genl_id(), s.get())); }
+
+	explicit operator bool() const { return b_; }
+	struct gtp5g_batch *get() const { return b_; }
+	unsigned int count() const { return gtp5g_batch_count(b_); }
+
+	int send(gtp5g_batch_err_cb_t cb = nullptr, void *data = nullptr)
+	{
+		return gtp5g_batch_send(b_, cb, data);
+	}
+
+	template <typename Rule>
+	int add(const Device &dev, const Rule &rule)
+	{
+		return queue(NLM_F_EXCL, Rule::add_cmd, dev, rule);
+	}
+
+	template <typename Rule>
+	int mod(const Device &dev, const Rule &rule)
+	{
+		return queue(NLM_F_REPLACE, Rule::add_cmd, dev, rule);
+	}
+
+	template <typename Rule>
+	int del(const Device &dev, const Rule &rule)
+	{
+		return queue(0, Rule::del_cmd, dev, rule);
+	}
+
+	template <typename Rule>
+	int add(const Device &dev, Span<Rule> rules)
+	{
+		return queue(NLM_F_EXCL, Rule::add_cmd, dev, rules);
+	}
+
+	template <typename Rule>
+	int mod(const Device &dev, Span<Rule> rules)
+	{
+		return queue(NLM_F_REPLACE, Rule::add_cmd, dev, rules);
+	}
+
+	template <typename Rule>
+	int del(const Device &dev, Span<Rule> rules)
+	{
+		return queue(0, Rule::del_cmd, dev, rules);
+	}
+
+private:
+	template <typename Rule>
+	int queue(uint16_t flags, uint8_t cmd, const Device &dev, const Rule &rule)
+	{
+		struct nlmsghdr *nlh;
+
+		nlh = gtp5g_batch_put(b_, flags, cmd, rule.id);
+		if (!nlh)
+			return -1;
+		dev.put(nlh);
+		rule.put(nlh);
+		gtp5g_batch_commit(b_, nlh);
+		return 0;
+	}
+
+	template <typename Rule>
+	int queue(uint16_t flags, uint8_t cmd, const Device &dev, Span<Rule> rules)
+	{
+		for (const Rule &rule : rules)
+			if (queue(flags, cmd, dev, rule) < 0)
+				return -1;
+		return 0;
+	}
+
+	struct gtp5g_batch *b_ = nullptr;
+};
+
+#ifdef __cpp_impl_coroutine
+/* Requests in flight on a non-blocking socket, see gtp5g_async_alloc().
+ * co_await on add(), mod() or del() queues the request and suspends until
+ * process() has read its ACK: the coroutine is resumed once the C library
+ * has returned, never from within its callbacks, and gets 0, or -1 with
+ * the cause in gtp5g_get_err(). Register fd() for events() with the event
+ * loop and call process() when it is ready, or leave it to run(). */
+class Async {
+	/* A suspended request, on the ready list once completed */
+	struct Waiter {
+		std::coroutine_handle<> h_;
+		Waiter *next_ = nullptr;
+		int ret_ = 0;
+	};
+
+	/* Stays put when the Async moves, requests in flight point to it */
+	struct State {
+		explicit State(struct gtp5g_async *a) : a(a) {}
+
+		struct gtp5g_async *a;
+		Waiter *head = nullptr;
+		Waiter **tail = &head;
+	};
+
+public:
+	template <typename Rule>
+	class Request : private Waiter {
+	public:
+		Request(State *s, uint16_t flags, uint8_t cmd,
+			const Device &dev, const Rule &rule)
+			: s_(s), flags_(flags), cmd_(cmd), dev_(dev), rule_(rule) {}
+
+		bool await_ready() const { return false; }
+
+		/* The request is built here, rule need not outlive it */
+		bool await_suspend(std::coroutine_handle<> h)
+		{
+			struct nlmsghdr *nlh;
+
+			/* Awaited again while the Async is being freed */
+			if (!s_->a) {
+				ret_ = -1;
+				return false;
+			}
+			nlh = gtp5g_async_put(s_->a, flags_, cmd_, rule_.id);
+			if (!nlh) {
+				ret_ = -1;
+				return false;
+			}
+			dev_.put(nlh);
+			rule_.put(nlh);
+			h_ = h;
+			gtp5g_async_commit(s_->a, nlh, done, this);
+			return true;
+		}
+
+		int await_resume() const { return ret_; }
+
+	private:
+		static void done(const struct gtp5g_err *err, void *data)
+		{
+			Request *r = static_cast<Request *>(data);
+			State *s = r->s_;
+
+			r->ret_ = err ? -1 : 0;
+			r->next_ = nullptr;
+			*s->tail = r;
+			s->tail = &r->next_;
+		}
+
+		State *s_;
+		uint16_t flags_;
+		uint8_t cmd_;
+		Device dev_;
+		const Rule &rule_;
+	};
+
+	Async() = default;
+
+	/* Takes a, empty when out of memory */
+	explicit Async(struct gtp5g_async *a)
+	{
+		if (!a)
+			return;
+		s_ = new (std::nothrow) State(a);
+		if (!s_)
+			gtp5g_async_free(a);
+	}
+
+	/* Requests in flight fail with ECANCELED */
+	~Async()
+	{
+		if (!s_)
+			return;
+		gtp5g_async_free(std::exchange(s_->a, nullptr));
+		resume();
+		delete s_;
+	}
+
+	Async(const Async &) = delete;
+	Async &operator=(const Async &) = delete;
+
+	Async(Async &&o) noexcept : s_(std::exchange(o.s_, nullptr)) {}
+
+	Async &operator=(Async &&o) noexcept
+	{
+		if (this != &o) {
+			Async old(std::move(*this));
+
+			s_ = std::exchange(o.s_, nullptr);
+		}
+		return *this;
+	}
+
+	/* s is non-blocking afterwards, keep it for this. Empty on failure. */
+	static Async alloc(const Socket &s) { return Async(gtp5g_async_alloc(s.genl_id(), s.get())); }
+
+	explicit operator bool() const { return s_; }
+	struct gtp5g_async *get() const { return s_ ? s_->a : nullptr; }
+	int fd() const { return gtp5g_async_get_fd(s_->a); }
+	int events() const { return gtp5g_async_events(s_->a); }
+	unsigned int pending() const { return gtp5g_async_pending(s_->a); }
+
+	int flush()
+	{
+		int ret = gtp5g_async_flush(s_->a);
+
+		resume();
+		return ret;
+	}
+
+	int process()
+	{
+		int ret = gtp5g_async_process(s_->a);
+
+		resume();
+		return ret;
+	}
+
+	/* Until the resumed coroutines stop queueing requests */
+	int run()
+	{
+		int done = 0, ret;
+
+		do {
+			ret = gtp5g_async_run(s_->a);
+			resume();
+			if (ret < 0)
+				return -1;
+			done += ret;
+		} while (pending());
+
+		return done;
+	}
+
+	template <typename Rule>
+	Request<Rule> add(const Device &dev, const Rule &rule)
+	{
+		return {s_, NLM_F_EXCL, Rule::add_cmd, dev, rule};
+	}
+
+	template <typename Rule>
+	Request<Rule> mod(const Device &dev, const Rule &rule)
+	{
+		return {s_, NLM_F_REPLACE, Rule::add_cmd, dev, rule};
+	}
+
+	template <typename Rule>
+	Request<Rule> del(const Device &dev, const Rule &rule)
+	{
+		return {s_, 0, Rule::del_cmd, dev, rule};
+	}
+
+private:
+	/* Resume the coroutines of the completed requests in order, those
+	 * they complete in turn included */
+	void resume()
+	{
+		Waiter *w;
+
+		while ((w = s_->head)) {
+			s_->head = w->next_;
+			if (!s_->head)
+				s_->tail = &s_->head;
+			w->h_.resume();
+		}
+	}
+
+	State *s_ = nullptr;
+};
+#endif
+
+/* gtp5g devices over network namespaces, see gtp5g_handle_alloc() */
+class Handle {
+public:
+	Handle() = default;
+	~Handle() { gtp5g_handle_free(h_); }
+
+	Handle(const Handle &) = delete;
+	Handle &operator=(const Handle &) = delete;
+
+	Handle(Handle &&o) noexcept : h_(std::exchange(o.h_, nullptr)) {}
+
+	Handle &operator=(Handle &&o) noexcept
+	{
+		if (this != &o) {
+			gtp5g_handle_free(h_);
+			h_ = std::exchange(o.h_, nullptr);
+		}
+		return *this;
+	}
+
+	/* Empty when out of memory */
+	static Handle alloc()
+	{
+		Handle h;
+
+		h.h_ = gtp5g_handle_alloc();
+		return h;
+	}
+
+	explicit operator bool() const { return h_; }
+	struct gtp5g_handle *get() const { return h_; }
+	unsigned int count() const { return gtp5g_handle_count(h_); }
+
+	/* The number of the device, or -1 */
+	int add_dev(const char *netns, const char *ifname)
+	{
+		return gtp5g_handle_add_dev(h_, netns, ifname);
+	}
+
+	/* ifidx is 0 when the device cannot be resolved */
+	Device device(unsigned int dev) const { return {-1, gtp5g_handle_ifindex(h_, dev)}; }
+
+	/* Requests for dev only, on the socket of its namespace */
+	Batch batch(unsigned int dev) const { return Batch(gtp5g_handle_batch_alloc(h_, dev)); }
+
+#ifdef __cpp_impl_coroutine
+	/* Requests for dev only, on a socket of their own */
+	Async async(unsigned int dev) const { return Async(gtp5g_handle_async_alloc(h_, dev)); }
+#endif
+
+	template <typename Rule>
+	int add(unsigned int dev, const Rule &rule)
+	{
+		return talk(dev, NLM_F_EXCL, Rule::add_cmd, rule);
+	}
+
+	template <typename Rule>
+	int mod(unsigned int dev, const Rule &rule)
+	{
+		return talk(dev, NLM_F_REPLACE, Rule::add_cmd, rule);
+	}
+
+	template <typename Rule>
+	int del(unsigned int dev, const Rule &rule)
+	{
+		return talk(dev, 0, Rule::del_cmd, rule);
+	}
+
+private:
+	template <typename Rule>
+	int talk(unsigned int dev, uint16_t flags, uint8_t cmd, const Rule &rule)
+	{
+		Device d = device(dev);
+		int genl_id;
+
+		if (!d.ifidx)
+			return -1;
+		genl_id = gtp5g_handle_genl_id(h_, dev);
+		if (genl_id < 0)
+			return -1;
+		return detail::talk(gtp5g_handle_socket(h_, dev), genl_id, flags, cmd, d, rule);
+	}
+
+	struct gtp5g_handle *h_ = nullptr;
+};
+
+} // namespace gtp5g
+
+#endif
@@ -1,15 +1,113 @@
 #ifndef _LIBGTP5GNL_H_
 #define _LIBGTP5GNL_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 struct mnl_socket;
 struct nlmsghdr;
 
+/*
+ * Error reporting
+ *
+ * The library does not write to stderr. The cause of the last failure is
+ * kept per thread and can be fetched with gtp5g_get_err(), a callback set
+ * with gtp5g_set_err_cb() is called once for each failure as well, from
+ * the thread that failed. Failures within the calls of a handle go to its
+ * callback instead, when gtp5g_handle_set_err_cb() gave it one. Setting a
+ * callback while other threads report is safe, each report goes to one
+ * callback with its own data; it returns -1 with ENOMEM if it fails.
+ *
+ * Sockets from genl_socket_open() have NETLINK_EXT_ACK enabled, so msg and
+ * attr_offset carry the kernel's extended ACK when it provides one.
+ */
+#define GTP5G_ERR_MSG_MAX	128
+
+struct gtp5g_err {
+	int		err;			/* errno value, positive */
+	uint8_t		cmd;			/* genetlink command of the failed request */
+	uint32_t	id;			/* PDR/FAR/QER ID of the failed request */
+	uint32_t	attr_offset;		/* offset of the rejected attribute from the start
+						 * of the request, 0 if unknown */
+	char		msg[GTP5G_ERR_MSG_MAX];	/* extack or library message, may be empty */
+};
+
+typedef void (*gtp5g_err_cb_t)(const struct gtp5g_err *err, void *data);
+
+int gtp5g_set_err_cb(gtp5g_err_cb_t cb, void *data);
+const struct gtp5g_err *gtp5g_get_err(void);
+void gtp5g_clear_err(void);
+
+/*
+ * Memory
+ *
+ * Everything the library allocates, rule objects and their parts, the
+ * lists of parsed replies, batches, handles and buffers, comes from the
+ * allocator set with gtp5g_set_allocator(), libc's by default. NULL sets
+ * libc's back. Memory is given back to the allocator it came from, which
+ * must stay valid until then; setting another one only affects what is
+ * allocated afterwards. It is not synchronized, set it before other
+ * threads use the library. ctx is passed to each hook.
+ */
+struct gtp5g_allocator {
+	void	*(*malloc)(size_t size, void *ctx);
+	void	*(*calloc)(size_t nmemb, size_t size, void *ctx);
+	void	*(*realloc)(void *ptr, size_t size, void *ctx);
+	void	(*free)(void *ptr, void *ctx);
+	void	*ctx;
+};
+
+int gtp5g_set_allocator(const struct gtp5g_allocator *a);
+
 struct mnl_socket *genl_socket_open(void);
 void genl_socket_close(struct mnl_socket *nl);
+int genl_socket_set_cap_ack(struct mnl_socket *nl, int on);
+int genl_socket_set_ext_ack(struct mnl_socket *nl, int on);
+int genl_socket_set_rcvbuf(struct mnl_socket *nl, int size, int force);
+int genl_socket_set_sndbuf(struct mnl_socket *nl, int size, int force);
+int genl_socket_set_no_enobufs(struct mnl_socket *nl, int on);
+/* Receive buffer of genl_socket_talk(), raise it when a single reply
+ * does not fit. */
+void genl_set_recv_buffer_size(size_t size);
+/* Number of datagrams of a dump taken per receive syscall */
+void genl_set_recv_batch(unsigned int vlen);
+
+/* How genl_socket_talk() and the gtp5g_* requests reach the kernel. With
+ * io_uring, a request goes out with the first datagram of its reply in one
+ * io_uring_enter(), a datagram of a batch with the ACKs of its requests,
+ * and the datagrams waiting on an async context all together. */
+enum genl_transport {
+	GENL_TRANSPORT_SOCKET,		/* sendto()/recvfrom(), the default */
+	GENL_TRANSPORT_IO_URING,	/* io_uring_enter(), see above */
+	GENL_TRANSPORT_CUSTOM,		/* set with genl_set_transport_ops() */
+};
+
+int genl_set_transport(enum genl_transport transport);
+
+/* A transport supplied by the application, e.g. a stand-in for the kernel.
+ * recv has the semantics of mnl_socket_recvfrom(). When it is NULL, replies
+ * are read from the socket itself as from the kernel, recvmmsg() included.
+ * talk sends a request and receives the first datagram of its reply, it may
+ * be NULL. */
+struct genl_transport_ops {
+	int	(*send)(struct mnl_socket *nl, const void *buf, size_t len,
+			void *data);
+	ssize_t	(*recv)(struct mnl_socket *nl, void *buf, size_t len,
+			void *data);
+	ssize_t	(*talk)(struct mnl_socket *nl, const void *req, size_t req_len,
+			void *buf, size_t len, void *data);
+};
+
+int genl_set_transport_ops(const struct genl_transport_ops *ops, void *data);
 struct nlmsghdr *genl_nlmsg_build_hdr(char *buf, uint16_t type, uint16_t flags,
 				      uint32_t seq, uint8_t cmd);
+/* Dumps interrupted by NLM_F_DUMP_INTR or ENOBUFS are started over, so cb
+ * is passed the entries read before the restart once more. */
 int genl_socket_talk(struct mnl_socket *nl, struct nlmsghdr *nlh, uint32_t seq,
 		     int (*cb)(const struct nlmsghdr *nlh, void *data),
 		     void *data);
@@ -39,6 +137,14 @@ int gtp5g_del_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 int gtp5g_del_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far);
 int gtp5g_del_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer);
 
+/* Exact length of the request on the rule, headers included. A rule whose
+ * request does not fit MNL_SOCKET_BUFFER_SIZE is refused with EMSGSIZE. */
+size_t gtp5g_pdr_msg_size(struct gtp5g_dev *dev, struct gtp5g_pdr *pdr);
+size_t gtp5g_far_msg_size(struct gtp5g_dev *dev, struct gtp5g_far *far);
+size_t gtp5g_qer_msg_size(struct gtp5g_dev *dev, struct gtp5g_qer *qer);
+
+/* A dump interrupted because the table changed is started over, the rules
+ * written before are then written again */
 int gtp5g_list_pdr(int genl_id, struct mnl_socket *nl);
 int gtp5g_list_far(int genl_id, struct mnl_socket *nl);
 int gtp5g_list_qer(int genl_id, struct mnl_socket *nl);
@@ -47,8 +153,514 @@ void gtp5g_print_pdr(struct gtp5g_pdr *pdr);
 void gtp5g_print_far(struct gtp5g_far *far);
 void gtp5g_print_qer(struct gtp5g_qer *qer);
 
+/*
+ * Output formats of the list and print functions. JSON is one object per
+ * rule and line, without the fields the rule does not have. CSV starts with
+ * a header line and leaves such fields empty. All of them are written to
+ * stdout in large writes rather than through stdio.
+ */
+enum gtp5g_format {
+	GTP5G_FORMAT_TEXT,		/* as gtp5g_list_pdr() and gtp5g_print_pdr() */
+	GTP5G_FORMAT_JSON,
+	GTP5G_FORMAT_CSV,
+};
+
+int gtp5g_list_pdr_format(int genl_id, struct mnl_socket *nl, enum gtp5g_format format);
+int gtp5g_list_far_format(int genl_id, struct mnl_socket *nl, enum gtp5g_format format);
+int gtp5g_list_qer_format(int genl_id, struct mnl_socket *nl, enum gtp5g_format format);
+
+void gtp5g_print_pdr_format(struct gtp5g_pdr *pdr, enum gtp5g_format format);
+void gtp5g_print_far_format(struct gtp5g_far *far, enum gtp5g_format format);
+void gtp5g_print_qer_format(struct gtp5g_qer *qer, enum gtp5g_format format);
+
+/*
+ * Where the output of the _to() variants goes: it is gathered in a buffer
+ * and handed over in large chunks to write, which returns the bytes it took
+ * or -1 with errno set, or to write(2) on fd when write is NULL. To print
+ * to a FILE *, use gtp5g_sink_fwrite() with the FILE * as data.
+ */
+struct gtp5g_sink {
+	int	fd;
+	ssize_t	(*write)(const void *buf, size_t len, void *data);
+	void	*data;
+};
+
+ssize_t gtp5g_sink_fwrite(const void *buf, size_t len, void *data);
+
+/* As gtp5g_list_pdr(), a restarted dump writes its rules again */
+int gtp5g_list_pdr_to(int genl_id, struct mnl_socket *nl,
+		      const struct gtp5g_sink *sink, enum gtp5g_format format);
+int gtp5g_list_far_to(int genl_id, struct mnl_socket *nl,
+		      const struct gtp5g_sink *sink, enum gtp5g_format format);
+int gtp5g_list_qer_to(int genl_id, struct mnl_socket *nl,
+		      const struct gtp5g_sink *sink, enum gtp5g_format format);
+
+void gtp5g_print_pdr_to(struct gtp5g_pdr *pdr, const struct gtp5g_sink *sink,
+			enum gtp5g_format format);
+void gtp5g_print_far_to(struct gtp5g_far *far, const struct gtp5g_sink *sink,
+			enum gtp5g_format format);
+void gtp5g_print_qer_to(struct gtp5g_qer *qer, const struct gtp5g_sink *sink,
+			enum gtp5g_format format);
+
+/*
+ * Batches
+ *
+ * Requests queued on a batch are sent a few dozen per datagram when
+ * gtp5g_batch_send() is called, and their ACKs are read back in one go.
+ * Like the kernel, a batch does not stop at a failed request: cb is called
+ * for each one with the index it was queued at, in addition to the callback
+ * of gtp5g_set_err_cb(). Failures found while queueing, such as a PDR
+ * without precedence, make the gtp5g_batch_* call return -1 instead.
+ */
+struct gtp5g_batch;
+
+typedef void (*gtp5g_batch_err_cb_t)(unsigned int index, const struct gtp5g_err *err,
+				     void *data);
+
+struct gtp5g_batch *gtp5g_batch_alloc(int genl_id, struct mnl_socket *nl);
+void gtp5g_batch_free(struct gtp5g_batch *b);
+unsigned int gtp5g_batch_count(const struct gtp5g_batch *b);
+int gtp5g_batch_send(struct gtp5g_batch *b, gtp5g_batch_err_cb_t cb, void *data);
+
+int gtp5g_batch_add_pdr(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr);
+int gtp5g_batch_add_far(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_far *far);
+int gtp5g_batch_add_qer(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_qer *qer);
+
+int gtp5g_batch_mod_pdr(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr);
+int gtp5g_batch_mod_far(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_far *far);
+int gtp5g_batch_mod_qer(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_qer *qer);
+
+int gtp5g_batch_del_pdr(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr);
+int gtp5g_batch_del_far(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_far *far);
+int gtp5g_batch_del_qer(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_qer *qer);
+
+/* For callers building the payload themselves: gtp5g_batch_put() starts a
+ * request of at most MNL_SOCKET_BUFFER_SIZE bytes, id is the one reported
+ * if it fails, and gtp5g_batch_commit() queues it once built.
+ * gtp5g_batch_put_size() leaves room for a request of size bytes only, e.g.
+ * of gtp5g_pdr_msg_size(), so that the batch grows no further than needed. */
+struct nlmsghdr *gtp5g_batch_put(struct gtp5g_batch *b, uint16_t flags,
+				 uint8_t cmd, uint32_t id);
+struct nlmsghdr *gtp5g_batch_put_size(struct gtp5g_batch *b, uint16_t flags,
+				      uint8_t cmd, uint32_t id, size_t size);
+void gtp5g_batch_commit(struct gtp5g_batch *b, struct nlmsghdr *nlh);
+
+/*
+ * Asynchronous requests
+ *
+ * A gtp5g_async keeps requests in flight without waiting for their ACKs,
+ * so one thread can have any number outstanding. Requests are built as on
+ * a batch, with gtp5g_async_put() and gtp5g_async_commit(), and go out
+ * several per datagram on the next gtp5g_async_flush() or
+ * gtp5g_async_process(); as for batches, no more than a datagram's worth
+ * is left unacknowledged at a time and the rest wait their turn.
+ *
+ * The socket is switched to non-blocking and should carry nothing else.
+ * Poll gtp5g_async_get_fd() for gtp5g_async_events(), POLLIN and POLLOUT
+ * when the socket took no more, e.g. from an epoll loop, and call
+ * gtp5g_async_process() when it is ready: it reads the ACKs that arrived
+ * and sends what waits. The callback of each request is called once from
+ * there, err NULL on success. It may queue more requests, but not flush,
+ * process or free the gtp5g_async. gtp5g_async_free() completes what is
+ * still pending with ECANCELED, and fails what those callbacks queue.
+ */
+struct gtp5g_async;
+
+typedef void (*gtp5g_async_cb_t)(const struct gtp5g_err *err, void *data);
+
+struct gtp5g_async *gtp5g_async_alloc(int genl_id, struct mnl_socket *nl);
+void gtp5g_async_free(struct gtp5g_async *a);
+int gtp5g_async_get_fd(const struct gtp5g_async *a);
+int gtp5g_async_events(const struct gtp5g_async *a);
+/* Requests committed whose callback was not called yet */
+unsigned int gtp5g_async_pending(const struct gtp5g_async *a);
+
+struct nlmsghdr *gtp5g_async_put(struct gtp5g_async *a, uint16_t flags,
+				 uint8_t cmd, uint32_t id);
+struct nlmsghdr *gtp5g_async_put_size(struct gtp5g_async *a, uint16_t flags,
+				      uint8_t cmd, uint32_t id, size_t size);
+void gtp5g_async_commit(struct gtp5g_async *a, struct nlmsghdr *nlh,
+			gtp5g_async_cb_t cb, void *data);
+
+/* These return the number of requests completed, or -1 */
+int gtp5g_async_flush(struct gtp5g_async *a);
+int gtp5g_async_process(struct gtp5g_async *a);
+/* Process and poll until nothing is pending */
+int gtp5g_async_run(struct gtp5g_async *a);
+
+/*
+ * Snapshots
+ *
+ * gtp5g_snapshot_save() dumps the PDR, FAR and QER tables into fd as a
+ * compact binary file: the netlink attributes of each rule, sorted by ID.
+ * gtp5g dumps carry no device, so this is every rule in the network
+ * namespace of the socket. gtp5g_snapshot_restore() replays such a file onto
+ * dev in batches, QERs and FARs first. It returns the number of rules that
+ * failed, each one also reported to cb like gtp5g_batch_send() does, or -1.
+ * Snapshots are only read back on hosts of the same byte order.
+ */
+struct gtp5g_snapshot_stats {
+	uint32_t	pdr;
+	uint32_t	far;
+	uint32_t	qer;
+	uint32_t	failed;		/* restore only */
+};
+
+int gtp5g_snapshot_save(int genl_id, struct mnl_socket *nl, int fd,
+			struct gtp5g_snapshot_stats *stats);
+int gtp5g_snapshot_restore(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev,
+			   int fd, struct gtp5g_snapshot_stats *stats,
+			   gtp5g_batch_err_cb_t cb, void *data);
+
+/*
+ * Mapped snapshots
+ *
+ * gtp5g_snapmap_save() dumps the tables like gtp5g_snapshot_save(), but
+ * writes fixed-size records that a reader can use in place: the PDRs, FARs
+ * and QERs sorted by ID, and indices of the PDRs by TEID and by UE address.
+ * Variable-length fields live in a data section that the records point into.
+ * gtp5g_snapmap_open() maps such a file read-only and only checks its
+ * header, so opening costs the same for any size; the pointers returned are
+ * valid until gtp5g_snapmap_close(). Like the rest of the library, TEIDs and
+ * IDs are in host byte order and IPv4 addresses in network byte order. The
+ * file is read back on hosts of the same byte order only. A record holds
+ * one SDF filter, saving PDRs with more fails with EOPNOTSUPP.
+ */
+struct gtp5g_snapmap;
+
+/* Bytes of the data section, len is 0 when the field is absent */
+struct gtp5g_snapmap_data {
+	uint32_t	off;
+	uint32_t	len;
+};
+
+enum {
+	GTP5G_SNAPMAP_PDR_PRECEDENCE	= (1 << 0),
+	GTP5G_SNAPMAP_PDR_OHR		= (1 << 1),
+	GTP5G_SNAPMAP_PDR_FAR_ID	= (1 << 2),
+	GTP5G_SNAPMAP_PDR_QER_ID	= (1 << 3),
+	GTP5G_SNAPMAP_PDR_UE_ADDR	= (1 << 4),
+	GTP5G_SNAPMAP_PDR_F_TEID	= (1 << 5),
+	GTP5G_SNAPMAP_PDR_ROLE_ADDR	= (1 << 6),
+	GTP5G_SNAPMAP_PDR_SDF_RULE	= (1 << 7),
+	GTP5G_SNAPMAP_PDR_SDF_TOS	= (1 << 8),
+	GTP5G_SNAPMAP_PDR_SDF_SPI	= (1 << 9),
+	GTP5G_SNAPMAP_PDR_SDF_FLOW_LABEL = (1 << 10),
+	GTP5G_SNAPMAP_PDR_SDF_ID	= (1 << 11),
+};
+
+struct gtp5g_snapmap_pdr {
+	uint32_t	flags;			/* GTP5G_SNAPMAP_PDR_* */
+	uint16_t	id;
+	uint8_t		outer_hdr_removal;
+	uint8_t		__pad;
+	uint32_t	precedence;
+	uint32_t	far_id;
+	uint32_t	qer_id;
+	uint32_t	teid;
+	uint32_t	gtpu_addr;
+	uint32_t	ue_addr;
+	uint32_t	role_addr;
+	struct gtp5g_snapmap_data unix_sock_path;	/* NUL terminated */
+	struct {
+		uint8_t		action;
+		uint8_t		direction;
+		uint8_t		proto;
+		uint8_t		__pad;
+		uint32_t	src;
+		uint32_t	smask;
+		uint32_t	dest;
+		uint32_t	dmask;
+		struct gtp5g_snapmap_data sport;	/* uint32_t port ranges */
+		struct gtp5g_snapmap_data dport;
+		uint16_t	tos_traffic_class;
+		uint16_t	__pad2;
+		uint32_t	security_param_idx;
+		uint32_t	flow_label;
+		uint32_t	sdf_filter_id;
+	} sdf;
+};
+
+enum {
+	GTP5G_SNAPMAP_FAR_OHC		= (1 << 0),
+};
+
+struct gtp5g_snapmap_far {
+	uint32_t	flags;			/* GTP5G_SNAPMAP_FAR_* */
+	uint32_t	id;
+	uint8_t		apply_action;
+	uint8_t		__pad;
+	uint16_t	ohc_desp;
+	uint32_t	ohc_teid;
+	uint32_t	ohc_peer_addr;
+	uint16_t	ohc_port;
+	uint16_t	__pad2;
+	struct gtp5g_snapmap_data fwd_policy;	/* NUL terminated */
+};
+
+struct gtp5g_snapmap_qer {
+	uint32_t	id;
+	uint8_t		ul_dl_gate;
+	uint8_t		qfi;
+	uint8_t		rqi;
+	uint8_t		ppi;
+	uint32_t	mbr_ul_high;
+	uint32_t	mbr_dl_high;
+	uint32_t	gbr_ul_high;
+	uint32_t	gbr_dl_high;
+	uint8_t		mbr_ul_low;
+	uint8_t		mbr_dl_low;
+	uint8_t		gbr_ul_low;
+	uint8_t		gbr_dl_low;
+	uint32_t	qer_corr_id;
+	uint8_t		rcsr;
+	uint8_t		__pad[3];
+};
+
+/* An index entry, pdr is the position of the PDR in gtp5g_snapmap_pdrs() */
+struct gtp5g_snapmap_idx {
+	uint32_t	key;
+	uint32_t	pdr;
+};
+
+int gtp5g_snapmap_save(int genl_id, struct mnl_socket *nl, int fd,
+		       struct gtp5g_snapshot_stats *stats);
+struct gtp5g_snapmap *gtp5g_snapmap_open(const char *path);
+void gtp5g_snapmap_close(struct gtp5g_snapmap *m);
+
+const struct gtp5g_snapmap_pdr *gtp5g_snapmap_pdrs(const struct gtp5g_snapmap *m, uint32_t *num);
+const struct gtp5g_snapmap_far *gtp5g_snapmap_fars(const struct gtp5g_snapmap *m, uint32_t *num);
+const struct gtp5g_snapmap_qer *gtp5g_snapmap_qers(const struct gtp5g_snapmap *m, uint32_t *num);
+
+const struct gtp5g_snapmap_pdr *gtp5g_snapmap_find_pdr(const struct gtp5g_snapmap *m, uint16_t id);
+const struct gtp5g_snapmap_far *gtp5g_snapmap_find_far(const struct gtp5g_snapmap *m, uint32_t id);
+const struct gtp5g_snapmap_qer *gtp5g_snapmap_find_qer(const struct gtp5g_snapmap *m, uint32_t id);
+
+/* All the PDRs of a TEID or UE address, as *num consecutive index entries */
+const struct gtp5g_snapmap_idx *gtp5g_snapmap_pdrs_by_teid(const struct gtp5g_snapmap *m,
+							  uint32_t teid, uint32_t *num);
+const struct gtp5g_snapmap_idx *gtp5g_snapmap_pdrs_by_ue_addr(const struct gtp5g_snapmap *m,
+							     uint32_t ue_addr, uint32_t *num);
+
+/* The bytes d refers to, NULL when absent or outside of the file */
+const void *gtp5g_snapmap_get_data(const struct gtp5g_snapmap *m,
+				   const struct gtp5g_snapmap_data *d);
+
 struct gtp5g_pdr *gtp5g_pdr_find_by_id(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr);
 struct gtp5g_far *gtp5g_far_find_by_id(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far);
 struct gtp5g_qer *gtp5g_qer_find_by_id(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer);
 
+/* Like gtp5g_*_find_by_id(), into out, an object of gtp5g_*_alloc() kept by
+ * the caller, rather than into a new object. out may be the object the ID
+ * is taken from. Memory out already has is reused, so once it has held a
+ * rule of the same shape the lookup allocates nothing. Returns 0 or -1,
+ * out is unchanged when the rule was not found. */
+int gtp5g_pdr_find_by_id_into(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev,
+                              struct gtp5g_pdr *pdr, struct gtp5g_pdr *out);
+int gtp5g_far_find_by_id_into(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev,
+                              struct gtp5g_far *far, struct gtp5g_far *out);
+int gtp5g_qer_find_by_id_into(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev,
+                              struct gtp5g_qer *qer, struct gtp5g_qer *out);
+
+/*
+ * Views
+ *
+ * gtp5g_dump_views() dumps the tables without building gtp5g_pdr, gtp5g_far
+ * or gtp5g_qer objects: the callbacks are passed a view of the message as
+ * received, and its accessors return pointers into the receive buffer. A
+ * view and what it returns are valid until the callback returns. An
+ * accessor returns NULL when the rule has no such field, the lists set *num
+ * to their number of entries. Values are as the kernel sent them: TEIDs and
+ * IDs in host byte order, IPv4 addresses in network byte order. Tables
+ * without a callback are not dumped, a callback returning -1 stops the dump.
+ * A dump interrupted because the table changed is started over: restart,
+ * when set, is called with the GTP5G_CMD_GET_* of the table before the
+ * rules passed to its callback so far are passed again.
+ */
+struct gtp5g_pdr_view;
+struct gtp5g_far_view;
+struct gtp5g_qer_view;
+
+struct gtp5g_view_ops {
+	int	(*pdr)(const struct gtp5g_pdr_view *view, void *data);
+	int	(*far)(const struct gtp5g_far_view *view, void *data);
+	int	(*qer)(const struct gtp5g_qer_view *view, void *data);
+	void	(*restart)(uint8_t cmd, void *data);
+};
+
+int gtp5g_dump_views(int genl_id, struct mnl_socket *nl, const struct gtp5g_view_ops *ops,
+		     void *data);
+
+const uint16_t *gtp5g_pdr_view_get_id(const struct gtp5g_pdr_view *v);
+const uint32_t *gtp5g_pdr_view_get_precedence(const struct gtp5g_pdr_view *v);
+const uint8_t *gtp5g_pdr_view_get_outer_header_removal(const struct gtp5g_pdr_view *v);
+const uint32_t *gtp5g_pdr_view_get_far_id(const struct gtp5g_pdr_view *v);
+const uint32_t *gtp5g_pdr_view_get_qer_id(const struct gtp5g_pdr_view *v);
+const struct in_addr *gtp5g_pdr_view_get_role_addr_ipv4(const struct gtp5g_pdr_view *v);
+/* *len bytes, not counting a NUL, which may be missing */
+const char *gtp5g_pdr_view_get_unix_sock_path(const struct gtp5g_pdr_view *v, size_t *len);
+const struct in_addr *gtp5g_pdr_view_get_ue_addr_ipv4(const struct gtp5g_pdr_view *v);
+const uint32_t *gtp5g_pdr_view_get_local_f_teid_teid(const struct gtp5g_pdr_view *v);
+const struct in_addr *gtp5g_pdr_view_get_local_f_teid_gtpu_addr_ipv4(const struct gtp5g_pdr_view *v);
+/* The SDF filter getters read the first filter of the PDR. For each of its
+ * filters in order, gtp5g_pdr_view_for_each_sdf_filter() passes cb a view
+ * whose SDF filter getters read that filter; it returns their number, or -1
+ * with ECANCELED when cb returns < 0. */
+int gtp5g_pdr_view_has_sdf_filter(const struct gtp5g_pdr_view *v);
+int gtp5g_pdr_view_for_each_sdf_filter(const struct gtp5g_pdr_view *v,
+				       int (*cb)(const struct gtp5g_pdr_view *sdf, void *data),
+				       void *data);
+const uint8_t *gtp5g_pdr_view_get_sdf_action(const struct gtp5g_pdr_view *v);
+const uint8_t *gtp5g_pdr_view_get_sdf_direction(const struct gtp5g_pdr_view *v);
+const uint8_t *gtp5g_pdr_view_get_sdf_protocol(const struct gtp5g_pdr_view *v);
+const struct in_addr *gtp5g_pdr_view_get_sdf_src_ipv4(const struct gtp5g_pdr_view *v);
+const struct in_addr *gtp5g_pdr_view_get_sdf_src_mask(const struct gtp5g_pdr_view *v);
+const struct in_addr *gtp5g_pdr_view_get_sdf_dest_ipv4(const struct gtp5g_pdr_view *v);
+const struct in_addr *gtp5g_pdr_view_get_sdf_dest_mask(const struct gtp5g_pdr_view *v);
+/* Port ranges packed as low | high << 16 */
+const uint32_t *gtp5g_pdr_view_get_sdf_src_ports(const struct gtp5g_pdr_view *v, int *num);
+const uint32_t *gtp5g_pdr_view_get_sdf_dest_ports(const struct gtp5g_pdr_view *v, int *num);
+const uint16_t *gtp5g_pdr_view_get_tos_traffic_class(const struct gtp5g_pdr_view *v);
+const uint32_t *gtp5g_pdr_view_get_security_param_idx(const struct gtp5g_pdr_view *v);
+const uint32_t *gtp5g_pdr_view_get_flow_label(const struct gtp5g_pdr_view *v);
+const uint32_t *gtp5g_pdr_view_get_sdf_filter_id(const struct gtp5g_pdr_view *v);
+
+const uint32_t *gtp5g_far_view_get_id(const struct gtp5g_far_view *v);
+const uint8_t *gtp5g_far_view_get_apply_action(const struct gtp5g_far_view *v);
+const uint16_t *gtp5g_far_view_get_outer_header_creation_description(const struct gtp5g_far_view *v);
+const uint32_t *gtp5g_far_view_get_outer_header_creation_teid(const struct gtp5g_far_view *v);
+const struct in_addr *gtp5g_far_view_get_outer_header_creation_peer_addr_ipv4(const struct gtp5g_far_view *v);
+const uint16_t *gtp5g_far_view_get_outer_header_creation_port(const struct gtp5g_far_view *v);
+/* *len bytes, not counting a NUL, which may be missing */
+const char *gtp5g_far_view_get_fwd_policy(const struct gtp5g_far_view *v, size_t *len);
+const uint16_t *gtp5g_far_view_get_related_pdr_list(const struct gtp5g_far_view *v, int *num);
+
+const uint32_t *gtp5g_qer_view_get_id(const struct gtp5g_qer_view *v);
+const uint8_t *gtp5g_qer_view_get_gate_status(const struct gtp5g_qer_view *v);
+const uint32_t *gtp5g_qer_view_get_mbr_uhigh(const struct gtp5g_qer_view *v);
+const uint8_t *gtp5g_qer_view_get_mbr_ulow(const struct gtp5g_qer_view *v);
+const uint32_t *gtp5g_qer_view_get_mbr_dhigh(const struct gtp5g_qer_view *v);
+const uint8_t *gtp5g_qer_view_get_mbr_dlow(const struct gtp5g_qer_view *v);
+const uint32_t *gtp5g_qer_view_get_gbr_uhigh(const struct gtp5g_qer_view *v);
+const uint8_t *gtp5g_qer_view_get_gbr_ulow(const struct gtp5g_qer_view *v);
+const uint32_t *gtp5g_qer_view_get_gbr_dhigh(const struct gtp5g_qer_view *v);
+const uint8_t *gtp5g_qer_view_get_gbr_dlow(const struct gtp5g_qer_view *v);
+const uint32_t *gtp5g_qer_view_get_qer_corr_id(const struct gtp5g_qer_view *v);
+const uint8_t *gtp5g_qer_view_get_rqi(const struct gtp5g_qer_view *v);
+const uint8_t *gtp5g_qer_view_get_qfi(const struct gtp5g_qer_view *v);
+const uint8_t *gtp5g_qer_view_get_ppi(const struct gtp5g_qer_view *v);
+const uint8_t *gtp5g_qer_view_get_rcsr(const struct gtp5g_qer_view *v);
+const uint16_t *gtp5g_qer_view_get_related_pdr_list(const struct gtp5g_qer_view *v, int *num);
+
+/*
+ * Handles
+ *
+ * A handle holds gtp5g devices spread over network namespaces, named like
+ * `ip netns` does, by a path such as /proc/<pid>/ns/net, or NULL for the
+ * namespace of the caller. Each namespace gets a genl socket created inside
+ * of it; entering another namespace needs CAP_SYS_ADMIN. Devices are
+ * numbered from 0 in the order they were added, requests through the
+ * handle go to the socket of the device's namespace.
+ *
+ * The family ID and the ifindex of each device are resolved when the device
+ * is added and cached. The handle listens to link and nlctrl notifications:
+ * a device deleted or renamed, or the gtp5g module unloaded, drops what it
+ * invalidates, and that is resolved again by the next request needing it.
+ * Notifications are taken before each request; a caller idle for long can
+ * also poll gtp5g_handle_get_fd() and call gtp5g_handle_process() when it
+ * is readable. The gtp5g_dev of gtp5g_handle_dev() is the cached one.
+ *
+ * gtp5g_handle_dump() and gtp5g_handle_run() work on every namespace at
+ * once, each from its own thread, so their callbacks are called
+ * concurrently from several threads, one per namespace. gtp5g dumps carry
+ * no device, a namespace's rules of all of its devices come in one dump:
+ * the dump callbacks are passed the number of the namespace, that of
+ * gtp5g_handle_netns_index(), and the rule they are passed is reused for the
+ * next one once they return. A callback returning -1 stops the dump of its
+ * namespace. Failures in the threads are reported to the callback of the
+ * handle, or of gtp5g_set_err_cb(), and the first namespace's failure is
+ * left for gtp5g_get_err() of the caller.
+ */
+struct gtp5g_handle;
+
+struct gtp5g_handle *gtp5g_handle_alloc(void);
+void gtp5g_handle_free(struct gtp5g_handle *h);
+/* What the handle allocates from then on, the rules of its dumps, its
+ * batches and its own tables, comes from a, NULL for the library's. Only
+ * before the first device is added. */
+int gtp5g_handle_set_allocator(struct gtp5g_handle *h, const struct gtp5g_allocator *a);
+/* Called for the failures of the handle's calls, including those in the
+ * threads of gtp5g_handle_dump() and gtp5g_handle_run(), in place of the
+ * callback of gtp5g_set_err_cb(); NULL goes back to that one. Batches and
+ * asynchronous requests from the handle report to the global callback. */
+int gtp5g_handle_set_err_cb(struct gtp5g_handle *h, gtp5g_err_cb_t cb, void *data);
+
+/* Both return the number of the device, or -1 */
+int gtp5g_handle_add_dev(struct gtp5g_handle *h, const char *netns, const char *ifname);
+int gtp5g_handle_find_dev(const struct gtp5g_handle *h, const char *netns,
+			  const char *ifname);
+unsigned int gtp5g_handle_count(const struct gtp5g_handle *h);
+
+/* For the functions taking genl_id, nl and dev themselves */
+struct gtp5g_dev *gtp5g_handle_dev(struct gtp5g_handle *h, unsigned int dev);
+struct mnl_socket *gtp5g_handle_socket(struct gtp5g_handle *h, unsigned int dev);
+int gtp5g_handle_genl_id(struct gtp5g_handle *h, unsigned int dev);
+/* 0 when the device cannot be resolved */
+uint32_t gtp5g_handle_ifindex(struct gtp5g_handle *h, unsigned int dev);
+const char *gtp5g_handle_netns(const struct gtp5g_handle *h, unsigned int dev);
+/* Namespaces are numbered from 0 in the order their first device was
+ * added, -1 for no such device */
+int gtp5g_handle_netns_index(const struct gtp5g_handle *h, unsigned int dev);
+const char *gtp5g_handle_ifname(const struct gtp5g_handle *h, unsigned int dev);
+
+int gtp5g_handle_add_pdr(struct gtp5g_handle *h, unsigned int dev, struct gtp5g_pdr *pdr);
+int gtp5g_handle_add_far(struct gtp5g_handle *h, unsigned int dev, struct gtp5g_far *far);
+int gtp5g_handle_add_qer(struct gtp5g_handle *h, unsigned int dev, struct gtp5g_qer *qer);
+
+int gtp5g_handle_mod_pdr(struct gtp5g_handle *h, unsigned int dev, struct gtp5g_pdr *pdr);
+int gtp5g_handle_mod_far(struct gtp5g_handle *h, unsigned int dev, struct gtp5g_far *far);
+int gtp5g_handle_mod_qer(struct gtp5g_handle *h, unsigned int dev, struct gtp5g_qer *qer);
+
+int gtp5g_handle_del_pdr(struct gtp5g_handle *h, unsigned int dev, struct gtp5g_pdr *pdr);
+int gtp5g_handle_del_far(struct gtp5g_handle *h, unsigned int dev, struct gtp5g_far *far);
+int gtp5g_handle_del_qer(struct gtp5g_handle *h, unsigned int dev, struct gtp5g_qer *qer);
+
+/* The fd is readable when notifications are pending, -1 before the first
+ * device is added. Returns the number of sockets they were read from */
+int gtp5g_handle_get_fd(const struct gtp5g_handle *h);
+int gtp5g_handle_process(struct gtp5g_handle *h);
+
+/* A batch on the socket of dev's namespace, queue requests for dev only */
+struct gtp5g_batch *gtp5g_handle_batch_alloc(struct gtp5g_handle *h, unsigned int dev);
+/* Asynchronous requests to dev, on a socket of its own in dev's namespace */
+struct gtp5g_async *gtp5g_handle_async_alloc(struct gtp5g_handle *h, unsigned int dev);
+
+/* Tables without a callback are not dumped. restart is called as for
+ * gtp5g_view_ops, when the dump of a table starts over. ns is the number of
+ * the namespace the rule is from. The callbacks of different namespaces run
+ * at the same time in different threads, data is shared by all of them. */
+struct gtp5g_handle_dump_ops {
+	int	(*pdr)(struct gtp5g_handle *h, unsigned int ns, struct gtp5g_pdr *pdr,
+		       void *data);
+	int	(*far)(struct gtp5g_handle *h, unsigned int ns, struct gtp5g_far *far,
+		       void *data);
+	int	(*qer)(struct gtp5g_handle *h, unsigned int ns, struct gtp5g_qer *qer,
+		       void *data);
+	void	(*restart)(struct gtp5g_handle *h, unsigned int ns, uint8_t cmd,
+			   void *data);
+};
+
+/* Returns the number of namespaces whose dump failed, or -1 */
+int gtp5g_handle_dump(struct gtp5g_handle *h, const struct gtp5g_handle_dump_ops *ops,
+		      void *data);
+/* Calls fn for every device, e.g. to restore a snapshot onto each of them.
+ * Returns the number of devices it returned -1 for, or -1 */
+int gtp5g_handle_run(struct gtp5g_handle *h,
+		     int (*fn)(struct gtp5g_handle *h, unsigned int dev, void *data),
+		     void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -55,6 +55,13 @@ enum gtp5g_pdi_attrs {
     GTP5G_PDI_UE_ADDR_IPV4 = 1,
     GTP5G_PDI_F_TEID,
     GTP5G_PDI_SDF_FILTER,
+    GTP5G_PDI_SRC_INTF,
+
+    /* Not in free5GC's gtp5g: a nest of one GTP5G_PDI_SDF_FILTER per
+     * filter, for PDRs with more than one. Only sent to a module whose
+     * policy dump advertises it at this value as a nested array in the PDI
+     * policy of GTP5G_CMD_ADD_PDR, see gtp5g_pdr_add_sdf_filter(). */
+    GTP5G_PDI_SDF_FILTER_LIST,
 
     __GTP5G_PDI_ATTR_MAX,
 };
@@ -69,7 +76,7 @@ enum gtp5g_f_teid_attrs {
 };
 #define GTP5G_F_TEID_ATTR_MAX (__GTP5G_F_TEID_ATTR_MAX - 1)
 
-/* Nest in GTP5G_PDI_SDF_FILTER */
+/* Nest in GTP5G_PDI_SDF_FILTER, alone or in GTP5G_PDI_SDF_FILTER_LIST */
 enum gtp5g_sdf_filter_attrs {
     GTP5G_SDF_FILTER_FLOW_DESCRIPTION = 1,
     GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS,
@@ -21,10 +21,13 @@
  *
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
 #include <time.h>
+#include <sys/socket.h>
 
 #include <libmnl/libmnl.h>
 #include <linux/genetlink.h>
@@ -64,7 +67,7 @@ static int genl_ctrl_validate_cb(const struct nlattr *attr, void *data)
 	switch(type) {
 	case CTRL_ATTR_FAMILY_ID:
 		if (mnl_attr_validate(attr, MNL_TYPE_U16) < 0) {
-			perror("mnl_attr_validate");
+			gtp5g_err_set(errno, 0, "CTRL_ATTR_FAMILY_ID mnl_attr_validate");
 			return MNL_CB_ERROR;
 		}
 		break;
@@ -88,53 +91,696 @@ static int genl_ctrl_cb(const struct nlmsghdr *nlh, void *data)
 	return MNL_CB_OK;
 }
 
+static int gtp5g_attr_parse_payload(const void *payload, size_t len,
+				    const struct gtp5g_policy *p,
+				    const struct nlattr **tb, int skip)
+{
+	const struct gtp5g_attr_policy *pol;
+	const struct nlattr *attr;
+	char msg[GTP5G_ERR_MSG_MAX];
+	uint16_t type, plen;
+	int bad;
+
+	mnl_attr_for_each_payload(payload, len) {
+		type = mnl_attr_get_type(attr);
+		if (type > p->max)
+			continue;
+
+		pol = &p->attrs[type];
+		plen = mnl_attr_get_payload_len(attr);
+		switch (pol->type) {
+		case MNL_TYPE_NESTED:
+			bad = plen && plen < MNL_ATTR_HDRLEN;
+			break;
+		default:
+			bad = pol->len && plen != pol->len;
+			break;
+		}
+		if (bad && skip)
+			continue;
+		if (bad) {
+			snprintf(msg, sizeof(msg), "%s attribute %u of length %u", p->name, type, plen);
+			gtp5g_err_set(ERANGE, 0, msg);
+			return -1;
+		}
+
+		tb[type] = attr;
+	}
+
+	return 0;
+}
+
+int gtp5g_attr_parse(const struct nlmsghdr *nlh, const struct gtp5g_policy *p,
+		     const struct nlattr **tb)
+{
+	if (nlh->nlmsg_len < MNL_NLMSG_HDRLEN + GENL_HDRLEN)
+		return 0;
+
+	return gtp5g_attr_parse_payload(mnl_nlmsg_get_payload_offset(nlh, GENL_HDRLEN),
+					nlh->nlmsg_len - MNL_NLMSG_HDRLEN - GENL_HDRLEN,
+					p, tb, 0);
+}
+
+int gtp5g_attr_parse_nested(const struct nlattr *nest, const struct gtp5g_policy *p,
+			    const struct nlattr **tb)
+{
+	return gtp5g_attr_parse_payload(mnl_attr_get_payload(nest),
+					mnl_attr_get_payload_len(nest), p, tb, 0);
+}
+
+void gtp5g_attr_parse_view(const struct nlmsghdr *nlh, const struct gtp5g_policy *p,
+			   const struct nlattr **tb)
+{
+	if (nlh->nlmsg_len < MNL_NLMSG_HDRLEN + GENL_HDRLEN)
+		return;
+
+	gtp5g_attr_parse_payload(mnl_nlmsg_get_payload_offset(nlh, GENL_HDRLEN),
+				 nlh->nlmsg_len - MNL_NLMSG_HDRLEN - GENL_HDRLEN,
+				 p, tb, 1);
+}
+
+void gtp5g_attr_parse_nested_view(const struct nlattr *nest, const struct gtp5g_policy *p,
+				  const struct nlattr **tb)
+{
+	gtp5g_attr_parse_payload(mnl_attr_get_payload(nest),
+				 mnl_attr_get_payload_len(nest), p, tb, 1);
+}
+
 struct mnl_socket *genl_socket_open(void)
 {
 	struct mnl_socket *nl;
 
 	nl = mnl_socket_open(NETLINK_GENERIC);
 	if (nl == NULL) {
-		perror("mnl_socket_open");
+		gtp5g_err_fail(errno, 0, 0, "mnl_socket_open");
 		return NULL;
 	}
 
 	if (mnl_socket_bind(nl, 0, MNL_SOCKET_AUTOPID) < 0) {
-		perror("mnl_socket_bind");
-		return NULL;
+		gtp5g_err_fail(errno, 0, 0, "mnl_socket_bind");
+		goto err;
 	}
 
+	/* Best effort, kernels before 4.12 do not know about extended ACKs */
+	genl_socket_set_cap_ack(nl, 1);
+	genl_socket_set_ext_ack(nl, 1);
+
 	return nl;
+err:
+	mnl_socket_close(nl);
+	return NULL;
 }
 EXPORT_SYMBOL(genl_socket_open);
 
+static int genl_socket_set_flag(struct mnl_socket *nl, int type, int on)
+{
+	on = !!on;
+	return mnl_socket_setsockopt(nl, type, &on, sizeof(on));
+}
+
+/* Only echo the header of the failed request back in error ACKs */
+int genl_socket_set_cap_ack(struct mnl_socket *nl, int on)
+{
+	return genl_socket_set_flag(nl, NETLINK_CAP_ACK, on);
+}
+EXPORT_SYMBOL(genl_socket_set_cap_ack);
+
+/* Let the kernel attach a message and the rejected attribute to error ACKs */
+int genl_socket_set_ext_ack(struct mnl_socket *nl, int on)
+{
+	return genl_socket_set_flag(nl, NETLINK_EXT_ACK, on);
+}
+EXPORT_SYMBOL(genl_socket_set_ext_ack);
+
+/* A dump that collected lost or inconsistent messages is started over, at
+ * most this many times */
+#define GENL_DUMP_MAX_RESTART	8
+
+/* Size of a receive buffer of genl_socket_talk(), one per datagram. 0 keeps
+ * the default of MNL_SOCKET_BUFFER_SIZE on the stack for requests and
+ * GENL_DUMP_BUFFER_SIZE on the heap for dumps. */
+#define GENL_DUMP_BUFFER_SIZE	32768
+
+/* Datagrams taken by one recvmmsg() call while reading a dump */
+#define GENL_RECV_BATCH		8
+#define GENL_RECV_BATCH_MAX	64
+
+static size_t genl_recv_size;
+static unsigned int genl_recv_batch = GENL_RECV_BATCH;
+
+static int genl_socket_set_buf(struct mnl_socket *nl, int type, int type_force,
+			       int size, int force)
+{
+	int fd = mnl_socket_get_fd(nl);
+
+	/* The FORCE variants need CAP_NET_ADMIN but ignore rmem_max/wmem_max */
+	if (force && setsockopt(fd, SOL_SOCKET, type_force, &size, sizeof(size)) == 0)
+		return 0;
+
+	return setsockopt(fd, SOL_SOCKET, type, &size, sizeof(size));
+}
+
+int genl_socket_set_rcvbuf(struct mnl_socket *nl, int size, int force)
+{
+	return genl_socket_set_buf(nl, SO_RCVBUF, SO_RCVBUFFORCE, size, force);
+}
+EXPORT_SYMBOL(genl_socket_set_rcvbuf);
+
+int genl_socket_set_sndbuf(struct mnl_socket *nl, int size, int force)
+{
+	return genl_socket_set_buf(nl, SO_SNDBUF, SO_SNDBUFFORCE, size, force);
+}
+EXPORT_SYMBOL(genl_socket_set_sndbuf);
+
+/* Do not report ENOBUFS when the kernel drops messages for this socket */
+int genl_socket_set_no_enobufs(struct mnl_socket *nl, int on)
+{
+	return genl_socket_set_flag(nl, NETLINK_NO_ENOBUFS, on);
+}
+EXPORT_SYMBOL(genl_socket_set_no_enobufs);
+
+void genl_set_recv_buffer_size(size_t size)
+{
+	genl_recv_size = size;
+}
+EXPORT_SYMBOL(genl_set_recv_buffer_size);
+
+/* 1 reads dumps one datagram per syscall, 0 restores the default */
+void genl_set_recv_batch(unsigned int vlen)
+{
+	if (!vlen)
+		vlen = GENL_RECV_BATCH;
+	else if (vlen > GENL_RECV_BATCH_MAX)
+		vlen = GENL_RECV_BATCH_MAX;
+
+	genl_recv_batch = vlen;
+}
+EXPORT_SYMBOL(genl_set_recv_batch);
+
+static int genl_sock_send(struct mnl_socket *nl, const void *buf, size_t len,
+			  void *data)
+{
+	return mnl_socket_sendto(nl, buf, len) < 0 ? -1 : 0;
+}
+
+static ssize_t genl_sock_recv(struct mnl_socket *nl, void *buf, size_t len,
+			      void *data)
+{
+	return mnl_socket_recvfrom(nl, buf, len);
+}
+
+const struct genl_transport_ops gtp5g_transport_socket = {
+	.send	= genl_sock_send,
+	.recv	= genl_sock_recv,
+};
+
+static enum genl_transport genl_transport = GENL_TRANSPORT_SOCKET;
+static const struct genl_transport_ops *genl_transport_ops;
+static void *genl_transport_data;
+/* Custom transports without recv, reading the socket */
+static struct genl_transport_ops genl_transport_sock_recv;
+
+/* Of gtp5g_sdf_filter_list_supported(): family genl_id << 2 with
+ * GENL_SDF_LIST_KNOWN and GENL_SDF_LIST, or 0. Asked again when the
+ * transport, which may be another module, changes. */
+#define GENL_SDF_LIST_KNOWN	2
+#define GENL_SDF_LIST		1
+static int genl_sdf_list_cache;
+
+/* Threads where io_uring turns out to be unavailable keep using sockets */
+int genl_set_transport(enum genl_transport transport)
+{
+	switch (transport) {
+	case GENL_TRANSPORT_SOCKET:
+		break;
+	case GENL_TRANSPORT_CUSTOM:
+		if (genl_transport_ops)
+			break;
+		errno = EINVAL;
+		return -1;
+	case GENL_TRANSPORT_IO_URING:
+#ifdef HAVE_IO_URING
+		if (gtp5g_uring_transport())
+			break;
+#endif
+		errno = EOPNOTSUPP;
+		return -1;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+
+	genl_transport = transport;
+	__atomic_store_n(&genl_sdf_list_cache, 0, __ATOMIC_RELAXED);
+	return 0;
+}
+EXPORT_SYMBOL(genl_set_transport);
+
+int genl_set_transport_ops(const struct genl_transport_ops *ops, void *data)
+{
+	if (!ops || !ops->send) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!ops->recv) {
+		genl_transport_sock_recv = *ops;
+		genl_transport_sock_recv.recv = genl_sock_recv;
+		ops = &genl_transport_sock_recv;
+	}
+
+	genl_transport_ops = ops;
+	genl_transport_data = data;
+	genl_transport = GENL_TRANSPORT_CUSTOM;
+	__atomic_store_n(&genl_sdf_list_cache, 0, __ATOMIC_RELAXED);
+	return 0;
+}
+EXPORT_SYMBOL(genl_set_transport_ops);
+
+const struct genl_transport_ops *genl_transport_get(void **data)
+{
+#ifdef HAVE_IO_URING
+	const struct genl_transport_ops *t;
+#endif
+
+	*data = NULL;
+	switch (genl_transport) {
+	case GENL_TRANSPORT_CUSTOM:
+		*data = genl_transport_data;
+		return genl_transport_ops;
+#ifdef HAVE_IO_URING
+	case GENL_TRANSPORT_IO_URING:
+		t = gtp5g_uring_transport();
+		if (t)
+			return t;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	return &gtp5g_transport_socket;
+}
+
+int genl_transport_reads_socket(const struct genl_transport_ops *t)
+{
+	return t->recv == genl_sock_recv;
+}
+
 void genl_socket_close(struct mnl_socket *nl)
 {
 	mnl_socket_close(nl);
 }
 EXPORT_SYMBOL(genl_socket_close);
 
-int genl_socket_talk(struct mnl_socket *nl, struct nlmsghdr *nlh, uint32_t seq,
-		     int (*cb)(const struct nlmsghdr *nlh, void *data),
-		     void *data)
+static uint8_t genl_nlmsg_get_cmd(const struct nlmsghdr *nlh)
 {
-	char buf[MNL_SOCKET_BUFFER_SIZE];
+	const struct genlmsghdr *genl;
+
+	if (mnl_nlmsg_get_payload_len(nlh) < sizeof(*genl))
+		return 0;
+
+	genl = mnl_nlmsg_get_payload(nlh);
+	return genl->cmd;
+}
+
+static int genl_extack_attr_cb(const struct nlattr *attr, void *data)
+{
+	const struct nlattr **tb = data;
+	int type = mnl_attr_get_type(attr);
+
+	if (mnl_attr_type_valid(attr, NLMSGERR_ATTR_MAX) < 0)
+		return MNL_CB_OK;
+
+	switch(type) {
+	case NLMSGERR_ATTR_MSG:
+		if (mnl_attr_validate(attr, MNL_TYPE_NUL_STRING) < 0)
+			return MNL_CB_OK;
+		break;
+	case NLMSGERR_ATTR_OFFS:
+		if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
+			return MNL_CB_OK;
+		break;
+	}
+	tb[type] = attr;
+	return MNL_CB_OK;
+}
+
+struct genl_talk {
+	int	(*cb)(const struct nlmsghdr *nlh, void *data);
+	void	*data;
+	int	intr;
+	int	failed;		/* cb failed before the end of the reply */
+};
+
+/* Parts of a dump flagged NLM_F_DUMP_INTR never get here, libmnl fails
+ * them with EINTR, see genl_talk_run() */
+static int genl_cb_data(const struct nlmsghdr *nlh, void *data)
+{
+	struct genl_talk *talk = data;
 	int ret;
 
-	if (mnl_socket_sendto(nl, nlh, nlh->nlmsg_len) < 0) {
-		perror("mnl_socket_send");
-		return -1;
+	ret = talk->cb ? talk->cb(nlh, talk->data) : MNL_CB_OK;
+	if (ret == MNL_CB_ERROR)
+		talk->failed = 1;
+	return ret;
+}
+
+static int genl_cb_noop(const struct nlmsghdr *nlh, void *data)
+{
+	return MNL_CB_OK;
+}
+
+/* Same as the default NLMSG_ERROR handling of libmnl, but also records
+ * the extended ACK attributes the kernel attached to the error. */
+int genl_cb_error(const struct nlmsghdr *nlh, void *data)
+{
+	struct nlattr *tb[NLMSGERR_ATTR_MAX + 1] = {};
+	const struct nlmsgerr *err = mnl_nlmsg_get_payload(nlh);
+	size_t offset, len = mnl_nlmsg_get_payload_len(nlh);
+	const char *msg = NULL;
+	uint32_t attr_offset = 0;
+
+	if (len < sizeof(*err)) {
+		gtp5g_err_set(EBADMSG, 0, "truncated NLMSG_ERROR");
+		return MNL_CB_ERROR;
 	}
 
-	ret = mnl_socket_recvfrom(nl, buf, sizeof(buf));
-	while (ret > 0) {
-		ret = mnl_cb_run(buf, ret, seq, mnl_socket_get_portid(nl),
-				 cb, data);
-		if (ret <= 0)
+	if (err->error == 0)
+		return MNL_CB_STOP;
+
+	if (nlh->nlmsg_flags & NLM_F_ACK_TLVS) {
+		/* TLVs follow the echoed request, of which only the header is
+		 * left when the ACK is capped */
+		offset = sizeof(*err);
+		if (!(nlh->nlmsg_flags & NLM_F_CAPPED))
+			offset += err->msg.nlmsg_len - sizeof(err->msg);
+
+		if (offset < len) {
+			mnl_attr_parse_payload((const char *)err + offset, len - offset,
+					       genl_extack_attr_cb, tb);
+			if (tb[NLMSGERR_ATTR_MSG])
+				msg = mnl_attr_get_str(tb[NLMSGERR_ATTR_MSG]);
+			if (tb[NLMSGERR_ATTR_OFFS])
+				attr_offset = mnl_attr_get_u32(tb[NLMSGERR_ATTR_OFFS]);
+		}
+	}
+
+	gtp5g_err_set(err->error < 0 ? -err->error : err->error, attr_offset, msg);
+	errno = gtp5g_get_err()->err;
+	return MNL_CB_ERROR;
+}
+
+static int genl_cb_done(const struct nlmsghdr *nlh, void *data)
+{
+	return MNL_CB_STOP;
+}
+
+static const mnl_cb_t genl_cb_ctl_array[NLMSG_DONE + 1] = {
+	[NLMSG_NOOP]	= genl_cb_noop,
+	[NLMSG_ERROR]	= genl_cb_error,
+	[NLMSG_DONE]	= genl_cb_done,
+};
+
+static int genl_nlmsg_has_done(const char *buf, size_t len)
+{
+	const struct nlmsghdr *nlh = (const struct nlmsghdr *)buf;
+	int rem = len;
+
+	while (mnl_nlmsg_ok(nlh, rem)) {
+		if (nlh->nlmsg_type == NLMSG_DONE)
+			return 1;
+		nlh = mnl_nlmsg_next(nlh, &rem);
+	}
+
+	return 0;
+}
+
+static int genl_talk_run(struct mnl_socket *nl, struct genl_talk *talk,
+			 const char *buf, size_t len, uint32_t seq)
+{
+	int ret;
+
+	ret = mnl_cb_run2(buf, len, seq, mnl_socket_get_portid(nl),
+			  genl_cb_data, talk, genl_cb_ctl_array,
+			  sizeof(genl_cb_ctl_array) / sizeof(genl_cb_ctl_array[0]));
+
+	/* libmnl gives up on the first message flagged NLM_F_DUMP_INTR, the
+	 * dump still has to be read until its end */
+	if (ret < 0 && errno == EINTR) {
+		talk->intr = 1;
+		return genl_nlmsg_has_done(buf, len) ? MNL_CB_STOP : MNL_CB_OK;
+	}
+
+	if (ret < 0 && talk->failed && genl_nlmsg_has_done(buf, len))
+		talk->failed = 0;
+	return ret;
+}
+
+static const mnl_cb_t genl_cb_drain_array[NLMSG_DONE + 1] = {
+	[NLMSG_NOOP]	= genl_cb_noop,
+	[NLMSG_ERROR]	= genl_cb_done,
+	[NLMSG_DONE]	= genl_cb_done,
+};
+
+/* A callback failing leaves the rest of the reply on the socket, where the
+ * next request would take it for its own. Read it up to its ACK or
+ * NLMSG_DONE without passing it on, a request without either has nothing
+ * left. */
+static void genl_talk_drain(struct mnl_socket *nl, const struct genl_transport_ops *t,
+			    void *t_data, const struct nlmsghdr *nlh, char *buf,
+			    size_t len, uint32_t seq)
+{
+	int dump = (nlh->nlmsg_flags & NLM_F_DUMP) == NLM_F_DUMP;
+	int saved = errno;
+	ssize_t n;
+	int ret;
+
+	if (!dump && !(nlh->nlmsg_flags & NLM_F_ACK))
+		return;
+
+	for (;;) {
+		n = t->recv(nl, buf, len, t_data);
+		if (n <= 0)
+			break;
+
+		ret = mnl_cb_run2(buf, n, seq, mnl_socket_get_portid(nl),
+				  NULL, NULL, genl_cb_drain_array,
+				  sizeof(genl_cb_drain_array) / sizeof(genl_cb_drain_array[0]));
+		if (ret == MNL_CB_STOP)
+			break;
+		if (ret < 0 && (errno != EINTR || genl_nlmsg_has_done(buf, n)))
 			break;
-		ret = mnl_socket_recvfrom(nl, buf, sizeof(buf));
 	}
 
+	errno = saved;
+}
+
+/* Send the request and read its reply through transport t */
+static int genl_talk_recv(struct mnl_socket *nl, const struct genl_transport_ops *t,
+			  void *t_data, struct genl_talk *talk,
+			  const struct nlmsghdr *nlh, char *buf, size_t len,
+			  uint32_t seq, int dump)
+{
+	ssize_t ret;
+
+	if (t->talk)
+		ret = t->talk(nl, nlh, nlh->nlmsg_len, buf, len, t_data);
+	else {
+		if (t->send(nl, nlh, nlh->nlmsg_len, t_data) < 0) {
+			gtp5g_err_set(errno, 0, "send request");
+			return -1;
+		}
+		ret = t->recv(nl, buf, len, t_data);
+	}
+
+	for (;;) {
+		if (ret < 0) {
+			/* Messages of the dump were dropped, the rest of it
+			 * still has to be read before starting over */
+			if (dump && errno == ENOBUFS) {
+				talk->intr = 1;
+				ret = t->recv(nl, buf, len, t_data);
+				continue;
+			}
+			if (errno == ENOSPC)
+				gtp5g_err_set(ENOSPC, 0, "receive buffer too small");
+			return -1;
+		}
+		if (ret == 0)
+			return 0;
+
+		ret = genl_talk_run(nl, talk, buf, ret, seq);
+		if (ret <= 0)
+			return ret;
+
+		ret = t->recv(nl, buf, len, t_data);
+	}
+}
+
+/* Same as genl_talk_recv() on a plain socket, but takes up to vlen datagrams of len bytes
+ * into buf per syscall. The kernel refills the socket with the next part
+ * of a dump as each datagram is read, so most calls return a full batch. */
+static int genl_talk_recv_mmsg(struct mnl_socket *nl, struct genl_talk *talk,
+			       char *buf, size_t len, unsigned int vlen,
+			       uint32_t seq)
+{
+	struct mmsghdr msgs[GENL_RECV_BATCH_MAX];
+	struct iovec iov[GENL_RECV_BATCH_MAX];
+	struct sockaddr_nl addr[GENL_RECV_BATCH_MAX];
+	int fd = mnl_socket_get_fd(nl);
+	unsigned int i;
+	int n, ret;
+
+	for (i = 0; i < vlen; i++) {
+		iov[i].iov_base = buf + i * len;
+		iov[i].iov_len = len;
+	}
+
+	for (;;) {
+		for (i = 0; i < vlen; i++) {
+			msgs[i].msg_hdr = (struct msghdr) {
+				.msg_name	= &addr[i],
+				.msg_namelen	= sizeof(addr[i]),
+				.msg_iov	= &iov[i],
+				.msg_iovlen	= 1,
+			};
+		}
+
+		n = recvmmsg(fd, msgs, vlen, MSG_WAITFORONE, NULL);
+		if (n < 0) {
+			if (errno == ENOBUFS) {
+				talk->intr = 1;
+				continue;
+			}
+			return -1;
+		}
+		if (n == 0)
+			return 0;
+
+		for (i = 0; i < (unsigned int)n; i++) {
+			if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+				gtp5g_err_set(ENOSPC, 0, "receive buffer too small");
+				return -1;
+			}
+			if (msgs[i].msg_hdr.msg_namelen != sizeof(addr[i])) {
+				errno = EINVAL;
+				return -1;
+			}
+
+			ret = genl_talk_run(nl, talk, iov[i].iov_base,
+					    msgs[i].msg_len, seq);
+			if (ret < 0 && talk->failed) {
+				/* The end of the reply may be in the batch */
+				while (++i < (unsigned int)n) {
+					if (genl_nlmsg_has_done(iov[i].iov_base, msgs[i].msg_len))
+						talk->failed = 0;
+				}
+			}
+			if (ret <= 0)
+				return ret;
+		}
+	}
+}
+
+/* Replies to dumps may be restarted, restart is then called before cb
+ * sees the same entries again. */
+int gtp5g_socket_dump(struct mnl_socket *nl, struct nlmsghdr *nlh, uint32_t seq,
+		      int (*cb)(const struct nlmsghdr *nlh, void *data),
+		      void (*restart)(void *data), void *data, uint32_t id)
+{
+	char stack_buf[MNL_SOCKET_BUFFER_SIZE];
+	struct genl_talk talk = {
+		.cb	= cb,
+		.data	= data,
+	};
+	void *t_data;
+	const struct genl_transport_ops *t = genl_transport_get(&t_data);
+	int dump = (nlh->nlmsg_flags & NLM_F_DUMP) == NLM_F_DUMP;
+	unsigned int vlen = 1;
+	size_t len = genl_recv_size;
+	const struct gtp5g_allocator *a = gtp5g_allocator;
+	char *buf = stack_buf;
+	int restarts = 0;
+	int ret;
+
+	gtp5g_err_reset();
+
+	/* recvmmsg() only exists for plain sockets */
+	if (dump && genl_transport_reads_socket(t))
+		vlen = genl_recv_batch;
+	if (!len && dump)
+		len = GENL_DUMP_BUFFER_SIZE;
+	if (len <= sizeof(stack_buf))
+		len = sizeof(stack_buf);
+	if (len > sizeof(stack_buf) || vlen > 1) {
+		buf = gtp5g_malloc(a, vlen * len);
+		if (!buf) {
+			gtp5g_err_set(ENOMEM, 0, "receive buffer");
+			goto err;
+		}
+	}
+
+	do {
+		if (talk.intr && restart)
+			restart(data);
+		talk.intr = 0;
+
+		if (vlen > 1) {
+			if (t->send(nl, nlh, nlh->nlmsg_len, t_data) < 0) {
+				gtp5g_err_set(errno, 0, "send request");
+				goto err;
+			}
+			ret = genl_talk_recv_mmsg(nl, &talk, buf, len, vlen, seq);
+		}
+		else
+			ret = genl_talk_recv(nl, t, t_data, &talk, nlh, buf, len, seq, dump);
+		if (ret < 0) {
+			/* Keep the cause if a callback has already recorded one */
+			if (!gtp5g_get_err()->err)
+				gtp5g_err_set(errno, 0, NULL);
+			if (talk.failed)
+				genl_talk_drain(nl, t, t_data, nlh, buf, len, seq);
+			goto err;
+		}
+	} while (dump && talk.intr && ++restarts <= GENL_DUMP_MAX_RESTART);
+
+	if (talk.intr) {
+		gtp5g_err_set(EINTR, 0, "dump interrupted too often");
+		goto err;
+	}
+
+	if (buf != stack_buf)
+		gtp5g_free(a, buf);
 	return ret;
+err:
+	if (buf != stack_buf)
+		gtp5g_free(a, buf);
+	gtp5g_err_report(genl_nlmsg_get_cmd(nlh), id);
+	return -1;
+}
+
+int gtp5g_socket_talk(struct mnl_socket *nl, struct nlmsghdr *nlh, uint32_t seq,
+		      int (*cb)(const struct nlmsghdr *nlh, void *data),
+		      void *data, uint32_t id)
+{
+	return gtp5g_socket_dump(nl, nlh, seq, cb, NULL, data, id);
+}
+
+int gtp5g_msg_fits(const struct nlmsghdr *nlh, size_t size, size_t len, uint32_t id)
+{
+	if (nlh->nlmsg_len <= size && len <= size - nlh->nlmsg_len)
+		return 0;
+
+	gtp5g_err_fail(EMSGSIZE, genl_nlmsg_get_cmd(nlh), id, "rule too large for a request");
+	return -1;
+}
+
+int genl_socket_talk(struct mnl_socket *nl, struct nlmsghdr *nlh, uint32_t seq,
+		     int (*cb)(const struct nlmsghdr *nlh, void *data),
+		     void *data)
+{
+	return gtp5g_socket_talk(nl, nlh, seq, cb, data, 0);
 }
 EXPORT_SYMBOL(genl_socket_talk);
 
@@ -173,3 +819,153 @@ int genl_lookup_family(struct mnl_socket *nl, const char *family)
 	return genl_id;
 }
 EXPORT_SYMBOL(genl_lookup_family);
+
+#if HAVE_DECL_CTRL_ATTR_OP
+/* Policies of a policy dump tracked, by their index */
+#define GENL_POLICY_MAX		32
+
+struct genl_sdf_list_probe {
+	uint32_t	do_policy;			/* of GTP5G_CMD_ADD_PDR */
+	uint32_t	pdi_policy[GENL_POLICY_MAX];	/* of its PDI nest, + 1 */
+	uint32_t	sdf_list;			/* policies with the list */
+};
+
+static int genl_policy_u32(const struct nlattr *nest, uint16_t type, uint32_t *v)
+{
+	const struct nlattr *attr;
+
+	mnl_attr_for_each_nested(attr, nest) {
+		if (mnl_attr_get_type(attr) == type &&
+		    mnl_attr_validate(attr, MNL_TYPE_U32) == 0) {
+			*v = mnl_attr_get_u32(attr);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* Attribute attr of policy pol, described by nested NL_POLICY_TYPE_ATTR_*.
+ * GTP5G_PDR_PDI and GTP5G_PDI_SDF_FILTER_LIST share a value, the type of
+ * the attribute tells them apart. */
+static void genl_sdf_list_attr(struct genl_sdf_list_probe *p, uint16_t pol,
+			       const struct nlattr *attr)
+{
+	uint16_t type = mnl_attr_get_type(attr);
+	uint32_t v;
+
+	if (genl_policy_u32(attr, NL_POLICY_TYPE_ATTR_TYPE, &v) < 0)
+		return;
+
+	if (type == GTP5G_PDR_PDI && v == NL_ATTR_TYPE_NESTED &&
+	    genl_policy_u32(attr, NL_POLICY_TYPE_ATTR_POLICY_IDX, &v) == 0 &&
+	    v < GENL_POLICY_MAX)
+		p->pdi_policy[pol] = v + 1;
+	else if (type == GTP5G_PDI_SDF_FILTER_LIST && v == NL_ATTR_TYPE_NESTED_ARRAY)
+		p->sdf_list |= 1u << pol;
+}
+
+static int genl_sdf_list_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct genl_sdf_list_probe *p = data;
+	const struct nlattr *attr, *nest, *pol;
+
+	mnl_attr_for_each(attr, nlh, sizeof(struct genlmsghdr)) {
+		switch (mnl_attr_get_type(attr)) {
+		case CTRL_ATTR_OP_POLICY:
+			mnl_attr_for_each_nested(nest, attr) {
+				if (mnl_attr_get_type(nest) == GTP5G_CMD_ADD_PDR)
+					genl_policy_u32(nest, CTRL_ATTR_POLICY_DO, &p->do_policy);
+			}
+			break;
+		case CTRL_ATTR_POLICY:
+			mnl_attr_for_each_nested(pol, attr) {
+				if (mnl_attr_get_type(pol) >= GENL_POLICY_MAX)
+					continue;
+				mnl_attr_for_each_nested(nest, pol)
+					genl_sdf_list_attr(p, mnl_attr_get_type(pol), nest);
+			}
+			break;
+		}
+	}
+
+	return MNL_CB_OK;
+}
+
+/* The probe is no request of the caller's, its failures are not reported */
+static void genl_sdf_list_quiet(const struct gtp5g_err *err, void *data)
+{
+}
+
+static const struct gtp5g_err_hook genl_sdf_list_hook = { .cb = genl_sdf_list_quiet };
+static const struct gtp5g_err_hook *const genl_sdf_list_scope = &genl_sdf_list_hook;
+
+/* Asks nlctrl on a socket of its own, nl may be busy or non-blocking. The
+ * last error is left as it was, unless the probe itself failed. */
+static int genl_sdf_list_probe(int genl_id)
+{
+	struct genl_sdf_list_probe p = {};
+	struct gtp5g_err last = *gtp5g_get_err();
+	const struct gtp5g_err_hook *saved;
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct mnl_socket *nl;
+	struct nlmsghdr *nlh;
+	uint32_t seq = time(NULL), pdi;
+	int ret;
+
+	saved = gtp5g_err_enter(&genl_sdf_list_scope);
+	nl = genl_socket_open();
+	if (!nl) {
+		gtp5g_err_leave(saved);
+		return -1;
+	}
+
+	nlh = genl_nlmsg_build_hdr(buf, GENL_ID_CTRL, NLM_F_DUMP, seq, CTRL_CMD_GETPOLICY);
+	mnl_attr_put_u16(nlh, CTRL_ATTR_FAMILY_ID, genl_id);
+	mnl_attr_put_u32(nlh, CTRL_ATTR_OP, GTP5G_CMD_ADD_PDR);
+	ret = gtp5g_socket_talk(nl, nlh, seq, genl_sdf_list_cb, &p, 0);
+	genl_socket_close(nl);
+	gtp5g_err_leave(saved);
+
+	if (ret < 0 && gtp5g_get_err()->err == ENOMEM)
+		return -1;
+	gtp5g_err_copy(&last);
+
+	/* Kernels before 5.10 cannot dump the policy of a command */
+	if (ret < 0)
+		return 0;
+
+	pdi = p.do_policy < GENL_POLICY_MAX ? p.pdi_policy[p.do_policy] : 0;
+	return pdi && (p.sdf_list >> (pdi - 1)) & 1;
+}
+#else
+static int genl_sdf_list_probe(int genl_id)
+{
+	return 0;
+}
+#endif
+
+/* Whether the gtp5g module of family genl_id takes GTP5G_PDI_SDF_FILTER_LIST
+ * in GTP5G_CMD_ADD_PDR, asked once. -1 when that failed. */
+int gtp5g_sdf_filter_list_supported(int genl_id)
+{
+	int v = __atomic_load_n(&genl_sdf_list_cache, __ATOMIC_RELAXED);
+	int ret;
+
+	if ((v & GENL_SDF_LIST_KNOWN) && v >> 2 == genl_id)
+		return v & GENL_SDF_LIST;
+
+	ret = genl_sdf_list_probe(genl_id);
+	if (ret < 0)
+		return -1;
+
+	v = genl_id << 2 | GENL_SDF_LIST_KNOWN | ret;
+	__atomic_store_n(&genl_sdf_list_cache, v, __ATOMIC_RELAXED);
+	return ret;
+}
+
+/* A module loaded again may get the same family id and take other
+ * attributes */
+void gtp5g_sdf_filter_list_forget(void)
+{
+	__atomic_store_n(&genl_sdf_list_cache, 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,89 @@
+/* Allocator of the library's memory */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+
+static void *gtp5g_libc_malloc(size_t size, void *ctx)
+{
+	return malloc(size);
+}
+
+static void *gtp5g_libc_calloc(size_t nmemb, size_t size, void *ctx)
+{
+	return calloc(nmemb, size);
+}
+
+static void *gtp5g_libc_realloc(void *ptr, size_t size, void *ctx)
+{
+	return realloc(ptr, size);
+}
+
+static void gtp5g_libc_free(void *ptr, void *ctx)
+{
+	free(ptr);
+}
+
+const struct gtp5g_allocator gtp5g_allocator_libc = {
+	.malloc		= gtp5g_libc_malloc,
+	.calloc		= gtp5g_libc_calloc,
+	.realloc	= gtp5g_libc_realloc,
+	.free		= gtp5g_libc_free,
+};
+
+const struct gtp5g_allocator *gtp5g_allocator = &gtp5g_allocator_libc;
+
+/* a, or the library's one when NULL, failing with NULL when a hook is
+ * missing */
+const struct gtp5g_allocator *gtp5g_allocator_check(const struct gtp5g_allocator *a)
+{
+	if (!a)
+		return gtp5g_allocator;
+	if (!a->malloc || !a->calloc || !a->realloc || !a->free) {
+		gtp5g_err_fail(EINVAL, 0, 0, "allocator without all of its hooks");
+		return NULL;
+	}
+	return a;
+}
+
+int gtp5g_set_allocator(const struct gtp5g_allocator *a)
+{
+	if (a && !gtp5g_allocator_check(a))
+		return -1;
+
+	gtp5g_allocator = a ? a : &gtp5g_allocator_libc;
+	return 0;
+}
+EXPORT_SYMBOL(gtp5g_set_allocator);
+
+char *gtp5g_strdup(const struct gtp5g_allocator *a, const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *p;
+
+	p = gtp5g_malloc(a, len);
+	if (p)
+		memcpy(p, s, len);
+	return p;
+}
@@ -0,0 +1,553 @@
+/* gtp5g requests in flight without waiting for their ACKs */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/uio.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/genetlink.h>
+
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+
+struct gtp5g_async_req {
+	gtp5g_async_cb_t	cb;
+	void			*data;
+	uint32_t		id;
+	uint8_t			cmd;
+	uint8_t			done;
+};
+
+/*
+ * Requests are kept in a ring in the order of their sequence numbers, the
+ * one at head has seq. The first sent of the num in the ring went out, the
+ * others wait in buf from off on. The kernel ACKs in order, so entries
+ * retire from the head; one completed out of order stays until the ones
+ * before it are.
+ */
+struct gtp5g_async {
+	const struct gtp5g_allocator	*alloc;
+	int32_t			genl_id;
+	struct mnl_socket	*nl;
+	int			own_nl;
+	uint32_t		seq;
+
+	struct gtp5g_async_req	*reqs;
+	unsigned int		head;
+	unsigned int		num;
+	unsigned int		max;		/* a power of two */
+	unsigned int		sent;
+	unsigned int		inflight;	/* sent, not completed */
+	unsigned int		pending;	/* not completed */
+	int			blocked;	/* the socket took no more */
+	int			freeing;
+
+	char			*buf;
+	size_t			off;
+	size_t			len;
+	size_t			size;
+
+	char			*acks;		/* ACKs read through io_uring */
+	size_t			acks_size;
+	size_t			ack_slot;	/* one of them, at most */
+};
+
+static struct gtp5g_async *gtp5g_async_alloc_with(const struct gtp5g_allocator *alloc,
+						  int genl_id, struct mnl_socket *nl)
+{
+	struct gtp5g_async *a;
+	int fd = mnl_socket_get_fd(nl), fl;
+
+	fl = fcntl(fd, F_GETFL);
+	if (fl < 0 || fcntl(fd, F_SETFL, fl | O_NONBLOCK) < 0) {
+		gtp5g_err_fail(errno, 0, 0, "make socket non-blocking");
+		return NULL;
+	}
+
+	a = gtp5g_calloc(alloc, 1, sizeof(*a));
+	if (!a) {
+		gtp5g_err_fail(ENOMEM, 0, 0, "async");
+		return NULL;
+	}
+
+	a->alloc = alloc;
+	a->genl_id = genl_id;
+	a->nl = nl;
+	a->seq = time(NULL);
+	return a;
+}
+
+struct gtp5g_async *gtp5g_async_alloc_own(const struct gtp5g_allocator *alloc,
+					  int genl_id, struct mnl_socket *nl)
+{
+	struct gtp5g_async *a;
+
+	a = gtp5g_async_alloc_with(alloc, genl_id, nl);
+	if (a)
+		a->own_nl = 1;
+	return a;
+}
+
+struct gtp5g_async *gtp5g_async_alloc(int genl_id, struct mnl_socket *nl)
+{
+	return gtp5g_async_alloc_with(gtp5g_allocator, genl_id, nl);
+}
+EXPORT_SYMBOL(gtp5g_async_alloc);
+
+static inline struct gtp5g_async_req *gtp5g_async_at(const struct gtp5g_async *a,
+						     unsigned int i)
+{
+	return &a->reqs[(a->head + i) & (a->max - 1)];
+}
+
+/* Call the callback of request seq, failed with the error recorded.
+ * Returns 0 when seq is not a request in flight. */
+static int gtp5g_async_complete(struct gtp5g_async *a, uint32_t seq, int failed)
+{
+	struct gtp5g_async_req *r, req;
+	unsigned int i = seq - a->seq;
+
+	if (i >= a->sent || gtp5g_async_at(a, i)->done)
+		return 0;
+
+	r = gtp5g_async_at(a, i);
+	req = *r;
+	r->done = 1;
+	a->inflight--;
+	a->pending--;
+
+	while (a->num && gtp5g_async_at(a, 0)->done) {
+		a->head = (a->head + 1) & (a->max - 1);
+		a->num--;
+		a->sent--;
+		a->seq++;
+	}
+
+	if (failed)
+		gtp5g_err_report(req.cmd, req.id);
+	if (req.cb)
+		req.cb(failed ? gtp5g_get_err() : NULL, req.data);
+	return 1;
+}
+
+void gtp5g_async_free(struct gtp5g_async *a)
+{
+	if (!a)
+		return;
+
+	/* As if sent, so they complete like the others. Their callbacks
+	 * cannot queue more. */
+	a->freeing = 1;
+	a->inflight += a->num - a->sent;
+	a->sent = a->num;
+	while (a->num) {
+		gtp5g_err_set(ECANCELED, 0, "async freed");
+		gtp5g_async_complete(a, a->seq, 1);
+	}
+
+	if (a->own_nl)
+		genl_socket_close(a->nl);
+	gtp5g_free(a->alloc, a->acks);
+	gtp5g_free(a->alloc, a->reqs);
+	gtp5g_free(a->alloc, a->buf);
+	gtp5g_free(a->alloc, a);
+}
+EXPORT_SYMBOL(gtp5g_async_free);
+
+int gtp5g_async_get_fd(const struct gtp5g_async *a)
+{
+	return mnl_socket_get_fd(a->nl);
+}
+EXPORT_SYMBOL(gtp5g_async_get_fd);
+
+int gtp5g_async_events(const struct gtp5g_async *a)
+{
+	return POLLIN | (a->blocked ? POLLOUT : 0);
+}
+EXPORT_SYMBOL(gtp5g_async_events);
+
+unsigned int gtp5g_async_pending(const struct gtp5g_async *a)
+{
+	return a->pending;
+}
+EXPORT_SYMBOL(gtp5g_async_pending);
+
+/* As gtp5g_batch_put_size(), the request is at most MNL_SOCKET_BUFFER_SIZE */
+struct nlmsghdr *gtp5g_async_put_size(struct gtp5g_async *a, uint16_t flags,
+				      uint8_t cmd, uint32_t id, size_t size)
+{
+	struct gtp5g_async_req *reqs, *r;
+	unsigned int i;
+	size_t n;
+	char *buf;
+
+	if (a->freeing) {
+		gtp5g_err_fail(ECANCELED, cmd, id, "async freed");
+		return NULL;
+	}
+	if (size > MNL_SOCKET_BUFFER_SIZE) {
+		gtp5g_err_fail(EMSGSIZE, cmd, id, "rule too large for a request");
+		return NULL;
+	}
+	if (size < GTP5G_MSG_HDR_SIZE)
+		size = GTP5G_MSG_HDR_SIZE;
+
+	if (a->size - a->len < size && a->off) {
+		memmove(a->buf, a->buf + a->off, a->len - a->off);
+		a->len -= a->off;
+		a->off = 0;
+	}
+	if (a->size - a->len < size) {
+		n = a->size ? a->size * 2 : 4 * MNL_SOCKET_BUFFER_SIZE;
+		while (n - a->len < size)
+			n *= 2;
+		buf = gtp5g_realloc(a->alloc, a->buf, n);
+		if (!buf)
+			goto err;
+		a->buf = buf;
+		a->size = n;
+	}
+
+	if (a->num == a->max) {
+		n = a->max ? a->max * 2 : 64;
+		reqs = gtp5g_malloc(a->alloc, n * sizeof(*reqs));
+		if (!reqs)
+			goto err;
+		for (i = 0; i < a->num; i++)
+			reqs[i] = *gtp5g_async_at(a, i);
+		gtp5g_free(a->alloc, a->reqs);
+		a->reqs = reqs;
+		a->head = 0;
+		a->max = n;
+	}
+
+	r = gtp5g_async_at(a, a->num);
+	r->cmd = cmd;
+	r->id = id;
+	r->done = 0;
+
+	return genl_nlmsg_build_hdr(a->buf + a->len, a->genl_id, flags | NLM_F_ACK,
+				    a->seq + a->num, cmd);
+err:
+	gtp5g_err_fail(ENOMEM, cmd, id, "async");
+	return NULL;
+}
+EXPORT_SYMBOL(gtp5g_async_put_size);
+
+struct nlmsghdr *gtp5g_async_put(struct gtp5g_async *a, uint16_t flags,
+				 uint8_t cmd, uint32_t id)
+{
+	return gtp5g_async_put_size(a, flags, cmd, id, MNL_SOCKET_BUFFER_SIZE);
+}
+EXPORT_SYMBOL(gtp5g_async_put);
+
+void gtp5g_async_commit(struct gtp5g_async *a, struct nlmsghdr *nlh,
+			gtp5g_async_cb_t cb, void *data)
+{
+	struct gtp5g_async_req *r = gtp5g_async_at(a, a->num);
+
+	r->cb = cb;
+	r->data = data;
+	if (a->ack_slot < NLMSG_ALIGN(nlh->nlmsg_len) + GTP5G_BATCH_ACK_ROOM)
+		a->ack_slot = NLMSG_ALIGN(nlh->nlmsg_len) + GTP5G_BATCH_ACK_ROOM;
+	a->len += NLMSG_ALIGN(nlh->nlmsg_len);
+	a->num++;
+	a->pending++;
+}
+EXPORT_SYMBOL(gtp5g_async_commit);
+
+/* Cut the next datagram of what waits, n requests while the ACKs in flight
+ * fit, from what is at off */
+static size_t gtp5g_async_dgram(const struct gtp5g_async *a, size_t off,
+				unsigned int sent, unsigned int inflight,
+				unsigned int *n)
+{
+	const struct nlmsghdr *nlh = (const struct nlmsghdr *)(a->buf + off), *next;
+	size_t len = 0;
+
+	for (*n = 0; sent + *n < a->num && inflight + *n < GTP5G_BATCH_DGRAM_MSGS; (*n)++) {
+		next = (const void *)((const char *)nlh + len);
+		if (*n && len + next->nlmsg_len > GTP5G_BATCH_DGRAM_SIZE)
+			break;
+		len += NLMSG_ALIGN(next->nlmsg_len);
+	}
+
+	return len;
+}
+
+/* The n requests of the next len bytes went out, or failed with err */
+static unsigned int gtp5g_async_sent(struct gtp5g_async *a, size_t len,
+				     unsigned int n, int err)
+{
+	uint32_t seq = a->seq + a->sent;
+	unsigned int i, done = 0;
+
+	a->off += len;
+	if (a->off == a->len)
+		a->off = a->len = 0;
+	a->sent += n;
+	a->inflight += n;
+
+	/* The callbacks may queue more, after these */
+	for (i = 0; err && i < n; i++) {
+		gtp5g_err_set(err, 0, "send request");
+		done += gtp5g_async_complete(a, seq + i, 1);
+	}
+
+	return done;
+}
+
+#ifdef HAVE_IO_URING
+/* All the datagrams that may go, in one io_uring_enter() */
+static int gtp5g_async_flush_uring(struct gtp5g_async *a, unsigned int *done)
+{
+	struct iovec iov[GTP5G_BATCH_DGRAM_MSGS];
+	unsigned int n[GTP5G_BATCH_DGRAM_MSGS];
+	int32_t res[GTP5G_BATCH_DGRAM_MSGS];
+	unsigned int k, i, sent = a->sent, inflight = a->inflight;
+	size_t off = a->off;
+
+	/* Called with at least one to send */
+	k = 0;
+	do {
+		iov[k].iov_base = a->buf + off;
+		iov[k].iov_len = gtp5g_async_dgram(a, off, sent, inflight, &n[k]);
+		off += iov[k].iov_len;
+		sent += n[k];
+		inflight += n[k];
+		k++;
+	} while (sent < a->num && inflight < GTP5G_BATCH_DGRAM_MSGS);
+
+	if (gtp5g_uring_xfer(a->nl, iov, k, NULL, 0, MSG_DONTWAIT, res) < 0)
+		return -1;
+
+	/* The first failure cancelled the datagrams after it, they are sent
+	 * again next time */
+	for (i = 0; i < k && res[i] >= 0; i++)
+		*done += gtp5g_async_sent(a, iov[i].iov_len, n[i], 0);
+	if (i == k)
+		return 0;
+	if (res[i] == -EAGAIN || res[i] == -EWOULDBLOCK) {
+		a->blocked = 1;
+		return 0;
+	}
+	if (res[i] != -EINTR)
+		*done += gtp5g_async_sent(a, iov[i].iov_len, n[i], -res[i]);
+	return 0;
+}
+#endif
+
+/* Send what waits, a datagram at a time while the ACKs in flight fit */
+int gtp5g_async_flush(struct gtp5g_async *a)
+{
+	void *t_data;
+	const struct genl_transport_ops *t = genl_transport_get(&t_data);
+	unsigned int n, done = 0;
+	size_t len;
+	int err;
+
+	a->blocked = 0;
+	while (a->sent < a->num && a->inflight < GTP5G_BATCH_DGRAM_MSGS) {
+#ifdef HAVE_IO_URING
+		if (t == &gtp5g_transport_uring) {
+			if (gtp5g_async_flush_uring(a, &done) < 0) {
+				err = errno;
+				len = gtp5g_async_dgram(a, a->off, a->sent, a->inflight, &n);
+				done += gtp5g_async_sent(a, len, n, err);
+			}
+			if (a->blocked)
+				break;
+			continue;
+		}
+#endif
+		len = gtp5g_async_dgram(a, a->off, a->sent, a->inflight, &n);
+
+		err = 0;
+		if (t->send(a->nl, a->buf + a->off, len, t_data) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				a->blocked = 1;
+				break;
+			}
+			err = errno;
+		}
+
+		done += gtp5g_async_sent(a, len, n, err);
+	}
+
+	return done;
+}
+EXPORT_SYMBOL(gtp5g_async_flush);
+
+/* Complete the requests ACKed in the len bytes of buf */
+static int gtp5g_async_ack(struct gtp5g_async *a, const char *buf, int len)
+{
+	const struct nlmsghdr *nlh = (const struct nlmsghdr *)buf;
+	int done = 0, failed;
+
+	for (; mnl_nlmsg_ok(nlh, len); nlh = mnl_nlmsg_next(nlh, &len)) {
+		if (nlh->nlmsg_type != NLMSG_ERROR)
+			continue;
+
+		gtp5g_err_reset();
+		failed = genl_cb_error(nlh, NULL) == MNL_CB_ERROR;
+		done += gtp5g_async_complete(a, nlh->nlmsg_seq, failed);
+	}
+
+	return done;
+}
+
+#ifdef HAVE_IO_URING
+/* Read as many ACKs as there are requests in flight, in one
+ * io_uring_enter(). Returns the number of datagrams read, -1 with errno
+ * set to what stopped the reads. */
+static int gtp5g_async_recv_uring(struct gtp5g_async *a, int *done)
+{
+	struct iovec iov[GTP5G_BATCH_DGRAM_MSGS];
+	int32_t res[GTP5G_BATCH_DGRAM_MSGS];
+	unsigned int n = a->inflight, i;
+	size_t slot = a->ack_slot;
+	ssize_t ret;
+	char *acks;
+
+	if (n > GTP5G_BATCH_DGRAM_MSGS)
+		n = GTP5G_BATCH_DGRAM_MSGS;
+	if (a->acks_size < n * slot) {
+		acks = gtp5g_realloc(a->alloc, a->acks, n * slot);
+		if (!acks) {
+			errno = ENOMEM;
+			return -1;
+		}
+		a->acks = acks;
+		a->acks_size = n * slot;
+	}
+	for (i = 0; i < n; i++) {
+		iov[i].iov_base = a->acks + i * slot;
+		iov[i].iov_len = slot;
+	}
+
+	if (gtp5g_uring_xfer(a->nl, NULL, 0, iov, n, MSG_DONTWAIT, res) < 0)
+		return -1;
+
+	/* Requests the callbacks queue leave the slots alone */
+	for (i = 0; i < n; i++) {
+		ret = gtp5g_uring_recv_res(res[i], slot);
+		if (ret < 0)
+			return -1;
+		*done += gtp5g_async_ack(a, iov[i].iov_base, ret);
+	}
+
+	return n;
+}
+#endif
+
+/* Read the ACKs there are. After ENOBUFS, the ones still missing once the
+ * socket is drained were dropped. */
+static int gtp5g_async_recv(struct gtp5g_async *a)
+{
+	void *t_data;
+	const struct genl_transport_ops *t = genl_transport_get(&t_data);
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	int done = 0, lost = 0;
+	ssize_t ret;
+
+	while (a->inflight) {
+#ifdef HAVE_IO_URING
+		if (t == &gtp5g_transport_uring) {
+			if (gtp5g_async_recv_uring(a, &done) >= 0)
+				continue;
+			ret = -1;
+		} else
+#endif
+			ret = t->recv(a->nl, buf, sizeof(buf), t_data);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS) {
+				lost = 1;
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			gtp5g_err_set(errno, 0, "receive ACKs");
+			return -1;
+		}
+
+		done += gtp5g_async_ack(a, buf, ret);
+	}
+
+	while (lost && a->inflight) {
+		gtp5g_err_set(ENOBUFS, 0, "ACK dropped by the socket");
+		done += gtp5g_async_complete(a, a->seq, 1);
+	}
+
+	return done;
+}
+
+int gtp5g_async_process(struct gtp5g_async *a)
+{
+	uint32_t unsent;
+	int done = 0, ret;
+
+	do {
+		ret = gtp5g_async_recv(a);
+		if (ret < 0)
+			return -1;
+		done += ret;
+
+		/* Sending may get more ACKs ready, the sequence number of the
+		 * first request not sent only moves when something went */
+		unsent = a->seq + a->sent;
+		done += gtp5g_async_flush(a);
+	} while (a->seq + a->sent != unsent && a->inflight);
+
+	return done;
+}
+EXPORT_SYMBOL(gtp5g_async_process);
+
+int gtp5g_async_run(struct gtp5g_async *a)
+{
+	struct pollfd pfd = {
+		.fd	= gtp5g_async_get_fd(a),
+	};
+	int done = 0, ret;
+
+	for (;;) {
+		ret = gtp5g_async_process(a);
+		if (ret < 0)
+			return -1;
+		done += ret;
+		if (!a->pending)
+			return done;
+
+		pfd.events = gtp5g_async_events(a);
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+			gtp5g_err_set(errno, 0, "poll async socket");
+			return -1;
+		}
+	}
+}
+EXPORT_SYMBOL(gtp5g_async_run);
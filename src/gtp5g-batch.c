@@ -0,0 +1,418 @@
+/* Batches of gtp5g requests sent together */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/genetlink.h>
+
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+
+struct gtp5g_batch_req {
+	uint8_t		cmd;
+	uint32_t	id;
+};
+
+struct gtp5g_batch {
+	const struct gtp5g_allocator	*alloc;
+	int32_t			genl_id;
+	struct mnl_socket	*nl;
+	uint32_t		seq;		/* of the first queued request */
+
+	char			*buf;
+	size_t			len;
+	size_t			size;
+
+	struct gtp5g_batch_req	*reqs;
+	unsigned int		num;
+	unsigned int		max;
+
+	char			*acks;		/* ACKs of a datagram, one per slot */
+	size_t			acks_size;
+};
+
+struct gtp5g_batch *gtp5g_batch_alloc_with(const struct gtp5g_allocator *a,
+					   int genl_id, struct mnl_socket *nl)
+{
+	struct gtp5g_batch *b;
+
+	b = gtp5g_calloc(a, 1, sizeof(*b));
+	if (!b) {
+		gtp5g_err_fail(ENOMEM, 0, 0, "batch");
+		return NULL;
+	}
+
+	b->alloc = a;
+	b->genl_id = genl_id;
+	b->nl = nl;
+	b->seq = time(NULL);
+	return b;
+}
+
+struct gtp5g_batch *gtp5g_batch_alloc(int genl_id, struct mnl_socket *nl)
+{
+	return gtp5g_batch_alloc_with(gtp5g_allocator, genl_id, nl);
+}
+EXPORT_SYMBOL(gtp5g_batch_alloc);
+
+void gtp5g_batch_free(struct gtp5g_batch *b)
+{
+	if (!b)
+		return;
+
+	gtp5g_free(b->alloc, b->acks);
+	gtp5g_free(b->alloc, b->reqs);
+	gtp5g_free(b->alloc, b->buf);
+	gtp5g_free(b->alloc, b);
+}
+EXPORT_SYMBOL(gtp5g_batch_free);
+
+unsigned int gtp5g_batch_count(const struct gtp5g_batch *b)
+{
+	return b->num;
+}
+EXPORT_SYMBOL(gtp5g_batch_count);
+
+/* Start the next request at the end of the batch, with room for size bytes
+ * of it */
+struct nlmsghdr *gtp5g_batch_put_size(struct gtp5g_batch *b, uint16_t flags,
+				      uint8_t cmd, uint32_t id, size_t size)
+{
+	struct gtp5g_batch_req *reqs;
+	size_t n;
+	char *buf;
+
+	if (size > MNL_SOCKET_BUFFER_SIZE) {
+		gtp5g_err_fail(EMSGSIZE, cmd, id, "rule too large for a request");
+		return NULL;
+	}
+	if (size < GTP5G_MSG_HDR_SIZE)
+		size = GTP5G_MSG_HDR_SIZE;
+
+	if (b->size - b->len < size) {
+		n = b->size ? b->size * 2 : 4 * MNL_SOCKET_BUFFER_SIZE;
+		while (n - b->len < size)
+			n *= 2;
+		buf = gtp5g_realloc(b->alloc, b->buf, n);
+		if (!buf)
+			goto err;
+		b->buf = buf;
+		b->size = n;
+	}
+
+	if (b->num == b->max) {
+		n = b->max ? b->max * 2 : 64;
+		reqs = gtp5g_realloc(b->alloc, b->reqs, n * sizeof(*reqs));
+		if (!reqs)
+			goto err;
+		b->reqs = reqs;
+		b->max = n;
+	}
+
+	b->reqs[b->num].cmd = cmd;
+	b->reqs[b->num].id = id;
+
+	return genl_nlmsg_build_hdr(b->buf + b->len, b->genl_id, flags | NLM_F_ACK,
+				    b->seq + b->num, cmd);
+err:
+	gtp5g_err_fail(ENOMEM, cmd, id, "batch");
+	return NULL;
+}
+EXPORT_SYMBOL(gtp5g_batch_put_size);
+
+/* As above, with room for the largest request the payload builders produce */
+struct nlmsghdr *gtp5g_batch_put(struct gtp5g_batch *b, uint16_t flags,
+				 uint8_t cmd, uint32_t id)
+{
+	return gtp5g_batch_put_size(b, flags, cmd, id, MNL_SOCKET_BUFFER_SIZE);
+}
+EXPORT_SYMBOL(gtp5g_batch_put);
+
+/* Queue the request started by gtp5g_batch_put() once its payload is built */
+void gtp5g_batch_commit(struct gtp5g_batch *b, struct nlmsghdr *nlh)
+{
+	b->len += NLMSG_ALIGN(nlh->nlmsg_len);
+	b->num++;
+}
+EXPORT_SYMBOL(gtp5g_batch_commit);
+
+/* Take the ACKs of requests [first, first + n) out of the len bytes of buf */
+static int gtp5g_batch_ack(struct gtp5g_batch *b, const char *buf, int len,
+			   unsigned int first, unsigned int n, unsigned int *acked,
+			   gtp5g_batch_err_cb_t cb, void *data)
+{
+	const struct nlmsghdr *nlh = (const struct nlmsghdr *)buf;
+	unsigned int idx;
+	int failed = 0;
+
+	for (; mnl_nlmsg_ok(nlh, len); nlh = mnl_nlmsg_next(nlh, &len)) {
+		if (nlh->nlmsg_type != NLMSG_ERROR)
+			continue;
+
+		/* Left over from an earlier request on this socket */
+		idx = nlh->nlmsg_seq - b->seq;
+		if (idx < first || idx >= first + n)
+			continue;
+		(*acked)++;
+
+		gtp5g_err_reset();
+		if (genl_cb_error(nlh, NULL) != MNL_CB_ERROR)
+			continue;
+
+		failed++;
+		gtp5g_err_report(b->reqs[idx].cmd, b->reqs[idx].id);
+		if (cb)
+			cb(idx, gtp5g_get_err(), data);
+	}
+
+	return failed;
+}
+
+/* Read the ACKs of requests [first, first + n) still missing */
+static int gtp5g_batch_recv(struct gtp5g_batch *b,
+			    const struct genl_transport_ops *t, void *t_data,
+			    unsigned int first, unsigned int n, unsigned int *acked,
+			    gtp5g_batch_err_cb_t cb, void *data)
+{
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	int failed = 0;
+	ssize_t ret;
+
+	while (*acked < n) {
+		ret = t->recv(b->nl, buf, sizeof(buf), t_data);
+		if (ret < 0) {
+			gtp5g_err_set(errno, 0, "receive batch ACKs");
+			return -1;
+		}
+		failed += gtp5g_batch_ack(b, buf, ret, first, n, acked, cb, data);
+	}
+
+	return failed;
+}
+
+/* Make room for the ACKs of the n requests at nlh, one per slot of the ACK
+ * buffer. A slot holds the ACK of the largest of the requests, which carries
+ * the request. Returns the slot size, or 0 on failure. */
+static size_t gtp5g_batch_slots(struct gtp5g_batch *b, const struct nlmsghdr *nlh,
+				unsigned int n)
+{
+	size_t slot = 0;
+	unsigned int i;
+	char *acks;
+
+	for (i = 0; i < n; i++) {
+		if (slot < nlh->nlmsg_len)
+			slot = nlh->nlmsg_len;
+		nlh = (const void *)((const char *)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+	}
+	slot = NLMSG_ALIGN(slot) + GTP5G_BATCH_ACK_ROOM;
+
+	if (b->acks_size < n * slot) {
+		acks = gtp5g_realloc(b->alloc, b->acks, n * slot);
+		if (!acks) {
+			gtp5g_err_set(ENOMEM, 0, "batch ACKs");
+			return 0;
+		}
+		b->acks = acks;
+		b->acks_size = n * slot;
+	}
+	return slot;
+}
+
+/* Read the ACKs of requests [first, first + n) at nlh, which the kernel sends
+ * one per datagram, with as few recvmmsg() as they arrive in */
+static int gtp5g_batch_mmsg(struct gtp5g_batch *b, const struct nlmsghdr *nlh,
+			    unsigned int first, unsigned int n,
+			    gtp5g_batch_err_cb_t cb, void *data)
+{
+	struct mmsghdr msgs[GTP5G_BATCH_DGRAM_MSGS];
+	struct iovec iov[GTP5G_BATCH_DGRAM_MSGS];
+	struct sockaddr_nl addr[GTP5G_BATCH_DGRAM_MSGS];
+	int fd = mnl_socket_get_fd(b->nl);
+	unsigned int acked = 0, vlen, i;
+	int failed = 0, ret;
+	size_t slot;
+
+	slot = gtp5g_batch_slots(b, nlh, n);
+	if (!slot)
+		return -1;
+	for (i = 0; i < n; i++) {
+		iov[i].iov_base = b->acks + i * slot;
+		iov[i].iov_len = slot;
+	}
+
+	while (acked < n) {
+		vlen = n - acked;
+		for (i = 0; i < vlen; i++) {
+			msgs[i].msg_hdr = (struct msghdr) {
+				.msg_name	= &addr[i],
+				.msg_namelen	= sizeof(addr[i]),
+				.msg_iov	= &iov[i],
+				.msg_iovlen	= 1,
+			};
+		}
+
+		ret = recvmmsg(fd, msgs, vlen, MSG_WAITFORONE, NULL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			gtp5g_err_set(errno, 0, "receive batch ACKs");
+			return -1;
+		}
+
+		for (i = 0; i < (unsigned int)ret; i++) {
+			if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+				gtp5g_err_set(ENOSPC, 0, "receive buffer too small");
+				return -1;
+			}
+			if (msgs[i].msg_hdr.msg_namelen != sizeof(addr[i])) {
+				gtp5g_err_set(EINVAL, 0, "receive batch ACKs");
+				return -1;
+			}
+			failed += gtp5g_batch_ack(b, iov[i].iov_base, msgs[i].msg_len,
+						  first, n, &acked, cb, data);
+		}
+	}
+
+	return failed;
+}
+
+#ifdef HAVE_IO_URING
+/* Send the datagram of len bytes at nlh, requests [first, first + n), and
+ * read their ACKs, which the kernel sends one per datagram, in a single
+ * io_uring_enter() */
+static int gtp5g_batch_uring(struct gtp5g_batch *b, const struct nlmsghdr *nlh,
+			     size_t len, unsigned int first, unsigned int n,
+			     gtp5g_batch_err_cb_t cb, void *data)
+{
+	struct iovec send = {
+		.iov_base	= (void *)nlh,
+		.iov_len	= len,
+	};
+	struct iovec recv[GTP5G_BATCH_DGRAM_MSGS];
+	int32_t res[1 + GTP5G_BATCH_DGRAM_MSGS];
+	unsigned int acked = 0, i;
+	int failed = 0, ret;
+	size_t slot;
+
+	slot = gtp5g_batch_slots(b, nlh, n);
+	if (!slot)
+		return -1;
+	for (i = 0; i < n; i++) {
+		recv[i].iov_base = b->acks + i * slot;
+		recv[i].iov_len = slot;
+	}
+
+	if (gtp5g_uring_xfer(b->nl, &send, 1, recv, n, 0, res) < 0) {
+		gtp5g_err_set(errno, 0, "send batch");
+		return -1;
+	}
+	if (res[0] < 0) {
+		gtp5g_err_set(-res[0], 0, "send batch");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		ret = gtp5g_uring_recv_res(res[1 + i], slot);
+		if (ret < 0) {
+			gtp5g_err_set(errno, 0, "receive batch ACKs");
+			return -1;
+		}
+		failed += gtp5g_batch_ack(b, recv[i].iov_base, ret, first, n, &acked,
+					  cb, data);
+	}
+
+	/* Some slots took ACKs left over from earlier requests */
+	ret = gtp5g_batch_recv(b, &gtp5g_transport_uring, NULL, first, n, &acked,
+			       cb, data);
+	return ret < 0 ? -1 : failed + ret;
+}
+#endif
+
+/* The kernel handles every request of a datagram in order and does not stop
+ * at a failure, so neither do we. Returns the number of failed requests, or
+ * -1 when the batch could not be sent or acknowledged as a whole. The batch
+ * is empty afterwards. */
+int gtp5g_batch_send(struct gtp5g_batch *b, gtp5g_batch_err_cb_t cb, void *data)
+{
+	void *t_data;
+	const struct genl_transport_ops *t = genl_transport_get(&t_data);
+	const struct nlmsghdr *nlh = (const struct nlmsghdr *)b->buf;
+	unsigned int first = 0, n, acked;
+	int failed = 0, ret;
+	size_t len;
+
+	gtp5g_err_reset();
+
+	while (first < b->num) {
+		/* Cut the next datagram at a request boundary */
+		len = 0;
+		for (n = 0; first + n < b->num && n < GTP5G_BATCH_DGRAM_MSGS; n++) {
+			const struct nlmsghdr *next = (const void *)((const char *)nlh + len);
+
+			if (n && len + next->nlmsg_len > GTP5G_BATCH_DGRAM_SIZE)
+				break;
+			len += NLMSG_ALIGN(next->nlmsg_len);
+		}
+
+#ifdef HAVE_IO_URING
+		if (t == &gtp5g_transport_uring)
+			ret = gtp5g_batch_uring(b, nlh, len, first, n, cb, data);
+		else
+#endif
+		{
+			if (t->send(b->nl, nlh, len, t_data) < 0) {
+				gtp5g_err_set(errno, 0, "send batch");
+				goto err;
+			}
+			if (genl_transport_reads_socket(t))
+				ret = gtp5g_batch_mmsg(b, nlh, first, n, cb, data);
+			else {
+				acked = 0;
+				ret = gtp5g_batch_recv(b, t, t_data, first, n, &acked,
+						       cb, data);
+			}
+		}
+		if (ret < 0)
+			goto err;
+		failed += ret;
+
+		nlh = (const void *)((const char *)nlh + len);
+		first += n;
+	}
+
+	b->seq += b->num;
+	b->len = 0;
+	b->num = 0;
+	return failed;
+err:
+	gtp5g_err_report(b->reqs[first].cmd, b->reqs[first].id);
+	b->seq += b->num;
+	b->len = 0;
+	b->num = 0;
+	return -1;
+}
+EXPORT_SYMBOL(gtp5g_batch_send);
@@ -0,0 +1,151 @@
+/* Error reporting of the library */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+
+/* The last error is kept per thread, like errno, so that error paths
+ * never take a lock nor touch stdio. */
+static __thread struct gtp5g_err gtp5g_last_err;
+
+/* The callback and its data are published together, a thread reporting
+ * while another sets them gets either pair. Replaced pairs stay chained to
+ * the new one, as a reporting thread may still be using them. */
+static const struct gtp5g_err_hook *gtp5g_err_global;
+
+/* Of the handle whose call the thread is in, if any */
+static __thread const struct gtp5g_err_hook *gtp5g_err_scope;
+
+int gtp5g_err_hook_set(const struct gtp5g_err_hook **hook, gtp5g_err_cb_t cb, void *data,
+		       const struct gtp5g_allocator *a)
+{
+	struct gtp5g_err_hook *n;
+
+	n = a ? gtp5g_malloc(a, sizeof(*n)) : malloc(sizeof(*n));
+	if (!n) {
+		gtp5g_err_fail(ENOMEM, 0, 0, "error callback");
+		return -1;
+	}
+
+	n->cb = cb;
+	n->data = data;
+	n->prev = __atomic_load_n(hook, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(hook, &n->prev, n, 0,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	return 0;
+}
+
+void gtp5g_err_hook_free(const struct gtp5g_err_hook *hook, const struct gtp5g_allocator *a)
+{
+	const struct gtp5g_err_hook *prev;
+
+	for (; hook; hook = prev) {
+		prev = hook->prev;
+		gtp5g_free(a, (void *)hook);
+	}
+}
+
+const struct gtp5g_err_hook *gtp5g_err_enter(const struct gtp5g_err_hook *const *hook)
+{
+	const struct gtp5g_err_hook *saved = gtp5g_err_scope;
+
+	gtp5g_err_scope = __atomic_load_n(hook, __ATOMIC_ACQUIRE);
+	return saved;
+}
+
+void gtp5g_err_leave(const struct gtp5g_err_hook *saved)
+{
+	gtp5g_err_scope = saved;
+}
+
+int gtp5g_set_err_cb(gtp5g_err_cb_t cb, void *data)
+{
+	return gtp5g_err_hook_set(&gtp5g_err_global, cb, data, NULL);
+}
+EXPORT_SYMBOL(gtp5g_set_err_cb);
+
+const struct gtp5g_err *gtp5g_get_err(void)
+{
+	return &gtp5g_last_err;
+}
+EXPORT_SYMBOL(gtp5g_get_err);
+
+void gtp5g_clear_err(void)
+{
+	memset(&gtp5g_last_err, 0, sizeof(gtp5g_last_err));
+}
+EXPORT_SYMBOL(gtp5g_clear_err);
+
+void gtp5g_err_reset(void)
+{
+	gtp5g_last_err.err = 0;
+}
+
+/* Record the cause of a failure, the request it belongs to is filled in
+ * later by gtp5g_err_report(). */
+void gtp5g_err_set(int err, uint32_t attr_offset, const char *msg)
+{
+	struct gtp5g_err *e = &gtp5g_last_err;
+
+	e->err = err ? err : EIO;
+	e->cmd = 0;
+	e->id = 0;
+	e->attr_offset = attr_offset;
+	if (msg) {
+		strncpy(e->msg, msg, sizeof(e->msg) - 1);
+		e->msg[sizeof(e->msg) - 1] = '\0';
+	}
+	else
+		e->msg[0] = '\0';
+}
+
+void gtp5g_err_report(uint8_t cmd, uint32_t id)
+{
+	struct gtp5g_err *e = &gtp5g_last_err;
+	const struct gtp5g_err_hook *hook;
+
+	e->cmd = cmd;
+	e->id = id;
+	errno = e->err;
+
+	hook = gtp5g_err_scope;
+	if (!hook || !hook->cb)
+		hook = __atomic_load_n(&gtp5g_err_global, __ATOMIC_ACQUIRE);
+	if (hook && hook->cb)
+		hook->cb(e, hook->data);
+}
+
+/* Take over a record filled in by another thread, without reporting it again */
+void gtp5g_err_copy(const struct gtp5g_err *err)
+{
+	gtp5g_last_err = *err;
+	errno = err->err;
+}
+
+void gtp5g_err_fail(int err, uint8_t cmd, uint32_t id, const char *msg)
+{
+	gtp5g_err_set(err, 0, msg);
+	gtp5g_err_report(cmd, id);
+}
@@ -0,0 +1,621 @@
+/* Output of the PDR/FAR/QER tables to sinks, in text, JSON or CSV form */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/genetlink.h>
+
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+#include "tools.h"
+
+/*
+ * JSON output is one object per rule and line, absent fields are left out.
+ * CSV output starts with a header line, absent fields are empty. Both write
+ * the SDF flow description in the syntax gtp5g_pdr_set_sdf_filter_description()
+ * takes, and lists such as the related PDRs as JSON arrays or ';' separated.
+ * The SDF filters of a PDR are a JSON array of objects; in CSV, each SDF
+ * column has the values of all filters ';' separated, in the order set.
+ */
+
+static const char *gtp5g_csv_header[] = {
+	[GTP5G_CMD_GET_PDR] = "id,precedence,outer_header_removal,far_id,qer_id,"
+			      "ue_ipv4,teid,gtpu_ipv4,flow_description,tos_traffic_class,"
+			      "security_param_idx,flow_label,sdf_filter_id,role_ipv4,"
+			      "unix_sock_path\n",
+	[GTP5G_CMD_GET_FAR] = "id,apply_action,ohc_description,ohc_teid,ohc_peer_ipv4,"
+			      "ohc_port,forwarding_policy,related_pdrs\n",
+	[GTP5G_CMD_GET_QER] = "id,gate_status,mbr_ul_high,mbr_ul_low,mbr_dl_high,"
+			      "mbr_dl_low,gbr_ul_high,gbr_ul_low,gbr_dl_high,gbr_dl_low,"
+			      "qer_corr_id,rqi,qfi,ppi,rcsr,related_pdrs\n",
+};
+
+void gtp5g_format_header(struct gtp5g_out *o, uint8_t cmd, enum gtp5g_format format)
+{
+	if (format == GTP5G_FORMAT_CSV)
+		gtp5g_out_str(o, gtp5g_csv_header[cmd]);
+}
+
+/* A field of the rule being written: the name is only used for JSON, where
+ * the field is left out when absent. CSV writes the separator regardless. */
+struct gtp5g_row {
+	struct gtp5g_out	*o;
+	enum gtp5g_format	format;
+	int			fields;		/* written so far at this level */
+};
+
+static int gtp5g_row_field(struct gtp5g_row *r, const char *name, int present)
+{
+	if (r->format == GTP5G_FORMAT_CSV) {
+		if (r->fields++)
+			gtp5g_out_char(r->o, ',');
+		return present;
+	}
+
+	if (!present)
+		return 0;
+	if (r->fields++)
+		gtp5g_out_char(r->o, ',');
+	gtp5g_out_char(r->o, '"');
+	gtp5g_out_str(r->o, name);
+	gtp5g_out_str(r->o, "\":");
+	return 1;
+}
+
+static void gtp5g_out_num(struct gtp5g_out *o, const void *v, int size)
+{
+	switch (size) {
+	case sizeof(uint8_t):
+		gtp5g_out_u32(o, *(const uint8_t *)v);
+		break;
+	case sizeof(uint16_t):
+		gtp5g_out_u32(o, *(const uint16_t *)v);
+		break;
+	default:
+		gtp5g_out_u32(o, *(const uint32_t *)v);
+	}
+}
+
+static void gtp5g_row_u32(struct gtp5g_row *r, const char *name, const void *v, int size)
+{
+	if (gtp5g_row_field(r, name, v != NULL))
+		gtp5g_out_num(r->o, v, size);
+}
+
+#define gtp5g_row_num(r, name, v)	gtp5g_row_u32(r, name, v, sizeof(*(v)))
+
+static void gtp5g_row_ipv4(struct gtp5g_row *r, const char *name, const struct in_addr *addr)
+{
+	if (!gtp5g_row_field(r, name, addr != NULL))
+		return;
+
+	if (r->format == GTP5G_FORMAT_JSON)
+		gtp5g_out_char(r->o, '"');
+	gtp5g_out_ipv4(r->o, addr);
+	if (r->format == GTP5G_FORMAT_JSON)
+		gtp5g_out_char(r->o, '"');
+}
+
+static void gtp5g_row_str(struct gtp5g_row *r, const char *name, const char *s)
+{
+	if (!gtp5g_row_field(r, name, s != NULL))
+		return;
+
+	if (r->format == GTP5G_FORMAT_JSON)
+		gtp5g_out_json_str(r->o, s);
+	else
+		gtp5g_out_csv_str(r->o, s);
+}
+
+/* JSON nests the fields of a group, CSV flattens them into the row */
+static void gtp5g_row_open(struct gtp5g_row *r, const char *name, int present,
+			   struct gtp5g_row *sub)
+{
+	*sub = *r;
+	if (r->format == GTP5G_FORMAT_CSV || !gtp5g_row_field(r, name, present))
+		return;
+
+	gtp5g_out_char(r->o, '{');
+	sub->fields = 0;
+}
+
+static void gtp5g_row_close(struct gtp5g_row *r, struct gtp5g_row *sub)
+{
+	if (r->format == GTP5G_FORMAT_CSV)
+		r->fields = sub->fields;
+	else
+		gtp5g_out_char(r->o, '}');
+}
+
+static void gtp5g_row_id_list(struct gtp5g_row *r, const char *name,
+			      const uint16_t *list, int num)
+{
+	if (!gtp5g_row_field(r, name, list && num > 0))
+		return;
+
+	if (r->format == GTP5G_FORMAT_JSON) {
+		gtp5g_out_char(r->o, '[');
+		gtp5g_out_ids(r->o, list, num, ",");
+		gtp5g_out_char(r->o, ']');
+	} else {
+		gtp5g_out_ids(r->o, list, num, ";");
+	}
+}
+
+static void gtp5g_out_rule_addr(struct gtp5g_out *o, const struct in_addr *addr,
+				const struct in_addr *mask)
+{
+	int len;
+
+	if (!addr->s_addr) {
+		gtp5g_out_str(o, "any");
+	} else {
+		gtp5g_out_ipv4(o, addr);
+		len = netmask_to_decimal(mask->s_addr);
+		if (len < 32) {
+			gtp5g_out_char(o, '/');
+			gtp5g_out_u32(o, len);
+		}
+	}
+}
+
+static void gtp5g_out_rule_ports(struct gtp5g_out *o, const uint32_t *list, int num)
+{
+	if (list && num > 0) {
+		gtp5g_out_char(o, ' ');
+		gtp5g_out_ports(o, list, num);
+	}
+}
+
+void gtp5g_out_flow_desc(struct gtp5g_out *o, const struct ip_filter_rule *rule)
+{
+	gtp5g_out_str(o, rule->action == GTP5G_SDF_FILTER_PERMIT ? "permit" : "unknown_action");
+	gtp5g_out_str(o, rule->direction == GTP5G_SDF_FILTER_IN ? " in" :
+			 rule->direction == GTP5G_SDF_FILTER_OUT ? " out" : " unknown_direction");
+	if (rule->proto == 0xff) {
+		gtp5g_out_str(o, " ip");
+	} else {
+		gtp5g_out_char(o, ' ');
+		gtp5g_out_u32(o, rule->proto);
+	}
+
+	gtp5g_out_str(o, " from ");
+	gtp5g_out_rule_addr(o, &rule->src, &rule->smask);
+	gtp5g_out_rule_ports(o, rule->sport_list, rule->sport_num);
+	gtp5g_out_str(o, " to ");
+	gtp5g_out_rule_addr(o, &rule->dest, &rule->dmask);
+	gtp5g_out_rule_ports(o, rule->dport_list, rule->dport_num);
+}
+
+/* The rule has no quote nor backslash, so it is written in quotes as is */
+static void gtp5g_row_flow_desc(struct gtp5g_row *r, const char *name,
+				const struct ip_filter_rule *rule)
+{
+	if (!gtp5g_row_field(r, name, rule != NULL) || !rule)
+		return;
+
+	gtp5g_out_char(r->o, '"');
+	gtp5g_out_flow_desc(r->o, rule);
+	gtp5g_out_char(r->o, '"');
+}
+
+/* Numbers of struct sdf_filter, in CSV column order */
+static const struct {
+	const char	*name;
+	size_t		off;
+	int		size;
+} gtp5g_sdf_nums[] = {
+	{ "tos_traffic_class", offsetof(struct sdf_filter, tos_traffic_class), sizeof(uint16_t) },
+	{ "security_param_idx", offsetof(struct sdf_filter, security_param_idx), sizeof(uint32_t) },
+	{ "flow_label", offsetof(struct sdf_filter, flow_label), sizeof(uint32_t) },
+	{ "sdf_filter_id", offsetof(struct sdf_filter, bi_id), sizeof(uint32_t) },
+};
+
+#define GTP5G_SDF_NUMS	(sizeof(gtp5g_sdf_nums) / sizeof(gtp5g_sdf_nums[0]))
+
+static const void *gtp5g_sdf_num(const struct sdf_filter *sdf, int i)
+{
+	return *(const void * const *)((const char *)sdf + gtp5g_sdf_nums[i].off);
+}
+
+static void gtp5g_row_sdf_json(struct gtp5g_row *r, const struct sdf_filter *sdf)
+{
+	const struct sdf_filter *f;
+	struct gtp5g_row r_sdf = *r;
+	int i;
+
+	if (!gtp5g_row_field(r, "sdf", sdf != NULL))
+		return;
+
+	gtp5g_out_char(r->o, '[');
+	for (f = sdf; f; f = f->next) {
+		if (f != sdf)
+			gtp5g_out_char(r->o, ',');
+		gtp5g_out_char(r->o, '{');
+		r_sdf.fields = 0;
+		gtp5g_row_flow_desc(&r_sdf, "flow_description", f->rule);
+		for (i = 0; i < GTP5G_SDF_NUMS; i++)
+			gtp5g_row_u32(&r_sdf, gtp5g_sdf_nums[i].name, gtp5g_sdf_num(f, i),
+				      gtp5g_sdf_nums[i].size);
+		gtp5g_out_char(r->o, '}');
+	}
+	gtp5g_out_char(r->o, ']');
+}
+
+/* Filters without a value leave it empty between the ';' */
+static void gtp5g_row_sdf_csv(struct gtp5g_row *r, const struct sdf_filter *sdf)
+{
+	const struct sdf_filter *f;
+	const void *v;
+	int i;
+
+	gtp5g_row_field(r, "flow_description", 1);
+	if (sdf)
+		gtp5g_out_char(r->o, '"');
+	for (f = sdf; f; f = f->next) {
+		if (f != sdf)
+			gtp5g_out_char(r->o, ';');
+		if (f->rule)
+			gtp5g_out_flow_desc(r->o, f->rule);
+	}
+	if (sdf)
+		gtp5g_out_char(r->o, '"');
+
+	for (i = 0; i < GTP5G_SDF_NUMS; i++) {
+		gtp5g_row_field(r, gtp5g_sdf_nums[i].name, 1);
+		for (f = sdf; f; f = f->next) {
+			if (f != sdf)
+				gtp5g_out_char(r->o, ';');
+			v = gtp5g_sdf_num(f, i);
+			if (v)
+				gtp5g_out_num(r->o, v, gtp5g_sdf_nums[i].size);
+		}
+	}
+}
+
+static void gtp5g_row_begin(struct gtp5g_row *r, struct gtp5g_out *o, enum gtp5g_format format)
+{
+	r->o = o;
+	r->format = format;
+	r->fields = 0;
+	if (format == GTP5G_FORMAT_JSON)
+		gtp5g_out_char(o, '{');
+}
+
+static void gtp5g_row_end(struct gtp5g_row *r)
+{
+	if (r->format == GTP5G_FORMAT_JSON)
+		gtp5g_out_char(r->o, '}');
+	gtp5g_out_char(r->o, '\n');
+}
+
+void gtp5g_format_pdr(struct gtp5g_out *o, struct gtp5g_pdr *pdr, enum gtp5g_format format)
+{
+	struct gtp5g_pdi *pdi = pdr->pdi;
+	struct local_f_teid *f_teid = pdi ? pdi->f_teid : NULL;
+	struct sdf_filter *sdf = pdi ? pdi->sdf : NULL;
+	struct gtp5g_row r, r_pdi, r_teid;
+
+	gtp5g_row_begin(&r, o, format);
+	gtp5g_row_num(&r, "id", &pdr->id);
+	gtp5g_row_num(&r, "precedence", pdr->precedence);
+	gtp5g_row_num(&r, "outer_header_removal", pdr->outer_hdr_removal);
+	gtp5g_row_num(&r, "far_id", pdr->far_id);
+	gtp5g_row_num(&r, "qer_id", pdr->qer_id);
+
+	gtp5g_row_open(&r, "pdi", pdi != NULL, &r_pdi);
+	gtp5g_row_ipv4(&r_pdi, "ue_ipv4", pdi ? pdi->ue_addr_ipv4 : NULL);
+
+	gtp5g_row_open(&r_pdi, "f_teid", f_teid != NULL, &r_teid);
+	gtp5g_row_num(&r_teid, "teid", f_teid ? &f_teid->teid : NULL);
+	gtp5g_row_ipv4(&r_teid, "gtpu_ipv4", f_teid ? &f_teid->gtpu_addr_ipv4 : NULL);
+	if (f_teid || format == GTP5G_FORMAT_CSV)
+		gtp5g_row_close(&r_pdi, &r_teid);
+
+	if (format == GTP5G_FORMAT_CSV)
+		gtp5g_row_sdf_csv(&r_pdi, sdf);
+	else
+		gtp5g_row_sdf_json(&r_pdi, sdf);
+
+	if (pdi || format == GTP5G_FORMAT_CSV)
+		gtp5g_row_close(&r, &r_pdi);
+
+	gtp5g_row_ipv4(&r, "role_ipv4", pdr->role_addr_ipv4);
+	gtp5g_row_str(&r, "unix_sock_path", pdr->unix_sock_path);
+	gtp5g_row_end(&r);
+}
+
+void gtp5g_format_far(struct gtp5g_out *o, struct gtp5g_far *far, enum gtp5g_format format)
+{
+	struct gtp5g_forwarding_parameter *fwd = far->fwd_param;
+	struct gtp5g_outer_header_creation *ohc = fwd ? fwd->hdr_creation : NULL;
+	struct gtp5g_row r, r_ohc;
+
+	gtp5g_row_begin(&r, o, format);
+	gtp5g_row_num(&r, "id", &far->id);
+	gtp5g_row_num(&r, "apply_action", &far->apply_action);
+
+	gtp5g_row_open(&r, "outer_header_creation", ohc != NULL, &r_ohc);
+	gtp5g_row_num(&r_ohc, "description", ohc ? &ohc->desp : NULL);
+	gtp5g_row_num(&r_ohc, "teid", ohc ? &ohc->teid : NULL);
+	gtp5g_row_ipv4(&r_ohc, "peer_ipv4", ohc ? &ohc->peer_addr_ipv4 : NULL);
+	gtp5g_row_num(&r_ohc, "port", ohc ? &ohc->port : NULL);
+	if (ohc || format == GTP5G_FORMAT_CSV)
+		gtp5g_row_close(&r, &r_ohc);
+
+	gtp5g_row_str(&r, "forwarding_policy",
+		      fwd && fwd->fwd_policy ? fwd->fwd_policy->identifier : NULL);
+	gtp5g_row_id_list(&r, "related_pdrs", far->related_pdr_list, far->related_pdr_num);
+	gtp5g_row_end(&r);
+}
+
+void gtp5g_format_qer(struct gtp5g_out *o, struct gtp5g_qer *qer, enum gtp5g_format format)
+{
+	struct gtp5g_row r, r_br;
+
+	gtp5g_row_begin(&r, o, format);
+	gtp5g_row_num(&r, "id", &qer->id);
+	gtp5g_row_num(&r, "gate_status", &qer->ul_dl_gate);
+
+	gtp5g_row_open(&r, "mbr", 1, &r_br);
+	gtp5g_row_num(&r_br, "ul_high", &qer->mbr.ul_high);
+	gtp5g_row_num(&r_br, "ul_low", &qer->mbr.ul_low);
+	gtp5g_row_num(&r_br, "dl_high", &qer->mbr.dl_high);
+	gtp5g_row_num(&r_br, "dl_low", &qer->mbr.dl_low);
+	gtp5g_row_close(&r, &r_br);
+
+	gtp5g_row_open(&r, "gbr", 1, &r_br);
+	gtp5g_row_num(&r_br, "ul_high", &qer->gbr.ul_high);
+	gtp5g_row_num(&r_br, "ul_low", &qer->gbr.ul_low);
+	gtp5g_row_num(&r_br, "dl_high", &qer->gbr.dl_high);
+	gtp5g_row_num(&r_br, "dl_low", &qer->gbr.dl_low);
+	gtp5g_row_close(&r, &r_br);
+
+	gtp5g_row_num(&r, "qer_corr_id", &qer->qer_corr_id);
+	gtp5g_row_num(&r, "rqi", &qer->rqi);
+	gtp5g_row_num(&r, "qfi", &qer->qfi);
+	gtp5g_row_num(&r, "ppi", &qer->ppi);
+	gtp5g_row_num(&r, "rcsr", &qer->rcsr);
+	gtp5g_row_id_list(&r, "related_pdrs", qer->related_pdr_list, qer->related_pdr_num);
+	gtp5g_row_end(&r);
+}
+
+/* One object of each type is decoded into for the whole dump */
+struct gtp5g_format_list {
+	struct gtp5g_out	*o;
+	enum gtp5g_format	format;
+	uint8_t			cmd;
+	struct gtp5g_pdr	*pdr;
+	struct gtp5g_far	*far;
+	struct gtp5g_qer	*qer;
+};
+
+static int gtp5g_format_list_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct gtp5g_format_list *l = data;
+
+	switch (l->cmd) {
+	case GTP5G_CMD_GET_PDR:
+		if (genl_gtp5g_pdr_attr_into_cb(nlh, l->pdr) != MNL_CB_OK)
+			return MNL_CB_ERROR;
+		gtp5g_format_pdr(l->o, l->pdr, l->format);
+		break;
+	case GTP5G_CMD_GET_FAR:
+		if (genl_gtp5g_far_attr_into_cb(nlh, l->far) != MNL_CB_OK)
+			return MNL_CB_ERROR;
+		gtp5g_format_far(l->o, l->far, l->format);
+		break;
+	case GTP5G_CMD_GET_QER:
+		if (genl_gtp5g_qer_attr_into_cb(nlh, l->qer) != MNL_CB_OK)
+			return MNL_CB_ERROR;
+		gtp5g_format_qer(l->o, l->qer, l->format);
+		break;
+	}
+
+	return l->o->err ? MNL_CB_ERROR : MNL_CB_OK;
+}
+
+/* The text form is written by the callback of each rule type as the dump
+ * is parsed, JSON and CSV go through the rule objects */
+static int gtp5g_list_format(int genl_id, struct mnl_socket *nl, uint8_t cmd,
+			     const struct gtp5g_sink *sink, enum gtp5g_format format,
+			     int (*text_cb)(const struct nlmsghdr *nlh, void *data))
+{
+	struct gtp5g_format_list l = {
+		.format	= format,
+		.cmd	= cmd,
+	};
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct gtp5g_out *o;
+	struct nlmsghdr *nlh;
+	uint32_t seq = time(NULL);
+	int ret;
+
+	if (!sink) {
+		gtp5g_err_fail(EINVAL, cmd, 0, "sink is NULL");
+		return -1;
+	}
+
+	o = gtp5g_out_new(sink);
+	if (!o)
+		return -1;
+	l.o = o;
+
+	gtp5g_format_header(o, cmd, format);
+	nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_DUMP, ++seq, cmd);
+	if (format == GTP5G_FORMAT_TEXT) {
+		ret = gtp5g_socket_talk(nl, nlh, seq, text_cb, o, 0);
+	} else {
+		l.pdr = gtp5g_pdr_alloc();
+		l.far = gtp5g_far_alloc();
+		l.qer = gtp5g_qer_alloc();
+		if (l.pdr && l.far && l.qer) {
+			ret = gtp5g_socket_talk(nl, nlh, seq, gtp5g_format_list_cb, &l, 0);
+		} else {
+			gtp5g_err_fail(ENOMEM, cmd, 0, "list");
+			ret = -1;
+		}
+		if (l.pdr)
+			gtp5g_pdr_free(l.pdr);
+		if (l.far)
+			gtp5g_far_free(l.far);
+		gtp5g_qer_free(l.qer);
+	}
+
+	if (gtp5g_out_free(o) < 0)
+		ret = -1;
+	return ret < 0 ? -1 : 0;
+}
+
+int gtp5g_list_pdr_to(int genl_id, struct mnl_socket *nl,
+		      const struct gtp5g_sink *sink, enum gtp5g_format format)
+{
+	return gtp5g_list_format(genl_id, nl, GTP5G_CMD_GET_PDR, sink, format,
+				 genl_gtp5g_pdr_attr_list_cb);
+}
+EXPORT_SYMBOL(gtp5g_list_pdr_to);
+
+int gtp5g_list_far_to(int genl_id, struct mnl_socket *nl,
+		      const struct gtp5g_sink *sink, enum gtp5g_format format)
+{
+	return gtp5g_list_format(genl_id, nl, GTP5G_CMD_GET_FAR, sink, format,
+				 genl_gtp5g_far_attr_list_cb);
+}
+EXPORT_SYMBOL(gtp5g_list_far_to);
+
+int gtp5g_list_qer_to(int genl_id, struct mnl_socket *nl,
+		      const struct gtp5g_sink *sink, enum gtp5g_format format)
+{
+	return gtp5g_list_format(genl_id, nl, GTP5G_CMD_GET_QER, sink, format,
+				 genl_gtp5g_qer_attr_list_cb);
+}
+EXPORT_SYMBOL(gtp5g_list_qer_to);
+
+int gtp5g_list_pdr_format(int genl_id, struct mnl_socket *nl, enum gtp5g_format format)
+{
+	return gtp5g_list_pdr_to(genl_id, nl, &gtp5g_sink_stdout, format);
+}
+EXPORT_SYMBOL(gtp5g_list_pdr_format);
+
+int gtp5g_list_far_format(int genl_id, struct mnl_socket *nl, enum gtp5g_format format)
+{
+	return gtp5g_list_far_to(genl_id, nl, &gtp5g_sink_stdout, format);
+}
+EXPORT_SYMBOL(gtp5g_list_far_format);
+
+int gtp5g_list_qer_format(int genl_id, struct mnl_socket *nl, enum gtp5g_format format)
+{
+	return gtp5g_list_qer_to(genl_id, nl, &gtp5g_sink_stdout, format);
+}
+EXPORT_SYMBOL(gtp5g_list_qer_format);
+
+/* A single rule, CSV comes with its header line */
+static void gtp5g_print_format(uint8_t cmd, void *rule, const struct gtp5g_sink *sink,
+			       enum gtp5g_format format)
+{
+	struct gtp5g_out *o;
+
+	if (!sink) {
+		gtp5g_err_fail(EINVAL, cmd, 0, "sink is NULL");
+		return;
+	}
+
+	o = gtp5g_out_new(sink);
+	if (!o)
+		return;
+
+	gtp5g_format_header(o, cmd, format);
+	if (format == GTP5G_FORMAT_TEXT) {
+		if (cmd == GTP5G_CMD_GET_PDR)
+			gtp5g_text_pdr(o, rule);
+		else if (cmd == GTP5G_CMD_GET_FAR)
+			gtp5g_text_far(o, rule);
+		else
+			gtp5g_text_qer(o, rule);
+	} else {
+		if (cmd == GTP5G_CMD_GET_PDR)
+			gtp5g_format_pdr(o, rule, format);
+		else if (cmd == GTP5G_CMD_GET_FAR)
+			gtp5g_format_far(o, rule, format);
+		else
+			gtp5g_format_qer(o, rule, format);
+	}
+
+	gtp5g_out_free(o);
+}
+
+void gtp5g_print_pdr_to(struct gtp5g_pdr *pdr, const struct gtp5g_sink *sink,
+			enum gtp5g_format format)
+{
+	if (!pdr) {
+		gtp5g_err_fail(EINVAL, 0, 0, "PDR is NULL");
+		return;
+	}
+	gtp5g_print_format(GTP5G_CMD_GET_PDR, pdr, sink, format);
+}
+EXPORT_SYMBOL(gtp5g_print_pdr_to);
+
+void gtp5g_print_far_to(struct gtp5g_far *far, const struct gtp5g_sink *sink,
+			enum gtp5g_format format)
+{
+	if (!far) {
+		gtp5g_err_fail(EINVAL, 0, 0, "FAR is NULL");
+		return;
+	}
+	gtp5g_print_format(GTP5G_CMD_GET_FAR, far, sink, format);
+}
+EXPORT_SYMBOL(gtp5g_print_far_to);
+
+void gtp5g_print_qer_to(struct gtp5g_qer *qer, const struct gtp5g_sink *sink,
+			enum gtp5g_format format)
+{
+	if (!qer) {
+		gtp5g_err_fail(EINVAL, 0, 0, "QER is NULL");
+		return;
+	}
+	gtp5g_print_format(GTP5G_CMD_GET_QER, qer, sink, format);
+}
+EXPORT_SYMBOL(gtp5g_print_qer_to);
+
+void gtp5g_print_pdr_format(struct gtp5g_pdr *pdr, enum gtp5g_format format)
+{
+	gtp5g_print_pdr_to(pdr, &gtp5g_sink_stdout, format);
+}
+EXPORT_SYMBOL(gtp5g_print_pdr_format);
+
+void gtp5g_print_far_format(struct gtp5g_far *far, enum gtp5g_format format)
+{
+	gtp5g_print_far_to(far, &gtp5g_sink_stdout, format);
+}
+EXPORT_SYMBOL(gtp5g_print_far_format);
+
+void gtp5g_print_qer_format(struct gtp5g_qer *qer, enum gtp5g_format format)
+{
+	gtp5g_print_qer_to(qer, &gtp5g_sink_stdout, format);
+}
+EXPORT_SYMBOL(gtp5g_print_qer_format);
@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
@@ -44,18 +45,43 @@
 #include "internal.h"
 #include "tools.h"
 
-static void gtp5g_build_far_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev, struct gtp5g_far *far)
+GTP5G_GEN_PUT(gtp5g_put_outer_header_creation, struct gtp5g_outer_header_creation,
+              GTP5G_OUTER_HEADER_CREATION_SCHEMA)
+GTP5G_GEN_SIZE(gtp5g_size_outer_header_creation, struct gtp5g_outer_header_creation,
+               GTP5G_OUTER_HEADER_CREATION_SCHEMA)
+
+/* What gtp5g_put_far_payload() puts, to the byte */
+static size_t gtp5g_far_payload_size(const struct gtp5g_dev *dev, const struct gtp5g_far *far)
+{
+    const struct gtp5g_forwarding_parameter *fwd_param = far->fwd_param;
+    size_t size, nest = 0;
+
+    size = GTP5G_DEV_SIZE(dev) + GTP5G_ATTR_SIZE(GTP5G_FAR_ID_LEN);
+    if (far->apply_action)
+        size += GTP5G_ATTR_SIZE(GTP5G_FAR_APPLY_ACTION_LEN);
+    if (!fwd_param)
+        return size;
+
+    if (fwd_param->hdr_creation)
+        nest += GTP5G_ATTR_SIZE(gtp5g_size_outer_header_creation(fwd_param->hdr_creation));
+    if (fwd_param->fwd_policy)
+        nest += GTP5G_ATTR_SIZE(fwd_param->fwd_policy->len);
+
+    return size + GTP5G_ATTR_SIZE(nest);
+}
+
+static void gtp5g_put_far_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev, struct gtp5g_far *far)
 {
     // Let kernel get dev easily
     if (dev->ifns >= 0)
-        mnl_attr_put_u32(nlh, GTP5G_NET_NS_FD, dev->ifns);
-    mnl_attr_put_u32(nlh, GTP5G_LINK, dev->ifidx);
+        GTP5G_PUT(nlh, GTP5G_NET_NS_FD, dev->ifns);
+    GTP5G_PUT(nlh, GTP5G_LINK, dev->ifidx);
 
     // Level 1 FAR
-    mnl_attr_put_u32(nlh, GTP5G_FAR_ID, far->id);
+    GTP5G_PUT(nlh, GTP5G_FAR_ID, far->id);
     
     if (far->apply_action)
-        mnl_attr_put_u8(nlh, GTP5G_FAR_APPLY_ACTION, far->apply_action);
+        GTP5G_PUT(nlh, GTP5G_FAR_APPLY_ACTION, far->apply_action);
 
     // Level 2 FAR : Forwarding Parameter
     struct nlattr *fwd_param_nest, *hdr_creation_nest;
@@ -66,14 +92,7 @@ static void gtp5g_build_far_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev,
         if (far->fwd_param->hdr_creation) {
             hdr_creation_nest = mnl_attr_nest_start(nlh, GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION);
 
-            mnl_attr_put_u16(nlh, GTP5G_OUTER_HEADER_CREATION_DESCRIPTION,
-                             far->fwd_param->hdr_creation->desp);
-            mnl_attr_put_u32(nlh, GTP5G_OUTER_HEADER_CREATION_O_TEID,
-                             far->fwd_param->hdr_creation->teid);
-            mnl_attr_put_u32(nlh, GTP5G_OUTER_HEADER_CREATION_PEER_ADDR_IPV4,
-                             far->fwd_param->hdr_creation->peer_addr_ipv4.s_addr);
-            mnl_attr_put_u16(nlh, GTP5G_OUTER_HEADER_CREATION_PORT,
-                             far->fwd_param->hdr_creation->port);
+            gtp5g_put_outer_header_creation(nlh, far->fwd_param->hdr_creation);
             mnl_attr_nest_end(nlh, hdr_creation_nest);
         }
 
@@ -85,6 +104,22 @@ static void gtp5g_build_far_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev,
     }
 }
 
+int gtp5g_build_far_payload(struct nlmsghdr *nlh, size_t size, struct gtp5g_dev *dev,
+                            struct gtp5g_far *far)
+{
+    if (gtp5g_msg_fits(nlh, size, gtp5g_far_payload_size(dev, far), far->id) < 0)
+        return -1;
+
+    gtp5g_put_far_payload(nlh, dev, far);
+    return 0;
+}
+
+size_t gtp5g_far_msg_size(struct gtp5g_dev *dev, struct gtp5g_far *far)
+{
+    return GTP5G_MSG_HDR_SIZE + gtp5g_far_payload_size(dev, far);
+}
+EXPORT_SYMBOL(gtp5g_far_msg_size);
+
 int gtp5g_add_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far)
 {
     struct nlmsghdr *nlh;
@@ -92,18 +127,17 @@ int gtp5g_add_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_ADD_FAR, far->id, "5G GTP device is NULL");
         return -1;
     }
 
     nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_EXCL | NLM_F_ACK, ++seq,
                                GTP5G_CMD_ADD_FAR);
-    gtp5g_build_far_payload(nlh, dev, far);
+    if (gtp5g_build_far_payload(nlh, sizeof(buf), dev, far) < 0)
+        return -1;
 
-    if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, NULL, NULL, far->id) < 0)
         return -1;
-    }
 
     return 0;
 }
@@ -116,18 +150,17 @@ int gtp5g_mod_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_ADD_FAR, far->id, "5G GTP device is NULL");
         return -1;
     }
 
     nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_REPLACE | NLM_F_ACK, ++seq,
                                GTP5G_CMD_ADD_FAR);
-    gtp5g_build_far_payload(nlh, dev, far);
+    if (gtp5g_build_far_payload(nlh, sizeof(buf), dev, far) < 0)
+        return -1;
 
-    if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, NULL, NULL, far->id) < 0)
         return -1;
-    }
 
     return 0;
 }
@@ -141,297 +174,287 @@ int gtp5g_del_far(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_DEL_FAR, far->id, "5G GTP device is NULL");
         return -1;
     }
 
     nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_ACK, ++seq,
                                GTP5G_CMD_DEL_FAR);
-    gtp5g_build_far_payload(nlh, dev, far);
+    if (gtp5g_build_far_payload(nlh, sizeof(buf), dev, far) < 0)
+        return -1;
 
-    if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, NULL, NULL, far->id) < 0)
         return -1;
-    }
 
     return 0;
 }
 EXPORT_SYMBOL(gtp5g_del_far);
 
-static int genl_gtp5g_far_validate_cb(const struct nlattr *attr, void *data)
+static int gtp5g_batch_far(struct gtp5g_batch *b, uint16_t flags, uint8_t cmd,
+                           struct gtp5g_dev *dev, struct gtp5g_far *far)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
-
-    if (mnl_attr_type_valid(attr, GTP5G_FAR_ATTR_MAX) < 0)
-        return MNL_CB_OK;
+    struct nlmsghdr *nlh;
 
-    switch(type) {
-        case GTP5G_FAR_ID:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_FAR_APPLY_ACTION:
-            if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_FAR_FORWARDING_PARAMETER:
-            if (mnl_attr_validate(attr, MNL_TYPE_NESTED) < 0)
-                goto VALIDATE_FAIL;
-            break;
-    default:
-        break;
+    if (!dev) {
+        gtp5g_err_fail(EINVAL, cmd, far->id, "5G GTP device is NULL");
+        return -1;
     }
 
-    tb[type] = attr;
-    return MNL_CB_OK;
+    /* Only the room the request takes, which it fills to the byte */
+    nlh = gtp5g_batch_put_size(b, flags, cmd, far->id, gtp5g_far_msg_size(dev, far));
+    if (!nlh)
+        return -1;
 
-VALIDATE_FAIL:
-    perror("FAR mnl_attr_validate");
-    return MNL_CB_ERROR;
+    gtp5g_put_far_payload(nlh, dev, far);
+    gtp5g_batch_commit(b, nlh);
+
+    return 0;
 }
 
-static int genl_gtp5g_forwarding_parameter_validate_cb(const struct nlattr *attr, void *data)
+int gtp5g_batch_add_far(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_far *far)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
-
-    if (mnl_attr_type_valid(attr, GTP5G_FORWARDING_PARAMETER_ATTR_MAX) < 0)
-        return MNL_CB_OK;
-
-    switch(type) {
-        case GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION:
-             if (mnl_attr_validate(attr, MNL_TYPE_NESTED) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY:
-            // Octet string
-            break;
-    default:
-        break;
-    }
-
-    tb[type] = attr;
-    return MNL_CB_OK;
-
-VALIDATE_FAIL:
-    perror("Forwarding Parameter mnl_attr_validate");
-    return MNL_CB_ERROR;
+    return gtp5g_batch_far(b, NLM_F_EXCL, GTP5G_CMD_ADD_FAR, dev, far);
 }
+EXPORT_SYMBOL(gtp5g_batch_add_far);
 
-static int genl_gtp5g_outer_header_creation_validate_cb(const struct nlattr *attr, void *data)
+int gtp5g_batch_mod_far(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_far *far)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
-
-    if (mnl_attr_type_valid(attr, GTP5G_OUTER_HEADER_CREATION_ATTR_MAX) < 0)
-        return MNL_CB_OK;
-
-    switch(type) {
-        case GTP5G_OUTER_HEADER_CREATION_DESCRIPTION:
-            if (mnl_attr_validate(attr, MNL_TYPE_U16) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_OUTER_HEADER_CREATION_O_TEID:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_OUTER_HEADER_CREATION_PEER_ADDR_IPV4:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_OUTER_HEADER_CREATION_PORT:
-            if (mnl_attr_validate(attr, MNL_TYPE_U16) < 0)
-                goto VALIDATE_FAIL;
-            break;
-    default:
-        break;
-    }
-
-    tb[type] = attr;
-    return MNL_CB_OK;
-
-VALIDATE_FAIL:
-    perror("Outer Header Creation mnl_attr_validate");
-    return MNL_CB_ERROR;
+    return gtp5g_batch_far(b, NLM_F_REPLACE, GTP5G_CMD_ADD_FAR, dev, far);
 }
+EXPORT_SYMBOL(gtp5g_batch_mod_far);
 
-static int genl_gtp5g_attr_list_cb(const struct nlmsghdr *nlh, void *data)
+int gtp5g_batch_del_far(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_far *far)
 {
-    struct nlattr *far_tb[GTP5G_FAR_ATTR_MAX + 1] = {};
-    struct nlattr *fwd_param_tb[GTP5G_FORWARDING_PARAMETER_ATTR_MAX + 1] = {};
-    struct nlattr *hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_ATTR_MAX + 1] = {};
-    char buf[MAX_LEN_OF_FORWARDING_POLICY_IDENTIFIER + 1];
-    struct genlmsghdr *genl;
+    return gtp5g_batch_far(b, 0, GTP5G_CMD_DEL_FAR, dev, far);
+}
+EXPORT_SYMBOL(gtp5g_batch_del_far);
 
-    const char *indent_str = "  ";
-    struct in_addr *ipv4 = (void *)buf;
+GTP5G_POLICY(gtp5g_far_policy, "FAR", GTP5G_FAR_ATTR_MAX,
+             GTP5G_DEVICE_SCHEMA(GTP5G_POLICY_ATTR) GTP5G_FAR_SCHEMA(GTP5G_POLICY_ATTR));
+GTP5G_POLICY(gtp5g_forwarding_parameter_policy, "Forwarding Parameter",
+             GTP5G_FORWARDING_PARAMETER_ATTR_MAX,
+             GTP5G_FORWARDING_PARAMETER_SCHEMA(GTP5G_POLICY_ATTR));
+GTP5G_POLICY(gtp5g_outer_header_creation_policy, "Outer Header Creation",
+             GTP5G_OUTER_HEADER_CREATION_ATTR_MAX,
+             GTP5G_OUTER_HEADER_CREATION_SCHEMA(GTP5G_POLICY_ATTR));
 
-    mnl_attr_parse(nlh, sizeof(*genl), genl_gtp5g_far_validate_cb, far_tb);
-    if (far_tb[GTP5G_FAR_ID])
-        printf("[FAR No.%u Info]\n", mnl_attr_get_u32(far_tb[GTP5G_FAR_ID]));
-    if (far_tb[GTP5G_FAR_APPLY_ACTION])
-        printf("%s- Apply Action: %u\n", indent_str, mnl_attr_get_u8(far_tb[GTP5G_FAR_APPLY_ACTION]));
+GTP5G_GEN_TEXT(gtp5g_text_far_attr, GTP5G_FAR_SCHEMA)
+GTP5G_GEN_TEXT(gtp5g_text_outer_header_creation_attr, GTP5G_OUTER_HEADER_CREATION_SCHEMA)
 
-    if (far_tb[GTP5G_FAR_FORWARDING_PARAMETER]) {
-        mnl_attr_parse_nested(far_tb[GTP5G_FAR_FORWARDING_PARAMETER], genl_gtp5g_forwarding_parameter_validate_cb, fwd_param_tb);
+static void gtp5g_text_far_nest_attr(struct gtp5g_out *o, uint16_t type, const struct nlattr *attr)
+{
+    const struct nlattr *fwd_param_tb[GTP5G_FORWARDING_PARAMETER_ATTR_MAX + 1] = {};
+    const struct nlattr *hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_ATTR_MAX + 1] = {};
+    const struct nlattr *policy;
 
-        printf("%s[Forwarding Parameter Info]\n", indent_str);
-        if (fwd_param_tb[GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION]) {
-            mnl_attr_parse_nested(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION],
-                                  genl_gtp5g_outer_header_creation_validate_cb, hdr_creation_tb);
-
-            printf("%s%s[Outer Header Creation Info]\n", indent_str, indent_str);
-            if (hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_DESCRIPTION])
-                printf("%s%s%s- Description: %u\n", indent_str, indent_str, indent_str,
-                       mnl_attr_get_u16(hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_DESCRIPTION]));
-
-            if (hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_O_TEID])
-                printf("%s%s%s- Out Teid: %u\n", indent_str, indent_str, indent_str,
-                       mnl_attr_get_u32(hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_O_TEID]));
-
-            if (hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_PEER_ADDR_IPV4]) {
-                ipv4->s_addr = mnl_attr_get_u32(hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_PEER_ADDR_IPV4]);
-                inet_ntop(AF_INET, ipv4, buf, sizeof(buf));
-                printf("%s%s%s- Next GTP-U IPv4: %s\n", indent_str, indent_str, indent_str, buf);
+    switch (type) {
+        case GTP5G_FAR_FORWARDING_PARAMETER:
+            if (gtp5g_attr_parse_nested(attr, &gtp5g_forwarding_parameter_policy, fwd_param_tb) < 0) {
+                o->err = ERANGE;
+                break;
             }
 
-            if (hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_PORT])
-                printf("%s%s%s- Port: %u\n", indent_str, indent_str, indent_str,
-                       mnl_attr_get_u16(hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_PORT]));
-        }
+            gtp5g_out_str(o, "  [Forwarding Parameter Info]\n");
+            if (fwd_param_tb[GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION]) {
+                if (gtp5g_attr_parse_nested(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION],
+                                            &gtp5g_outer_header_creation_policy, hdr_creation_tb) < 0) {
+                    o->err = ERANGE;
+                    break;
+                }
 
-        if (fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY]) {
-            strncpy(buf, mnl_attr_get_payload(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY]), mnl_attr_get_payload_len(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY]));
-            printf("%s%s- Forwarding Policy: %s\n", indent_str, indent_str, buf);
-        }
-    }
+                gtp5g_out_str(o, "    [Outer Header Creation Info]\n");
+                gtp5g_text_outer_header_creation_attr(o, hdr_creation_tb, NULL);
+            }
 
-    if (far_tb[GTP5G_FAR_RELATED_TO_PDR]) {
-        printf("%s- Related PDR ID: ", indent_str);
-        u16_id_list_from_kernel_space_print(mnl_attr_get_payload(far_tb[GTP5G_FAR_RELATED_TO_PDR]),
-            mnl_attr_get_payload_len(far_tb[GTP5G_FAR_RELATED_TO_PDR]) / (sizeof(uint16_t) / sizeof(char)));
-        printf(" (Not a real IE)\n");
+            if (fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY]) {
+                /* Not NUL terminated by the kernel */
+                policy = fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY];
+                gtp5g_out_str(o, "    - Forwarding Policy: ");
+                gtp5g_out_mem(o, mnl_attr_get_payload(policy),
+                              strnlen(mnl_attr_get_payload(policy), mnl_attr_get_payload_len(policy)));
+                gtp5g_out_char(o, '\n');
+            }
+            break;
+        case GTP5G_FAR_RELATED_TO_PDR:
+            gtp5g_out_str(o, "  - Related PDR ID: ");
+            gtp5g_out_ids(o, mnl_attr_get_payload(attr),
+                          mnl_attr_get_payload_len(attr) / sizeof(uint16_t), ", ");
+            gtp5g_out_str(o, " (Not a real IE)\n");
+            break;
     }
-
-    return MNL_CB_OK;
 }
 
-int gtp5g_list_far(int genl_id, struct mnl_socket *nl)
+int genl_gtp5g_far_attr_list_cb(const struct nlmsghdr *nlh, void *data)
 {
-    char buf[MNL_SOCKET_BUFFER_SIZE];
-    struct nlmsghdr *nlh;
-    uint32_t seq = time(NULL);
-
-    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_DUMP, 0,
-                               GTP5G_CMD_GET_FAR);
-
-    if (genl_socket_talk(nl, nlh, seq, genl_gtp5g_attr_list_cb, NULL) < 0) {
-        perror("genl_socket_talk");
-        return -1;
+    const struct nlattr *far_tb[GTP5G_FAR_ATTR_MAX + 1] = {};
+    struct gtp5g_out *o = data;
+
+    if (gtp5g_attr_parse(nlh, &gtp5g_far_policy, far_tb) < 0)
+        return MNL_CB_ERROR;
+    if (far_tb[GTP5G_FAR_ID]) {
+        gtp5g_out_str(o, "[FAR No.");
+        gtp5g_out_u32(o, mnl_attr_get_u32(far_tb[GTP5G_FAR_ID]));
+        gtp5g_out_str(o, " Info]\n");
     }
+    gtp5g_text_far_attr(o, far_tb, gtp5g_text_far_nest_attr);
 
-    return 0;
+    return o->err ? MNL_CB_ERROR : MNL_CB_OK;
 }
-EXPORT_SYMBOL(gtp5g_list_far);
 
-void gtp5g_print_far(struct gtp5g_far *far)
+int gtp5g_list_far(int genl_id, struct mnl_socket *nl)
 {
-    struct gtp5g_forwarding_parameter *fwd_param;
-    struct gtp5g_outer_header_creation *hdr_creation;
+    return gtp5g_list_far_to(genl_id, nl, &gtp5g_sink_stdout, GTP5G_FORMAT_TEXT);
+}
+EXPORT_SYMBOL(gtp5g_list_far);
 
-    const char *indent_str = "  ";
-    char buf[MAX_LEN_OF_FORWARDING_POLICY_IDENTIFIER + 1];
+GTP5G_GEN_PRINT(gtp5g_text_far_fields, struct gtp5g_far, GTP5G_FAR_SCHEMA)
+GTP5G_GEN_PRINT(gtp5g_text_outer_header_creation_fields, struct gtp5g_outer_header_creation,
+                GTP5G_OUTER_HEADER_CREATION_SCHEMA)
 
-    if (!far) {
-        perror("FAR is NULL");
-        return;
-    }
+static void gtp5g_text_far_nest(struct gtp5g_out *o, uint16_t type, const struct gtp5g_far *far)
+{
+    struct gtp5g_forwarding_parameter *fwd_param = far->fwd_param;
 
-    printf("[FAR No.%u Info]\n", far->id);
-    printf("%s- Apply Action: %u\n", indent_str, far->apply_action);
-    if (far->fwd_param) {
-        fwd_param = far->fwd_param;
-        printf("%s[Forwarding Parameter Info]\n", indent_str);
+    if (type == GTP5G_FAR_FORWARDING_PARAMETER && fwd_param) {
+        gtp5g_out_str(o, "  [Forwarding Parameter Info]\n");
 
         if (fwd_param->hdr_creation) {
-            hdr_creation = fwd_param->hdr_creation;
-            printf("%s%s[Outer Header Creation Info]\n", indent_str, indent_str);
-
-            printf("%s%s%s- Description: %u\n", indent_str, indent_str, indent_str,
-                hdr_creation->desp);
-            
-            printf("%s%s%s- Out Teid: %u\n", indent_str, indent_str, indent_str,
-                hdr_creation->teid);
-
-            inet_ntop(AF_INET, &hdr_creation->peer_addr_ipv4, buf, sizeof(buf));
-            printf("%s%s%s- Next GTP-U IPv4: %s\n", indent_str, indent_str, indent_str, buf);
-
-            printf("%s%s%s- Port: %u\n", indent_str, indent_str, indent_str,
-                hdr_creation->port);
+            gtp5g_out_str(o, "    [Outer Header Creation Info]\n");
+            gtp5g_text_outer_header_creation_fields(o, fwd_param->hdr_creation, NULL);
         }
 
         if (fwd_param->fwd_policy) {
-            strncpy(buf, fwd_param->fwd_policy->identifier, fwd_param->fwd_policy->len);
-            printf("%s%s- Forwarding Policy: %s\n", indent_str, indent_str, buf);
+            gtp5g_out_str(o, "    - Forwarding Policy: ");
+            gtp5g_out_str(o, fwd_param->fwd_policy->identifier);
+            gtp5g_out_char(o, '\n');
         }
+    } else if (type == GTP5G_FAR_RELATED_TO_PDR && far->related_pdr_num && far->related_pdr_list) {
+        gtp5g_out_str(o, "  - Related PDR ID: ");
+        gtp5g_out_ids(o, far->related_pdr_list, far->related_pdr_num, ", ");
+        gtp5g_out_str(o, " (Not a real IE)\n");
     }
+}
 
-    if (far->related_pdr_num && far->related_pdr_list) {
-        printf("%s- Related PDR ID: ", indent_str);
-        u16_id_list_from_kernel_space_print(far->related_pdr_list, far->related_pdr_num);
-        printf(" (Not a real IE)\n");
-    }
+void gtp5g_text_far(struct gtp5g_out *o, struct gtp5g_far *far)
+{
+    gtp5g_out_str(o, "[FAR No.");
+    gtp5g_out_u32(o, far->id);
+    gtp5g_out_str(o, " Info]\n");
+    gtp5g_text_far_fields(o, far, gtp5g_text_far_nest);
+}
 
+void gtp5g_print_far(struct gtp5g_far *far)
+{
+    gtp5g_print_far_to(far, &gtp5g_sink_stdout, GTP5G_FORMAT_TEXT);
 }
 EXPORT_SYMBOL(gtp5g_print_far);
 
-static int genl_gtp5g_attr_cb(const struct nlmsghdr *nlh, void *data)
-{
-    struct nlattr *far_tb[GTP5G_FAR_ATTR_MAX + 1] = {};
-    struct nlattr *fwd_param_tb[GTP5G_FORWARDING_PARAMETER_ATTR_MAX + 1] = {};
-    struct nlattr *hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_ATTR_MAX + 1] = {};
+GTP5G_GEN_GET(gtp5g_get_far, struct gtp5g_far, GTP5G_FAR_SCHEMA)
+GTP5G_GEN_GET(gtp5g_get_outer_header_creation, struct gtp5g_outer_header_creation,
+              GTP5G_OUTER_HEADER_CREATION_SCHEMA)
 
-    struct genlmsghdr *genl;
-    struct gtp5g_far *far;
-    struct in_addr ipv4;
+int genl_gtp5g_far_attr_into_cb(const struct nlmsghdr *nlh, void *data)
+{
+    const struct nlattr *far_tb[GTP5G_FAR_ATTR_MAX + 1] = {};
+    const struct nlattr *fwd_param_tb[GTP5G_FORWARDING_PARAMETER_ATTR_MAX + 1] = {};
+    const struct nlattr *hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_ATTR_MAX + 1] = {};
+    struct gtp5g_far *far = data;
+    const struct gtp5g_allocator *a = far->alloc;
+    struct gtp5g_forwarding_parameter *fwd_param;
+    const struct nlattr *attr;
     char buf[MAX_LEN_OF_FORWARDING_POLICY_IDENTIFIER + 1];
+    size_t len;
+
+    if (gtp5g_attr_parse(nlh, &gtp5g_far_policy, far_tb) < 0)
+        return MNL_CB_ERROR;
 
-    mnl_attr_parse(nlh, sizeof(*genl), genl_gtp5g_far_validate_cb, far_tb);
-    far = *(struct gtp5g_far **) data = gtp5g_far_alloc();
+    gtp5g_get_far(a, far, far_tb);
 
-    if (far_tb[GTP5G_FAR_ID])
-        gtp5g_far_set_id(far, mnl_attr_get_u32(far_tb[GTP5G_FAR_ID]));
-    if (far_tb[GTP5G_FAR_APPLY_ACTION])
-        gtp5g_far_set_apply_action(far, mnl_attr_get_u8(far_tb[GTP5G_FAR_APPLY_ACTION]));
+    if (!far_tb[GTP5G_FAR_FORWARDING_PARAMETER]) {
+        if (far->fwd_param)
+            gtp5g_forwarding_parameter_free(a, far->fwd_param);
+        far->fwd_param = NULL;
+    } else {
+        if (gtp5g_attr_parse_nested(far_tb[GTP5G_FAR_FORWARDING_PARAMETER], &gtp5g_forwarding_parameter_policy,
+                                    fwd_param_tb) < 0)
+            return MNL_CB_ERROR;
 
-    if (far_tb[GTP5G_FAR_FORWARDING_PARAMETER]) {
-        mnl_attr_parse_nested(far_tb[GTP5G_FAR_FORWARDING_PARAMETER], genl_gtp5g_forwarding_parameter_validate_cb, fwd_param_tb);
+        if (!far->fwd_param && !(far->fwd_param = gtp5g_calloc(a, 1, sizeof(*far->fwd_param))))
+            goto err;
+        fwd_param = far->fwd_param;
 
         if (fwd_param_tb[GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION]) {
-            mnl_attr_parse_nested(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION],
-                                  genl_gtp5g_outer_header_creation_validate_cb, hdr_creation_tb);
-
-            ipv4.s_addr = mnl_attr_get_u32(hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_PEER_ADDR_IPV4]);
-            gtp5g_far_set_outer_header_creation(far,
-                mnl_attr_get_u16(hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_DESCRIPTION]),
-                mnl_attr_get_u32(hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_O_TEID]),
-                &ipv4, mnl_attr_get_u16(hdr_creation_tb[GTP5G_OUTER_HEADER_CREATION_PORT]));
-        }
+            if (gtp5g_attr_parse_nested(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION],
+                                        &gtp5g_outer_header_creation_policy, hdr_creation_tb) < 0)
+                return MNL_CB_ERROR;
+
+            if (!fwd_param->hdr_creation &&
+                !(fwd_param->hdr_creation = gtp5g_calloc(a, 1, sizeof(*fwd_param->hdr_creation))))
+                goto err;
+            gtp5g_get_outer_header_creation(a, fwd_param->hdr_creation, hdr_creation_tb);
+        } else
+            gtp5g_drop(a, fwd_param->hdr_creation);
 
         if (fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY]) {
-            strncpy(buf, mnl_attr_get_payload(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY]), mnl_attr_get_payload_len(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY]));
+            /* Not NUL terminated by the kernel */
+            len = mnl_attr_get_payload_len(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY]);
+            if (len > sizeof(buf) - 1)
+                len = sizeof(buf) - 1;
+            memcpy(buf, mnl_attr_get_payload(fwd_param_tb[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY]), len);
+            buf[len] = '\0';
             gtp5g_far_set_fwd_policy(far, buf);
-        }
+        } else
+            gtp5g_drop(a, fwd_param->fwd_policy);
     }
 
-    if (far_tb[GTP5G_FAR_RELATED_TO_PDR]) {
-        far->related_pdr_num = mnl_attr_get_payload_len(far_tb[GTP5G_FAR_RELATED_TO_PDR]) / (sizeof(uint16_t) / sizeof(char));
-        far->related_pdr_list = calloc(1, mnl_attr_get_payload_len(far_tb[GTP5G_FAR_RELATED_TO_PDR]));
-        memcpy(far->related_pdr_list, mnl_attr_get_payload(far_tb[GTP5G_FAR_RELATED_TO_PDR]), mnl_attr_get_payload_len(far_tb[GTP5G_FAR_RELATED_TO_PDR]));
+    attr = far_tb[GTP5G_FAR_RELATED_TO_PDR];
+    if (attr) {
+        far->related_pdr_list = gtp5g_list_copy(a, far->related_pdr_list, &far->related_pdr_num, sizeof(uint16_t),
+                                                mnl_attr_get_payload(attr), mnl_attr_get_payload_len(attr));
+        if (!far->related_pdr_list && mnl_attr_get_payload_len(attr))
+            goto err;
+    } else {
+        gtp5g_drop(a, far->related_pdr_list);
+        far->related_pdr_num = 0;
     }
 
     return MNL_CB_OK;
+err:
+    /* Keep the cause if a parser has already recorded one */
+    if (!gtp5g_get_err()->err)
+        gtp5g_err_set(ENOMEM, 0, "FAR reply");
+    return MNL_CB_ERROR;
+}
+
+int genl_gtp5g_far_attr_cb(const struct nlmsghdr *nlh, void *data)
+{
+    struct gtp5g_far **far = data;
+
+    *far = gtp5g_far_alloc();
+    if (!*far) {
+        gtp5g_err_set(ENOMEM, 0, "FAR reply");
+        return MNL_CB_ERROR;
+    }
+
+    if (genl_gtp5g_far_attr_into_cb(nlh, *far) != MNL_CB_OK) {
+        gtp5g_far_free(*far);
+        *far = NULL;
+        return MNL_CB_ERROR;
+    }
+    return MNL_CB_OK;
+}
+
+void genl_gtp5g_far_view_parse(const struct nlmsghdr *nlh, struct gtp5g_far_view *v)
+{
+    memset(v, 0, sizeof(*v));
+
+    gtp5g_attr_parse_view(nlh, &gtp5g_far_policy, v->far);
+    if (v->far[GTP5G_FAR_FORWARDING_PARAMETER])
+        gtp5g_attr_parse_nested_view(v->far[GTP5G_FAR_FORWARDING_PARAMETER],
+                                     &gtp5g_forwarding_parameter_policy, v->fwd_param);
+    if (v->fwd_param[GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION])
+        gtp5g_attr_parse_nested_view(v->fwd_param[GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION],
+                                     &gtp5g_outer_header_creation_policy, v->hdr_creation);
 }
 
 struct gtp5g_far *gtp5g_far_find_by_id(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_far *far)
@@ -442,20 +465,42 @@ struct gtp5g_far *gtp5g_far_find_by_id(int genl_id, struct mnl_socket *nl, struc
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_GET_FAR, far->id, "5G GTP device is NULL");
         return NULL;
     }
 
     nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_EXCL | NLM_F_ACK, ++seq,
                                GTP5G_CMD_GET_FAR);
-    gtp5g_build_far_payload(nlh, dev, far);
+    if (gtp5g_build_far_payload(nlh, sizeof(buf), dev, far) < 0)
+        return NULL;
 
-    if (genl_socket_talk(nl, nlh, seq, genl_gtp5g_attr_cb, &rt_far) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, genl_gtp5g_far_attr_cb, &rt_far, far->id) < 0)
         return NULL;
-    }
 
     return rt_far;
 }
 EXPORT_SYMBOL(gtp5g_far_find_by_id);
 
+int gtp5g_far_find_by_id_into(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev,
+                              struct gtp5g_far *far, struct gtp5g_far *out)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+    uint32_t id = far->id;
+
+    if (!dev || !out) {
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_GET_FAR, id, dev ? "FAR is NULL" : "5G GTP device is NULL");
+        return -1;
+    }
+
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_EXCL | NLM_F_ACK, ++seq,
+                               GTP5G_CMD_GET_FAR);
+    if (gtp5g_build_far_payload(nlh, sizeof(buf), dev, far) < 0)
+        return -1;
+
+    /* The request is built, so out may be far */
+    return gtp5g_socket_talk(nl, nlh, seq, genl_gtp5g_far_attr_into_cb, out, id) < 0 ? -1 : 0;
+}
+EXPORT_SYMBOL(gtp5g_far_find_by_id_into);
+
@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
@@ -44,99 +45,166 @@
 #include "internal.h"
 #include "tools.h"
 
-static void gtp5g_build_pdr_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+GTP5G_GEN_PUT(gtp5g_put_pdr, struct gtp5g_pdr, GTP5G_PDR_SCHEMA)
+GTP5G_GEN_PUT(gtp5g_put_pdi, struct gtp5g_pdi, GTP5G_PDI_SCHEMA)
+GTP5G_GEN_PUT(gtp5g_put_f_teid, struct local_f_teid, GTP5G_F_TEID_SCHEMA)
+GTP5G_GEN_PUT(gtp5g_put_sdf_filter, struct sdf_filter, GTP5G_SDF_FILTER_SCHEMA)
+GTP5G_GEN_PUT(gtp5g_put_flow_description, struct ip_filter_rule, GTP5G_FLOW_DESCRIPTION_SCHEMA)
+GTP5G_GEN_SIZE(gtp5g_size_pdr, struct gtp5g_pdr, GTP5G_PDR_SCHEMA)
+GTP5G_GEN_SIZE(gtp5g_size_pdi, struct gtp5g_pdi, GTP5G_PDI_SCHEMA)
+GTP5G_GEN_SIZE(gtp5g_size_f_teid, struct local_f_teid, GTP5G_F_TEID_SCHEMA)
+GTP5G_GEN_SIZE(gtp5g_size_sdf_filter, struct sdf_filter, GTP5G_SDF_FILTER_SCHEMA)
+GTP5G_GEN_SIZE(gtp5g_size_flow_description, struct ip_filter_rule, GTP5G_FLOW_DESCRIPTION_SCHEMA)
+
+/* What gtp5g_put_sdf_filter_nest() puts, to the byte */
+static size_t gtp5g_sdf_filter_nest_size(const struct sdf_filter *sdf)
 {
-	// Let kernel get dev easily
-	if (dev->ifns >= 0)
-		mnl_attr_put_u32(nlh, GTP5G_NET_NS_FD, dev->ifns);
+    const struct ip_filter_rule *rule = sdf->rule;
+    size_t size, desp;
+
+    size = gtp5g_size_sdf_filter(sdf);
+    if (rule) {
+        desp = gtp5g_size_flow_description(rule);
+        if (rule->sport_list)
+            desp += GTP5G_ATTR_SIZE(rule->sport_num * sizeof(uint32_t));
+        if (rule->dport_list)
+            desp += GTP5G_ATTR_SIZE(rule->dport_num * sizeof(uint32_t));
+        size += GTP5G_ATTR_SIZE(desp);
+    }
 
-	mnl_attr_put_u32(nlh, GTP5G_LINK, dev->ifidx);
+    return GTP5G_ATTR_SIZE(size);
+}
 
-	// Level 1 PDR
-	mnl_attr_put_u16(nlh, GTP5G_PDR_ID, pdr->id);
+/* What gtp5g_put_pdr_payload() puts, to the byte */
+static size_t gtp5g_pdr_payload_size(const struct gtp5g_dev *dev, const struct gtp5g_pdr *pdr)
+{
+    const struct gtp5g_pdi *pdi = pdr->pdi;
+    const struct sdf_filter *sdf;
+    size_t size, nest, list;
 
-	if (pdr->precedence)
-		mnl_attr_put_u32(nlh, GTP5G_PDR_PRECEDENCE, *pdr->precedence);
+    size = GTP5G_DEV_SIZE(dev) + gtp5g_size_pdr(pdr);
+    if (pdr->unix_sock_path)
+        size += GTP5G_ATTR_SIZE(strlen(pdr->unix_sock_path) + 1);
+    if (!pdi)
+        return size;
+
+    nest = gtp5g_size_pdi(pdi);
+    if (pdi->f_teid)
+        nest += GTP5G_ATTR_SIZE(gtp5g_size_f_teid(pdi->f_teid));
+    for (list = 0, sdf = pdi->sdf; sdf; sdf = sdf->next)
+        list += gtp5g_sdf_filter_nest_size(sdf);
+    nest += pdi->sdf && pdi->sdf->next ? GTP5G_ATTR_SIZE(list) : list;
+
+    return size + GTP5G_ATTR_SIZE(nest);
+}
 
-	if (pdr->outer_hdr_removal)
-		mnl_attr_put_u8(nlh, GTP5G_OUTER_HEADER_REMOVAL, *pdr->outer_hdr_removal);
+static void gtp5g_put_sdf_filter_nest(struct nlmsghdr *nlh, struct sdf_filter *sdf)
+{
+    struct nlattr *sdf_filter_nest, *sdf_desp_nest;
+
+    sdf_filter_nest = mnl_attr_nest_start(nlh, GTP5G_PDI_SDF_FILTER);
+
+    // Level 4 : SDF Filter description
+    struct ip_filter_rule *rule = sdf->rule;
+    if (rule) {
+        sdf_desp_nest = mnl_attr_nest_start(nlh, GTP5G_SDF_FILTER_FLOW_DESCRIPTION);
+        gtp5g_put_flow_description(nlh, rule);
+        if (rule->sport_list)
+            mnl_attr_put(nlh, GTP5G_FLOW_DESCRIPTION_SRC_PORT,
+                         rule->sport_num * sizeof(uint32_t), rule->sport_list);
+        if (rule->dport_list)
+            mnl_attr_put(nlh, GTP5G_FLOW_DESCRIPTION_DEST_PORT,
+                         rule->dport_num * sizeof(uint32_t), rule->dport_list);
+        mnl_attr_nest_end(nlh, sdf_desp_nest);
+    }
 
-	if (pdr->far_id)
-		mnl_attr_put_u32(nlh, GTP5G_PDR_FAR_ID, *pdr->far_id);
+    gtp5g_put_sdf_filter(nlh, sdf);
+    mnl_attr_nest_end(nlh, sdf_filter_nest);
+}
 
-	if (pdr->qer_id)
-        mnl_attr_put_u32(nlh, GTP5G_PDR_QER_ID, *pdr->qer_id);
-    
-    /* Not in 3GPP spec, just used for routing */
-    if (pdr->role_addr_ipv4)
-        mnl_attr_put_u32(nlh, GTP5G_PDR_ROLE_ADDR_IPV4, pdr->role_addr_ipv4->s_addr);
+static void gtp5g_put_pdr_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+{
+	// Let kernel get dev easily
+	if (dev->ifns >= 0)
+		GTP5G_PUT(nlh, GTP5G_NET_NS_FD, dev->ifns);
+
+	GTP5G_PUT(nlh, GTP5G_LINK, dev->ifidx);
+
+	// Level 1 PDR
+	gtp5g_put_pdr(nlh, pdr);
 
     /* Not in 3GPP spec, just used for buffering */
     if (pdr->unix_sock_path)
-        mnl_attr_put_str(nlh, GTP5G_PDR_UNIX_SOCKET_PATH, pdr->unix_sock_path);
+        mnl_attr_put_strz(nlh, GTP5G_PDR_UNIX_SOCKET_PATH, pdr->unix_sock_path);
 
     // Level 2 PDR : PDI
     struct gtp5g_pdi *pdi = pdr->pdi;
-    struct nlattr *pdi_nest, *f_teid_nest, *sdf_filter_nest, *sdf_desp_nest;
+    struct nlattr *pdi_nest, *f_teid_nest, *sdf_list_nest;
     if (pdi) {
         pdi_nest = mnl_attr_nest_start(nlh, GTP5G_PDR_PDI);
-        if (pdi->ue_addr_ipv4)
-            mnl_attr_put_u32(nlh, GTP5G_PDI_UE_ADDR_IPV4, pdi->ue_addr_ipv4->s_addr);
+        gtp5g_put_pdi(nlh, pdi);
 
         // Level 3 : local f-teid
         struct local_f_teid *f_teid = pdi->f_teid;
         if (f_teid) {
             f_teid_nest = mnl_attr_nest_start(nlh, GTP5G_PDI_F_TEID);
-            mnl_attr_put_u32(nlh, GTP5G_F_TEID_I_TEID, f_teid->teid);
-            mnl_attr_put_u32(nlh, GTP5G_F_TEID_GTPU_ADDR_IPV4, f_teid->gtpu_addr_ipv4.s_addr);
+            gtp5g_put_f_teid(nlh, f_teid);
             mnl_attr_nest_end(nlh, f_teid_nest);
         }
 
-        // Level 3 : SDF Filter
+        // Level 3 : SDF Filter, a single one as before the list, which free5GC's gtp5g lacks
         struct sdf_filter *sdf = pdi->sdf;
-        if (sdf) {
-            sdf_filter_nest = mnl_attr_nest_start(nlh, GTP5G_PDI_SDF_FILTER);
-
-            // Level 4 : SDF Filter description
-            struct ip_filter_rule *rule = sdf->rule;
-            if (rule) {
-                sdf_desp_nest = mnl_attr_nest_start(nlh, GTP5G_SDF_FILTER_FLOW_DESCRIPTION);
-                mnl_attr_put_u8(nlh, GTP5G_FLOW_DESCRIPTION_ACTION, rule->action);
-                mnl_attr_put_u8(nlh, GTP5G_FLOW_DESCRIPTION_DIRECTION, rule->direction);
-                mnl_attr_put_u8(nlh, GTP5G_FLOW_DESCRIPTION_PROTOCOL, rule->proto);
-                mnl_attr_put_u32(nlh, GTP5G_FLOW_DESCRIPTION_SRC_IPV4, rule->src.s_addr);
-                mnl_attr_put_u32(nlh, GTP5G_FLOW_DESCRIPTION_SRC_MASK, rule->smask.s_addr);
-                if (rule->sport_list)
-                    mnl_attr_put(nlh, GTP5G_FLOW_DESCRIPTION_SRC_PORT,
-                                 rule->sport_list[0] * sizeof(uint32_t) / sizeof(char),
-                                 (void *) &rule->sport_list[1]);
-                mnl_attr_put_u32(nlh, GTP5G_FLOW_DESCRIPTION_DEST_IPV4, rule->dest.s_addr);
-                mnl_attr_put_u32(nlh, GTP5G_FLOW_DESCRIPTION_DEST_MASK, rule->dmask.s_addr);
-                if (rule->dport_list)
-                    mnl_attr_put(nlh, GTP5G_FLOW_DESCRIPTION_DEST_PORT,
-                                 rule->dport_list[0] * sizeof(uint32_t) / sizeof(char),
-                                 (void *) &rule->dport_list[1]);
-                mnl_attr_nest_end(nlh, sdf_desp_nest);
-            }
+        if (sdf && sdf->next) {
+            sdf_list_nest = mnl_attr_nest_start(nlh, GTP5G_PDI_SDF_FILTER_LIST);
+            for (; sdf; sdf = sdf->next)
+                gtp5g_put_sdf_filter_nest(nlh, sdf);
+            mnl_attr_nest_end(nlh, sdf_list_nest);
+        } else if (sdf)
+            gtp5g_put_sdf_filter_nest(nlh, sdf);
+        mnl_attr_nest_end(nlh, pdi_nest);
+    }
+}
 
-            if (sdf->tos_traffic_class)
-                mnl_attr_put_u16(nlh, GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS, *sdf->tos_traffic_class);
+/* Several SDF filters only go to a module that takes the list of them */
+static int gtp5g_check_sdf_filters(const struct nlmsghdr *nlh, const struct gtp5g_pdr *pdr)
+{
+    const struct genlmsghdr *genl = mnl_nlmsg_get_payload(nlh);
+    int ret;
 
-            if (sdf->security_param_idx)
-                mnl_attr_put_u32(nlh, GTP5G_SDF_FILTER_SECURITY_PARAMETER_INDEX, *sdf->security_param_idx);
+    if (genl->cmd != GTP5G_CMD_ADD_PDR || !pdr->pdi || !pdr->pdi->sdf || !pdr->pdi->sdf->next)
+        return 0;
 
-            if (sdf->flow_label)
-                mnl_attr_put_u32(nlh, GTP5G_SDF_FILTER_FLOW_LABEL, *sdf->flow_label);
+    ret = gtp5g_sdf_filter_list_supported(nlh->nlmsg_type);
+    if (ret < 0) {
+        gtp5g_err_report(genl->cmd, pdr->id);
+        return -1;
+    }
+    if (!ret) {
+        gtp5g_err_fail(EOPNOTSUPP, genl->cmd, pdr->id,
+                       "gtp5g module takes a single SDF filter per PDR");
+        return -1;
+    }
+    return 0;
+}
 
-            if (sdf->bi_id)
-                mnl_attr_put_u32(nlh, GTP5G_SDF_FILTER_SDF_FILTER_ID, *sdf->bi_id);
+int gtp5g_build_pdr_payload(struct nlmsghdr *nlh, size_t size, struct gtp5g_dev *dev,
+                            struct gtp5g_pdr *pdr)
+{
+    if (gtp5g_msg_fits(nlh, size, gtp5g_pdr_payload_size(dev, pdr), pdr->id) < 0)
+        return -1;
+    if (gtp5g_check_sdf_filters(nlh, pdr) < 0)
+        return -1;
 
-            mnl_attr_nest_end(nlh, sdf_filter_nest);
-        }
-        mnl_attr_nest_end(nlh, pdi_nest);
-    }
+    gtp5g_put_pdr_payload(nlh, dev, pdr);
+    return 0;
 }
 
+size_t gtp5g_pdr_msg_size(struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+{
+    return GTP5G_MSG_HDR_SIZE + gtp5g_pdr_payload_size(dev, pdr);
+}
+EXPORT_SYMBOL(gtp5g_pdr_msg_size);
+
 int gtp5g_add_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
 {
     struct nlmsghdr *nlh;
@@ -144,7 +212,7 @@ int gtp5g_add_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_ADD_PDR, pdr->id, "5G GTP device is NULL");
         return -1;
     }
 
@@ -153,16 +221,15 @@ int gtp5g_add_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 
     // Add mandatory IEs here
     if (!pdr->precedence) {
-        perror("Add PDR must have precedence");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_ADD_PDR, pdr->id, "Add PDR must have precedence");
         return -1;
     }
 
-    gtp5g_build_pdr_payload(nlh, dev, pdr);
+    if (gtp5g_build_pdr_payload(nlh, sizeof(buf), dev, pdr) < 0)
+        return -1;
 
-    if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, NULL, NULL, pdr->id) < 0)
         return -1;
-    }
 
     return 0;
 }
@@ -175,18 +242,17 @@ int gtp5g_mod_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_ADD_PDR, pdr->id, "5G GTP device is NULL");
         return -1;
     }
 
     nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_REPLACE | NLM_F_ACK, ++seq,
                                GTP5G_CMD_ADD_PDR);
-    gtp5g_build_pdr_payload(nlh, dev, pdr);
+    if (gtp5g_build_pdr_payload(nlh, sizeof(buf), dev, pdr) < 0)
+        return -1;
 
-    if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, NULL, NULL, pdr->id) < 0)
         return -1;
-    }
 
     return 0;
 }
@@ -199,684 +265,531 @@ int gtp5g_del_pdr(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
     uint32_t seq = time(NULL);
     
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_DEL_PDR, pdr->id, "5G GTP device is NULL");
         return -1;
     }
 
     nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_ACK, ++seq,
                                GTP5G_CMD_DEL_PDR);
-    gtp5g_build_pdr_payload(nlh, dev, pdr);
+    if (gtp5g_build_pdr_payload(nlh, sizeof(buf), dev, pdr) < 0)
+        return -1;
 
-    if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, NULL, NULL, pdr->id) < 0)
         return -1;
-    }
 
     return 0;
 }
 EXPORT_SYMBOL(gtp5g_del_pdr);
 
-static int genl_gtp5g_pdr_validate_cb(const struct nlattr *attr, void *data)
+static int gtp5g_batch_pdr(struct gtp5g_batch *b, uint16_t flags, uint8_t cmd,
+                           struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
-
-    if (mnl_attr_type_valid(attr, GTP5G_PDR_ATTR_MAX) < 0)
-        return MNL_CB_OK;
-
-    switch(type) {
-        case GTP5G_PDR_ID:
-            if (mnl_attr_validate(attr, MNL_TYPE_U16) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_PDR_PRECEDENCE:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_PDR_PDI:
-            if (mnl_attr_validate(attr, MNL_TYPE_NESTED) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_OUTER_HEADER_REMOVAL:
-            if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_PDR_FAR_ID:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-		case GTP5G_PDR_QER_ID:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-
+    struct nlmsghdr *nlh;
 
-        /* Not in 3GPP spec, just used for routing */
-        case GTP5G_PDR_ROLE_ADDR_IPV4:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-    default:
-        break;
+    if (!dev) {
+        gtp5g_err_fail(EINVAL, cmd, pdr->id, "5G GTP device is NULL");
+        return -1;
     }
 
-    tb[type] = attr;
-    return MNL_CB_OK;
+    /* Only the room the request takes, which it fills to the byte */
+    nlh = gtp5g_batch_put_size(b, flags, cmd, pdr->id, gtp5g_pdr_msg_size(dev, pdr));
+    if (!nlh || gtp5g_check_sdf_filters(nlh, pdr) < 0)
+        return -1;
 
-VALIDATE_FAIL:
-    perror("PDR mnl_attr_validate");
-    return MNL_CB_ERROR;
+    gtp5g_put_pdr_payload(nlh, dev, pdr);
+    gtp5g_batch_commit(b, nlh);
+
+    return 0;
 }
 
-static int genl_gtp5g_pdi_validate_cb(const struct nlattr *attr, void *data)
+int gtp5g_batch_add_pdr(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
-
-    if (mnl_attr_type_valid(attr, GTP5G_PDI_ATTR_MAX) < 0)
-        return MNL_CB_OK;
-
-    switch(type) {
-        case GTP5G_PDI_UE_ADDR_IPV4:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_PDI_F_TEID:
-             if (mnl_attr_validate(attr, MNL_TYPE_NESTED) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_PDI_SDF_FILTER:
-             if (mnl_attr_validate(attr, MNL_TYPE_NESTED) < 0)
-                goto VALIDATE_FAIL;
-            break;
-    default:
-        break;
+    if (!pdr->precedence) {
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_ADD_PDR, pdr->id, "Add PDR must have precedence");
+        return -1;
     }
 
-    tb[type] = attr;
-    return MNL_CB_OK;
-
-VALIDATE_FAIL:
-    perror("PDI mnl_attr_validate");
-    return MNL_CB_ERROR;
+    return gtp5g_batch_pdr(b, NLM_F_EXCL, GTP5G_CMD_ADD_PDR, dev, pdr);
 }
+EXPORT_SYMBOL(gtp5g_batch_add_pdr);
 
-static int genl_gtp5g_f_teid_validate_cb(const struct nlattr *attr, void *data)
+int gtp5g_batch_mod_pdr(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
+    return gtp5g_batch_pdr(b, NLM_F_REPLACE, GTP5G_CMD_ADD_PDR, dev, pdr);
+}
+EXPORT_SYMBOL(gtp5g_batch_mod_pdr);
 
-    if (mnl_attr_type_valid(attr, GTP5G_F_TEID_ATTR_MAX) < 0)
-        return MNL_CB_OK;
+int gtp5g_batch_del_pdr(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
+{
+    return gtp5g_batch_pdr(b, 0, GTP5G_CMD_DEL_PDR, dev, pdr);
+}
+EXPORT_SYMBOL(gtp5g_batch_del_pdr);
+
+GTP5G_POLICY(gtp5g_pdr_policy, "PDR", GTP5G_PDR_ATTR_MAX,
+             GTP5G_DEVICE_SCHEMA(GTP5G_POLICY_ATTR) GTP5G_PDR_SCHEMA(GTP5G_POLICY_ATTR));
+GTP5G_POLICY(gtp5g_pdi_policy, "PDI", GTP5G_PDI_ATTR_MAX,
+             GTP5G_PDI_SCHEMA(GTP5G_POLICY_ATTR));
+GTP5G_POLICY(gtp5g_f_teid_policy, "F-TEID", GTP5G_F_TEID_ATTR_MAX,
+             GTP5G_F_TEID_SCHEMA(GTP5G_POLICY_ATTR));
+GTP5G_POLICY(gtp5g_sdf_filter_policy, "SDF Filter", GTP5G_SDF_FILTER_ATTR_MAX,
+             GTP5G_SDF_FILTER_SCHEMA(GTP5G_POLICY_ATTR));
+GTP5G_POLICY(gtp5g_flow_description_policy, "Flow Description", GTP5G_FLOW_DESCRIPTION_ATTR_MAX,
+             GTP5G_FLOW_DESCRIPTION_SCHEMA(GTP5G_POLICY_ATTR));
+
+/* A port list attribute, " 80,8000-8080" */
+static void gtp5g_out_port_attr(struct gtp5g_out *o, const struct nlattr *attr)
+{
+    gtp5g_out_char(o, ' ');
+    gtp5g_out_ports(o, mnl_attr_get_payload(attr), mnl_attr_get_payload_len(attr) / sizeof(uint32_t));
+}
 
-    switch(type) {
-        case GTP5G_F_TEID_I_TEID:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_F_TEID_GTPU_ADDR_IPV4:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-    default:
-        break;
+static void gtp5g_out_addr_attr(struct gtp5g_out *o, const struct nlattr *addr,
+                                const struct nlattr *mask)
+{
+    struct in_addr ipv4;
+    int len;
+
+    if (addr) {
+        ipv4.s_addr = mnl_attr_get_u32(addr);
+        if (ipv4.s_addr == 0)
+            gtp5g_out_str(o, "any");
+        else
+            gtp5g_out_ipv4(o, &ipv4);
     }
 
-    tb[type] = attr;
-    return MNL_CB_OK;
-
-VALIDATE_FAIL:
-    perror("F-TEID mnl_attr_validate");
-    return MNL_CB_ERROR;
+    if (mask) {
+        len = netmask_to_decimal(mnl_attr_get_u32(mask));
+        if (len < 32) {
+            gtp5g_out_char(o, '/');
+            gtp5g_out_u32(o, len);
+        }
+    }
 }
 
-static int genl_gtp5g_sdf_filter_validate_cb(const struct nlattr *attr, void *data)
+GTP5G_GEN_TEXT(gtp5g_text_pdr_attr, GTP5G_PDR_SCHEMA)
+GTP5G_GEN_TEXT(gtp5g_text_pdi_attr, GTP5G_PDI_SCHEMA)
+GTP5G_GEN_TEXT(gtp5g_text_f_teid_attr, GTP5G_F_TEID_SCHEMA)
+GTP5G_GEN_TEXT(gtp5g_text_sdf_filter_attr, GTP5G_SDF_FILTER_SCHEMA)
+
+static void gtp5g_text_sdf_filter_nest_attr(struct gtp5g_out *o, uint16_t type, const struct nlattr *attr)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
+    const struct nlattr *rule_tb[GTP5G_FLOW_DESCRIPTION_ATTR_MAX + 1] = {};
+    int proto;
 
-    if (mnl_attr_type_valid(attr, GTP5G_SDF_FILTER_ATTR_MAX) < 0)
-        return MNL_CB_OK;
+    if (type != GTP5G_SDF_FILTER_FLOW_DESCRIPTION)
+        return;
 
-    switch(type) {
-        case GTP5G_SDF_FILTER_FLOW_DESCRIPTION:
-             if (mnl_attr_validate(attr, MNL_TYPE_NESTED) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS:
-            if (mnl_attr_validate(attr, MNL_TYPE_U16) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_SDF_FILTER_SECURITY_PARAMETER_INDEX:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_SDF_FILTER_FLOW_LABEL:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_SDF_FILTER_SDF_FILTER_ID:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-    default:
-        break;
+    if (gtp5g_attr_parse_nested(attr, &gtp5g_flow_description_policy, rule_tb) < 0) {
+        o->err = ERANGE;
+        return;
+    }
+    gtp5g_out_str(o, "      - Flow Description:");
+
+    if (rule_tb[GTP5G_FLOW_DESCRIPTION_ACTION]) {
+        switch (mnl_attr_get_u8(rule_tb[GTP5G_FLOW_DESCRIPTION_ACTION])) {
+            case GTP5G_SDF_FILTER_PERMIT:
+                gtp5g_out_str(o, " permit");
+                break;
+            default:
+                gtp5g_out_str(o, " unknown_action");
+        }
     }
 
-    tb[type] = attr;
-    return MNL_CB_OK;
+    if (rule_tb[GTP5G_FLOW_DESCRIPTION_DIRECTION]) {
+        switch (mnl_attr_get_u8(rule_tb[GTP5G_FLOW_DESCRIPTION_DIRECTION])) {
+            case GTP5G_SDF_FILTER_IN:
+                gtp5g_out_str(o, " in");
+                break;
+            case GTP5G_SDF_FILTER_OUT:
+                gtp5g_out_str(o, " out");
+                break;
+            default:
+                gtp5g_out_str(o, " unknown_direction");
+        }
+    }
 
-VALIDATE_FAIL:
-    perror("SDF Filter mnl_attr_validate");
-    return MNL_CB_ERROR;
+    if (rule_tb[GTP5G_FLOW_DESCRIPTION_PROTOCOL]) {
+        proto = mnl_attr_get_u8(rule_tb[GTP5G_FLOW_DESCRIPTION_PROTOCOL]);
+        if (proto == 0xff) {
+            gtp5g_out_str(o, " ip");
+        } else {
+            gtp5g_out_char(o, ' ');
+            gtp5g_out_u32(o, proto);
+        }
+    }
+
+    gtp5g_out_str(o, " from ");
+    gtp5g_out_addr_attr(o, rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_IPV4],
+                        rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_MASK]);
+    if (rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT])
+        gtp5g_out_port_attr(o, rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]);
+
+    gtp5g_out_str(o, " to ");
+    gtp5g_out_addr_attr(o, rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_IPV4],
+                        rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_MASK]);
+    if (rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT])
+        gtp5g_out_port_attr(o, rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]);
+
+    gtp5g_out_char(o, '\n');
 }
 
-static int genl_gtp5g_flow_description_validate_cb(const struct nlattr *attr, void *data)
+static void gtp5g_text_pdi_nest_attr(struct gtp5g_out *o, uint16_t type, const struct nlattr *attr)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
-
-    if (mnl_attr_type_valid(attr, GTP5G_FLOW_DESCRIPTION_ATTR_MAX) < 0)
-        return MNL_CB_OK;
+    const struct nlattr *f_teid_tb[GTP5G_F_TEID_ATTR_MAX + 1] = {};
+    const struct nlattr *sdf_tb[GTP5G_SDF_FILTER_ATTR_MAX + 1] = {};
+    const struct nlattr *sdf;
 
-    switch(type) {
-        case GTP5G_FLOW_DESCRIPTION_ACTION:
-            if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_FLOW_DESCRIPTION_DIRECTION:
-            if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_FLOW_DESCRIPTION_PROTOCOL:
-            if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_FLOW_DESCRIPTION_SRC_IPV4:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
-            break;
-        case GTP5G_FLOW_DESCRIPTION_SRC_MASK:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
+    switch (type) {
+        case GTP5G_PDI_F_TEID:
+            if (gtp5g_attr_parse_nested(attr, &gtp5g_f_teid_policy, f_teid_tb) < 0) {
+                o->err = ERANGE;
+                break;
+            }
+            gtp5g_out_str(o, "    [Local F-Teid Info]\n");
+            gtp5g_text_f_teid_attr(o, f_teid_tb, NULL);
             break;
-        case GTP5G_FLOW_DESCRIPTION_DEST_IPV4:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
+        case GTP5G_PDI_SDF_FILTER:
+            if (gtp5g_attr_parse_nested(attr, &gtp5g_sdf_filter_policy, sdf_tb) < 0) {
+                o->err = ERANGE;
+                break;
+            }
+            gtp5g_out_str(o, "    [SDF Filter Info]\n");
+            gtp5g_text_sdf_filter_attr(o, sdf_tb, gtp5g_text_sdf_filter_nest_attr);
             break;
-        case GTP5G_FLOW_DESCRIPTION_DEST_MASK:
-            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-                goto VALIDATE_FAIL;
+        case GTP5G_PDI_SDF_FILTER_LIST:
+            mnl_attr_for_each_nested(sdf, attr) {
+                if (mnl_attr_get_type(sdf) == GTP5G_PDI_SDF_FILTER)
+                    gtp5g_text_pdi_nest_attr(o, GTP5G_PDI_SDF_FILTER, sdf);
+            }
             break;
-    default:
-        break;
     }
-
-    tb[type] = attr;
-    return MNL_CB_OK;
-
-VALIDATE_FAIL:
-    perror("Flow Description mnl_attr_validate");
-    return MNL_CB_ERROR;
 }
 
-static int genl_gtp5g_attr_list_cb(const struct nlmsghdr *nlh, void *data)
+static void gtp5g_text_pdr_nest_attr(struct gtp5g_out *o, uint16_t type, const struct nlattr *attr)
 {
-    struct nlattr *pdr_tb[GTP5G_PDR_ATTR_MAX + 1] = {};
-    struct nlattr *pdi_tb[GTP5G_PDI_ATTR_MAX + 1] = {};
-    struct nlattr *f_teid_tb[GTP5G_F_TEID_ATTR_MAX + 1] = {};
-    struct nlattr *sdf_tb[GTP5G_SDF_FILTER_ATTR_MAX + 1] = {};
-    struct nlattr *rule_tb[GTP5G_FLOW_DESCRIPTION_ATTR_MAX + 1] = {};
-
-    char buf[INET_ADDRSTRLEN];
-    struct genlmsghdr *genl;
-
-    const char *indent_str = "  ";
-    struct in_addr *ipv4 = (void *)buf;
-    int mask;
-
-    mnl_attr_parse(nlh, sizeof(*genl), genl_gtp5g_pdr_validate_cb, pdr_tb);
-    if (pdr_tb[GTP5G_PDR_ID])
-        printf("[PDR No.%u Info]\n", mnl_attr_get_u16(pdr_tb[GTP5G_PDR_ID]));
-    if (pdr_tb[GTP5G_PDR_PRECEDENCE])
-        printf("%s- Precedence: %u\n", indent_str, mnl_attr_get_u32(pdr_tb[GTP5G_PDR_PRECEDENCE]));
-    if (pdr_tb[GTP5G_OUTER_HEADER_REMOVAL])
-        printf("%s- Outer Header Removal: %u\n", indent_str, mnl_attr_get_u8(pdr_tb[GTP5G_OUTER_HEADER_REMOVAL]));
-
-    if (pdr_tb[GTP5G_PDR_PDI]) {
-        mnl_attr_parse_nested(pdr_tb[GTP5G_PDR_PDI], genl_gtp5g_pdi_validate_cb, pdi_tb);
-
-        printf("%s[PDI Info]\n", indent_str);
-        if (pdi_tb[GTP5G_PDI_UE_ADDR_IPV4]) {
-            ipv4->s_addr = mnl_attr_get_u32(pdi_tb[GTP5G_PDI_UE_ADDR_IPV4]);
-            inet_ntop(AF_INET, ipv4, buf, sizeof(buf));
-            printf("%s%s- UE IPv4: %s\n", indent_str, indent_str, buf);
-        }
+    const struct nlattr *pdi_tb[GTP5G_PDI_ATTR_MAX + 1] = {};
 
-        if (pdi_tb[GTP5G_PDI_F_TEID]) {
-            mnl_attr_parse_nested(pdi_tb[GTP5G_PDI_F_TEID], genl_gtp5g_f_teid_validate_cb, f_teid_tb);
-
-            printf("%s%s[Local F-Teid Info]\n", indent_str, indent_str);
-            if (f_teid_tb[GTP5G_F_TEID_I_TEID])
-                printf("%s%s%s- In Teid: %u\n", indent_str, indent_str, indent_str,
-                       mnl_attr_get_u32(f_teid_tb[GTP5G_F_TEID_I_TEID]));
-
-            if (f_teid_tb[GTP5G_F_TEID_GTPU_ADDR_IPV4]) {
-                ipv4->s_addr = mnl_attr_get_u32(f_teid_tb[GTP5G_F_TEID_GTPU_ADDR_IPV4]);
-                inet_ntop(AF_INET, ipv4, buf, sizeof(buf));
-                printf("%s%s%s- Local GTP-U IPv4: %s\n", indent_str, indent_str, indent_str, buf);
-            }
-        }
-
-        if (pdi_tb[GTP5G_PDI_SDF_FILTER]) {
-            mnl_attr_parse_nested(pdi_tb[GTP5G_PDI_SDF_FILTER], genl_gtp5g_sdf_filter_validate_cb, sdf_tb);
-
-            printf("%s%s[SDF Filter Info]\n", indent_str, indent_str);
-
-            if (sdf_tb[GTP5G_SDF_FILTER_FLOW_DESCRIPTION]) {
-                mnl_attr_parse_nested(sdf_tb[GTP5G_SDF_FILTER_FLOW_DESCRIPTION],
-                                      genl_gtp5g_flow_description_validate_cb, rule_tb);
-                printf("%s%s%s- Flow Description:", indent_str, indent_str, indent_str);
-
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_ACTION]) {
-                    switch (mnl_attr_get_u8(rule_tb[GTP5G_FLOW_DESCRIPTION_ACTION])) {
-                        case GTP5G_SDF_FILTER_PERMIT:
-                            printf(" permit");
-                            break;
-                        default:
-                            printf(" unknown_action");
-                    }
-                }
-
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_DIRECTION]) {
-                    switch (mnl_attr_get_u8(rule_tb[GTP5G_FLOW_DESCRIPTION_DIRECTION])) {
-                        case GTP5G_SDF_FILTER_IN:
-                            printf(" in");
-                            break;
-                        case GTP5G_SDF_FILTER_OUT:
-                            printf(" out");
-                            break;
-                        default:
-                            printf(" unknown_direction");
-                    }
-                }
-
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_PROTOCOL]) {
-                    int proto = mnl_attr_get_u8(rule_tb[GTP5G_FLOW_DESCRIPTION_PROTOCOL]);
-                    if (proto == 0xff)
-                        printf(" ip");
-                    else
-                        printf(" %d", proto);
-                }
-                
-                printf(" from ");
-
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_IPV4]) {
-                    ipv4->s_addr = mnl_attr_get_u32(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_IPV4]);
-                    if (ipv4->s_addr == 0)
-                        printf("any");
-                    else {
-                        inet_ntop(AF_INET, ipv4, buf, sizeof(buf));
-                        printf("%s", buf);
-                    }
-                }
-
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_MASK]) {
-                    mask = netmask_to_decimal(mnl_attr_get_u32(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_MASK]));
-                    if (mask < 32)
-                        printf("/%d", mask);
-                }
-
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]) {
-                    printf(" ");
-                    port_list_from_kernel_print(mnl_attr_get_payload(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]),
-                        mnl_attr_get_payload_len(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]) / (sizeof(uint32_t) / sizeof(char)));
-                }
-
-                printf(" to ");
-
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_IPV4]) {
-                    ipv4->s_addr = mnl_attr_get_u32(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_IPV4]);
-                    if (ipv4->s_addr == 0)
-                        printf("any");
-                    else {
-                        inet_ntop(AF_INET, ipv4, buf, sizeof(buf));
-                        printf("%s", buf);
-                    }
-                }
-
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_MASK]) {
-                    mask = netmask_to_decimal(mnl_attr_get_u32(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_MASK]));
-                    if (mask < 32)
-                        printf("/%d", mask);
-                }
-
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]) {
-                    printf(" ");
-                    port_list_from_kernel_print(mnl_attr_get_payload(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]),
-                        mnl_attr_get_payload_len(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]) / (sizeof(uint32_t) / sizeof(char)));
-                }
-
-                printf("\n");
-            }
-
-            if (sdf_tb[GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS])
-                printf("%s%s%s- ToS Traffic Class: %u\n", indent_str, indent_str, indent_str,
-                       mnl_attr_get_u16(sdf_tb[GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS]));
-
-            if (sdf_tb[GTP5G_SDF_FILTER_SECURITY_PARAMETER_INDEX])
-                printf("%s%s%s- Security Parameter Index: %u\n", indent_str, indent_str, indent_str,
-                       mnl_attr_get_u32(sdf_tb[GTP5G_SDF_FILTER_SECURITY_PARAMETER_INDEX]));
-
-            if (sdf_tb[GTP5G_SDF_FILTER_FLOW_LABEL])
-                printf("%s%s%s- Flow Label: %u\n", indent_str, indent_str, indent_str,
-                       mnl_attr_get_u32(sdf_tb[GTP5G_SDF_FILTER_FLOW_LABEL]));
+    if (type != GTP5G_PDR_PDI)
+        return;
 
-            if (sdf_tb[GTP5G_SDF_FILTER_SDF_FILTER_ID])
-                printf("%s%s%s- SDF Filter ID: %u\n", indent_str, indent_str, indent_str,
-                       mnl_attr_get_u32(sdf_tb[GTP5G_SDF_FILTER_SDF_FILTER_ID]));
-        }
+    if (gtp5g_attr_parse_nested(attr, &gtp5g_pdi_policy, pdi_tb) < 0) {
+        o->err = ERANGE;
+        return;
     }
+    gtp5g_out_str(o, "  [PDI Info]\n");
+    gtp5g_text_pdi_attr(o, pdi_tb, gtp5g_text_pdi_nest_attr);
+}
 
-    if (pdr_tb[GTP5G_PDR_FAR_ID])
-        printf("%s- FAR ID: %u\n", indent_str, mnl_attr_get_u32(pdr_tb[GTP5G_PDR_FAR_ID]));
+int genl_gtp5g_pdr_attr_list_cb(const struct nlmsghdr *nlh, void *data)
+{
+    const struct nlattr *pdr_tb[GTP5G_PDR_ATTR_MAX + 1] = {};
+    struct gtp5g_out *o = data;
+    struct in_addr ipv4;
 
-    if (pdr_tb[GTP5G_PDR_QER_ID])
-        printf("%s- QER ID: %u\n", indent_str, mnl_attr_get_u32(pdr_tb[GTP5G_PDR_QER_ID]));
+    if (gtp5g_attr_parse(nlh, &gtp5g_pdr_policy, pdr_tb) < 0)
+        return MNL_CB_ERROR;
+    if (pdr_tb[GTP5G_PDR_ID]) {
+        gtp5g_out_str(o, "[PDR No.");
+        gtp5g_out_u32(o, mnl_attr_get_u16(pdr_tb[GTP5G_PDR_ID]));
+        gtp5g_out_str(o, " Info]\n");
+    }
+    gtp5g_text_pdr_attr(o, pdr_tb, gtp5g_text_pdr_nest_attr);
 
     /* Not in 3GPP spec, just used for routing */
     if (pdr_tb[GTP5G_PDR_ROLE_ADDR_IPV4]) {
-        ipv4->s_addr = mnl_attr_get_u32(pdr_tb[GTP5G_PDR_ROLE_ADDR_IPV4]);
-        inet_ntop(AF_INET, ipv4, buf, sizeof(buf));
-        printf("%s- GTP-U IPv4: %s (For routing)\n", indent_str, buf);
+        ipv4.s_addr = mnl_attr_get_u32(pdr_tb[GTP5G_PDR_ROLE_ADDR_IPV4]);
+        gtp5g_out_str(o, "  - GTP-U IPv4: ");
+        gtp5g_out_ipv4(o, &ipv4);
+        gtp5g_out_str(o, " (For routing)\n");
     }
 
-    return MNL_CB_OK;
+    return o->err ? MNL_CB_ERROR : MNL_CB_OK;
 }
 
 int gtp5g_list_pdr(int genl_id, struct mnl_socket *nl)
 {
-    char buf[MNL_SOCKET_BUFFER_SIZE];
-    struct nlmsghdr *nlh;
-    uint32_t seq = time(NULL);
-
-    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_DUMP, 0,
-                               GTP5G_CMD_GET_PDR);
-
-    if (genl_socket_talk(nl, nlh, seq, genl_gtp5g_attr_list_cb, NULL) < 0) {
-        perror("genl_socket_talk");
-        return -1;
-    }
-
-    return 0;
+    return gtp5g_list_pdr_to(genl_id, nl, &gtp5g_sink_stdout, GTP5G_FORMAT_TEXT);
 }
 EXPORT_SYMBOL(gtp5g_list_pdr);
 
-void gtp5g_print_pdr(struct gtp5g_pdr *pdr)
-{
-    struct gtp5g_pdi *pdi;
-    struct local_f_teid *f_teid;
-    struct sdf_filter *sdf;
-    struct ip_filter_rule *rule;
-
-    const char *indent_str = "  ";
-    char buf[INET_ADDRSTRLEN];
-    int mask;
+GTP5G_GEN_PRINT(gtp5g_text_pdr_fields, struct gtp5g_pdr, GTP5G_PDR_SCHEMA)
+GTP5G_GEN_PRINT(gtp5g_text_pdi_fields, struct gtp5g_pdi, GTP5G_PDI_SCHEMA)
+GTP5G_GEN_PRINT(gtp5g_text_f_teid_fields, struct local_f_teid, GTP5G_F_TEID_SCHEMA)
+GTP5G_GEN_PRINT(gtp5g_text_sdf_filter_fields, struct sdf_filter, GTP5G_SDF_FILTER_SCHEMA)
 
-    if (!pdr) {
-        perror("PDR is NULL");
-        return;
+static void gtp5g_text_sdf_filter_nest(struct gtp5g_out *o, uint16_t type, const struct sdf_filter *sdf)
+{
+    if (type == GTP5G_SDF_FILTER_FLOW_DESCRIPTION && sdf->rule) {
+        gtp5g_out_str(o, "      - Flow Description: ");
+        gtp5g_out_flow_desc(o, sdf->rule);
+        gtp5g_out_char(o, '\n');
     }
+}
 
-    printf("[PDR No.%u Info]\n", pdr->id);
-    printf("%s- Precedence: %u\n", indent_str, *pdr->precedence);
-    if (pdr->outer_hdr_removal)
-        printf("%s- Outer Header Removal: %u\n", indent_str, *pdr->outer_hdr_removal);
-    
-    if (pdr->pdi) {
-        pdi = pdr->pdi;
-        printf("%s[PDI Info]\n", indent_str);
-
-        if (pdi->ue_addr_ipv4) {
-            inet_ntop(AF_INET, pdi->ue_addr_ipv4, buf, sizeof(buf));
-            printf("%s%s- UE IPv4: %s\n", indent_str, indent_str, buf);
-        }
-
-        if (pdi->f_teid) {
-            f_teid = pdi->f_teid;
-            printf("%s%s[Local F-Teid Info]\n", indent_str, indent_str);
-
-            printf("%s%s%s- In Teid: %u\n", indent_str, indent_str, indent_str, f_teid->teid);
-
-            inet_ntop(AF_INET, &f_teid->gtpu_addr_ipv4, buf, sizeof(buf));
-            printf("%s%s%s- Local GTP-U IPv4: %s\n", indent_str, indent_str, indent_str, buf);
-        }
-
-        if (pdi->sdf) {
-            sdf = pdi->sdf;
-            printf("%s%s[SDF Filter Info]\n", indent_str, indent_str);
-
-            if (sdf->rule) {
-                rule = sdf->rule;
-                printf("%s%s%s- Flow Description:", indent_str, indent_str, indent_str);
-
-                switch (rule->action) {
-                    case GTP5G_SDF_FILTER_PERMIT:
-                        printf(" permit");
-                        break;
-                    default:
-                        printf(" unknown_action");
-                }
-
-                switch (rule->direction) {
-                    case GTP5G_SDF_FILTER_IN:
-                        printf(" in");
-                        break;
-                    case GTP5G_SDF_FILTER_OUT:
-                        printf(" out");
-                        break;
-                    default:
-                        printf(" unknown_direction");
-                }
-
-                if (rule->proto == 0xff)
-                    printf(" ip");
-                else
-                    printf(" %d", rule->proto);
-
-                printf(" from ");
-
-                if (!rule->src.s_addr)
-                    printf("any");
-                else {
-                    inet_ntop(AF_INET, &rule->src, buf, sizeof(buf));
-                    printf("%s", buf);
-                }
-
-                mask = netmask_to_decimal(rule->smask.s_addr);
-                if (mask < 32)
-                    printf("/%d", mask);
-
-                if (rule->sport_num && rule->sport_list) {
-                    printf(" ");
-                    port_list_from_kernel_print(rule->sport_list, rule->sport_num);
-                }
-
-                printf(" to ");
-
-                if (!rule->dest.s_addr)
-                    printf("any");
-                else {
-                    inet_ntop(AF_INET, &rule->dest, buf, sizeof(buf));
-                    printf("%s", buf);
-                }
-
-                mask = netmask_to_decimal(rule->dmask.s_addr);
-                if (mask < 32)
-                    printf("/%d", mask);
-
-                if (rule->dport_num && rule->dport_list) {
-                    printf(" ");
-                    port_list_from_kernel_print(rule->dport_list, rule->dport_num);
-                }
-
-                printf("\n");
-            }
-
-            if (sdf->tos_traffic_class)
-                printf("%s%s%s- ToS Traffic Class: %u\n", indent_str, indent_str, indent_str,
-                    *sdf->tos_traffic_class);
-
-            if (sdf->security_param_idx)
-                printf("%s%s%s- Security Parameter Index: %u\n", indent_str, indent_str, indent_str,
-                    *sdf->security_param_idx);
-
-            if (sdf->flow_label)
-                printf("%s%s%s- Flow Label: %u\n", indent_str, indent_str, indent_str,
-                    *sdf->flow_label);
-
-            if (sdf->bi_id)
-                printf("%s%s%s- SDF Filter ID: %u\n", indent_str, indent_str, indent_str,
-                    *sdf->bi_id);
+static void gtp5g_text_pdi_nest(struct gtp5g_out *o, uint16_t type, const struct gtp5g_pdi *pdi)
+{
+    const struct sdf_filter *sdf;
+
+    if (type == GTP5G_PDI_F_TEID && pdi->f_teid) {
+        gtp5g_out_str(o, "    [Local F-Teid Info]\n");
+        gtp5g_text_f_teid_fields(o, pdi->f_teid, NULL);
+    } else if (type == GTP5G_PDI_SDF_FILTER) {
+        for (sdf = pdi->sdf; sdf; sdf = sdf->next) {
+            gtp5g_out_str(o, "    [SDF Filter Info]\n");
+            gtp5g_text_sdf_filter_fields(o, sdf, gtp5g_text_sdf_filter_nest);
         }
     }
+}
 
-    if (pdr->far_id)
-        printf("%s- FAR ID: %u\n", indent_str, *pdr->far_id);
+static void gtp5g_text_pdr_nest(struct gtp5g_out *o, uint16_t type, const struct gtp5g_pdr *pdr)
+{
+    if (type == GTP5G_PDR_PDI && pdr->pdi) {
+        gtp5g_out_str(o, "  [PDI Info]\n");
+        gtp5g_text_pdi_fields(o, pdr->pdi, gtp5g_text_pdi_nest);
+    }
+}
 
-    if (pdr->qer_id)
-        printf("%s- QER ID: %u\n", indent_str, *pdr->qer_id);
+void gtp5g_text_pdr(struct gtp5g_out *o, struct gtp5g_pdr *pdr)
+{
+    gtp5g_out_str(o, "[PDR No.");
+    gtp5g_out_u32(o, pdr->id);
+    gtp5g_out_str(o, " Info]\n");
+    gtp5g_text_pdr_fields(o, pdr, gtp5g_text_pdr_nest);
 
     /* Not in 3GPP spec, just used for routing */
     if (pdr->role_addr_ipv4) {
-        inet_ntop(AF_INET, pdr->role_addr_ipv4, buf, sizeof(buf));
-        printf("%s- GTP-U IPv4: %s (For routing)\n", indent_str, buf);
+        gtp5g_out_str(o, "  - GTP-U IPv4: ");
+        gtp5g_out_ipv4(o, pdr->role_addr_ipv4);
+        gtp5g_out_str(o, " (For routing)\n");
     }
 }
-EXPORT_SYMBOL(gtp5g_print_pdr);
 
-static int genl_gtp5g_attr_cb(const struct nlmsghdr *nlh, void *data)
+void gtp5g_print_pdr(struct gtp5g_pdr *pdr)
 {
-    struct nlattr *pdr_tb[GTP5G_PDR_ATTR_MAX + 1] = {};
-    struct nlattr *pdi_tb[GTP5G_PDI_ATTR_MAX + 1] = {};
-    struct nlattr *f_teid_tb[GTP5G_F_TEID_ATTR_MAX + 1] = {};
-    struct nlattr *sdf_tb[GTP5G_SDF_FILTER_ATTR_MAX + 1] = {};
-    struct nlattr *rule_tb[GTP5G_FLOW_DESCRIPTION_ATTR_MAX + 1] = {};
+    gtp5g_print_pdr_to(pdr, &gtp5g_sink_stdout, GTP5G_FORMAT_TEXT);
+}
+EXPORT_SYMBOL(gtp5g_print_pdr);
 
-    struct genlmsghdr *genl;
-    struct gtp5g_pdr *pdr;
-    struct ip_filter_rule *rule;
-    struct in_addr ipv4;
-    const char *pstr;
+GTP5G_GEN_GET(gtp5g_get_pdr, struct gtp5g_pdr, GTP5G_PDR_SCHEMA)
+GTP5G_GEN_GET(gtp5g_get_pdi, struct gtp5g_pdi, GTP5G_PDI_SCHEMA)
+GTP5G_GEN_GET(gtp5g_get_f_teid, struct local_f_teid, GTP5G_F_TEID_SCHEMA)
+GTP5G_GEN_GET(gtp5g_get_sdf_filter, struct sdf_filter, GTP5G_SDF_FILTER_SCHEMA)
+GTP5G_GEN_GET(gtp5g_get_flow_description, struct ip_filter_rule, GTP5G_FLOW_DESCRIPTION_SCHEMA)
 
-    mnl_attr_parse(nlh, sizeof(*genl), genl_gtp5g_pdr_validate_cb, pdr_tb);
-    pdr = *(struct gtp5g_pdr **) data = gtp5g_pdr_alloc();
+static int genl_gtp5g_ports(const struct gtp5g_allocator *a, uint32_t **list, int *num,
+                            const struct nlattr *attr)
+{
+    if (!attr) {
+        gtp5g_drop(a, *list);
+        *num = 0;
+        return 0;
+    }
 
-    if (pdr_tb[GTP5G_PDR_ID])
-        gtp5g_pdr_set_id(pdr, mnl_attr_get_u16(pdr_tb[GTP5G_PDR_ID]));
+    *list = gtp5g_list_copy(a, *list, num, sizeof(uint32_t),
+                            mnl_attr_get_payload(attr), mnl_attr_get_payload_len(attr));
+    return *list || !mnl_attr_get_payload_len(attr) ? 0 : -1;
+}
 
-    if (pdr_tb[GTP5G_PDR_PRECEDENCE])
-        gtp5g_pdr_set_precedence(pdr, mnl_attr_get_u32(pdr_tb[GTP5G_PDR_PRECEDENCE]));
+static int genl_gtp5g_flow_description_into(const struct gtp5g_allocator *a, const struct nlattr *attr,
+                                            struct ip_filter_rule *rule)
+{
+    const struct nlattr *rule_tb[GTP5G_FLOW_DESCRIPTION_ATTR_MAX + 1] = {};
 
-    if (pdr_tb[GTP5G_OUTER_HEADER_REMOVAL])
-        gtp5g_pdr_set_outer_header_removal(pdr, mnl_attr_get_u8(pdr_tb[GTP5G_OUTER_HEADER_REMOVAL]));
+    if (gtp5g_attr_parse_nested(attr, &gtp5g_flow_description_policy, rule_tb) < 0)
+        return -1;
 
-    if (pdr_tb[GTP5G_PDR_PDI]) {
-        mnl_attr_parse_nested(pdr_tb[GTP5G_PDR_PDI], genl_gtp5g_pdi_validate_cb, pdi_tb);
+    gtp5g_get_flow_description(a, rule, rule_tb);
 
-        if (pdi_tb[GTP5G_PDI_UE_ADDR_IPV4]) {
-            ipv4.s_addr = mnl_attr_get_u32(pdi_tb[GTP5G_PDI_UE_ADDR_IPV4]);
-            gtp5g_pdr_set_ue_addr_ipv4(pdr, &ipv4);
-        }
+    if (genl_gtp5g_ports(a, &rule->sport_list, &rule->sport_num, rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]) < 0 ||
+        genl_gtp5g_ports(a, &rule->dport_list, &rule->dport_num, rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]) < 0)
+        return -1;
 
-        if (pdi_tb[GTP5G_PDI_F_TEID]) {
-            mnl_attr_parse_nested(pdi_tb[GTP5G_PDI_F_TEID], genl_gtp5g_f_teid_validate_cb, f_teid_tb);
+    return 0;
+}
 
-            ipv4.s_addr = mnl_attr_get_u32(f_teid_tb[GTP5G_F_TEID_GTPU_ADDR_IPV4]);
-            gtp5g_pdr_set_local_f_teid(pdr, mnl_attr_get_u32(f_teid_tb[GTP5G_F_TEID_I_TEID]), &ipv4);
-        }
+static int genl_gtp5g_sdf_filter_into(const struct gtp5g_allocator *a, const struct nlattr *attr,
+                                      struct sdf_filter *sdf)
+{
+    const struct nlattr *sdf_tb[GTP5G_SDF_FILTER_ATTR_MAX + 1] = {};
 
-        if (pdi_tb[GTP5G_PDI_SDF_FILTER]) {
-            mnl_attr_parse_nested(pdi_tb[GTP5G_PDI_SDF_FILTER], genl_gtp5g_sdf_filter_validate_cb, sdf_tb);
+    if (gtp5g_attr_parse_nested(attr, &gtp5g_sdf_filter_policy, sdf_tb) < 0)
+        return -1;
 
-            if (sdf_tb[GTP5G_SDF_FILTER_FLOW_DESCRIPTION]) {
-                mnl_attr_parse_nested(sdf_tb[GTP5G_SDF_FILTER_FLOW_DESCRIPTION],
-                                      genl_gtp5g_flow_description_validate_cb, rule_tb);
+    if (!sdf_tb[GTP5G_SDF_FILTER_FLOW_DESCRIPTION]) {
+        if (sdf->rule)
+            gtp5g_sdf_filter_description_free(a, sdf->rule);
+        sdf->rule = NULL;
+    } else {
+        if (!sdf->rule && !(sdf->rule = gtp5g_calloc(a, 1, sizeof(*sdf->rule))))
+            return -1;
+        if (genl_gtp5g_flow_description_into(a, sdf_tb[GTP5G_SDF_FILTER_FLOW_DESCRIPTION], sdf->rule) < 0)
+            return -1;
+    }
 
-                if (!pdr->pdi->sdf)
-                    pdr->pdi->sdf = calloc(1, sizeof(*pdr->pdi->sdf));
+    return gtp5g_get_sdf_filter(a, sdf, sdf_tb);
+}
 
-                rule = pdr->pdi->sdf->rule;
+/* Into the filter at the link sdf, allocated when missing, returning the
+ * link to the next one */
+static struct sdf_filter **genl_gtp5g_sdf_filter_at(const struct gtp5g_allocator *a,
+                                                   const struct nlattr *attr,
+                                                   struct sdf_filter **sdf)
+{
+    if (!*sdf && !(*sdf = gtp5g_calloc(a, 1, sizeof(**sdf))))
+        return NULL;
+    if (genl_gtp5g_sdf_filter_into(a, attr, *sdf) < 0)
+        return NULL;
+    return &(*sdf)->next;
+}
 
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_ACTION])
-                    rule->action = mnl_attr_get_u8(rule_tb[GTP5G_FLOW_DESCRIPTION_ACTION]);
+/* Into the filters of pdi in order, from GTP5G_PDI_SDF_FILTER_LIST or the
+ * single GTP5G_PDI_SDF_FILTER, reusing those it has and dropping the rest */
+static int genl_gtp5g_sdf_filters_into(const struct gtp5g_allocator *a, const struct nlattr **pdi_tb,
+                                       struct gtp5g_pdi *pdi)
+{
+    struct sdf_filter **sdf = &pdi->sdf, *next;
+    const struct nlattr *attr;
+
+    if (pdi_tb[GTP5G_PDI_SDF_FILTER_LIST]) {
+        mnl_attr_for_each_nested(attr, pdi_tb[GTP5G_PDI_SDF_FILTER_LIST]) {
+            if (mnl_attr_get_type(attr) != GTP5G_PDI_SDF_FILTER)
+                continue;
+            if (!(sdf = genl_gtp5g_sdf_filter_at(a, attr, sdf)))
+                return -1;
+        }
+    } else if (pdi_tb[GTP5G_PDI_SDF_FILTER]) {
+        if (!(sdf = genl_gtp5g_sdf_filter_at(a, pdi_tb[GTP5G_PDI_SDF_FILTER], sdf)))
+            return -1;
+    }
 
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_DIRECTION])
-                    rule->direction = mnl_attr_get_u8(rule_tb[GTP5G_FLOW_DESCRIPTION_DIRECTION]);
+    while (*sdf) {
+        next = (*sdf)->next;
+        gtp5g_sdf_filter_free(a, *sdf);
+        *sdf = next;
+    }
+    return 0;
+}
 
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_PROTOCOL])
-                    rule->proto = mnl_attr_get_u8(rule_tb[GTP5G_FLOW_DESCRIPTION_PROTOCOL]);
+static int genl_gtp5g_pdi_into(const struct nlattr *attr, struct gtp5g_pdr *pdr)
+{
+    const struct nlattr *pdi_tb[GTP5G_PDI_ATTR_MAX + 1] = {};
+    const struct nlattr *f_teid_tb[GTP5G_F_TEID_ATTR_MAX + 1] = {};
+    const struct gtp5g_allocator *a = pdr->alloc;
+    struct gtp5g_pdi *pdi;
 
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_IPV4])
-                    rule->src.s_addr = mnl_attr_get_u32(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_IPV4]);
+    if (gtp5g_attr_parse_nested(attr, &gtp5g_pdi_policy, pdi_tb) < 0)
+        return -1;
 
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_MASK])
-                    rule->smask.s_addr = mnl_attr_get_u32(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_MASK]);
+    if (!pdr->pdi && !(pdr->pdi = gtp5g_calloc(a, 1, sizeof(*pdr->pdi))))
+        return -1;
+    pdi = pdr->pdi;
 
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]) {
-                    rule->sport_num = mnl_attr_get_payload_len(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]) / (sizeof(uint32_t) / sizeof(char));
-                    rule->sport_list = calloc(1, mnl_attr_get_payload_len(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]));
-                    memcpy(rule->sport_list, mnl_attr_get_payload(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]), mnl_attr_get_payload_len(rule_tb[GTP5G_FLOW_DESCRIPTION_SRC_PORT]));
-                }
+    if (gtp5g_get_pdi(a, pdi, pdi_tb) < 0)
+        return -1;
 
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_IPV4])
-                    rule->dest.s_addr = mnl_attr_get_u32(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_IPV4]);
+    if (pdi_tb[GTP5G_PDI_F_TEID]) {
+        if (gtp5g_attr_parse_nested(pdi_tb[GTP5G_PDI_F_TEID], &gtp5g_f_teid_policy, f_teid_tb) < 0)
+            return -1;
 
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_MASK])
-                    rule->dest.s_addr = mnl_attr_get_u32(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_MASK]);
+        if (!pdi->f_teid && !(pdi->f_teid = gtp5g_calloc(a, 1, sizeof(*pdi->f_teid))))
+            return -1;
+        gtp5g_get_f_teid(a, pdi->f_teid, f_teid_tb);
+    } else
+        gtp5g_drop(a, pdi->f_teid);
 
-                if (rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]) {
-                    rule->dport_num = mnl_attr_get_payload_len(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]) / (sizeof(uint32_t) / sizeof(char));
-                    rule->dport_list = calloc(1, mnl_attr_get_payload_len(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]));
-                    memcpy(rule->dport_list, mnl_attr_get_payload(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]), mnl_attr_get_payload_len(rule_tb[GTP5G_FLOW_DESCRIPTION_DEST_PORT]));
-                }
-            }
+    return genl_gtp5g_sdf_filters_into(a, pdi_tb, pdi);
+}
 
-            if (sdf_tb[GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS])
-                gtp5g_pdr_set_tos_traffic_class(pdr, mnl_attr_get_u16(sdf_tb[GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS]));
+int genl_gtp5g_pdr_attr_into_cb(const struct nlmsghdr *nlh, void *data)
+{
+    const struct nlattr *pdr_tb[GTP5G_PDR_ATTR_MAX + 1] = {};
+    struct gtp5g_pdr *pdr = data;
+    const struct nlattr *path;
 
-            if (sdf_tb[GTP5G_SDF_FILTER_SECURITY_PARAMETER_INDEX])
-                gtp5g_pdr_set_security_param_idx(pdr, mnl_attr_get_u32(sdf_tb[GTP5G_SDF_FILTER_SECURITY_PARAMETER_INDEX]));
+    if (gtp5g_attr_parse(nlh, &gtp5g_pdr_policy, pdr_tb) < 0)
+        return MNL_CB_ERROR;
 
-            if (sdf_tb[GTP5G_SDF_FILTER_FLOW_LABEL])
-                gtp5g_pdr_set_flow_label(pdr, mnl_attr_get_u32(sdf_tb[GTP5G_SDF_FILTER_FLOW_LABEL]));
+    if (gtp5g_get_pdr(pdr->alloc, pdr, pdr_tb) < 0)
+        goto err;
 
-            if (sdf_tb[GTP5G_SDF_FILTER_SDF_FILTER_ID])
-                gtp5g_pdr_set_sdf_filter_id(pdr, mnl_attr_get_u32(sdf_tb[GTP5G_SDF_FILTER_SDF_FILTER_ID]));
-        }
+    if (pdr_tb[GTP5G_PDR_PDI]) {
+        if (genl_gtp5g_pdi_into(pdr_tb[GTP5G_PDR_PDI], pdr) < 0)
+            goto err;
+    } else if (pdr->pdi) {
+        gtp5g_pdi_free(pdr->alloc, pdr->pdi);
+        pdr->pdi = NULL;
     }
 
-	if (pdr_tb[GTP5G_PDR_FAR_ID])
-		gtp5g_pdr_set_far_id(pdr, mnl_attr_get_u32(pdr_tb[GTP5G_PDR_FAR_ID]));
+    /* Not in 3GPP spec, just used for buffering, sun_path sized. Only
+     * taken NUL terminated within the attribute, as the kernel puts it */
+    path = pdr_tb[GTP5G_PDR_UNIX_SOCKET_PATH];
+    if (path && mnl_attr_validate(path, MNL_TYPE_NUL_STRING) == 0 &&
+        mnl_attr_get_payload_len(path) <= 108)
+        gtp5g_pdr_set_unix_sock_path(pdr, mnl_attr_get_str(path));
+    else
+        gtp5g_drop(pdr->alloc, pdr->unix_sock_path);
 
-	if (pdr_tb[GTP5G_PDR_QER_ID])
-		gtp5g_pdr_set_qer_id(pdr, mnl_attr_get_u32(pdr_tb[GTP5G_PDR_QER_ID]));
+    return MNL_CB_OK;
+err:
+    /* Keep the cause if a parser has already recorded one */
+    if (!gtp5g_get_err()->err)
+        gtp5g_err_set(ENOMEM, 0, "PDR reply");
+    return MNL_CB_ERROR;
+}
 
-    /* Not in 3GPP spec, just used for routing */
-    if (pdr_tb[GTP5G_PDR_ROLE_ADDR_IPV4]) {
-        ipv4.s_addr = mnl_attr_get_u32(pdr_tb[GTP5G_PDR_ROLE_ADDR_IPV4]);
-        gtp5g_pdr_set_role_addr_ipv4(pdr, &ipv4);
-    }
+int genl_gtp5g_pdr_attr_cb(const struct nlmsghdr *nlh, void *data)
+{
+    struct gtp5g_pdr **pdr = data;
 
-    /* Not in 3GPP spec, just used for buffering */
-    if (pdr_tb[GTP5G_PDR_UNIX_SOCKET_PATH]) {
-        pstr = mnl_attr_get_str(pdr_tb[GTP5G_PDR_UNIX_SOCKET_PATH]);
-        gtp5g_pdr_set_unix_sock_path(pdr, pstr);
+    *pdr = gtp5g_pdr_alloc();
+    if (!*pdr) {
+        gtp5g_err_set(ENOMEM, 0, "PDR reply");
+        return MNL_CB_ERROR;
     }
 
+    if (genl_gtp5g_pdr_attr_into_cb(nlh, *pdr) != MNL_CB_OK) {
+        gtp5g_pdr_free(*pdr);
+        *pdr = NULL;
+        return MNL_CB_ERROR;
+    }
     return MNL_CB_OK;
 }
 
+void genl_gtp5g_pdr_view_parse(const struct nlmsghdr *nlh, struct gtp5g_pdr_view *v)
+{
+    const struct nlattr *sdf;
+
+    memset(v, 0, sizeof(*v));
+
+    gtp5g_attr_parse_view(nlh, &gtp5g_pdr_policy, v->pdr);
+    if (v->pdr[GTP5G_PDR_PDI])
+        gtp5g_attr_parse_nested_view(v->pdr[GTP5G_PDR_PDI], &gtp5g_pdi_policy, v->pdi);
+    if (v->pdi[GTP5G_PDI_F_TEID])
+        gtp5g_attr_parse_nested_view(v->pdi[GTP5G_PDI_F_TEID], &gtp5g_f_teid_policy, v->f_teid);
+    /* A view holds one filter, the first of a list */
+    if (!v->pdi[GTP5G_PDI_SDF_FILTER] && v->pdi[GTP5G_PDI_SDF_FILTER_LIST]) {
+        mnl_attr_for_each_nested(sdf, v->pdi[GTP5G_PDI_SDF_FILTER_LIST]) {
+            if (mnl_attr_get_type(sdf) == GTP5G_PDI_SDF_FILTER) {
+                v->pdi[GTP5G_PDI_SDF_FILTER] = sdf;
+                break;
+            }
+        }
+    }
+    if (v->pdi[GTP5G_PDI_SDF_FILTER])
+        genl_gtp5g_pdr_view_sdf(v, v->pdi[GTP5G_PDI_SDF_FILTER]);
+}
+
+void genl_gtp5g_pdr_view_sdf(struct gtp5g_pdr_view *v, const struct nlattr *sdf)
+{
+    memset(v->sdf, 0, sizeof(v->sdf));
+    memset(v->rule, 0, sizeof(v->rule));
+
+    gtp5g_attr_parse_nested_view(sdf, &gtp5g_sdf_filter_policy, v->sdf);
+    if (v->sdf[GTP5G_SDF_FILTER_FLOW_DESCRIPTION])
+        gtp5g_attr_parse_nested_view(v->sdf[GTP5G_SDF_FILTER_FLOW_DESCRIPTION],
+                                     &gtp5g_flow_description_policy, v->rule);
+}
+
 struct gtp5g_pdr *gtp5g_pdr_find_by_id(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_pdr *pdr)
 {
     char buf[MNL_SOCKET_BUFFER_SIZE];
@@ -885,19 +798,41 @@ struct gtp5g_pdr *gtp5g_pdr_find_by_id(int genl_id, struct mnl_socket *nl, struc
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_GET_PDR, pdr->id, "5G GTP device is NULL");
         return NULL;
     }
 
     nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_ACK, ++seq,
                                GTP5G_CMD_GET_PDR);
-    gtp5g_build_pdr_payload(nlh, dev, pdr);
+    if (gtp5g_build_pdr_payload(nlh, sizeof(buf), dev, pdr) < 0)
+        return NULL;
 
-    if (genl_socket_talk(nl, nlh, seq, genl_gtp5g_attr_cb, &rt_pdr) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, genl_gtp5g_pdr_attr_cb, &rt_pdr, pdr->id) < 0)
         return NULL;
-    }
 
     return rt_pdr;
 }
 EXPORT_SYMBOL(gtp5g_pdr_find_by_id);
+
+int gtp5g_pdr_find_by_id_into(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev,
+                              struct gtp5g_pdr *pdr, struct gtp5g_pdr *out)
+{
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    struct nlmsghdr *nlh;
+    uint32_t seq = time(NULL);
+    uint16_t id = pdr->id;
+
+    if (!dev || !out) {
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_GET_PDR, id, dev ? "PDR is NULL" : "5G GTP device is NULL");
+        return -1;
+    }
+
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_ACK, ++seq,
+                               GTP5G_CMD_GET_PDR);
+    if (gtp5g_build_pdr_payload(nlh, sizeof(buf), dev, pdr) < 0)
+        return -1;
+
+    /* The request is built, so out may be pdr */
+    return gtp5g_socket_talk(nl, nlh, seq, genl_gtp5g_pdr_attr_into_cb, out, id) < 0 ? -1 : 0;
+}
+EXPORT_SYMBOL(gtp5g_pdr_find_by_id_into);
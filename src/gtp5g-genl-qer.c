@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
@@ -46,44 +47,61 @@
 #include "internal.h"
 #include "tools.h"
 
-static void gtp5g_build_qer_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
+GTP5G_GEN_PUT(gtp5g_put_qer, struct gtp5g_qer, GTP5G_QER_SCHEMA)
+GTP5G_GEN_PUT(gtp5g_put_mbr, struct gtp5g_qer, GTP5G_QER_MBR_SCHEMA)
+GTP5G_GEN_PUT(gtp5g_put_gbr, struct gtp5g_qer, GTP5G_QER_GBR_SCHEMA)
+GTP5G_GEN_SIZE(gtp5g_size_qer, struct gtp5g_qer, GTP5G_QER_SCHEMA)
+GTP5G_GEN_SIZE(gtp5g_size_mbr, struct gtp5g_qer, GTP5G_QER_MBR_SCHEMA)
+GTP5G_GEN_SIZE(gtp5g_size_gbr, struct gtp5g_qer, GTP5G_QER_GBR_SCHEMA)
+
+/* What gtp5g_put_qer_payload() puts, to the byte */
+static size_t gtp5g_qer_payload_size(const struct gtp5g_dev *dev, const struct gtp5g_qer *qer)
+{
+    return GTP5G_DEV_SIZE(dev) + gtp5g_size_qer(qer) +
+           GTP5G_ATTR_SIZE(gtp5g_size_mbr(qer)) + GTP5G_ATTR_SIZE(gtp5g_size_gbr(qer));
+}
+
+static void gtp5g_put_qer_payload(struct nlmsghdr *nlh, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
 {
 	struct nlattr *mbr_nest;
 	struct nlattr *gbr_nest;
 
     // Let kernel get dev easily
     if (dev->ifns >= 0)
-        mnl_attr_put_u32(nlh, GTP5G_NET_NS_FD, dev->ifns);
+        GTP5G_PUT(nlh, GTP5G_NET_NS_FD, dev->ifns);
 
 	// Level 0 GTP5G
-    mnl_attr_put_u32(nlh, GTP5G_LINK, dev->ifidx);
+    GTP5G_PUT(nlh, GTP5G_LINK, dev->ifidx);
 
     // Level 1 QER
-    mnl_attr_put_u32(nlh, GTP5G_QER_ID, qer->id);
-    mnl_attr_put_u8(nlh, GTP5G_QER_GATE, qer->ul_dl_gate);
+    gtp5g_put_qer(nlh, qer);
 	
 	//Level 2 MBR 
 	mbr_nest = mnl_attr_nest_start(nlh, GTP5G_QER_MBR);
-	mnl_attr_put_u32(nlh, GTP5G_QER_MBR_UL_HIGH32,  qer->mbr.ul_high);
-	mnl_attr_put_u8(nlh, GTP5G_QER_MBR_UL_LOW8, qer->mbr.ul_low);
-	mnl_attr_put_u32(nlh, GTP5G_QER_MBR_DL_HIGH32,  qer->mbr.dl_high);
-	mnl_attr_put_u8(nlh, GTP5G_QER_MBR_DL_LOW8, qer->mbr.dl_low);
+	gtp5g_put_mbr(nlh, qer);
 	mnl_attr_nest_end(nlh, mbr_nest);
 
 	//Level 2 GBR 
 	gbr_nest = mnl_attr_nest_start(nlh, GTP5G_QER_GBR);
-	mnl_attr_put_u32(nlh, GTP5G_QER_GBR_UL_HIGH32,  qer->gbr.ul_high);
-	mnl_attr_put_u8(nlh, GTP5G_QER_GBR_UL_LOW8, qer->gbr.ul_low);
-	mnl_attr_put_u32(nlh, GTP5G_QER_GBR_DL_HIGH32,  qer->gbr.dl_high);
-	mnl_attr_put_u8(nlh, GTP5G_QER_GBR_DL_LOW8, qer->gbr.dl_low);
+	gtp5g_put_gbr(nlh, qer);
 	mnl_attr_nest_end(nlh, gbr_nest);
+}
 
-    mnl_attr_put_u32(nlh, GTP5G_QER_CORR_ID, qer->qer_corr_id);
-    mnl_attr_put_u8(nlh, GTP5G_QER_RQI, qer->rqi);
-    mnl_attr_put_u8(nlh, GTP5G_QER_QFI, qer->qfi);
-    mnl_attr_put_u8(nlh, GTP5G_QER_PPI, qer->ppi);
-    mnl_attr_put_u8(nlh, GTP5G_QER_RCSR, qer->rcsr);
+int gtp5g_build_qer_payload(struct nlmsghdr *nlh, size_t size, struct gtp5g_dev *dev,
+                            struct gtp5g_qer *qer)
+{
+    if (gtp5g_msg_fits(nlh, size, gtp5g_qer_payload_size(dev, qer), qer->id) < 0)
+        return -1;
+
+    gtp5g_put_qer_payload(nlh, dev, qer);
+    return 0;
+}
+
+size_t gtp5g_qer_msg_size(struct gtp5g_dev *dev, struct gtp5g_qer *qer)
+{
+    return GTP5G_MSG_HDR_SIZE + gtp5g_qer_payload_size(dev, qer);
 }
+EXPORT_SYMBOL(gtp5g_qer_msg_size);
 
 int gtp5g_add_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
 {
@@ -92,7 +110,7 @@ int gtp5g_add_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_ADD_QER, qer->id, "5G GTP device is NULL");
         return -1;
     }
 
@@ -102,16 +120,15 @@ int gtp5g_add_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 								++seq,
                                	GTP5G_CMD_ADD_QER);
 	if (!nlh) {
-        fprintf(stderr, "%s Netlink Msg header is NULL\n", __func__);
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_ADD_QER, qer->id, "Netlink Msg header is NULL");
         return -1;
 	}
 
-    gtp5g_build_qer_payload(nlh, dev, qer);
+    if (gtp5g_build_qer_payload(nlh, sizeof(buf), dev, qer) < 0)
+        return -1;
 
-    if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, NULL, NULL, qer->id) < 0)
         return -1;
-    }
 
     return 0;
 }
@@ -124,7 +141,7 @@ int gtp5g_mod_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_ADD_QER, qer->id, "5G GTP device is NULL");
         return -1;
     }
 
@@ -134,12 +151,11 @@ int gtp5g_mod_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 								++seq,
                                	GTP5G_CMD_ADD_QER);
 
-    gtp5g_build_qer_payload(nlh, dev, qer);
+    if (gtp5g_build_qer_payload(nlh, sizeof(buf), dev, qer) < 0)
+        return -1;
 
-    if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, NULL, NULL, qer->id) < 0)
         return -1;
-    }
 
     return 0;
 }
@@ -153,7 +169,7 @@ int gtp5g_del_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_DEL_QER, qer->id, "5G GTP device is NULL");
         return -1;
     }
 
@@ -163,290 +179,210 @@ int gtp5g_del_qer(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, str
 								++seq,
                                	GTP5G_CMD_DEL_QER);
 
-    gtp5g_build_qer_payload(nlh, dev, qer);
+    if (gtp5g_build_qer_payload(nlh, sizeof(buf), dev, qer) < 0)
+        return -1;
 
-    if (genl_socket_talk(nl, nlh, seq, NULL, NULL) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, NULL, NULL, qer->id) < 0)
         return -1;
-    }
 
     return 0;
 }
 EXPORT_SYMBOL(gtp5g_del_qer);
 
-static int genl_gtp5g_qer_validate_cb(const struct nlattr *attr, void *data)
+static int gtp5g_batch_qer(struct gtp5g_batch *b, uint16_t flags, uint8_t cmd,
+                           struct gtp5g_dev *dev, struct gtp5g_qer *qer)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
-
-    if (mnl_attr_type_valid(attr, GTP5G_QER_ATTR_MAX) < 0)
-        return MNL_CB_OK;
+    struct nlmsghdr *nlh;
 
-    switch (type) {
-    case GTP5G_QER_ID:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_GATE:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_MBR:
-    	if (mnl_attr_validate(attr, MNL_TYPE_NESTED) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_GBR:
-    	if (mnl_attr_validate(attr, MNL_TYPE_NESTED) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_CORR_ID:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_RQI:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_QFI:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_PPI:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_RCSR:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_RELATED_TO_PDR:
-		break;
-    default:
-		printf("%s: Unknown type type(%#x)\n", __func__, type);
-        break;
+    if (!dev) {
+        gtp5g_err_fail(EINVAL, cmd, qer->id, "5G GTP device is NULL");
+        return -1;
     }
 
-    tb[type] = attr;
-    return MNL_CB_OK;
+    /* Only the room the request takes, which it fills to the byte */
+    nlh = gtp5g_batch_put_size(b, flags, cmd, qer->id, gtp5g_qer_msg_size(dev, qer));
+    if (!nlh)
+        return -1;
 
-VALIDATE_FAIL:
-    perror("QER mnl_attr_validate");
-    return MNL_CB_ERROR;
+    gtp5g_put_qer_payload(nlh, dev, qer);
+    gtp5g_batch_commit(b, nlh);
+
+    return 0;
 }
 
-static int genl_gtp5g_mbr_validate_cb(const struct nlattr *attr, void *data)
+int gtp5g_batch_add_qer(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
-
-	if (mnl_attr_type_valid(attr, GTP5G_QER_MBR_ATTR_MAX) < 0)
-        return MNL_CB_OK;
-
- 	switch (type) {
-    case GTP5G_QER_MBR_UL_HIGH32:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_MBR_UL_LOW8:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_MBR_DL_HIGH32:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_MBR_DL_LOW8:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    default:
-        break;
-    }
-
-    tb[type] = attr;
-    return MNL_CB_OK;
-
-VALIDATE_FAIL:
-    perror("QER mnl_attr_validate");
-    return MNL_CB_ERROR;
+    return gtp5g_batch_qer(b, NLM_F_EXCL, GTP5G_CMD_ADD_QER, dev, qer);
 }
+EXPORT_SYMBOL(gtp5g_batch_add_qer);
 
-static int genl_gtp5g_gbr_validate_cb(const struct nlattr *attr, void *data)
+int gtp5g_batch_mod_qer(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
 {
-    const struct nlattr **tb = data;
-    int type = mnl_attr_get_type(attr);
-
-	if (mnl_attr_type_valid(attr, GTP5G_QER_GBR_ATTR_MAX) < 0)
-        return MNL_CB_OK;
-
- 	switch (type) {
-    case GTP5G_QER_GBR_UL_HIGH32:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_GBR_UL_LOW8:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_GBR_DL_HIGH32:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    case GTP5G_QER_GBR_DL_LOW8:
-    	if (mnl_attr_validate(attr, MNL_TYPE_U8) < 0)
-        	goto VALIDATE_FAIL;
-        break;
-    default:
-        break;
-    }
-
-    tb[type] = attr;
-    return MNL_CB_OK;
-
-VALIDATE_FAIL:
-    perror("QER mnl_attr_validate");
-    return MNL_CB_ERROR;
+    return gtp5g_batch_qer(b, NLM_F_REPLACE, GTP5G_CMD_ADD_QER, dev, qer);
 }
+EXPORT_SYMBOL(gtp5g_batch_mod_qer);
 
-static int genl_gtp5g_qer_attr_list_cb(const struct nlmsghdr *nlh, void *data)
+int gtp5g_batch_del_qer(struct gtp5g_batch *b, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
 {
-    struct nlattr *qer_tb[GTP5G_QER_ATTR_MAX + 1] = {};
-    struct nlattr *mbr_tb[GTP5G_QER_MBR_ATTR_MAX + 1] = {};
-    struct nlattr *gbr_tb[GTP5G_QER_GBR_ATTR_MAX + 1] = {};
-    struct genlmsghdr *genl;
-
-    mnl_attr_parse(nlh, 
-					sizeof(*genl), 
-					genl_gtp5g_qer_validate_cb, 
-					qer_tb);
-
-    if (qer_tb[GTP5G_QER_ID])
-        printf("[QER ID: %u]\n", mnl_attr_get_u32(qer_tb[GTP5G_QER_ID]));
-
-    if (qer_tb[GTP5G_QER_GATE])
-        printf("\t Gate Status: %u\n", mnl_attr_get_u8(qer_tb[GTP5G_QER_GATE]));
-
-    if (qer_tb[GTP5G_QER_MBR]) {
-        mnl_attr_parse_nested(qer_tb[GTP5G_QER_MBR], 
-				genl_gtp5g_mbr_validate_cb, 
-				mbr_tb);
-        printf("\t MBR Parameter Info\n");
-
-		if (mbr_tb[GTP5G_QER_MBR_UL_HIGH32])
-			printf("\t\t UL High: %u\n", mnl_attr_get_u32(mbr_tb[GTP5G_QER_MBR_UL_HIGH32]));
-
-		if (mbr_tb[GTP5G_QER_MBR_UL_LOW8])
-			printf("\t\t UL Low: %u\n", mnl_attr_get_u8(mbr_tb[GTP5G_QER_MBR_UL_LOW8]));
-
-		if (mbr_tb[GTP5G_QER_MBR_DL_HIGH32])
-			printf("\t\t DL High: %u\n", mnl_attr_get_u32(mbr_tb[GTP5G_QER_MBR_DL_HIGH32]));
-
-		if (mbr_tb[GTP5G_QER_MBR_DL_LOW8])
-			printf("\t\t DL Low: %u\n", mnl_attr_get_u8(mbr_tb[GTP5G_QER_MBR_DL_LOW8]));
-	}
-
-    if (qer_tb[GTP5G_QER_GBR]) {
-        mnl_attr_parse_nested(qer_tb[GTP5G_QER_GBR], 
-				genl_gtp5g_gbr_validate_cb, 
-				gbr_tb);
-        printf("\t GBR Parameter Info\n");
+    return gtp5g_batch_qer(b, 0, GTP5G_CMD_DEL_QER, dev, qer);
+}
+EXPORT_SYMBOL(gtp5g_batch_del_qer);
 
-		if (gbr_tb[GTP5G_QER_GBR_UL_HIGH32])
-			printf("\t\t UL High: %u\n", mnl_attr_get_u32(gbr_tb[GTP5G_QER_GBR_UL_HIGH32]));
+GTP5G_POLICY(gtp5g_qer_policy, "QER", GTP5G_QER_ATTR_MAX,
+             GTP5G_DEVICE_SCHEMA(GTP5G_POLICY_ATTR) GTP5G_QER_SCHEMA(GTP5G_POLICY_ATTR));
+GTP5G_POLICY(gtp5g_mbr_policy, "MBR", GTP5G_QER_MBR_ATTR_MAX,
+             GTP5G_QER_MBR_SCHEMA(GTP5G_POLICY_ATTR));
+GTP5G_POLICY(gtp5g_gbr_policy, "GBR", GTP5G_QER_GBR_ATTR_MAX,
+             GTP5G_QER_GBR_SCHEMA(GTP5G_POLICY_ATTR));
 
-		if (gbr_tb[GTP5G_QER_GBR_UL_LOW8])
-			printf("\t\t UL Low: %u\n", mnl_attr_get_u8(gbr_tb[GTP5G_QER_GBR_UL_LOW8]));
+GTP5G_GEN_TEXT(gtp5g_text_qer_attr, GTP5G_QER_SCHEMA)
+GTP5G_GEN_TEXT(gtp5g_text_mbr_attr, GTP5G_QER_MBR_SCHEMA)
+GTP5G_GEN_TEXT(gtp5g_text_gbr_attr, GTP5G_QER_GBR_SCHEMA)
 
-		if (gbr_tb[GTP5G_QER_GBR_DL_HIGH32])
-			printf("\t\t DL High: %u\n", mnl_attr_get_u32(gbr_tb[GTP5G_QER_GBR_DL_HIGH32]));
+/* MBR, GBR and the related PDRs, at their place in the text form */
+static void gtp5g_text_qer_nest(struct gtp5g_out *o, uint16_t type, const struct nlattr *attr)
+{
+    const struct nlattr *mbr_tb[GTP5G_QER_MBR_ATTR_MAX + 1] = {};
+    const struct nlattr *gbr_tb[GTP5G_QER_GBR_ATTR_MAX + 1] = {};
 
-		if (gbr_tb[GTP5G_QER_GBR_DL_LOW8])
-			printf("\t\t DL Low: %u\n", mnl_attr_get_u8(gbr_tb[GTP5G_QER_GBR_DL_LOW8]));
-	}
+    switch (type) {
+        case GTP5G_QER_MBR:
+            if (gtp5g_attr_parse_nested(attr, &gtp5g_mbr_policy, mbr_tb) < 0) {
+                o->err = ERANGE;
+                break;
+            }
+            gtp5g_out_str(o, "\t MBR Parameter Info\n");
+            gtp5g_text_mbr_attr(o, mbr_tb, NULL);
+            break;
+        case GTP5G_QER_GBR:
+            if (gtp5g_attr_parse_nested(attr, &gtp5g_gbr_policy, gbr_tb) < 0) {
+                o->err = ERANGE;
+                break;
+            }
+            gtp5g_out_str(o, "\t GBR Parameter Info\n");
+            gtp5g_text_gbr_attr(o, gbr_tb, NULL);
+            break;
+        case GTP5G_QER_RELATED_TO_PDR:
+            gtp5g_out_str(o, "\t Related PDR ID: ");
+            gtp5g_out_ids(o, mnl_attr_get_payload(attr),
+                          mnl_attr_get_payload_len(attr) / sizeof(uint16_t), ", ");
+            gtp5g_out_str(o, " (Not a real IE)\n");
+            break;
+    }
+}
 
-    if (qer_tb[GTP5G_QER_CORR_ID])
-        printf("\t Correlation ID: %u\n", mnl_attr_get_u32(qer_tb[GTP5G_QER_CORR_ID]));
+int genl_gtp5g_qer_attr_list_cb(const struct nlmsghdr *nlh, void *data)
+{
+    const struct nlattr *qer_tb[GTP5G_QER_ATTR_MAX + 1] = {};
+    struct gtp5g_out *o = data;
 
-    if (qer_tb[GTP5G_QER_RQI])
-        printf("\t RQI: %u\n", mnl_attr_get_u8(qer_tb[GTP5G_QER_RQI]));
+    if (gtp5g_attr_parse(nlh, &gtp5g_qer_policy, qer_tb) < 0)
+        return MNL_CB_ERROR;
 
-    if (qer_tb[GTP5G_QER_QFI])
-        printf("\t QFI: %u\n", mnl_attr_get_u8(qer_tb[GTP5G_QER_QFI]));
+    if (qer_tb[GTP5G_QER_ID]) {
+        gtp5g_out_str(o, "[QER ID: ");
+        gtp5g_out_u32(o, mnl_attr_get_u32(qer_tb[GTP5G_QER_ID]));
+        gtp5g_out_str(o, "]\n");
+    }
+    gtp5g_text_qer_attr(o, qer_tb, gtp5g_text_qer_nest);
 
-    if (qer_tb[GTP5G_QER_PPI])
-        printf("\t PPI: %u\n", mnl_attr_get_u8(qer_tb[GTP5G_QER_PPI]));
+    return o->err ? MNL_CB_ERROR : MNL_CB_OK;
+}
 
-    if (qer_tb[GTP5G_QER_RCSR])
-        printf("\t RCSR: %u\n", mnl_attr_get_u8(qer_tb[GTP5G_QER_RCSR]));
+int gtp5g_list_qer(int genl_id, struct mnl_socket *nl)
+{
+    return gtp5g_list_qer_to(genl_id, nl, &gtp5g_sink_stdout, GTP5G_FORMAT_TEXT);
+}
+EXPORT_SYMBOL(gtp5g_list_qer);
 
-    if (qer_tb[GTP5G_QER_RELATED_TO_PDR]) {
-        printf("\t Related PDR ID: ");
-        u16_id_list_from_kernel_space_print(mnl_attr_get_payload(qer_tb[GTP5G_QER_RELATED_TO_PDR]),
-            mnl_attr_get_payload_len(qer_tb[GTP5G_QER_RELATED_TO_PDR]) / (sizeof(uint16_t) / sizeof(char)));
-        printf(" (Not a real IE)\n");
+void gtp5g_text_qer(struct gtp5g_out *o, struct gtp5g_qer *qer)
+{
+    gtp5g_out_str(o, "[QER No.");
+    gtp5g_out_u32(o, qer->id);
+    gtp5g_out_str(o, " Info]\n");
+    if (qer->related_pdr_num && qer->related_pdr_list) {
+        gtp5g_out_str(o, "\t Related PDR ID: ");
+        gtp5g_out_ids(o, qer->related_pdr_list, qer->related_pdr_num, ", ");
+        gtp5g_out_str(o, " (Not a real IE)\n");
     }
-
-    return MNL_CB_OK;
 }
 
-int gtp5g_list_qer(int genl_id, struct mnl_socket *nl)
+void gtp5g_print_qer(struct gtp5g_qer *qer)
 {
-    char buf[MNL_SOCKET_BUFFER_SIZE];
-    struct nlmsghdr *nlh;
-    uint32_t seq = time(NULL);
+    gtp5g_print_qer_to(qer, &gtp5g_sink_stdout, GTP5G_FORMAT_TEXT);
+}
+EXPORT_SYMBOL(gtp5g_print_qer);
 
-    nlh = genl_nlmsg_build_hdr(buf, 
-								genl_id, 
-								NLM_F_DUMP, 
-								0,
-                               	GTP5G_CMD_GET_QER);
+GTP5G_GEN_GET(gtp5g_get_qer, struct gtp5g_qer, GTP5G_QER_SCHEMA)
+GTP5G_GEN_GET(gtp5g_get_mbr, struct gtp5g_qer, GTP5G_QER_MBR_SCHEMA)
+GTP5G_GEN_GET(gtp5g_get_gbr, struct gtp5g_qer, GTP5G_QER_GBR_SCHEMA)
 
-    if (genl_socket_talk(nl, nlh, seq, genl_gtp5g_qer_attr_list_cb, NULL) < 0) {
-        perror("genl_socket_talk");
-        return -1;
+int genl_gtp5g_qer_attr_into_cb(const struct nlmsghdr *nlh, void *data)
+{
+    const struct nlattr *qer_tb[GTP5G_QER_ATTR_MAX + 1] = {};
+    const struct nlattr *mbr_tb[GTP5G_QER_MBR_ATTR_MAX + 1] = {};
+    const struct nlattr *gbr_tb[GTP5G_QER_GBR_ATTR_MAX + 1] = {};
+    struct gtp5g_qer *qer = data;
+    const struct nlattr *attr;
+
+    if (gtp5g_attr_parse(nlh, &gtp5g_qer_policy, qer_tb) < 0)
+        return MNL_CB_ERROR;
+    if (qer_tb[GTP5G_QER_MBR] &&
+        gtp5g_attr_parse_nested(qer_tb[GTP5G_QER_MBR], &gtp5g_mbr_policy, mbr_tb) < 0)
+        return MNL_CB_ERROR;
+    if (qer_tb[GTP5G_QER_GBR] &&
+        gtp5g_attr_parse_nested(qer_tb[GTP5G_QER_GBR], &gtp5g_gbr_policy, gbr_tb) < 0)
+        return MNL_CB_ERROR;
+
+    /* Nothing but the list is behind a pointer, an absent MBR or GBR
+     * leaves its table empty and zeroes the fields */
+    gtp5g_get_qer(qer->alloc, qer, qer_tb);
+    gtp5g_get_mbr(qer->alloc, qer, mbr_tb);
+    gtp5g_get_gbr(qer->alloc, qer, gbr_tb);
+
+    attr = qer_tb[GTP5G_QER_RELATED_TO_PDR];
+    if (attr) {
+        qer->related_pdr_list = gtp5g_list_copy(qer->alloc, qer->related_pdr_list, &qer->related_pdr_num, sizeof(uint16_t),
+                                                mnl_attr_get_payload(attr), mnl_attr_get_payload_len(attr));
+        if (!qer->related_pdr_list && mnl_attr_get_payload_len(attr)) {
+            gtp5g_err_set(ENOMEM, 0, "QER reply");
+            return MNL_CB_ERROR;
+        }
+    } else {
+        gtp5g_drop(qer->alloc, qer->related_pdr_list);
+        qer->related_pdr_num = 0;
     }
 
-    return 0;
+    return MNL_CB_OK;
 }
-EXPORT_SYMBOL(gtp5g_list_qer);
 
-void gtp5g_print_qer(struct gtp5g_qer *qer)
+int genl_gtp5g_qer_attr_cb(const struct nlmsghdr *nlh, void *data)
 {
-    if (!qer) {
-        perror("QER is NULL");
-        return;
+    struct gtp5g_qer **qer = data;
+
+    *qer = gtp5g_qer_alloc();
+    if (!*qer) {
+        gtp5g_err_set(ENOMEM, 0, "QER reply");
+        return MNL_CB_ERROR;
     }
 
-    printf("[QER No.%u Info]\n", qer->id);
-    if (qer->related_pdr_num && qer->related_pdr_list) {
-        printf("\t Related PDR ID: ");
-        u16_id_list_from_kernel_space_print(qer->related_pdr_list, qer->related_pdr_num);
-        printf(" (Not a real IE)\n");
+    if (genl_gtp5g_qer_attr_into_cb(nlh, *qer) != MNL_CB_OK) {
+        gtp5g_qer_free(*qer);
+        *qer = NULL;
+        return MNL_CB_ERROR;
     }
+    return MNL_CB_OK;
 }
-EXPORT_SYMBOL(gtp5g_print_qer);
 
-static int genl_gtp5g_attr_cb(const struct nlmsghdr *nlh, void *data)
+void genl_gtp5g_qer_view_parse(const struct nlmsghdr *nlh, struct gtp5g_qer_view *v)
 {
-    struct nlattr *qer_tb[GTP5G_QER_ATTR_MAX + 1] = {};
-    struct genlmsghdr *genl;
-    struct gtp5g_qer *qer;
-
-    mnl_attr_parse(nlh, sizeof(*genl), genl_gtp5g_qer_validate_cb, qer_tb);
-    qer = *(struct gtp5g_qer **) data = gtp5g_qer_alloc();
-
-	if (qer_tb[GTP5G_QER_ID])
-        gtp5g_qer_set_id(qer, mnl_attr_get_u32(qer_tb[GTP5G_QER_ID]));
-
-	if (qer_tb[GTP5G_QER_RELATED_TO_PDR]) {
-        qer->related_pdr_num = mnl_attr_get_payload_len(qer_tb[GTP5G_QER_RELATED_TO_PDR]) / (sizeof(uint16_t) / sizeof(char));
-        qer->related_pdr_list = calloc(1, mnl_attr_get_payload_len(qer_tb[GTP5G_QER_RELATED_TO_PDR]));
-        memcpy(qer->related_pdr_list, 
-				mnl_attr_get_payload(qer_tb[GTP5G_QER_RELATED_TO_PDR]), 
-				mnl_attr_get_payload_len(qer_tb[GTP5G_QER_RELATED_TO_PDR]));
-    }
+    memset(v, 0, sizeof(*v));
 
-    return MNL_CB_OK;
+    gtp5g_attr_parse_view(nlh, &gtp5g_qer_policy, v->qer);
+    if (v->qer[GTP5G_QER_MBR])
+        gtp5g_attr_parse_nested_view(v->qer[GTP5G_QER_MBR], &gtp5g_mbr_policy, v->mbr);
+    if (v->qer[GTP5G_QER_GBR])
+        gtp5g_attr_parse_nested_view(v->qer[GTP5G_QER_GBR], &gtp5g_gbr_policy, v->gbr);
 }
 
 struct gtp5g_qer *gtp5g_qer_find_by_id(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev, struct gtp5g_qer *qer)
@@ -457,7 +393,7 @@ struct gtp5g_qer *gtp5g_qer_find_by_id(int genl_id, struct mnl_socket *nl, struc
     uint32_t seq = time(NULL);
 
     if (!dev) {
-        fprintf(stderr, "5G GTP device is NULL\n");
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_GET_QER, qer->id, "5G GTP device is NULL");
         return NULL;
     }
 
@@ -467,14 +403,36 @@ struct gtp5g_qer *gtp5g_qer_find_by_id(int genl_id, struct mnl_socket *nl, struc
 								++seq,
                                	GTP5G_CMD_GET_QER);
 
-    gtp5g_build_qer_payload(nlh, dev, qer);
+    if (gtp5g_build_qer_payload(nlh, sizeof(buf), dev, qer) < 0)
+        return NULL;
 
-    if (genl_socket_talk(nl, nlh, seq, genl_gtp5g_attr_cb, &rt_qer) < 0) {
-        perror("genl_socket_talk");
+    if (gtp5g_socket_talk(nl, nlh, seq, genl_gtp5g_qer_attr_cb, &rt_qer, qer->id) < 0)
         return NULL;
-    }
 
     return rt_qer;
 }
 EXPORT_SYMBOL(gtp5g_qer_find_by_id);
 
+int gtp5g_qer_find_by_id_into(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev,
+                              struct gtp5g_qer *qer, struct gtp5g_qer *out)
+{
+    struct nlmsghdr *nlh;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    uint32_t seq = time(NULL);
+    uint32_t id = qer->id;
+
+    if (!dev || !out) {
+        gtp5g_err_fail(EINVAL, GTP5G_CMD_GET_QER, id, dev ? "QER is NULL" : "5G GTP device is NULL");
+        return -1;
+    }
+
+    nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_EXCL | NLM_F_ACK, ++seq,
+                               GTP5G_CMD_GET_QER);
+    if (gtp5g_build_qer_payload(nlh, sizeof(buf), dev, qer) < 0)
+        return -1;
+
+    /* The request is built, so out may be qer */
+    return gtp5g_socket_talk(nl, nlh, seq, genl_gtp5g_qer_attr_into_cb, out, id) < 0 ? -1 : 0;
+}
+EXPORT_SYMBOL(gtp5g_qer_find_by_id_into);
+
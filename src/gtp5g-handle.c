@@ -0,0 +1,1099 @@
+/* Handles of gtp5g devices spread over network namespaces */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <net/if.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/genetlink.h>
+#include <linux/rtnetlink.h>
+
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+
+/* Where `ip netns add` keeps its namespaces */
+#define GTP5G_NETNS_RUN_DIR	"/run/netns"
+
+/* epoll tag of the nlctrl socket, the link sockets are tagged with the
+ * number of their namespace */
+#define GTP5G_HANDLE_CTRL	UINT32_MAX
+
+struct gtp5g_handle_ns {
+	char			*name;		/* NULL for the caller's */
+	int			fd;		/* -1 for the caller's */
+	struct mnl_socket	*nl;		/* opened inside of the namespace */
+	struct mnl_socket	*rtnl;		/* link notifications of the namespace */
+	int32_t			genl_id;	/* -1 until resolved again */
+};
+
+struct gtp5g_handle_dev {
+	char			*ifname;
+	unsigned int		ns;
+	struct gtp5g_dev	dev;		/* ifidx 0 until resolved again */
+};
+
+/*
+ * The ifindex of the devices and the family ID are resolved once and kept
+ * until a notification says otherwise: RTM_DELLINK or RTM_NEWLINK under
+ * another name for a device, CTRL_CMD_DELFAMILY when the gtp5g module is
+ * unloaded. What they invalidate is resolved again when next used. The
+ * notification sockets are polled through epfd before each request, which
+ * costs one epoll_wait() rather than a lookup.
+ */
+struct gtp5g_handle {
+	const struct gtp5g_allocator	*alloc;	/* of what the handle holds */
+	const struct gtp5g_allocator	*own;	/* of the handle itself */
+
+	struct gtp5g_handle_ns	**ns;
+	unsigned int		num_ns;
+
+	struct gtp5g_handle_dev	**devs;
+	unsigned int		num_devs;
+
+	int			epfd;
+	struct mnl_socket	*ctrl;		/* nlctrl notifications, of all namespaces */
+	pthread_mutex_t		lock;		/* of the cache, for gtp5g_handle_run() */
+
+	const struct gtp5g_err_hook	*err_hook;	/* from own, NULL for the global */
+};
+
+struct gtp5g_handle *gtp5g_handle_alloc(void)
+{
+	struct gtp5g_handle *h;
+
+	h = gtp5g_calloc(gtp5g_allocator, 1, sizeof(*h));
+	if (!h) {
+		gtp5g_err_fail(ENOMEM, 0, 0, "handle");
+		return NULL;
+	}
+
+	h->alloc = h->own = gtp5g_allocator;
+	h->epfd = -1;
+	pthread_mutex_init(&h->lock, NULL);
+	return h;
+}
+EXPORT_SYMBOL(gtp5g_handle_alloc);
+
+static void gtp5g_handle_ns_free(const struct gtp5g_handle *h, struct gtp5g_handle_ns *ns)
+{
+	if (ns->nl)
+		genl_socket_close(ns->nl);
+	if (ns->rtnl)
+		mnl_socket_close(ns->rtnl);
+	if (ns->fd >= 0)
+		close(ns->fd);
+	gtp5g_free(h->alloc, ns->name);
+	gtp5g_free(h->alloc, ns);
+}
+
+void gtp5g_handle_free(struct gtp5g_handle *h)
+{
+	unsigned int i;
+
+	if (!h)
+		return;
+
+	for (i = 0; i < h->num_devs; i++) {
+		gtp5g_free(h->alloc, h->devs[i]->ifname);
+		gtp5g_free(h->alloc, h->devs[i]);
+	}
+	for (i = 0; i < h->num_ns; i++)
+		gtp5g_handle_ns_free(h, h->ns[i]);
+	gtp5g_free(h->alloc, h->devs);
+	gtp5g_free(h->alloc, h->ns);
+	if (h->ctrl)
+		mnl_socket_close(h->ctrl);
+	if (h->epfd >= 0)
+		close(h->epfd);
+	pthread_mutex_destroy(&h->lock);
+	gtp5g_err_hook_free(h->err_hook, h->own);
+	gtp5g_free(h->own, h);
+}
+EXPORT_SYMBOL(gtp5g_handle_free);
+
+/* Failures between these go to the callback of the handle */
+static inline const struct gtp5g_err_hook *gtp5g_handle_err_enter(const struct gtp5g_handle *h)
+{
+	return gtp5g_err_enter(&h->err_hook);
+}
+
+int gtp5g_handle_set_allocator(struct gtp5g_handle *h, const struct gtp5g_allocator *a)
+{
+	const struct gtp5g_err_hook *saved = gtp5g_handle_err_enter(h);
+	int ret = -1;
+
+	pthread_mutex_lock(&h->lock);
+	if (h->num_devs || h->num_ns)
+		gtp5g_err_fail(EBUSY, 0, 0, "handle has devices");
+	else if ((a = gtp5g_allocator_check(a))) {
+		h->alloc = a;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&h->lock);
+	gtp5g_err_leave(saved);
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_handle_set_allocator);
+
+int gtp5g_handle_set_err_cb(struct gtp5g_handle *h, gtp5g_err_cb_t cb, void *data)
+{
+	const struct gtp5g_err_hook *saved = gtp5g_handle_err_enter(h);
+	int ret;
+
+	ret = gtp5g_err_hook_set(&h->err_hook, cb, data, h->own);
+	gtp5g_err_leave(saved);
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_handle_set_err_cb);
+
+static int gtp5g_netns_open(const char *name)
+{
+	char path[PATH_MAX];
+
+	if (strchr(name, '/'))
+		return open(name, O_RDONLY | O_CLOEXEC);
+
+	if (snprintf(path, sizeof(path), "%s/%s", GTP5G_NETNS_RUN_DIR, name) >= (int)sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/* Move the calling thread into the namespace of fd, *saved is where it
+ * came from for gtp5g_netns_leave() */
+static int gtp5g_netns_enter(int fd, int *saved)
+{
+	*saved = -1;
+	if (fd < 0)
+		return 0;
+
+	*saved = open("/proc/thread-self/ns/net", O_RDONLY | O_CLOEXEC);
+	if (*saved < 0)
+		return -1;
+
+	if (setns(fd, CLONE_NEWNET) < 0) {
+		close(*saved);
+		*saved = -1;
+		return -1;
+	}
+	return 0;
+}
+
+static void gtp5g_netns_leave(int saved)
+{
+	if (saved < 0)
+		return;
+
+	/* Going back to where we were allowed to come from does not fail */
+	setns(saved, CLONE_NEWNET);
+	close(saved);
+}
+
+static int gtp5g_netns_equal(const char *a, const char *b)
+{
+	if (!a || !b)
+		return a == b;
+	return strcmp(a, b) == 0;
+}
+
+static int gtp5g_handle_find_ns(const struct gtp5g_handle *h, const char *netns)
+{
+	unsigned int i;
+
+	for (i = 0; i < h->num_ns; i++) {
+		if (gtp5g_netns_equal(h->ns[i]->name, netns))
+			return i;
+	}
+	return -1;
+}
+
+static struct gtp5g_handle_ns *gtp5g_handle_ns_alloc(const struct gtp5g_handle *h,
+						     const char *netns)
+{
+	struct gtp5g_handle_ns *ns;
+
+	ns = gtp5g_calloc(h->alloc, 1, sizeof(*ns));
+	if (!ns)
+		return NULL;
+
+	ns->fd = -1;
+	ns->genl_id = -1;
+	if (netns) {
+		ns->name = gtp5g_strdup(h->alloc, netns);
+		if (!ns->name) {
+			gtp5g_free(h->alloc, ns);
+			return NULL;
+		}
+	}
+	return ns;
+}
+
+static struct mnl_socket *gtp5g_notify_open(int bus, unsigned int group)
+{
+	struct mnl_socket *nl;
+
+	nl = mnl_socket_open(bus);
+	if (!nl)
+		return NULL;
+
+	if (mnl_socket_bind(nl, 0, MNL_SOCKET_AUTOPID) < 0 ||
+	    mnl_socket_setsockopt(nl, NETLINK_ADD_MEMBERSHIP, &group, sizeof(group)) < 0) {
+		mnl_socket_close(nl);
+		return NULL;
+	}
+	return nl;
+}
+
+static int gtp5g_handle_poll_add(struct gtp5g_handle *h, struct mnl_socket *nl, uint32_t tag)
+{
+	struct epoll_event ev = {
+		.events		= EPOLLIN,
+		.data.u32	= tag,
+	};
+
+	return epoll_ctl(h->epfd, EPOLL_CTL_ADD, mnl_socket_get_fd(nl), &ev);
+}
+
+/* Family IDs are global, so nlctrl notifications of the caller's namespace
+ * cover all of them. Its notify group has the ID of the family. */
+static int gtp5g_handle_watch(struct gtp5g_handle *h)
+{
+	if (h->epfd >= 0)
+		return 0;
+
+	h->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (h->epfd < 0)
+		goto err;
+
+	h->ctrl = gtp5g_notify_open(NETLINK_GENERIC, GENL_ID_CTRL);
+	if (!h->ctrl || gtp5g_handle_poll_add(h, h->ctrl, GTP5G_HANDLE_CTRL) < 0)
+		goto err;
+
+	return 0;
+err:
+	gtp5g_err_fail(errno, 0, 0, "subscribe to nlctrl notifications");
+	if (h->ctrl)
+		mnl_socket_close(h->ctrl);
+	h->ctrl = NULL;
+	if (h->epfd >= 0)
+		close(h->epfd);
+	h->epfd = -1;
+	return -1;
+}
+
+static void gtp5g_handle_forget_family(struct gtp5g_handle *h)
+{
+	unsigned int i;
+
+	for (i = 0; i < h->num_ns; i++)
+		h->ns[i]->genl_id = -1;
+}
+
+static void gtp5g_handle_forget_links(struct gtp5g_handle *h, unsigned int ns)
+{
+	unsigned int i;
+
+	for (i = 0; i < h->num_devs; i++) {
+		if (h->devs[i]->ns == ns)
+			h->devs[i]->dev.ifidx = 0;
+	}
+}
+
+struct gtp5g_handle_notify {
+	struct gtp5g_handle	*h;
+	uint32_t		tag;
+};
+
+static int gtp5g_handle_ctrl_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct gtp5g_handle_notify *n = data;
+	const struct genlmsghdr *genl = mnl_nlmsg_get_payload(nlh);
+	const struct nlattr *attr;
+	const char *name = NULL;
+	int32_t genl_id = -1;
+	unsigned int i;
+
+	if (nlh->nlmsg_type != GENL_ID_CTRL ||
+	    mnl_nlmsg_get_payload_len(nlh) < sizeof(*genl) ||
+	    (genl->cmd != CTRL_CMD_NEWFAMILY && genl->cmd != CTRL_CMD_DELFAMILY))
+		return MNL_CB_OK;
+
+	mnl_attr_for_each(attr, nlh, sizeof(*genl)) {
+		switch (mnl_attr_get_type(attr)) {
+		case CTRL_ATTR_FAMILY_NAME:
+			if (mnl_attr_validate(attr, MNL_TYPE_NUL_STRING) == 0)
+				name = mnl_attr_get_str(attr);
+			break;
+		case CTRL_ATTR_FAMILY_ID:
+			if (mnl_attr_validate(attr, MNL_TYPE_U16) == 0)
+				genl_id = mnl_attr_get_u16(attr);
+			break;
+		}
+	}
+	if (!name || strcmp(name, "gtp5g"))
+		return MNL_CB_OK;
+
+	if (genl->cmd == CTRL_CMD_DELFAMILY) {
+		gtp5g_sdf_filter_list_forget();
+		genl_id = -1;
+	}
+	for (i = 0; i < n->h->num_ns; i++)
+		n->h->ns[i]->genl_id = genl_id;
+	return MNL_CB_OK;
+}
+
+static int gtp5g_handle_link_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct gtp5g_handle_notify *n = data;
+	const struct ifinfomsg *ifm = mnl_nlmsg_get_payload(nlh);
+	struct gtp5g_handle_dev *d;
+	const struct nlattr *attr;
+	const char *ifname = NULL;
+	unsigned int i;
+	int gone;
+
+	if ((nlh->nlmsg_type != RTM_NEWLINK && nlh->nlmsg_type != RTM_DELLINK) ||
+	    mnl_nlmsg_get_payload_len(nlh) < sizeof(*ifm))
+		return MNL_CB_OK;
+
+	mnl_attr_for_each(attr, nlh, sizeof(*ifm)) {
+		if (mnl_attr_get_type(attr) == IFLA_IFNAME &&
+		    mnl_attr_validate(attr, MNL_TYPE_NUL_STRING) == 0)
+			ifname = mnl_attr_get_str(attr);
+	}
+
+	for (i = 0; i < n->h->num_devs; i++) {
+		d = n->h->devs[i];
+		if (d->ns != n->tag)
+			continue;
+
+		/* Deleted, or renamed away from the name we know it by */
+		gone = nlh->nlmsg_type == RTM_DELLINK || !ifname || strcmp(ifname, d->ifname);
+		if (d->dev.ifidx == (uint32_t)ifm->ifi_index && gone)
+			d->dev.ifidx = 0;
+		else if (!gone)
+			d->dev.ifidx = ifm->ifi_index;
+	}
+	return MNL_CB_OK;
+}
+
+static void gtp5g_handle_drain(struct gtp5g_handle *h, uint32_t tag)
+{
+	struct gtp5g_handle_notify n = {
+		.h	= h,
+		.tag	= tag,
+	};
+	struct mnl_socket *nl = tag == GTP5G_HANDLE_CTRL ? h->ctrl : h->ns[tag]->rtnl;
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	ssize_t ret;
+
+	for (;;) {
+		ret = recv(mnl_socket_get_fd(nl), buf, sizeof(buf), MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			/* Notifications were lost, the cache cannot be trusted */
+			if (errno == ENOBUFS) {
+				if (tag == GTP5G_HANDLE_CTRL)
+					gtp5g_handle_forget_family(h);
+				else
+					gtp5g_handle_forget_links(h, tag);
+				continue;
+			}
+			return;
+		}
+
+		mnl_cb_run(buf, ret, 0, 0, tag == GTP5G_HANDLE_CTRL ?
+			   gtp5g_handle_ctrl_cb : gtp5g_handle_link_cb, &n);
+	}
+}
+
+static int gtp5g_handle_process_locked(struct gtp5g_handle *h)
+{
+	struct epoll_event ev[8];
+	int i, n, total = 0;
+
+	if (h->epfd < 0)
+		return 0;
+
+	do {
+		n = epoll_wait(h->epfd, ev, sizeof(ev) / sizeof(ev[0]), 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			gtp5g_err_fail(errno, 0, 0, "epoll_wait");
+			return -1;
+		}
+		for (i = 0; i < n; i++)
+			gtp5g_handle_drain(h, ev[i].data.u32);
+		total += n;
+	} while (n == sizeof(ev) / sizeof(ev[0]));
+
+	return total;
+}
+
+int gtp5g_handle_get_fd(const struct gtp5g_handle *h)
+{
+	return h->epfd;
+}
+EXPORT_SYMBOL(gtp5g_handle_get_fd);
+
+int gtp5g_handle_process(struct gtp5g_handle *h)
+{
+	const struct gtp5g_err_hook *saved = gtp5g_handle_err_enter(h);
+	int ret;
+
+	pthread_mutex_lock(&h->lock);
+	ret = gtp5g_handle_process_locked(h);
+	pthread_mutex_unlock(&h->lock);
+	gtp5g_err_leave(saved);
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_handle_process);
+
+/* The family ID is the same everywhere, whoever looks it up shares it */
+static int gtp5g_handle_resolve_family(struct gtp5g_handle *h, struct gtp5g_handle_ns *ns)
+{
+	unsigned int i;
+
+	if (ns->genl_id >= 0)
+		return 0;
+
+	for (i = 0; i < h->num_ns; i++) {
+		if (h->ns[i]->genl_id >= 0) {
+			ns->genl_id = h->ns[i]->genl_id;
+			return 0;
+		}
+	}
+
+	ns->genl_id = genl_lookup_family(ns->nl, "gtp5g");
+	if (ns->genl_id < 0)
+		return -1;
+
+	for (i = 0; i < h->num_ns; i++)
+		h->ns[i]->genl_id = ns->genl_id;
+	return 0;
+}
+
+static uint32_t gtp5g_handle_lookup_link(struct gtp5g_handle_ns *ns, const char *ifname)
+{
+	uint32_t ifidx;
+	int saved;
+
+	if (gtp5g_netns_enter(ns->fd, &saved) < 0) {
+		gtp5g_err_fail(errno, 0, 0, "enter network namespace");
+		return 0;
+	}
+	ifidx = if_nametoindex(ifname);
+	if (!ifidx)
+		gtp5g_err_fail(errno ? errno : ENODEV, 0, 0, "unknown interface");
+	gtp5g_netns_leave(saved);
+
+	return ifidx;
+}
+
+/* Bring the cache entries dev depends on up to date */
+static int gtp5g_handle_resolve(struct gtp5g_handle *h, unsigned int dev)
+{
+	struct gtp5g_handle_dev *d = h->devs[dev];
+	struct gtp5g_handle_ns *ns = h->ns[d->ns];
+
+	if (gtp5g_handle_process_locked(h) < 0 ||
+	    gtp5g_handle_resolve_family(h, ns) < 0)
+		return -1;
+
+	if (!d->dev.ifidx) {
+		d->dev.ifidx = gtp5g_handle_lookup_link(ns, d->ifname);
+		if (!d->dev.ifidx)
+			return -1;
+	}
+	return 0;
+}
+
+int gtp5g_handle_find_dev(const struct gtp5g_handle *h, const char *netns,
+			  const char *ifname)
+{
+	unsigned int i;
+
+	for (i = 0; i < h->num_devs; i++) {
+		if (strcmp(h->devs[i]->ifname, ifname) == 0 &&
+		    gtp5g_netns_equal(h->ns[h->devs[i]->ns]->name, netns))
+			return i;
+	}
+	return -1;
+}
+EXPORT_SYMBOL(gtp5g_handle_find_dev);
+
+static int gtp5g_handle_add_dev_locked(struct gtp5g_handle *h, const char *netns,
+				       const char *ifname)
+{
+	struct gtp5g_handle_ns *ns = NULL, **ns_arr;
+	struct gtp5g_handle_dev *dev, **dev_arr;
+	const char *what = NULL;
+	int idx, saved = -1, err = 0;
+	uint32_t ifidx = 0;
+
+	idx = gtp5g_handle_find_dev(h, netns, ifname);
+	if (idx >= 0)
+		return idx;
+
+	if (gtp5g_handle_watch(h) < 0)
+		return -1;
+
+	idx = gtp5g_handle_find_ns(h, netns);
+	if (idx < 0) {
+		ns = gtp5g_handle_ns_alloc(h, netns);
+		if (!ns) {
+			gtp5g_err_fail(ENOMEM, 0, 0, "handle");
+			return -1;
+		}
+		if (netns) {
+			ns->fd = gtp5g_netns_open(netns);
+			if (ns->fd < 0) {
+				gtp5g_err_fail(errno, 0, 0, "open network namespace");
+				goto err;
+			}
+		}
+	}
+
+	/* One trip into the namespace for the sockets and the ifindex, a
+	 * socket keeps talking to the namespace it was created in. Links are
+	 * watched before the ifindex is looked up, so no change is missed. */
+	if (gtp5g_netns_enter(ns ? ns->fd : h->ns[idx]->fd, &saved) < 0) {
+		gtp5g_err_fail(errno, 0, 0, "enter network namespace");
+		goto err;
+	}
+	if (ns) {
+		ns->nl = genl_socket_open();
+		if (!ns->nl)
+			err = -1;
+		else if (!(ns->rtnl = gtp5g_notify_open(NETLINK_ROUTE, RTNLGRP_LINK))) {
+			err = errno;
+			what = "subscribe to link notifications";
+		}
+	}
+	if (!err) {
+		ifidx = if_nametoindex(ifname);
+		if (!ifidx) {
+			err = errno ? errno : ENODEV;
+			what = "unknown interface";
+		}
+	}
+	gtp5g_netns_leave(saved);
+
+	if (err) {
+		if (what)
+			gtp5g_err_fail(err, 0, 0, what);
+		goto err;
+	}
+
+	if (ns && gtp5g_handle_resolve_family(h, ns) < 0)
+		goto err;
+
+	dev = gtp5g_calloc(h->alloc, 1, sizeof(*dev));
+	if (!dev)
+		goto err_nomem;
+	dev->ifname = gtp5g_strdup(h->alloc, ifname);
+	dev_arr = gtp5g_realloc(h->alloc, h->devs, (h->num_devs + 1) * sizeof(*dev_arr));
+	if (dev_arr)
+		h->devs = dev_arr;
+	if (!dev->ifname || !dev_arr) {
+		gtp5g_free(h->alloc, dev->ifname);
+		gtp5g_free(h->alloc, dev);
+		goto err_nomem;
+	}
+
+	if (ns) {
+		ns_arr = gtp5g_realloc(h->alloc, h->ns, (h->num_ns + 1) * sizeof(*ns_arr));
+		if (!ns_arr) {
+			gtp5g_free(h->alloc, dev->ifname);
+			gtp5g_free(h->alloc, dev);
+			goto err_nomem;
+		}
+		h->ns = ns_arr;
+		if (gtp5g_handle_poll_add(h, ns->rtnl, h->num_ns) < 0) {
+			gtp5g_err_fail(errno, 0, 0, "watch link notifications");
+			gtp5g_free(h->alloc, dev->ifname);
+			gtp5g_free(h->alloc, dev);
+			goto err;
+		}
+		idx = h->num_ns;
+		h->ns[h->num_ns++] = ns;
+	}
+
+	/* The socket lives in the namespace, so requests need no
+	 * GTP5G_NET_NS_FD */
+	dev->ns = idx;
+	dev->dev.ifns = -1;
+	dev->dev.ifidx = ifidx;
+	h->devs[h->num_devs] = dev;
+	return h->num_devs++;
+
+err_nomem:
+	gtp5g_err_fail(ENOMEM, 0, 0, "handle");
+err:
+	if (ns)
+		gtp5g_handle_ns_free(h, ns);
+	return -1;
+}
+
+int gtp5g_handle_add_dev(struct gtp5g_handle *h, const char *netns, const char *ifname)
+{
+	const struct gtp5g_err_hook *saved = gtp5g_handle_err_enter(h);
+	int ret;
+
+	pthread_mutex_lock(&h->lock);
+	ret = gtp5g_handle_add_dev_locked(h, netns, ifname);
+	pthread_mutex_unlock(&h->lock);
+	gtp5g_err_leave(saved);
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_handle_add_dev);
+
+unsigned int gtp5g_handle_count(const struct gtp5g_handle *h)
+{
+	return h->num_devs;
+}
+EXPORT_SYMBOL(gtp5g_handle_count);
+
+static inline struct gtp5g_handle_ns *gtp5g_handle_dev_ns(const struct gtp5g_handle *h,
+							 unsigned int dev)
+{
+	return h->ns[h->devs[dev]->ns];
+}
+
+static int gtp5g_handle_check(const struct gtp5g_handle *h, unsigned int dev)
+{
+	if (dev < h->num_devs)
+		return 0;
+
+	gtp5g_err_fail(ENODEV, 0, 0, "no such device in handle");
+	return -1;
+}
+
+/* What a request to dev needs, taken while the cache is up to date */
+static int gtp5g_handle_get(struct gtp5g_handle *h, unsigned int dev, int32_t *genl_id,
+			    struct mnl_socket **nl, struct gtp5g_dev *d)
+{
+	const struct gtp5g_err_hook *saved = gtp5g_handle_err_enter(h);
+	int ret = -1;
+
+	if (gtp5g_handle_check(h, dev) == 0) {
+		pthread_mutex_lock(&h->lock);
+		if (gtp5g_handle_resolve(h, dev) == 0) {
+			*genl_id = gtp5g_handle_dev_ns(h, dev)->genl_id;
+			*nl = gtp5g_handle_dev_ns(h, dev)->nl;
+			if (d)
+				*d = h->devs[dev]->dev;
+			ret = 0;
+		}
+		pthread_mutex_unlock(&h->lock);
+	}
+	gtp5g_err_leave(saved);
+	return ret;
+}
+
+struct gtp5g_dev *gtp5g_handle_dev(struct gtp5g_handle *h, unsigned int dev)
+{
+	struct mnl_socket *nl;
+	int32_t genl_id;
+
+	if (gtp5g_handle_get(h, dev, &genl_id, &nl, NULL) < 0)
+		return NULL;
+	return &h->devs[dev]->dev;
+}
+EXPORT_SYMBOL(gtp5g_handle_dev);
+
+uint32_t gtp5g_handle_ifindex(struct gtp5g_handle *h, unsigned int dev)
+{
+	struct gtp5g_dev d;
+	struct mnl_socket *nl;
+	int32_t genl_id;
+
+	if (gtp5g_handle_get(h, dev, &genl_id, &nl, &d) < 0)
+		return 0;
+	return d.ifidx;
+}
+EXPORT_SYMBOL(gtp5g_handle_ifindex);
+
+struct mnl_socket *gtp5g_handle_socket(struct gtp5g_handle *h, unsigned int dev)
+{
+	return dev < h->num_devs ? gtp5g_handle_dev_ns(h, dev)->nl : NULL;
+}
+EXPORT_SYMBOL(gtp5g_handle_socket);
+
+int gtp5g_handle_genl_id(struct gtp5g_handle *h, unsigned int dev)
+{
+	struct mnl_socket *nl;
+	int32_t genl_id;
+
+	if (gtp5g_handle_get(h, dev, &genl_id, &nl, NULL) < 0)
+		return -1;
+	return genl_id;
+}
+EXPORT_SYMBOL(gtp5g_handle_genl_id);
+
+const char *gtp5g_handle_netns(const struct gtp5g_handle *h, unsigned int dev)
+{
+	return dev < h->num_devs ? gtp5g_handle_dev_ns(h, dev)->name : NULL;
+}
+EXPORT_SYMBOL(gtp5g_handle_netns);
+
+int gtp5g_handle_netns_index(const struct gtp5g_handle *h, unsigned int dev)
+{
+	return dev < h->num_devs ? (int)h->devs[dev]->ns : -1;
+}
+EXPORT_SYMBOL(gtp5g_handle_netns_index);
+
+const char *gtp5g_handle_ifname(const struct gtp5g_handle *h, unsigned int dev)
+{
+	return dev < h->num_devs ? h->devs[dev]->ifname : NULL;
+}
+EXPORT_SYMBOL(gtp5g_handle_ifname);
+
+/* gtp5g_handle_<op>_<rule>() is gtp5g_<op>_<rule>() on the socket of dev */
+#define GTP5G_HANDLE_REQ(op, rule)						\
+int gtp5g_handle_##op##_##rule(struct gtp5g_handle *h, unsigned int dev,	\
+			       struct gtp5g_##rule *rule)			\
+{										\
+	const struct gtp5g_err_hook *saved;					\
+	struct mnl_socket *nl;							\
+	struct gtp5g_dev d;							\
+	int32_t genl_id;							\
+	int ret;								\
+										\
+	if (gtp5g_handle_get(h, dev, &genl_id, &nl, &d) < 0)			\
+		return -1;							\
+	saved = gtp5g_handle_err_enter(h);					\
+	ret = gtp5g_##op##_##rule(genl_id, nl, &d, rule);			\
+	gtp5g_err_leave(saved);							\
+	return ret;								\
+}										\
+EXPORT_SYMBOL(gtp5g_handle_##op##_##rule)
+
+GTP5G_HANDLE_REQ(add, pdr);
+GTP5G_HANDLE_REQ(add, far);
+GTP5G_HANDLE_REQ(add, qer);
+GTP5G_HANDLE_REQ(mod, pdr);
+GTP5G_HANDLE_REQ(mod, far);
+GTP5G_HANDLE_REQ(mod, qer);
+GTP5G_HANDLE_REQ(del, pdr);
+GTP5G_HANDLE_REQ(del, far);
+GTP5G_HANDLE_REQ(del, qer);
+
+struct gtp5g_batch *gtp5g_handle_batch_alloc(struct gtp5g_handle *h, unsigned int dev)
+{
+	const struct gtp5g_err_hook *saved;
+	struct gtp5g_batch *b;
+	struct mnl_socket *nl;
+	int32_t genl_id;
+
+	if (gtp5g_handle_get(h, dev, &genl_id, &nl, NULL) < 0)
+		return NULL;
+	saved = gtp5g_handle_err_enter(h);
+	b = gtp5g_batch_alloc_with(h->alloc, genl_id, nl);
+	gtp5g_err_leave(saved);
+	return b;
+}
+EXPORT_SYMBOL(gtp5g_handle_batch_alloc);
+
+struct gtp5g_async *gtp5g_handle_async_alloc(struct gtp5g_handle *h, unsigned int dev)
+{
+	const struct gtp5g_err_hook *saved_err;
+	struct gtp5g_async *a = NULL;
+	struct mnl_socket *nl;
+	int32_t genl_id;
+	int saved;
+
+	if (gtp5g_handle_get(h, dev, &genl_id, &nl, NULL) < 0)
+		return NULL;
+
+	/* A socket of its own, the one of the namespace stays blocking */
+	saved_err = gtp5g_handle_err_enter(h);
+	if (gtp5g_netns_enter(gtp5g_handle_dev_ns(h, dev)->fd, &saved) < 0) {
+		gtp5g_err_fail(errno, 0, 0, "enter network namespace");
+		goto out;
+	}
+	nl = genl_socket_open();
+	gtp5g_netns_leave(saved);
+	if (!nl)
+		goto out;
+
+	a = gtp5g_async_alloc_own(h->alloc, genl_id, nl);
+	if (!a)
+		genl_socket_close(nl);
+out:
+	gtp5g_err_leave(saved_err);
+	return a;
+}
+EXPORT_SYMBOL(gtp5g_handle_async_alloc);
+
+/* Work on one namespace, from its own thread */
+struct gtp5g_handle_job {
+	struct gtp5g_handle	*h;
+	unsigned int		ns;
+	int			(*fn)(struct gtp5g_handle_job *job);
+
+	/* of gtp5g_handle_dump() and gtp5g_handle_run() */
+	const struct gtp5g_handle_dump_ops *ops;
+	int			(*dev_fn)(struct gtp5g_handle *h, unsigned int dev, void *data);
+	void			*data;
+
+	int			failed;
+	struct gtp5g_err	err;		/* of the thread, when it failed */
+	pthread_t		thread;
+	int			started;
+};
+
+static void *gtp5g_handle_job_run(void *arg)
+{
+	struct gtp5g_handle_job *job = arg;
+	const struct gtp5g_err_hook *saved = gtp5g_handle_err_enter(job->h);
+
+	job->failed = job->fn(job);
+	if (job->failed)
+		job->err = *gtp5g_get_err();
+	gtp5g_err_leave(saved);
+	return NULL;
+}
+
+/* Namespaces are independent sockets, so each gets a thread; the first one
+ * runs in the caller's. A namespace without a thread is run in the caller's
+ * as well. Returns the sum of what the jobs returned, the caller's thread
+ * is left with the failure of the first namespace that had one. */
+static int gtp5g_handle_parallel(struct gtp5g_handle *h, const struct gtp5g_handle_job *tmpl)
+{
+	struct gtp5g_handle_job *jobs;
+	unsigned int i;
+	int failed = 0;
+
+	if (!h->num_ns)
+		return 0;
+
+	jobs = gtp5g_calloc(h->alloc, h->num_ns, sizeof(*jobs));
+	if (!jobs) {
+		gtp5g_err_fail(ENOMEM, 0, 0, "handle");
+		return -1;
+	}
+
+	for (i = 0; i < h->num_ns; i++) {
+		jobs[i] = *tmpl;
+		jobs[i].h = h;
+		jobs[i].ns = i;
+		if (i)
+			jobs[i].started = pthread_create(&jobs[i].thread, NULL,
+							 gtp5g_handle_job_run, &jobs[i]) == 0;
+	}
+
+	for (i = 0; i < h->num_ns; i++) {
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+		else
+			gtp5g_handle_job_run(&jobs[i]);
+		failed += jobs[i].failed;
+	}
+
+	for (i = 0; i < h->num_ns; i++) {
+		if (jobs[i].failed) {
+			gtp5g_err_copy(&jobs[i].err);
+			break;
+		}
+	}
+
+	gtp5g_free(h->alloc, jobs);
+	return failed;
+}
+
+/* Each namespace decodes into its own object of each type, which the
+ * callbacks are passed */
+struct gtp5g_handle_dump {
+	struct gtp5g_handle_job			*job;
+	const struct gtp5g_handle_dump_ops	*ops;
+	uint8_t					cmd;
+	struct gtp5g_pdr			*pdr;
+	struct gtp5g_far			*far;
+	struct gtp5g_qer			*qer;
+};
+
+static int gtp5g_handle_dump_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct gtp5g_handle_dump *d = data;
+	struct gtp5g_handle *h = d->job->h;
+	void *user = d->job->data;
+	int ret;
+
+	switch (d->cmd) {
+	case GTP5G_CMD_GET_PDR:
+		if (genl_gtp5g_pdr_attr_into_cb(nlh, d->pdr) != MNL_CB_OK)
+			return MNL_CB_ERROR;
+		ret = d->ops->pdr(h, d->job->ns, d->pdr, user);
+		break;
+	case GTP5G_CMD_GET_FAR:
+		if (genl_gtp5g_far_attr_into_cb(nlh, d->far) != MNL_CB_OK)
+			return MNL_CB_ERROR;
+		ret = d->ops->far(h, d->job->ns, d->far, user);
+		break;
+	default:
+		if (genl_gtp5g_qer_attr_into_cb(nlh, d->qer) != MNL_CB_OK)
+			return MNL_CB_ERROR;
+		ret = d->ops->qer(h, d->job->ns, d->qer, user);
+		break;
+	}
+
+	if (ret < 0) {
+		gtp5g_err_set(ECANCELED, 0, "dump stopped by callback");
+		return MNL_CB_ERROR;
+	}
+	return MNL_CB_OK;
+}
+
+static void gtp5g_handle_dump_restart(void *data)
+{
+	struct gtp5g_handle_dump *d = data;
+
+	if (d->ops->restart)
+		d->ops->restart(d->job->h, d->job->ns, d->cmd, d->job->data);
+}
+
+static int gtp5g_handle_dump_job(struct gtp5g_handle_job *job)
+{
+	static const uint8_t cmds[] = {
+		GTP5G_CMD_GET_PDR, GTP5G_CMD_GET_FAR, GTP5G_CMD_GET_QER,
+	};
+	struct gtp5g_handle_ns *ns = job->h->ns[job->ns];
+	struct gtp5g_handle_dump d = {
+		.job	= job,
+		.ops	= job->ops,
+	};
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nlmsghdr *nlh;
+	uint32_t seq = time(NULL);
+	unsigned int i;
+	int32_t genl_id;
+	int failed = 0;
+
+	pthread_mutex_lock(&job->h->lock);
+	if (gtp5g_handle_process_locked(job->h) < 0 ||
+	    gtp5g_handle_resolve_family(job->h, ns) < 0)
+		genl_id = -1;
+	else
+		genl_id = ns->genl_id;
+	pthread_mutex_unlock(&job->h->lock);
+	if (genl_id < 0)
+		return 1;
+
+	d.pdr = gtp5g_pdr_alloc_with(job->h->alloc);
+	d.far = gtp5g_far_alloc_with(job->h->alloc);
+	d.qer = gtp5g_qer_alloc_with(job->h->alloc);
+	if (!d.pdr || !d.far || !d.qer) {
+		gtp5g_err_fail(ENOMEM, 0, 0, "dump");
+		failed = 1;
+	}
+
+	for (i = 0; !failed && i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+		if ((cmds[i] == GTP5G_CMD_GET_PDR && !d.ops->pdr) ||
+		    (cmds[i] == GTP5G_CMD_GET_FAR && !d.ops->far) ||
+		    (cmds[i] == GTP5G_CMD_GET_QER && !d.ops->qer))
+			continue;
+
+		d.cmd = cmds[i];
+		nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_DUMP, ++seq, cmds[i]);
+		if (gtp5g_socket_dump(ns->nl, nlh, seq, gtp5g_handle_dump_cb,
+				      gtp5g_handle_dump_restart, &d, 0) < 0)
+			failed = 1;
+	}
+
+	if (d.pdr)
+		gtp5g_pdr_free(d.pdr);
+	if (d.far)
+		gtp5g_far_free(d.far);
+	gtp5g_qer_free(d.qer);
+	return failed;
+}
+
+/* Returns the number of namespaces whose dump failed */
+int gtp5g_handle_dump(struct gtp5g_handle *h, const struct gtp5g_handle_dump_ops *ops,
+		      void *data)
+{
+	struct gtp5g_handle_job tmpl = {
+		.fn	= gtp5g_handle_dump_job,
+		.ops	= ops,
+		.data	= data,
+	};
+	const struct gtp5g_err_hook *saved = gtp5g_handle_err_enter(h);
+	int ret = -1;
+
+	if (!ops)
+		gtp5g_err_fail(EINVAL, 0, 0, "dump ops is NULL");
+	else
+		ret = gtp5g_handle_parallel(h, &tmpl);
+	gtp5g_err_leave(saved);
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_handle_dump);
+
+static int gtp5g_handle_run_job(struct gtp5g_handle_job *job)
+{
+	unsigned int i;
+	int failed = 0;
+
+	for (i = 0; i < job->h->num_devs; i++) {
+		if (job->h->devs[i]->ns == job->ns && job->dev_fn(job->h, i, job->data) < 0)
+			failed++;
+	}
+	return failed;
+}
+
+/* Returns the number of devices fn failed on */
+int gtp5g_handle_run(struct gtp5g_handle *h,
+		     int (*fn)(struct gtp5g_handle *h, unsigned int dev, void *data),
+		     void *data)
+{
+	struct gtp5g_handle_job tmpl = {
+		.fn	= gtp5g_handle_run_job,
+		.dev_fn	= fn,
+		.data	= data,
+	};
+	const struct gtp5g_err_hook *saved = gtp5g_handle_err_enter(h);
+	int ret = -1;
+
+	if (!fn)
+		gtp5g_err_fail(EINVAL, 0, 0, "run function is NULL");
+	else
+		ret = gtp5g_handle_parallel(h, &tmpl);
+	gtp5g_err_leave(saved);
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_handle_run);
@@ -0,0 +1,273 @@
+/* Buffered output of the list and print functions */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "internal.h"
+
+/* Sink of the functions without one */
+const struct gtp5g_sink gtp5g_sink_stdout = {
+	.fd	= STDOUT_FILENO,
+};
+
+ssize_t gtp5g_sink_fwrite(const void *buf, size_t len, void *data)
+{
+	size_t ret;
+
+	ret = fwrite(buf, 1, len, data);
+	if (ret < len && ferror((FILE *)data))
+		return -1;
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_sink_fwrite);
+
+void gtp5g_out_init(struct gtp5g_out *o, const struct gtp5g_sink *sink)
+{
+	/* Whatever the caller printed through stdio goes first */
+	fflush(stdout);
+
+	o->sink = *sink;
+	o->err = 0;
+	o->len = 0;
+}
+
+struct gtp5g_out *gtp5g_out_new(const struct gtp5g_sink *sink)
+{
+	struct gtp5g_out *o;
+
+	o = gtp5g_malloc(gtp5g_allocator, sizeof(*o));
+	if (!o) {
+		gtp5g_err_fail(ENOMEM, 0, 0, "output buffer");
+		return NULL;
+	}
+	gtp5g_out_init(o, sink);
+	o->alloc = gtp5g_allocator;
+	return o;
+}
+
+int gtp5g_out_free(struct gtp5g_out *o)
+{
+	int ret;
+
+	ret = gtp5g_out_flush(o);
+	gtp5g_free(o->alloc, o);
+	return ret;
+}
+
+static ssize_t gtp5g_out_write(struct gtp5g_out *o, const void *p, size_t len)
+{
+	if (o->sink.write)
+		return o->sink.write(p, len, o->sink.data);
+	return write(o->sink.fd, p, len);
+}
+
+int gtp5g_out_flush(struct gtp5g_out *o)
+{
+	const char *p = o->buf;
+	size_t len = o->len;
+	ssize_t ret;
+
+	/* After a failure the output is dropped, it is reported once */
+	o->len = 0;
+	if (o->err)
+		return -1;
+
+	while (len) {
+		ret = gtp5g_out_write(o, p, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			o->err = errno ? errno : EIO;
+			gtp5g_err_fail(o->err, 0, 0, "write output");
+			return -1;
+		}
+		p += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/* Room for len more bytes, len is at most GTP5G_OUT_SIZE */
+static inline char *gtp5g_out_reserve(struct gtp5g_out *o, size_t len)
+{
+	if (o->len + len > sizeof(o->buf))
+		gtp5g_out_flush(o);
+	return o->buf + o->len;
+}
+
+void gtp5g_out_mem(struct gtp5g_out *o, const void *p, size_t len)
+{
+	size_t n;
+
+	while (len) {
+		n = len < sizeof(o->buf) ? len : sizeof(o->buf);
+		memcpy(gtp5g_out_reserve(o, n), p, n);
+		o->len += n;
+		p = (const char *)p + n;
+		len -= n;
+	}
+}
+
+void gtp5g_out_str(struct gtp5g_out *o, const char *s)
+{
+	gtp5g_out_mem(o, s, strlen(s));
+}
+
+void gtp5g_out_char(struct gtp5g_out *o, char c)
+{
+	*gtp5g_out_reserve(o, 1) = c;
+	o->len++;
+}
+
+/* Digits of v, backwards from end, returns the first one */
+static inline char *gtp5g_out_digits(char *end, uint32_t v)
+{
+	do {
+		*--end = '0' + v % 10;
+		v /= 10;
+	} while (v);
+
+	return end;
+}
+
+void gtp5g_out_u32(struct gtp5g_out *o, uint32_t v)
+{
+	char tmp[10], *p;
+
+	p = gtp5g_out_digits(tmp + sizeof(tmp), v);
+	gtp5g_out_mem(o, p, tmp + sizeof(tmp) - p);
+}
+
+/* "label" v "\n", the label carries the indent of the text form */
+void gtp5g_out_field(struct gtp5g_out *o, const char *label, uint32_t v)
+{
+	gtp5g_out_str(o, label);
+	gtp5g_out_u32(o, v);
+	gtp5g_out_char(o, '\n');
+}
+
+/* Port ranges packed as low | high << 16, "80,8000-8080" */
+void gtp5g_out_ports(struct gtp5g_out *o, const uint32_t *list, int num)
+{
+	int i;
+
+	for (i = 0; list && i < num; i++) {
+		if (i)
+			gtp5g_out_char(o, ',');
+		gtp5g_out_u32(o, list[i] & 0xffff);
+		if ((list[i] & 0xffff) != list[i] >> 16) {
+			gtp5g_out_char(o, '-');
+			gtp5g_out_u32(o, list[i] >> 16);
+		}
+	}
+}
+
+void gtp5g_out_ids(struct gtp5g_out *o, const uint16_t *list, int num, const char *sep)
+{
+	int i;
+
+	for (i = 0; list && i < num; i++) {
+		if (i)
+			gtp5g_out_str(o, sep);
+		gtp5g_out_u32(o, list[i]);
+	}
+}
+
+void gtp5g_out_ipv4(struct gtp5g_out *o, const struct in_addr *addr)
+{
+	const uint8_t *b = (const uint8_t *)&addr->s_addr;
+	char tmp[3], *p, *out;
+	int i;
+
+	out = gtp5g_out_reserve(o, sizeof("255.255.255.255") - 1);
+	for (i = 0; i < 4; i++) {
+		if (i)
+			*out++ = '.';
+		p = gtp5g_out_digits(tmp + sizeof(tmp), b[i]);
+		memcpy(out, p, tmp + sizeof(tmp) - p);
+		out += tmp + sizeof(tmp) - p;
+	}
+	o->len = out - o->buf;
+}
+
+/* As gtp5g_out_field() for an address */
+void gtp5g_out_ipv4_field(struct gtp5g_out *o, const char *label, const struct in_addr *addr)
+{
+	gtp5g_out_str(o, label);
+	gtp5g_out_ipv4(o, addr);
+	gtp5g_out_char(o, '\n');
+}
+
+void gtp5g_out_json_str(struct gtp5g_out *o, const char *s)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char *run = s;
+
+	gtp5g_out_char(o, '"');
+	for (; *s; s++) {
+		if ((unsigned char)*s >= 0x20 && *s != '"' && *s != '\\')
+			continue;
+
+		gtp5g_out_mem(o, run, s - run);
+		run = s + 1;
+		gtp5g_out_char(o, '\\');
+		switch (*s) {
+		case '"':
+		case '\\':
+			gtp5g_out_char(o, *s);
+			break;
+		case '\n':
+			gtp5g_out_char(o, 'n');
+			break;
+		case '\t':
+			gtp5g_out_char(o, 't');
+			break;
+		default:
+			gtp5g_out_str(o, "u00");
+			gtp5g_out_char(o, hex[(unsigned char)*s >> 4]);
+			gtp5g_out_char(o, hex[*s & 0xf]);
+		}
+	}
+	gtp5g_out_mem(o, run, s - run);
+	gtp5g_out_char(o, '"');
+}
+
+/* RFC 4180: quoted when it holds a separator, quote or line break */
+void gtp5g_out_csv_str(struct gtp5g_out *o, const char *s)
+{
+	const char *p;
+
+	if (!s[strcspn(s, ",\"\r\n")]) {
+		gtp5g_out_str(o, s);
+		return;
+	}
+
+	gtp5g_out_char(o, '"');
+	for (p = s; *p; p++) {
+		if (*p == '"')
+			gtp5g_out_char(o, '"');
+		gtp5g_out_char(o, *p);
+	}
+	gtp5g_out_char(o, '"');
+}
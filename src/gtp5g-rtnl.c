@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <unistd.h>
 #include <string.h>
 #include <time.h>
@@ -60,12 +61,12 @@ static struct mnl_socket *rtnl_open(void)
 
 	nl = mnl_socket_open(NETLINK_ROUTE);
 	if (nl == NULL) {
-		perror("mnl_socket_open");
+		gtp5g_err_fail(errno, 0, 0, "mnl_socket_open");
 		return NULL;
 	}
 
 	if (mnl_socket_bind(nl, 0, MNL_SOCKET_AUTOPID) < 0) {
-		perror("mnl_socket_bind");
+		gtp5g_err_fail(errno, 0, 0, "mnl_socket_bind");
 		goto err;
 	}
 
@@ -82,14 +83,21 @@ static int rtnl_talk(struct mnl_socket *nl, struct nlmsghdr *nlh)
 
 	ret = mnl_socket_sendto(nl, nlh, nlh->nlmsg_len);
 	if (ret < 0)
-		return ret;
+		goto err;
 
 	ret = mnl_socket_recvfrom(nl, buf, sizeof(buf));
 	if (ret < 0)
-		return ret;
+		goto err;
+
+	ret = mnl_cb_run(buf, ret, nlh->nlmsg_seq, mnl_socket_get_portid(nl),
+			 NULL, NULL);
+	if (ret < 0)
+		goto err;
 
-	return mnl_cb_run(buf, ret, nlh->nlmsg_seq, mnl_socket_get_portid(nl),
-			  NULL, NULL);
+	return ret;
+err:
+	gtp5g_err_fail(errno, 0, 0, "rtnl_talk");
+	return ret;
 }
 
 static int gtp_dev_talk(struct nlmsghdr *nlh, uint32_t seq)
@@ -179,7 +187,7 @@ int gtp_dev_config(const char *ifname, struct in_addr *dst, uint32_t prefix)
 
 	iface = if_nametoindex(ifname);
 	if (iface == 0) {
-		perror("if_nametoindex");
+		gtp5g_err_fail(errno, 0, 0, "if_nametoindex");
 		return -1;
 	}
 
@@ -0,0 +1,797 @@
+/* Memory-mapped snapshots of the PDR/FAR/QER tables */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/genetlink.h>
+
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+
+/*
+ * File layout, in the byte order of the host that wrote it:
+ *
+ *	struct gtp5g_snapmap_hdr
+ *	one section per GTP5G_SNAPMAP_SECT_*, each starting 8 byte aligned
+ *
+ * The record sections are arrays of the structs of gtp5gnl.h sorted by ID,
+ * the index sections arrays of struct gtp5g_snapmap_idx sorted by key, then
+ * by PDR ID. Keys of the UE address index are in host byte order so that
+ * addresses of a subnet are next to each other.
+ */
+#define GTP5G_SNAPMAP_MAGIC	"G5SM"
+#define GTP5G_SNAPMAP_VERSION	1
+#define GTP5G_SNAPMAP_BOM	0x0102
+#define GTP5G_SNAPMAP_ALIGN	8
+
+enum {
+	GTP5G_SNAPMAP_SECT_PDR,
+	GTP5G_SNAPMAP_SECT_FAR,
+	GTP5G_SNAPMAP_SECT_QER,
+	GTP5G_SNAPMAP_SECT_TEID,
+	GTP5G_SNAPMAP_SECT_UE_ADDR,
+	GTP5G_SNAPMAP_SECT_DATA,
+	__GTP5G_SNAPMAP_SECT_MAX,
+};
+
+struct gtp5g_snapmap_sect {
+	uint64_t	offset;
+	uint32_t	count;
+	uint32_t	elem_size;
+};
+
+struct gtp5g_snapmap_hdr {
+	char			magic[4];
+	uint16_t		version;
+	uint16_t		bom;
+	uint32_t		hdr_len;
+	uint32_t		flags;
+	struct gtp5g_snapmap_sect sect[__GTP5G_SNAPMAP_SECT_MAX];
+};
+
+static const uint32_t gtp5g_snapmap_elem_size[__GTP5G_SNAPMAP_SECT_MAX] = {
+	[GTP5G_SNAPMAP_SECT_PDR]	= sizeof(struct gtp5g_snapmap_pdr),
+	[GTP5G_SNAPMAP_SECT_FAR]	= sizeof(struct gtp5g_snapmap_far),
+	[GTP5G_SNAPMAP_SECT_QER]	= sizeof(struct gtp5g_snapmap_qer),
+	[GTP5G_SNAPMAP_SECT_TEID]	= sizeof(struct gtp5g_snapmap_idx),
+	[GTP5G_SNAPMAP_SECT_UE_ADDR]	= sizeof(struct gtp5g_snapmap_idx),
+	[GTP5G_SNAPMAP_SECT_DATA]	= 1,
+};
+
+struct gtp5g_snapmap {
+	const struct gtp5g_allocator *alloc;
+	const char	*base;
+	size_t		len;
+	const void	*sect[__GTP5G_SNAPMAP_SECT_MAX];
+	uint32_t	count[__GTP5G_SNAPMAP_SECT_MAX];
+};
+
+/* A growable array, one per section while the tables are dumped */
+struct gtp5g_snapmap_vec {
+	const struct gtp5g_allocator *alloc;
+	char		*buf;
+	size_t		len;		/* in elements */
+	size_t		size;
+	size_t		elem;
+};
+
+struct gtp5g_snapmap_build {
+	const struct gtp5g_allocator *alloc;
+	struct gtp5g_snapmap_vec sect[__GTP5G_SNAPMAP_SECT_MAX];
+	uint32_t	seen;
+	uint32_t	*order;		/* arrival of each record, for dedup */
+	size_t		order_size;
+};
+
+static void *gtp5g_snapmap_vec_push(struct gtp5g_snapmap_vec *v, size_t n)
+{
+	size_t size = v->size ? v->size : 1024;
+	char *buf;
+
+	if (v->len + n > v->size) {
+		while (size < v->len + n)
+			size *= 2;
+		buf = gtp5g_realloc(v->alloc, v->buf, size * v->elem);
+		if (!buf)
+			return NULL;
+		v->buf = buf;
+		v->size = size;
+	}
+
+	buf = v->buf + v->len * v->elem;
+	memset(buf, 0, n * v->elem);
+	v->len += n;
+	return buf;
+}
+
+/* Copy len bytes into the data section, d stays empty when len is 0 */
+static int gtp5g_snapmap_put_data(struct gtp5g_snapmap_build *b, struct gtp5g_snapmap_data *d,
+				  const void *p, size_t len)
+{
+	struct gtp5g_snapmap_vec *v = &b->sect[GTP5G_SNAPMAP_SECT_DATA];
+	size_t off = v->len;
+	char *buf;
+
+	if (!len)
+		return 0;
+	if (off + len > UINT32_MAX)
+		return -1;
+
+	buf = gtp5g_snapmap_vec_push(v, len);
+	if (!buf)
+		return -1;
+	memcpy(buf, p, len);
+
+	d->off = off;
+	d->len = len;
+	return 0;
+}
+
+static int gtp5g_snapmap_put_order(struct gtp5g_snapmap_build *b, size_t idx)
+{
+	size_t size = b->order_size ? b->order_size : 1024;
+	uint32_t *order;
+
+	if (idx >= b->order_size) {
+		while (size <= idx)
+			size *= 2;
+		order = gtp5g_realloc(b->alloc, b->order, size * sizeof(*order));
+		if (!order)
+			return -1;
+		b->order = order;
+		b->order_size = size;
+	}
+
+	b->order[idx] = b->seen++;
+	return 0;
+}
+
+static int gtp5g_snapmap_pdr_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct gtp5g_snapmap_build *b = data;
+	struct gtp5g_snapmap_pdr *rec;
+	struct ip_filter_rule *rule;
+	struct sdf_filter *sdf;
+	struct gtp5g_pdr *pdr;
+	int ret = MNL_CB_ERROR;
+
+	genl_gtp5g_pdr_attr_cb(nlh, &pdr);
+	if (!pdr)
+		goto err;
+
+	/* Records have room for one filter */
+	if (pdr->pdi && pdr->pdi->sdf && pdr->pdi->sdf->next) {
+		gtp5g_pdr_free(pdr);
+		gtp5g_err_set(EOPNOTSUPP, 0, "several SDF filters in a mapped snapshot");
+		return MNL_CB_ERROR;
+	}
+
+	rec = gtp5g_snapmap_vec_push(&b->sect[GTP5G_SNAPMAP_SECT_PDR], 1);
+	if (!rec || gtp5g_snapmap_put_order(b, b->sect[GTP5G_SNAPMAP_SECT_PDR].len - 1) < 0)
+		goto out;
+
+	rec->id = pdr->id;
+	if (pdr->precedence) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_PRECEDENCE;
+		rec->precedence = *pdr->precedence;
+	}
+	if (pdr->outer_hdr_removal) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_OHR;
+		rec->outer_hdr_removal = *pdr->outer_hdr_removal;
+	}
+	if (pdr->far_id) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_FAR_ID;
+		rec->far_id = *pdr->far_id;
+	}
+	if (pdr->qer_id) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_QER_ID;
+		rec->qer_id = *pdr->qer_id;
+	}
+	if (pdr->role_addr_ipv4) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_ROLE_ADDR;
+		rec->role_addr = pdr->role_addr_ipv4->s_addr;
+	}
+	if (pdr->unix_sock_path &&
+	    gtp5g_snapmap_put_data(b, &rec->unix_sock_path, pdr->unix_sock_path,
+				   strlen(pdr->unix_sock_path) + 1) < 0)
+		goto out;
+
+	if (pdr->pdi && pdr->pdi->ue_addr_ipv4) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_UE_ADDR;
+		rec->ue_addr = pdr->pdi->ue_addr_ipv4->s_addr;
+	}
+	if (pdr->pdi && pdr->pdi->f_teid) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_F_TEID;
+		rec->teid = pdr->pdi->f_teid->teid;
+		rec->gtpu_addr = pdr->pdi->f_teid->gtpu_addr_ipv4.s_addr;
+	}
+
+	sdf = pdr->pdi ? pdr->pdi->sdf : NULL;
+	if (sdf && sdf->rule) {
+		rule = sdf->rule;
+		rec->flags |= GTP5G_SNAPMAP_PDR_SDF_RULE;
+		rec->sdf.action = rule->action;
+		rec->sdf.direction = rule->direction;
+		rec->sdf.proto = rule->proto;
+		rec->sdf.src = rule->src.s_addr;
+		rec->sdf.smask = rule->smask.s_addr;
+		rec->sdf.dest = rule->dest.s_addr;
+		rec->sdf.dmask = rule->dmask.s_addr;
+		if (gtp5g_snapmap_put_data(b, &rec->sdf.sport, rule->sport_list,
+					   rule->sport_num * sizeof(uint32_t)) < 0 ||
+		    gtp5g_snapmap_put_data(b, &rec->sdf.dport, rule->dport_list,
+					   rule->dport_num * sizeof(uint32_t)) < 0)
+			goto out;
+	}
+	if (sdf && sdf->tos_traffic_class) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_SDF_TOS;
+		rec->sdf.tos_traffic_class = *sdf->tos_traffic_class;
+	}
+	if (sdf && sdf->security_param_idx) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_SDF_SPI;
+		rec->sdf.security_param_idx = *sdf->security_param_idx;
+	}
+	if (sdf && sdf->flow_label) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_SDF_FLOW_LABEL;
+		rec->sdf.flow_label = *sdf->flow_label;
+	}
+	if (sdf && sdf->bi_id) {
+		rec->flags |= GTP5G_SNAPMAP_PDR_SDF_ID;
+		rec->sdf.sdf_filter_id = *sdf->bi_id;
+	}
+
+	ret = MNL_CB_OK;
+out:
+	gtp5g_pdr_free(pdr);
+err:
+	if (ret != MNL_CB_OK)
+		gtp5g_err_set(ENOMEM, 0, "snapshot");
+	return ret;
+}
+
+static int gtp5g_snapmap_far_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct gtp5g_snapmap_build *b = data;
+	struct gtp5g_forwarding_parameter *fwd;
+	struct gtp5g_snapmap_far *rec;
+	struct gtp5g_far *far;
+	int ret = MNL_CB_ERROR;
+
+	genl_gtp5g_far_attr_cb(nlh, &far);
+	if (!far)
+		goto err;
+
+	rec = gtp5g_snapmap_vec_push(&b->sect[GTP5G_SNAPMAP_SECT_FAR], 1);
+	if (!rec || gtp5g_snapmap_put_order(b, b->sect[GTP5G_SNAPMAP_SECT_FAR].len - 1) < 0)
+		goto out;
+
+	rec->id = far->id;
+	rec->apply_action = far->apply_action;
+
+	fwd = far->fwd_param;
+	if (fwd && fwd->hdr_creation) {
+		rec->flags |= GTP5G_SNAPMAP_FAR_OHC;
+		rec->ohc_desp = fwd->hdr_creation->desp;
+		rec->ohc_teid = fwd->hdr_creation->teid;
+		rec->ohc_peer_addr = fwd->hdr_creation->peer_addr_ipv4.s_addr;
+		rec->ohc_port = fwd->hdr_creation->port;
+	}
+	if (fwd && fwd->fwd_policy &&
+	    gtp5g_snapmap_put_data(b, &rec->fwd_policy, fwd->fwd_policy->identifier,
+				   strlen(fwd->fwd_policy->identifier) + 1) < 0)
+		goto out;
+
+	ret = MNL_CB_OK;
+out:
+	gtp5g_far_free(far);
+err:
+	if (ret != MNL_CB_OK)
+		gtp5g_err_set(ENOMEM, 0, "snapshot");
+	return ret;
+}
+
+static int gtp5g_snapmap_qer_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct gtp5g_snapmap_build *b = data;
+	struct gtp5g_snapmap_qer *rec;
+	struct gtp5g_qer *qer;
+	int ret = MNL_CB_ERROR;
+
+	genl_gtp5g_qer_attr_cb(nlh, &qer);
+	if (!qer)
+		goto err;
+
+	rec = gtp5g_snapmap_vec_push(&b->sect[GTP5G_SNAPMAP_SECT_QER], 1);
+	if (!rec || gtp5g_snapmap_put_order(b, b->sect[GTP5G_SNAPMAP_SECT_QER].len - 1) < 0)
+		goto out;
+
+	rec->id = qer->id;
+	rec->ul_dl_gate = qer->ul_dl_gate;
+	rec->qfi = qer->qfi;
+	rec->rqi = qer->rqi;
+	rec->ppi = qer->ppi;
+	rec->mbr_ul_high = qer->mbr.ul_high;
+	rec->mbr_ul_low = qer->mbr.ul_low;
+	rec->mbr_dl_high = qer->mbr.dl_high;
+	rec->mbr_dl_low = qer->mbr.dl_low;
+	rec->gbr_ul_high = qer->gbr.ul_high;
+	rec->gbr_ul_low = qer->gbr.ul_low;
+	rec->gbr_dl_high = qer->gbr.dl_high;
+	rec->gbr_dl_low = qer->gbr.dl_low;
+	rec->qer_corr_id = qer->qer_corr_id;
+	rec->rcsr = qer->rcsr;
+
+	ret = MNL_CB_OK;
+out:
+	gtp5g_qer_free(qer);
+err:
+	if (ret != MNL_CB_OK)
+		gtp5g_err_set(ENOMEM, 0, "snapshot");
+	return ret;
+}
+
+static const struct {
+	uint8_t		get;
+	int		(*cb)(const struct nlmsghdr *nlh, void *data);
+} gtp5g_snapmap_tables[] = {
+	[GTP5G_SNAPMAP_SECT_PDR] = { GTP5G_CMD_GET_PDR, gtp5g_snapmap_pdr_cb },
+	[GTP5G_SNAPMAP_SECT_FAR] = { GTP5G_CMD_GET_FAR, gtp5g_snapmap_far_cb },
+	[GTP5G_SNAPMAP_SECT_QER] = { GTP5G_CMD_GET_QER, gtp5g_snapmap_qer_cb },
+};
+
+/* All the records start with their ID, the one of a PDR is 16 bits wide */
+static uint32_t gtp5g_snapmap_rec_id(int sect, const void *rec)
+{
+	switch (sect) {
+	case GTP5G_SNAPMAP_SECT_PDR:
+		return ((const struct gtp5g_snapmap_pdr *)rec)->id;
+	case GTP5G_SNAPMAP_SECT_FAR:
+		return ((const struct gtp5g_snapmap_far *)rec)->id;
+	default:
+		return ((const struct gtp5g_snapmap_qer *)rec)->id;
+	}
+}
+
+struct gtp5g_snapmap_sort {
+	uint32_t	id;
+	uint32_t	seen;
+	uint32_t	idx;
+};
+
+static int gtp5g_snapmap_sort_cmp(const void *a, const void *b)
+{
+	const struct gtp5g_snapmap_sort *x = a, *y = b;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->seen < y->seen ? -1 : x->seen > y->seen;
+}
+
+/* Sort the records of a section by ID. A restarted dump delivers rules
+ * again, the last copy of each wins. */
+static int gtp5g_snapmap_sort(struct gtp5g_snapmap_build *b, int sect)
+{
+	struct gtp5g_snapmap_vec *v = &b->sect[sect];
+	struct gtp5g_snapmap_sort *s;
+	size_t i, n = 0;
+	char *buf;
+
+	if (!v->len)
+		return 0;
+
+	s = gtp5g_malloc(v->alloc, v->len * sizeof(*s));
+	buf = gtp5g_malloc(v->alloc, v->len * v->elem);
+	if (!s || !buf) {
+		gtp5g_free(v->alloc, s);
+		gtp5g_free(v->alloc, buf);
+		return -1;
+	}
+
+	for (i = 0; i < v->len; i++) {
+		s[i].id = gtp5g_snapmap_rec_id(sect, v->buf + i * v->elem);
+		s[i].seen = b->order[i];
+		s[i].idx = i;
+	}
+	qsort(s, v->len, sizeof(*s), gtp5g_snapmap_sort_cmp);
+
+	for (i = 0; i < v->len; i++) {
+		if (i + 1 < v->len && s[i + 1].id == s[i].id)
+			continue;
+		memcpy(buf + n++ * v->elem, v->buf + s[i].idx * v->elem, v->elem);
+	}
+
+	gtp5g_free(v->alloc, s);
+	gtp5g_free(v->alloc, v->buf);
+	v->buf = buf;
+	v->len = n;
+	v->size = n;
+	return 0;
+}
+
+static int gtp5g_snapmap_idx_cmp(const void *a, const void *b)
+{
+	const struct gtp5g_snapmap_idx *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return x->pdr < y->pdr ? -1 : x->pdr > y->pdr;
+}
+
+static int gtp5g_snapmap_index(struct gtp5g_snapmap_build *b)
+{
+	const struct gtp5g_snapmap_vec *pdrs = &b->sect[GTP5G_SNAPMAP_SECT_PDR];
+	struct gtp5g_snapmap_vec *teid = &b->sect[GTP5G_SNAPMAP_SECT_TEID];
+	struct gtp5g_snapmap_vec *ue = &b->sect[GTP5G_SNAPMAP_SECT_UE_ADDR];
+	const struct gtp5g_snapmap_pdr *pdr;
+	struct gtp5g_snapmap_idx *idx;
+	size_t i;
+
+	for (i = 0; i < pdrs->len; i++) {
+		pdr = (const struct gtp5g_snapmap_pdr *)pdrs->buf + i;
+
+		if (pdr->flags & GTP5G_SNAPMAP_PDR_F_TEID) {
+			idx = gtp5g_snapmap_vec_push(teid, 1);
+			if (!idx)
+				return -1;
+			idx->key = pdr->teid;
+			idx->pdr = i;
+		}
+		if (pdr->flags & GTP5G_SNAPMAP_PDR_UE_ADDR) {
+			idx = gtp5g_snapmap_vec_push(ue, 1);
+			if (!idx)
+				return -1;
+			idx->key = ntohl(pdr->ue_addr);
+			idx->pdr = i;
+		}
+	}
+
+	if (teid->len)
+		qsort(teid->buf, teid->len, teid->elem, gtp5g_snapmap_idx_cmp);
+	if (ue->len)
+		qsort(ue->buf, ue->len, ue->elem, gtp5g_snapmap_idx_cmp);
+	return 0;
+}
+
+static int gtp5g_snapmap_write(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, p, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+int gtp5g_snapmap_save(int genl_id, struct mnl_socket *nl, int fd,
+		       struct gtp5g_snapshot_stats *stats)
+{
+	static const char pad[GTP5G_SNAPMAP_ALIGN];
+	struct gtp5g_snapmap_build b = {};
+	struct gtp5g_snapmap_hdr hdr = {
+		.version	= GTP5G_SNAPMAP_VERSION,
+		.bom		= GTP5G_SNAPMAP_BOM,
+		.hdr_len	= sizeof(hdr),
+	};
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nlmsghdr *nlh;
+	uint64_t offset = sizeof(hdr);
+	uint32_t seq = time(NULL);
+	size_t len;
+	int k, ret = -1;
+
+	memcpy(hdr.magic, GTP5G_SNAPMAP_MAGIC, sizeof(hdr.magic));
+	b.alloc = gtp5g_allocator;
+	for (k = 0; k < __GTP5G_SNAPMAP_SECT_MAX; k++) {
+		b.sect[k].alloc = b.alloc;
+		b.sect[k].elem = gtp5g_snapmap_elem_size[k];
+	}
+
+	for (k = GTP5G_SNAPMAP_SECT_PDR; k <= GTP5G_SNAPMAP_SECT_QER; k++) {
+		b.seen = 0;
+		nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_DUMP, ++seq,
+					   gtp5g_snapmap_tables[k].get);
+		if (gtp5g_socket_talk(nl, nlh, seq, gtp5g_snapmap_tables[k].cb, &b, 0) < 0)
+			goto out;
+
+		if (gtp5g_snapmap_sort(&b, k) < 0)
+			goto err_nomem;
+	}
+
+	if (gtp5g_snapmap_index(&b) < 0)
+		goto err_nomem;
+
+	for (k = 0; k < __GTP5G_SNAPMAP_SECT_MAX; k++) {
+		offset = (offset + GTP5G_SNAPMAP_ALIGN - 1) & ~(uint64_t)(GTP5G_SNAPMAP_ALIGN - 1);
+		hdr.sect[k].offset = offset;
+		hdr.sect[k].count = b.sect[k].len;
+		hdr.sect[k].elem_size = b.sect[k].elem;
+		offset += (uint64_t)b.sect[k].len * b.sect[k].elem;
+	}
+
+	if (gtp5g_snapmap_write(fd, &hdr, sizeof(hdr)) < 0)
+		goto err_write;
+
+	offset = sizeof(hdr);
+	for (k = 0; k < __GTP5G_SNAPMAP_SECT_MAX; k++) {
+		if (gtp5g_snapmap_write(fd, pad, hdr.sect[k].offset - offset) < 0)
+			goto err_write;
+
+		len = b.sect[k].len * b.sect[k].elem;
+		if (gtp5g_snapmap_write(fd, b.sect[k].buf, len) < 0)
+			goto err_write;
+		offset = hdr.sect[k].offset + len;
+	}
+
+	if (stats) {
+		memset(stats, 0, sizeof(*stats));
+		stats->pdr = b.sect[GTP5G_SNAPMAP_SECT_PDR].len;
+		stats->far = b.sect[GTP5G_SNAPMAP_SECT_FAR].len;
+		stats->qer = b.sect[GTP5G_SNAPMAP_SECT_QER].len;
+	}
+	ret = 0;
+	goto out;
+
+err_nomem:
+	gtp5g_err_fail(ENOMEM, 0, 0, "snapshot");
+	goto out;
+err_write:
+	gtp5g_err_fail(errno, 0, 0, "write snapshot");
+out:
+	for (k = 0; k < __GTP5G_SNAPMAP_SECT_MAX; k++)
+		gtp5g_free(b.alloc, b.sect[k].buf);
+	gtp5g_free(b.alloc, b.order);
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_snapmap_save);
+
+static int gtp5g_snapmap_check(const struct gtp5g_snapmap_hdr *hdr, size_t len)
+{
+	uint64_t size;
+	int k;
+
+	if (len < sizeof(*hdr) || memcmp(hdr->magic, GTP5G_SNAPMAP_MAGIC, sizeof(hdr->magic)))
+		return -1;
+	if (hdr->bom != GTP5G_SNAPMAP_BOM || hdr->version != GTP5G_SNAPMAP_VERSION ||
+	    hdr->hdr_len < sizeof(*hdr))
+		return -1;
+
+	for (k = 0; k < __GTP5G_SNAPMAP_SECT_MAX; k++) {
+		if (hdr->sect[k].elem_size != gtp5g_snapmap_elem_size[k] ||
+		    hdr->sect[k].offset % GTP5G_SNAPMAP_ALIGN ||
+		    hdr->sect[k].offset < hdr->hdr_len || hdr->sect[k].offset > len)
+			return -1;
+
+		size = (uint64_t)hdr->sect[k].count * hdr->sect[k].elem_size;
+		if (size > len - hdr->sect[k].offset)
+			return -1;
+	}
+
+	return 0;
+}
+
+struct gtp5g_snapmap *gtp5g_snapmap_open(const char *path)
+{
+	const struct gtp5g_snapmap_hdr *hdr;
+	struct gtp5g_snapmap *m;
+	struct stat st;
+	void *base;
+	int fd, k;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		gtp5g_err_fail(errno, 0, 0, "open snapshot");
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0) {
+		gtp5g_err_fail(errno, 0, 0, "stat snapshot");
+		close(fd);
+		return NULL;
+	}
+	if ((size_t)st.st_size < sizeof(*hdr)) {
+		gtp5g_err_fail(EINVAL, 0, 0, "not a gtp5g mapped snapshot");
+		close(fd);
+		return NULL;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		gtp5g_err_fail(errno, 0, 0, "mmap snapshot");
+		return NULL;
+	}
+
+	hdr = base;
+	if (gtp5g_snapmap_check(hdr, st.st_size) < 0) {
+		gtp5g_err_fail(EINVAL, 0, 0, "not a gtp5g mapped snapshot, or of another version");
+		goto err;
+	}
+
+	m = gtp5g_calloc(gtp5g_allocator, 1, sizeof(*m));
+	if (!m) {
+		gtp5g_err_fail(ENOMEM, 0, 0, "snapshot");
+		goto err;
+	}
+
+	m->alloc = gtp5g_allocator;
+	m->base = base;
+	m->len = st.st_size;
+	for (k = 0; k < __GTP5G_SNAPMAP_SECT_MAX; k++) {
+		m->sect[k] = m->base + hdr->sect[k].offset;
+		m->count[k] = hdr->sect[k].count;
+	}
+	return m;
+err:
+	munmap(base, st.st_size);
+	return NULL;
+}
+EXPORT_SYMBOL(gtp5g_snapmap_open);
+
+void gtp5g_snapmap_close(struct gtp5g_snapmap *m)
+{
+	if (!m)
+		return;
+
+	munmap((void *)m->base, m->len);
+	gtp5g_free(m->alloc, m);
+}
+EXPORT_SYMBOL(gtp5g_snapmap_close);
+
+const struct gtp5g_snapmap_pdr *gtp5g_snapmap_pdrs(const struct gtp5g_snapmap *m, uint32_t *num)
+{
+	*num = m->count[GTP5G_SNAPMAP_SECT_PDR];
+	return m->sect[GTP5G_SNAPMAP_SECT_PDR];
+}
+EXPORT_SYMBOL(gtp5g_snapmap_pdrs);
+
+const struct gtp5g_snapmap_far *gtp5g_snapmap_fars(const struct gtp5g_snapmap *m, uint32_t *num)
+{
+	*num = m->count[GTP5G_SNAPMAP_SECT_FAR];
+	return m->sect[GTP5G_SNAPMAP_SECT_FAR];
+}
+EXPORT_SYMBOL(gtp5g_snapmap_fars);
+
+const struct gtp5g_snapmap_qer *gtp5g_snapmap_qers(const struct gtp5g_snapmap *m, uint32_t *num)
+{
+	*num = m->count[GTP5G_SNAPMAP_SECT_QER];
+	return m->sect[GTP5G_SNAPMAP_SECT_QER];
+}
+EXPORT_SYMBOL(gtp5g_snapmap_qers);
+
+/* Binary search of a record section sorted by ID */
+static const void *gtp5g_snapmap_find(const struct gtp5g_snapmap *m, int sect, uint32_t id)
+{
+	const char *recs = m->sect[sect];
+	uint32_t lo = 0, hi = m->count[sect], mid, cur;
+	size_t elem = gtp5g_snapmap_elem_size[sect];
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cur = gtp5g_snapmap_rec_id(sect, recs + mid * elem);
+		if (cur == id)
+			return recs + mid * elem;
+		if (cur < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+const struct gtp5g_snapmap_pdr *gtp5g_snapmap_find_pdr(const struct gtp5g_snapmap *m, uint16_t id)
+{
+	return gtp5g_snapmap_find(m, GTP5G_SNAPMAP_SECT_PDR, id);
+}
+EXPORT_SYMBOL(gtp5g_snapmap_find_pdr);
+
+const struct gtp5g_snapmap_far *gtp5g_snapmap_find_far(const struct gtp5g_snapmap *m, uint32_t id)
+{
+	return gtp5g_snapmap_find(m, GTP5G_SNAPMAP_SECT_FAR, id);
+}
+EXPORT_SYMBOL(gtp5g_snapmap_find_far);
+
+const struct gtp5g_snapmap_qer *gtp5g_snapmap_find_qer(const struct gtp5g_snapmap *m, uint32_t id)
+{
+	return gtp5g_snapmap_find(m, GTP5G_SNAPMAP_SECT_QER, id);
+}
+EXPORT_SYMBOL(gtp5g_snapmap_find_qer);
+
+/* The run of index entries with the given key */
+static const struct gtp5g_snapmap_idx *gtp5g_snapmap_lookup(const struct gtp5g_snapmap *m,
+							    int sect, uint32_t key,
+							    uint32_t *num)
+{
+	const struct gtp5g_snapmap_idx *idx = m->sect[sect];
+	uint32_t lo = 0, hi = m->count[sect], mid, first;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (idx[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	first = lo;
+
+	hi = m->count[sect];
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (idx[mid].key <= key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* An entry pointing past the PDRs would hand out memory outside of
+	 * the file, refuse the whole run */
+	for (mid = first; mid < lo; mid++) {
+		if (idx[mid].pdr >= m->count[GTP5G_SNAPMAP_SECT_PDR])
+			lo = first;
+	}
+
+	*num = lo - first;
+	return *num ? idx + first : NULL;
+}
+
+const struct gtp5g_snapmap_idx *gtp5g_snapmap_pdrs_by_teid(const struct gtp5g_snapmap *m,
+							  uint32_t teid, uint32_t *num)
+{
+	return gtp5g_snapmap_lookup(m, GTP5G_SNAPMAP_SECT_TEID, teid, num);
+}
+EXPORT_SYMBOL(gtp5g_snapmap_pdrs_by_teid);
+
+const struct gtp5g_snapmap_idx *gtp5g_snapmap_pdrs_by_ue_addr(const struct gtp5g_snapmap *m,
+							     uint32_t ue_addr, uint32_t *num)
+{
+	return gtp5g_snapmap_lookup(m, GTP5G_SNAPMAP_SECT_UE_ADDR, ntohl(ue_addr), num);
+}
+EXPORT_SYMBOL(gtp5g_snapmap_pdrs_by_ue_addr);
+
+const void *gtp5g_snapmap_get_data(const struct gtp5g_snapmap *m,
+				   const struct gtp5g_snapmap_data *d)
+{
+	uint32_t size = m->count[GTP5G_SNAPMAP_SECT_DATA];
+
+	if (!d->len || d->off > size || d->len > size - d->off)
+		return NULL;
+
+	return (const char *)m->sect[GTP5G_SNAPMAP_SECT_DATA] + d->off;
+}
+EXPORT_SYMBOL(gtp5g_snapmap_get_data);
@@ -0,0 +1,491 @@
+/* Binary snapshots of the PDR/FAR/QER tables */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/genetlink.h>
+
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+
+/*
+ * File layout, in the byte order of the host that wrote it:
+ *
+ *	struct gtp5g_snap_hdr
+ *	QER section, FAR section, PDR section
+ *
+ * A section is a stream of records sorted by rule ID. A record is a netlink
+ * attribute of type GTP5G_CMD_ADD_*, holding the attributes of the rule as
+ * the kernel dumped them, less the device and the related PDR lists. The
+ * sections are in the order they have to be restored in, so that PDRs find
+ * the FARs and QERs they refer to.
+ */
+#define GTP5G_SNAP_MAGIC	"G5SN"
+#define GTP5G_SNAP_VERSION	1
+#define GTP5G_SNAP_BOM		0x0102
+
+/* Rules restored per gtp5g_batch_send() */
+#define GTP5G_SNAP_BATCH	4096
+
+enum {
+	GTP5G_SNAP_QER,
+	GTP5G_SNAP_FAR,
+	GTP5G_SNAP_PDR,
+	__GTP5G_SNAP_MAX,
+};
+
+struct gtp5g_snap_sect {
+	uint32_t	count;
+	uint32_t	len;
+	uint64_t	offset;
+};
+
+struct gtp5g_snap_hdr {
+	char			magic[4];
+	uint16_t		version;
+	uint16_t		bom;
+	uint32_t		hdr_len;
+	uint32_t		flags;
+	struct gtp5g_snap_sect	sect[__GTP5G_SNAP_MAX];
+};
+
+static const struct {
+	uint8_t		get;
+	uint8_t		add;
+	uint16_t	related;
+	uint16_t	id;		/* attribute of the rule ID */
+	uint16_t	id_len;		/* PDR IDs are 16 bits wide, FAR and QER IDs 32 */
+} gtp5g_snap_kinds[__GTP5G_SNAP_MAX] = {
+	[GTP5G_SNAP_QER] = { GTP5G_CMD_GET_QER, GTP5G_CMD_ADD_QER, GTP5G_QER_RELATED_TO_PDR,
+			     GTP5G_QER_ID, sizeof(uint32_t) },
+	[GTP5G_SNAP_FAR] = { GTP5G_CMD_GET_FAR, GTP5G_CMD_ADD_FAR, GTP5G_FAR_RELATED_TO_PDR,
+			     GTP5G_FAR_ID, sizeof(uint32_t) },
+	[GTP5G_SNAP_PDR] = { GTP5G_CMD_GET_PDR, GTP5G_CMD_ADD_PDR, 0,
+			     GTP5G_PDR_ID, sizeof(uint16_t) },
+};
+
+/* The ID of a rule of kind in attribute attr of its type, 0 when too short */
+static uint32_t gtp5g_snap_id(const struct nlattr *attr, int kind)
+{
+	if (mnl_attr_get_payload_len(attr) < gtp5g_snap_kinds[kind].id_len)
+		return 0;
+	return gtp5g_snap_kinds[kind].id_len == sizeof(uint16_t) ?
+	       mnl_attr_get_u16(attr) : mnl_attr_get_u32(attr);
+}
+
+struct gtp5g_snap_rec {
+	uint32_t	id;
+	uint32_t	seen;		/* order of arrival */
+	uint32_t	off;
+	uint32_t	len;
+};
+
+/* One table while it is being dumped */
+struct gtp5g_snap_dump {
+	const struct gtp5g_allocator *alloc;
+	int		kind;
+	char		*buf;
+	size_t		len;
+	size_t		size;
+	struct gtp5g_snap_rec *recs;
+	uint32_t	num;
+	uint32_t	max;
+};
+
+static int gtp5g_snap_grow(const struct gtp5g_allocator *a, void **p, size_t *size,
+			   size_t need, size_t elem)
+{
+	size_t n = *size ? *size : 1024;
+	void *q;
+
+	if (need <= *size)
+		return 0;
+	while (n < need)
+		n *= 2;
+
+	q = gtp5g_realloc(a, *p, n * elem);
+	if (!q)
+		return -1;
+	*p = q;
+	*size = n;
+	return 0;
+}
+
+static int gtp5g_snap_dump_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct gtp5g_snap_dump *d = data;
+	const struct nlattr *attr;
+	struct nlattr *rec;
+	size_t max = d->max;
+	uint32_t id = 0;
+	size_t len = 0;
+	char *p;
+
+	mnl_attr_for_each(attr, nlh, sizeof(struct genlmsghdr)) {
+		if (mnl_attr_get_type(attr) <= GTP5G_NET_NS_FD ||
+		    mnl_attr_get_type(attr) == gtp5g_snap_kinds[d->kind].related)
+			continue;
+		len += MNL_ALIGN(attr->nla_len);
+	}
+
+	if (MNL_ATTR_HDRLEN + len > UINT16_MAX) {
+		gtp5g_err_set(EMSGSIZE, 0, "rule too large for a snapshot record");
+		return MNL_CB_ERROR;
+	}
+
+	if (gtp5g_snap_grow(d->alloc, (void **)&d->buf, &d->size,
+			    d->len + MNL_ATTR_HDRLEN + len, 1) < 0 ||
+	    gtp5g_snap_grow(d->alloc, (void **)&d->recs, &max, d->num + 1,
+			    sizeof(*d->recs)) < 0) {
+		gtp5g_err_set(ENOMEM, 0, "snapshot");
+		return MNL_CB_ERROR;
+	}
+	d->max = max;
+
+	rec = (struct nlattr *)(d->buf + d->len);
+	rec->nla_type = gtp5g_snap_kinds[d->kind].add;
+	rec->nla_len = MNL_ATTR_HDRLEN + len;
+	p = mnl_attr_get_payload(rec);
+
+	mnl_attr_for_each(attr, nlh, sizeof(struct genlmsghdr)) {
+		if (mnl_attr_get_type(attr) <= GTP5G_NET_NS_FD ||
+		    mnl_attr_get_type(attr) == gtp5g_snap_kinds[d->kind].related)
+			continue;
+
+		if (mnl_attr_get_type(attr) == gtp5g_snap_kinds[d->kind].id)
+			id = gtp5g_snap_id(attr, d->kind);
+
+		memcpy(p, attr, attr->nla_len);
+		memset(p + attr->nla_len, 0, MNL_ALIGN(attr->nla_len) - attr->nla_len);
+		p += MNL_ALIGN(attr->nla_len);
+	}
+
+	d->recs[d->num].id = id;
+	d->recs[d->num].seen = d->num;
+	d->recs[d->num].off = d->len;
+	d->recs[d->num].len = rec->nla_len;
+	d->num++;
+	d->len += rec->nla_len;
+
+	return MNL_CB_OK;
+}
+
+static int gtp5g_snap_rec_cmp(const void *a, const void *b)
+{
+	const struct gtp5g_snap_rec *x = a, *y = b;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->seen < y->seen ? -1 : x->seen > y->seen;
+}
+
+/* A restarted dump delivers rules again, the last copy of each wins */
+static void gtp5g_snap_dedup(struct gtp5g_snap_dump *d)
+{
+	uint32_t i, n = 0;
+
+	qsort(d->recs, d->num, sizeof(*d->recs), gtp5g_snap_rec_cmp);
+
+	for (i = 0; i < d->num; i++) {
+		if (i + 1 < d->num && d->recs[i + 1].id == d->recs[i].id)
+			continue;
+		d->recs[n++] = d->recs[i];
+	}
+	d->num = n;
+}
+
+static int gtp5g_snap_write(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, p, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+int gtp5g_snapshot_save(int genl_id, struct mnl_socket *nl, int fd,
+			struct gtp5g_snapshot_stats *stats)
+{
+	struct gtp5g_snap_dump d[__GTP5G_SNAP_MAX] = {};
+	struct gtp5g_snap_hdr hdr = {
+		.version	= GTP5G_SNAP_VERSION,
+		.bom		= GTP5G_SNAP_BOM,
+		.hdr_len	= sizeof(hdr),
+	};
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nlmsghdr *nlh;
+	uint64_t offset = sizeof(hdr);
+	uint32_t seq = time(NULL);
+	uint32_t i;
+	int k, ret = -1;
+
+	memcpy(hdr.magic, GTP5G_SNAP_MAGIC, sizeof(hdr.magic));
+
+	for (k = 0; k < __GTP5G_SNAP_MAX; k++) {
+		d[k].alloc = gtp5g_allocator;
+		d[k].kind = k;
+		nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_DUMP, ++seq,
+					   gtp5g_snap_kinds[k].get);
+		if (gtp5g_socket_talk(nl, nlh, seq, gtp5g_snap_dump_cb, &d[k], 0) < 0)
+			goto out;
+
+		gtp5g_snap_dedup(&d[k]);
+
+		hdr.sect[k].count = d[k].num;
+		hdr.sect[k].offset = offset;
+		for (i = 0; i < d[k].num; i++)
+			hdr.sect[k].len += d[k].recs[i].len;
+		offset += hdr.sect[k].len;
+	}
+
+	if (gtp5g_snap_write(fd, &hdr, sizeof(hdr)) < 0)
+		goto err_write;
+
+	for (k = 0; k < __GTP5G_SNAP_MAX; k++) {
+		for (i = 0; i < d[k].num; i++) {
+			if (gtp5g_snap_write(fd, d[k].buf + d[k].recs[i].off,
+					     d[k].recs[i].len) < 0)
+				goto err_write;
+		}
+	}
+
+	if (stats) {
+		memset(stats, 0, sizeof(*stats));
+		stats->pdr = d[GTP5G_SNAP_PDR].num;
+		stats->far = d[GTP5G_SNAP_FAR].num;
+		stats->qer = d[GTP5G_SNAP_QER].num;
+	}
+	ret = 0;
+	goto out;
+
+err_write:
+	gtp5g_err_fail(errno, 0, 0, "write snapshot");
+out:
+	for (k = 0; k < __GTP5G_SNAP_MAX; k++) {
+		gtp5g_free(d[k].alloc, d[k].buf);
+		gtp5g_free(d[k].alloc, d[k].recs);
+	}
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_snapshot_save);
+
+static char *gtp5g_snap_read(const struct gtp5g_allocator *a, int fd, size_t *len)
+{
+	size_t size = 0, n = 0;
+	char *buf = NULL;
+	ssize_t ret;
+
+	for (;;) {
+		if (gtp5g_snap_grow(a, (void **)&buf, &size, n + 65536, 1) < 0) {
+			errno = ENOMEM;
+			goto err;
+		}
+		ret = read(fd, buf + n, size - n);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			goto err;
+		}
+		if (ret == 0)
+			break;
+		n += ret;
+	}
+
+	*len = n;
+	return buf;
+err:
+	gtp5g_free(a, buf);
+	return NULL;
+}
+
+static int gtp5g_snap_check(const char *buf, size_t len)
+{
+	const struct gtp5g_snap_hdr *hdr = (const struct gtp5g_snap_hdr *)buf;
+	int k;
+
+	if (len < sizeof(*hdr) || memcmp(hdr->magic, GTP5G_SNAP_MAGIC, sizeof(hdr->magic)))
+		return -1;
+	if (hdr->bom != GTP5G_SNAP_BOM || hdr->version != GTP5G_SNAP_VERSION ||
+	    hdr->hdr_len < sizeof(*hdr))
+		return -1;
+
+	for (k = 0; k < __GTP5G_SNAP_MAX; k++) {
+		if (hdr->sect[k].offset < hdr->hdr_len || hdr->sect[k].offset > len ||
+		    hdr->sect[k].len > len - hdr->sect[k].offset)
+			return -1;
+	}
+
+	return 0;
+}
+
+static uint32_t gtp5g_snap_rec_id(const struct nlattr *rec, int kind)
+{
+	const struct nlattr *attr;
+
+	mnl_attr_for_each_nested(attr, rec) {
+		if (mnl_attr_get_type(attr) == gtp5g_snap_kinds[kind].id)
+			return gtp5g_snap_id(attr, kind);
+	}
+
+	return 0;
+}
+
+struct gtp5g_snap_restore {
+	gtp5g_batch_err_cb_t	cb;
+	void			*data;
+	unsigned int		base;	/* index of the first rule of the batch */
+};
+
+static void gtp5g_snap_restore_err(unsigned int index, const struct gtp5g_err *err,
+				   void *data)
+{
+	struct gtp5g_snap_restore *r = data;
+
+	if (r->cb)
+		r->cb(r->base + index, err, r->data);
+}
+
+static int gtp5g_snap_flush(struct gtp5g_batch *b, struct gtp5g_snap_restore *r,
+			    uint32_t *failed)
+{
+	unsigned int num = gtp5g_batch_count(b);
+	int ret;
+
+	ret = gtp5g_batch_send(b, gtp5g_snap_restore_err, r);
+	if (ret < 0)
+		return -1;
+
+	*failed += ret;
+	r->base += num;
+	return 0;
+}
+
+/* Rules are indexed in file order for cb: QERs, then FARs, then PDRs */
+int gtp5g_snapshot_restore(int genl_id, struct mnl_socket *nl, struct gtp5g_dev *dev,
+			   int fd, struct gtp5g_snapshot_stats *stats,
+			   gtp5g_batch_err_cb_t cb, void *data)
+{
+	struct gtp5g_snap_restore r = {
+		.cb	= cb,
+		.data	= data,
+	};
+	const struct gtp5g_snap_hdr *hdr;
+	struct gtp5g_snapshot_stats st = {};
+	const struct gtp5g_allocator *a = gtp5g_allocator;
+	struct gtp5g_batch *b = NULL;
+	const struct nlattr *rec;
+	struct nlmsghdr *nlh;
+	size_t len = 0;
+	const char *end;
+	char *buf;
+	int k, ret = -1;
+	uint32_t *count;
+
+	if (!dev) {
+		gtp5g_err_fail(EINVAL, 0, 0, "5G GTP device is NULL");
+		return -1;
+	}
+
+	buf = gtp5g_snap_read(a, fd, &len);
+	if (!buf) {
+		gtp5g_err_fail(errno, 0, 0, "read snapshot");
+		return -1;
+	}
+	if (gtp5g_snap_check(buf, len) < 0) {
+		gtp5g_err_fail(EINVAL, 0, 0, "not a gtp5g snapshot, or of another version");
+		goto out;
+	}
+	hdr = (const struct gtp5g_snap_hdr *)buf;
+
+	b = gtp5g_batch_alloc_with(a, genl_id, nl);
+	if (!b)
+		goto out;
+
+	for (k = 0; k < __GTP5G_SNAP_MAX; k++) {
+		count = k == GTP5G_SNAP_PDR ? &st.pdr : k == GTP5G_SNAP_FAR ? &st.far : &st.qer;
+
+		rec = (const struct nlattr *)(buf + hdr->sect[k].offset);
+		end = buf + hdr->sect[k].offset + hdr->sect[k].len;
+		for (; mnl_attr_ok(rec, end - (const char *)rec); rec = mnl_attr_next(rec)) {
+			if (mnl_attr_get_type(rec) != gtp5g_snap_kinds[k].add ||
+			    mnl_attr_get_payload_len(rec) > MNL_SOCKET_BUFFER_SIZE / 2) {
+				gtp5g_err_fail(EINVAL, gtp5g_snap_kinds[k].add, 0,
+					       "corrupted snapshot record");
+				goto out;
+			}
+
+			nlh = gtp5g_batch_put_size(b, NLM_F_EXCL, gtp5g_snap_kinds[k].add,
+						   gtp5g_snap_rec_id(rec, k),
+						   GTP5G_MSG_HDR_SIZE + GTP5G_DEV_SIZE(dev) +
+						   MNL_ALIGN(mnl_attr_get_payload_len(rec)));
+			if (!nlh)
+				goto out;
+
+			if (dev->ifns >= 0)
+				mnl_attr_put_u32(nlh, GTP5G_NET_NS_FD, dev->ifns);
+			mnl_attr_put_u32(nlh, GTP5G_LINK, dev->ifidx);
+			memcpy(mnl_nlmsg_get_payload_tail(nlh), mnl_attr_get_payload(rec),
+			       mnl_attr_get_payload_len(rec));
+			nlh->nlmsg_len += MNL_ALIGN(mnl_attr_get_payload_len(rec));
+
+			gtp5g_batch_commit(b, nlh);
+			(*count)++;
+
+			if (gtp5g_batch_count(b) == GTP5G_SNAP_BATCH &&
+			    gtp5g_snap_flush(b, &r, &st.failed) < 0)
+				goto out;
+		}
+
+		/* A record mnl_attr_ok() rejects ends the loop early */
+		if ((const char *)rec != end || *count != hdr->sect[k].count) {
+			gtp5g_err_fail(EINVAL, gtp5g_snap_kinds[k].add, 0,
+				       "truncated snapshot section");
+			goto out;
+		}
+	}
+
+	if (gtp5g_snap_flush(b, &r, &st.failed) < 0)
+		goto out;
+
+	if (stats)
+		*stats = st;
+	ret = st.failed;
+out:
+	gtp5g_batch_free(b);
+	gtp5g_free(a, buf);
+	return ret;
+}
+EXPORT_SYMBOL(gtp5g_snapshot_restore);
@@ -0,0 +1,422 @@
+/* io_uring transport of genl_socket_talk(), batches and async requests */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/io_uring.h>
+
+#include "internal.h"
+
+/* user_data of an SQE: the number of the gtp5g_uring_run() call it was
+ * queued by, so that a CQE left over from an earlier call is never taken
+ * for one of the current call, and its index in the call */
+#define GTP5G_URING_DATA(gen, idx)	((uint64_t)(gen) << 32 | (idx))
+#define GTP5G_URING_CANCEL		0xffffffffu
+
+struct gtp5g_uring {
+	const struct gtp5g_allocator *alloc;
+	int			fd;
+	unsigned int		*sq_tail;
+	unsigned int		*sq_mask;
+	unsigned int		*sq_array;
+	unsigned int		*cq_head;
+	unsigned int		*cq_tail;
+	unsigned int		*cq_mask;
+	struct io_uring_sqe	*sqes;
+	struct io_uring_cqe	*cqes;
+	void			*sq_ring;
+	void			*cq_ring;
+	size_t			sq_ring_size;
+	size_t			cq_ring_size;
+	size_t			sqes_size;
+	uint32_t		gen;
+};
+
+/* One ring per thread, set up on first use and torn down at thread exit */
+static __thread struct gtp5g_uring *gtp5g_uring;
+static __thread int gtp5g_uring_unavailable;
+
+static pthread_key_t gtp5g_uring_key;
+static pthread_once_t gtp5g_uring_once = PTHREAD_ONCE_INIT;
+
+static void gtp5g_uring_free(void *data)
+{
+	struct gtp5g_uring *ring = data;
+
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	close(ring->fd);
+	gtp5g_free(ring->alloc, ring);
+}
+
+static void gtp5g_uring_key_create(void)
+{
+	pthread_key_create(&gtp5g_uring_key, gtp5g_uring_free);
+}
+
+static void *gtp5g_uring_mmap(int fd, size_t size, off_t offset)
+{
+	void *ptr;
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		   fd, offset);
+	return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static struct gtp5g_uring *gtp5g_uring_setup(void)
+{
+	struct io_uring_params p = {};
+	struct gtp5g_uring *ring;
+	char *sq, *cq;
+
+	ring = gtp5g_calloc(gtp5g_allocator, 1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	ring->alloc = gtp5g_allocator;
+	ring->fd = syscall(__NR_io_uring_setup, GTP5G_URING_ENTRIES, &p);
+	if (ring->fd < 0) {
+		gtp5g_free(ring->alloc, ring);
+		return NULL;
+	}
+
+	/* SENDMSG/RECVMSG came along with NODROP, both predate 5.5 */
+	if (!(p.features & IORING_FEAT_NODROP))
+		goto err;
+
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size)
+			ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+
+	ring->sq_ring = gtp5g_uring_mmap(ring->fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+	if (!ring->sq_ring)
+		goto err;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cq_ring = ring->sq_ring;
+	else {
+		ring->cq_ring = gtp5g_uring_mmap(ring->fd, ring->cq_ring_size, IORING_OFF_CQ_RING);
+		if (!ring->cq_ring)
+			goto err;
+	}
+
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = gtp5g_uring_mmap(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+	if (!ring->sqes)
+		goto err;
+
+	sq = ring->sq_ring;
+	ring->sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(sq + p.sq_off.array);
+
+	cq = ring->cq_ring;
+	ring->cq_head = (unsigned int *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	return ring;
+err:
+	gtp5g_uring_free(ring);
+	return NULL;
+}
+
+static struct io_uring_sqe *gtp5g_uring_get_sqe(struct gtp5g_uring *ring,
+						uint8_t opcode, int fd,
+						struct msghdr *msg,
+						uint32_t msg_flags)
+{
+	unsigned int tail = *ring->sq_tail;
+	unsigned int idx = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)msg;
+	sqe->len = 1;
+	sqe->msg_flags = msg_flags;
+
+	ring->sq_array[idx] = idx;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	return sqe;
+}
+
+static int gtp5g_uring_enter(struct gtp5g_uring *ring, unsigned int submit,
+			     unsigned int wait)
+{
+	int ret;
+
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, submit, wait,
+			      IORING_ENTER_GETEVENTS, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
+/* Take the CQEs there are, returns how many SQEs of the current call
+ * completed */
+static unsigned int gtp5g_uring_reap(struct gtp5g_uring *ring, unsigned int nr,
+				     int32_t *res, uint8_t *fin)
+{
+	unsigned int head = *ring->cq_head, done = 0;
+	struct io_uring_cqe *cqe;
+	uint32_t idx;
+
+	while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+		cqe = &ring->cqes[head & *ring->cq_mask];
+		idx = (uint32_t)cqe->user_data;
+		if (cqe->user_data >> 32 == ring->gen && idx < nr && !fin[idx]) {
+			res[idx] = cqe->res;
+			fin[idx] = 1;
+			done++;
+		}
+		head++;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+	return done;
+}
+
+/* Ask the kernel to cancel the SQEs of the current call that did not
+ * complete, and wait until they have */
+static int gtp5g_uring_cancel(struct gtp5g_uring *ring, unsigned int nr,
+			      int32_t *res, uint8_t *fin, unsigned int done)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int i, submit = 0;
+	int ret;
+
+	for (i = 0; i < nr; i++) {
+		if (fin[i])
+			continue;
+		sqe = gtp5g_uring_get_sqe(ring, IORING_OP_ASYNC_CANCEL, -1, NULL, 0);
+		sqe->addr = GTP5G_URING_DATA(ring->gen, i);
+		sqe->len = 0;
+		sqe->user_data = GTP5G_URING_DATA(ring->gen, GTP5G_URING_CANCEL);
+		submit++;
+	}
+
+	while (done < nr) {
+		ret = gtp5g_uring_enter(ring, submit, 1);
+		if (ret < 0) {
+			/* Out of memory for now, try again */
+			if (errno == EAGAIN || errno == EBUSY || errno == ENOMEM)
+				continue;
+			return -1;
+		}
+		submit -= ret < (int)submit ? ret : submit;
+		done += gtp5g_uring_reap(ring, nr, res, fin);
+	}
+
+	return 0;
+}
+
+/* Drop the ring of the calling thread, which goes back to sockets. The
+ * kernel cancels what the ring still has in flight once it goes away. */
+static void gtp5g_uring_teardown(void)
+{
+	gtp5g_uring_free(gtp5g_uring);
+	gtp5g_uring = NULL;
+	gtp5g_uring_unavailable = 1;
+	pthread_setspecific(gtp5g_uring_key, NULL);
+}
+
+/* Submit the nr queued SQEs and wait for all of them. The messages they
+ * point to live on the caller's stack, so nothing may be left in flight:
+ * when io_uring_enter() fails, the SQEs the kernel has not taken yet are
+ * taken back and the others cancelled before returning. */
+static int gtp5g_uring_run(struct gtp5g_uring *ring, unsigned int nr,
+			   int32_t *res)
+{
+	uint8_t fin[GTP5G_URING_ENTRIES] = {};
+	unsigned int submit = nr, done = 0;
+	int ret, err;
+
+	while (done < nr) {
+		ret = gtp5g_uring_enter(ring, submit, nr - done);
+		if (ret < 0)
+			goto err;
+		submit -= ret < (int)submit ? ret : submit;
+		done += gtp5g_uring_reap(ring, nr, res, fin);
+	}
+
+	ring->gen++;
+	return 0;
+err:
+	err = errno;
+
+	/* Without SQPOLL, the kernel only reads the SQ in io_uring_enter(), so
+	 * the SQEs it has not taken are still ours */
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail - submit, __ATOMIC_RELEASE);
+	for (; submit; submit--, done++)
+		fin[nr - submit] = 1;
+
+	if (gtp5g_uring_cancel(ring, nr, res, fin, done) < 0)
+		gtp5g_uring_teardown();
+	else
+		ring->gen++;
+
+	errno = err;
+	return -1;
+}
+
+/* Up to GTP5G_URING_ENTRIES sendmsg() and recvmsg() calls on fd, linked in
+ * the order given so that the first failure cancels the ones after it */
+int gtp5g_uring_xfer(struct mnl_socket *nl, const struct iovec *send,
+		     unsigned int nsend, struct iovec *recv, unsigned int nrecv,
+		     int flags, int32_t *res)
+{
+	struct sockaddr_nl snl = {
+		.nl_family	= AF_NETLINK,
+	}, rnl[GTP5G_URING_ENTRIES];
+	struct msghdr msg[GTP5G_URING_ENTRIES];
+	struct io_uring_sqe *sqe;
+	int fd = mnl_socket_get_fd(nl);
+	unsigned int i, nr = nsend + nrecv;
+
+	if (!gtp5g_uring || nr > GTP5G_URING_ENTRIES) {
+		errno = gtp5g_uring ? EINVAL : EOPNOTSUPP;
+		return -1;
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (i < nsend)
+			msg[i] = (struct msghdr) {
+				.msg_name	= &snl,
+				.msg_namelen	= sizeof(snl),
+				.msg_iov	= (struct iovec *)&send[i],
+				.msg_iovlen	= 1,
+			};
+		else
+			msg[i] = (struct msghdr) {
+				.msg_name	= &rnl[i],
+				.msg_namelen	= sizeof(rnl[i]),
+				.msg_iov	= &recv[i - nsend],
+				.msg_iovlen	= 1,
+			};
+
+		sqe = gtp5g_uring_get_sqe(gtp5g_uring,
+					  i < nsend ? IORING_OP_SENDMSG : IORING_OP_RECVMSG,
+					  fd, &msg[i], i < nsend ? flags : flags | MSG_TRUNC);
+		if (i + 1 < nr)
+			sqe->flags = IOSQE_IO_LINK;
+		sqe->user_data = GTP5G_URING_DATA(gtp5g_uring->gen, i);
+	}
+
+	return gtp5g_uring_run(gtp5g_uring, nr, res);
+}
+
+/* MSG_TRUNC makes netlink return the full length of the datagram, which
+ * tells truncation apart the way mnl_socket_recvfrom() does */
+ssize_t gtp5g_uring_recv_res(int32_t res, size_t len)
+{
+	if (res < 0) {
+		errno = -res;
+		return -1;
+	}
+	if ((size_t)res > len) {
+		errno = ENOSPC;
+		return -1;
+	}
+	return res;
+}
+
+static ssize_t gtp5g_uring_talk(struct mnl_socket *nl, const void *req,
+				size_t req_len, void *buf, size_t len,
+				void *data)
+{
+	struct iovec siov = {
+		.iov_base	= (void *)req,
+		.iov_len	= req_len,
+	};
+	struct iovec riov = {
+		.iov_base	= buf,
+		.iov_len	= len,
+	};
+	unsigned int nsend = req ? 1 : 0, nrecv = buf ? 1 : 0;
+	int32_t res[2];
+
+	if (gtp5g_uring_xfer(nl, &siov, nsend, &riov, nrecv, 0, res) < 0)
+		return -1;
+
+	if (req && res[0] < 0) {
+		errno = -res[0];
+		return -1;
+	}
+
+	return buf ? gtp5g_uring_recv_res(res[nsend], len) : 0;
+}
+
+static int gtp5g_uring_send(struct mnl_socket *nl, const void *buf, size_t len,
+			    void *data)
+{
+	return gtp5g_uring_talk(nl, buf, len, NULL, 0, data) < 0 ? -1 : 0;
+}
+
+static ssize_t gtp5g_uring_recv(struct mnl_socket *nl, void *buf, size_t len,
+				void *data)
+{
+	return gtp5g_uring_talk(nl, NULL, 0, buf, len, data);
+}
+
+const struct genl_transport_ops gtp5g_transport_uring = {
+	.send	= gtp5g_uring_send,
+	.recv	= gtp5g_uring_recv,
+	.talk	= gtp5g_uring_talk,
+};
+
+const struct genl_transport_ops *gtp5g_uring_transport(void)
+{
+	if (gtp5g_uring)
+		return &gtp5g_transport_uring;
+	if (gtp5g_uring_unavailable)
+		return NULL;
+
+	pthread_once(&gtp5g_uring_once, gtp5g_uring_key_create);
+
+	gtp5g_uring = gtp5g_uring_setup();
+	if (!gtp5g_uring) {
+		gtp5g_uring_unavailable = 1;
+		return NULL;
+	}
+	pthread_setspecific(gtp5g_uring_key, gtp5g_uring);
+
+	return &gtp5g_transport_uring;
+}
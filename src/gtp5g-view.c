@@ -0,0 +1,266 @@
+/* Read-only views of dumped rules, straight from the receive buffer */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/genetlink.h>
+
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "internal.h"
+
+/* Attributes were validated for their type by the parsers, netlink keeps
+ * payloads 4 byte aligned, so they are read in place */
+static inline const void *gtp5g_view_payload(const struct nlattr *attr)
+{
+	return attr ? mnl_attr_get_payload(attr) : NULL;
+}
+
+static inline const void *gtp5g_view_list(const struct nlattr *attr, size_t elem, int *num)
+{
+	*num = attr ? mnl_attr_get_payload_len(attr) / elem : 0;
+	return *num ? mnl_attr_get_payload(attr) : NULL;
+}
+
+/* gtp5g_<obj>_view_get_<name>() is the payload of attribute attr of table
+ * tb, NULL when the rule has none */
+#define GTP5G_VIEW_GET(obj, name, type, tb, attr)				\
+const type *gtp5g_##obj##_view_get_##name(const struct gtp5g_##obj##_view *v)	\
+{										\
+	return gtp5g_view_payload(v->tb[attr]);					\
+}										\
+EXPORT_SYMBOL(gtp5g_##obj##_view_get_##name)
+
+GTP5G_VIEW_GET(pdr, id, uint16_t, pdr, GTP5G_PDR_ID);
+GTP5G_VIEW_GET(pdr, precedence, uint32_t, pdr, GTP5G_PDR_PRECEDENCE);
+GTP5G_VIEW_GET(pdr, outer_header_removal, uint8_t, pdr, GTP5G_OUTER_HEADER_REMOVAL);
+GTP5G_VIEW_GET(pdr, far_id, uint32_t, pdr, GTP5G_PDR_FAR_ID);
+GTP5G_VIEW_GET(pdr, qer_id, uint32_t, pdr, GTP5G_PDR_QER_ID);
+GTP5G_VIEW_GET(pdr, role_addr_ipv4, struct in_addr, pdr, GTP5G_PDR_ROLE_ADDR_IPV4);
+GTP5G_VIEW_GET(pdr, ue_addr_ipv4, struct in_addr, pdi, GTP5G_PDI_UE_ADDR_IPV4);
+GTP5G_VIEW_GET(pdr, local_f_teid_teid, uint32_t, f_teid, GTP5G_F_TEID_I_TEID);
+GTP5G_VIEW_GET(pdr, local_f_teid_gtpu_addr_ipv4, struct in_addr, f_teid, GTP5G_F_TEID_GTPU_ADDR_IPV4);
+GTP5G_VIEW_GET(pdr, sdf_action, uint8_t, rule, GTP5G_FLOW_DESCRIPTION_ACTION);
+GTP5G_VIEW_GET(pdr, sdf_direction, uint8_t, rule, GTP5G_FLOW_DESCRIPTION_DIRECTION);
+GTP5G_VIEW_GET(pdr, sdf_protocol, uint8_t, rule, GTP5G_FLOW_DESCRIPTION_PROTOCOL);
+GTP5G_VIEW_GET(pdr, sdf_src_ipv4, struct in_addr, rule, GTP5G_FLOW_DESCRIPTION_SRC_IPV4);
+GTP5G_VIEW_GET(pdr, sdf_src_mask, struct in_addr, rule, GTP5G_FLOW_DESCRIPTION_SRC_MASK);
+GTP5G_VIEW_GET(pdr, sdf_dest_ipv4, struct in_addr, rule, GTP5G_FLOW_DESCRIPTION_DEST_IPV4);
+GTP5G_VIEW_GET(pdr, sdf_dest_mask, struct in_addr, rule, GTP5G_FLOW_DESCRIPTION_DEST_MASK);
+GTP5G_VIEW_GET(pdr, tos_traffic_class, uint16_t, sdf, GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS);
+GTP5G_VIEW_GET(pdr, security_param_idx, uint32_t, sdf, GTP5G_SDF_FILTER_SECURITY_PARAMETER_INDEX);
+GTP5G_VIEW_GET(pdr, flow_label, uint32_t, sdf, GTP5G_SDF_FILTER_FLOW_LABEL);
+GTP5G_VIEW_GET(pdr, sdf_filter_id, uint32_t, sdf, GTP5G_SDF_FILTER_SDF_FILTER_ID);
+
+GTP5G_VIEW_GET(far, id, uint32_t, far, GTP5G_FAR_ID);
+GTP5G_VIEW_GET(far, apply_action, uint8_t, far, GTP5G_FAR_APPLY_ACTION);
+GTP5G_VIEW_GET(far, outer_header_creation_description, uint16_t, hdr_creation,
+	       GTP5G_OUTER_HEADER_CREATION_DESCRIPTION);
+GTP5G_VIEW_GET(far, outer_header_creation_teid, uint32_t, hdr_creation,
+	       GTP5G_OUTER_HEADER_CREATION_O_TEID);
+GTP5G_VIEW_GET(far, outer_header_creation_peer_addr_ipv4, struct in_addr, hdr_creation,
+	       GTP5G_OUTER_HEADER_CREATION_PEER_ADDR_IPV4);
+GTP5G_VIEW_GET(far, outer_header_creation_port, uint16_t, hdr_creation,
+	       GTP5G_OUTER_HEADER_CREATION_PORT);
+
+GTP5G_VIEW_GET(qer, id, uint32_t, qer, GTP5G_QER_ID);
+GTP5G_VIEW_GET(qer, gate_status, uint8_t, qer, GTP5G_QER_GATE);
+GTP5G_VIEW_GET(qer, mbr_uhigh, uint32_t, mbr, GTP5G_QER_MBR_UL_HIGH32);
+GTP5G_VIEW_GET(qer, mbr_ulow, uint8_t, mbr, GTP5G_QER_MBR_UL_LOW8);
+GTP5G_VIEW_GET(qer, mbr_dhigh, uint32_t, mbr, GTP5G_QER_MBR_DL_HIGH32);
+GTP5G_VIEW_GET(qer, mbr_dlow, uint8_t, mbr, GTP5G_QER_MBR_DL_LOW8);
+GTP5G_VIEW_GET(qer, gbr_uhigh, uint32_t, gbr, GTP5G_QER_GBR_UL_HIGH32);
+GTP5G_VIEW_GET(qer, gbr_ulow, uint8_t, gbr, GTP5G_QER_GBR_UL_LOW8);
+GTP5G_VIEW_GET(qer, gbr_dhigh, uint32_t, gbr, GTP5G_QER_GBR_DL_HIGH32);
+GTP5G_VIEW_GET(qer, gbr_dlow, uint8_t, gbr, GTP5G_QER_GBR_DL_LOW8);
+GTP5G_VIEW_GET(qer, qer_corr_id, uint32_t, qer, GTP5G_QER_CORR_ID);
+GTP5G_VIEW_GET(qer, rqi, uint8_t, qer, GTP5G_QER_RQI);
+GTP5G_VIEW_GET(qer, qfi, uint8_t, qer, GTP5G_QER_QFI);
+GTP5G_VIEW_GET(qer, ppi, uint8_t, qer, GTP5G_QER_PPI);
+GTP5G_VIEW_GET(qer, rcsr, uint8_t, qer, GTP5G_QER_RCSR);
+
+const uint32_t *gtp5g_pdr_view_get_sdf_src_ports(const struct gtp5g_pdr_view *v, int *num)
+{
+	return gtp5g_view_list(v->rule[GTP5G_FLOW_DESCRIPTION_SRC_PORT], sizeof(uint32_t), num);
+}
+EXPORT_SYMBOL(gtp5g_pdr_view_get_sdf_src_ports);
+
+const uint32_t *gtp5g_pdr_view_get_sdf_dest_ports(const struct gtp5g_pdr_view *v, int *num)
+{
+	return gtp5g_view_list(v->rule[GTP5G_FLOW_DESCRIPTION_DEST_PORT], sizeof(uint32_t), num);
+}
+EXPORT_SYMBOL(gtp5g_pdr_view_get_sdf_dest_ports);
+
+int gtp5g_pdr_view_has_sdf_filter(const struct gtp5g_pdr_view *v)
+{
+	return v->pdi[GTP5G_PDI_SDF_FILTER] != NULL;
+}
+EXPORT_SYMBOL(gtp5g_pdr_view_has_sdf_filter);
+
+int gtp5g_pdr_view_for_each_sdf_filter(const struct gtp5g_pdr_view *v,
+				       int (*cb)(const struct gtp5g_pdr_view *sdf, void *data),
+				       void *data)
+{
+	const struct nlattr *list = v->pdi[GTP5G_PDI_SDF_FILTER_LIST], *attr;
+	struct gtp5g_pdr_view f;
+	int n = 0;
+
+	if (!list) {
+		if (!v->pdi[GTP5G_PDI_SDF_FILTER])
+			return 0;
+		if (cb(v, data) < 0)
+			goto stop;
+		return 1;
+	}
+
+	f = *v;
+	mnl_attr_for_each_nested(attr, list) {
+		if (mnl_attr_get_type(attr) != GTP5G_PDI_SDF_FILTER)
+			continue;
+		genl_gtp5g_pdr_view_sdf(&f, attr);
+		if (cb(&f, data) < 0)
+			goto stop;
+		n++;
+	}
+	return n;
+stop:
+	gtp5g_err_set(ECANCELED, 0, "SDF filters stopped by callback");
+	return -1;
+}
+EXPORT_SYMBOL(gtp5g_pdr_view_for_each_sdf_filter);
+
+/* The forwarding policy is sent without a NUL, the socket path with one,
+ * which *len leaves out */
+static const char *gtp5g_view_str(const struct nlattr *attr, size_t *len)
+{
+	*len = attr ? strnlen(gtp5g_view_payload(attr), mnl_attr_get_payload_len(attr)) : 0;
+	return gtp5g_view_payload(attr);
+}
+
+const char *gtp5g_pdr_view_get_unix_sock_path(const struct gtp5g_pdr_view *v, size_t *len)
+{
+	return gtp5g_view_str(v->pdr[GTP5G_PDR_UNIX_SOCKET_PATH], len);
+}
+EXPORT_SYMBOL(gtp5g_pdr_view_get_unix_sock_path);
+
+const char *gtp5g_far_view_get_fwd_policy(const struct gtp5g_far_view *v, size_t *len)
+{
+	return gtp5g_view_str(v->fwd_param[GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY], len);
+}
+EXPORT_SYMBOL(gtp5g_far_view_get_fwd_policy);
+
+const uint16_t *gtp5g_far_view_get_related_pdr_list(const struct gtp5g_far_view *v, int *num)
+{
+	return gtp5g_view_list(v->far[GTP5G_FAR_RELATED_TO_PDR], sizeof(uint16_t), num);
+}
+EXPORT_SYMBOL(gtp5g_far_view_get_related_pdr_list);
+
+const uint16_t *gtp5g_qer_view_get_related_pdr_list(const struct gtp5g_qer_view *v, int *num)
+{
+	return gtp5g_view_list(v->qer[GTP5G_QER_RELATED_TO_PDR], sizeof(uint16_t), num);
+}
+EXPORT_SYMBOL(gtp5g_qer_view_get_related_pdr_list);
+
+/* A view of each type on the stack, filled again for every message */
+struct gtp5g_view_dump {
+	const struct gtp5g_view_ops	*ops;
+	void				*data;
+	uint8_t				cmd;
+};
+
+static int gtp5g_view_dump_cb(const struct nlmsghdr *nlh, void *data)
+{
+	struct gtp5g_view_dump *d = data;
+	struct gtp5g_pdr_view pdr;
+	struct gtp5g_far_view far;
+	struct gtp5g_qer_view qer;
+	int ret;
+
+	switch (d->cmd) {
+	case GTP5G_CMD_GET_PDR:
+		genl_gtp5g_pdr_view_parse(nlh, &pdr);
+		ret = d->ops->pdr(&pdr, d->data);
+		break;
+	case GTP5G_CMD_GET_FAR:
+		genl_gtp5g_far_view_parse(nlh, &far);
+		ret = d->ops->far(&far, d->data);
+		break;
+	default:
+		genl_gtp5g_qer_view_parse(nlh, &qer);
+		ret = d->ops->qer(&qer, d->data);
+		break;
+	}
+
+	if (ret < 0) {
+		gtp5g_err_set(ECANCELED, 0, "dump stopped by callback");
+		return MNL_CB_ERROR;
+	}
+	return MNL_CB_OK;
+}
+
+static void gtp5g_view_dump_restart(void *data)
+{
+	struct gtp5g_view_dump *d = data;
+
+	if (d->ops->restart)
+		d->ops->restart(d->cmd, d->data);
+}
+
+int gtp5g_dump_views(int genl_id, struct mnl_socket *nl, const struct gtp5g_view_ops *ops,
+		     void *data)
+{
+	static const uint8_t cmds[] = {
+		GTP5G_CMD_GET_PDR, GTP5G_CMD_GET_FAR, GTP5G_CMD_GET_QER,
+	};
+	struct gtp5g_view_dump d = {
+		.ops	= ops,
+		.data	= data,
+	};
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct nlmsghdr *nlh;
+	uint32_t seq = time(NULL);
+	unsigned int i;
+
+	if (!ops) {
+		gtp5g_err_fail(EINVAL, 0, 0, "view ops is NULL");
+		return -1;
+	}
+
+	for (i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+		if ((cmds[i] == GTP5G_CMD_GET_PDR && !ops->pdr) ||
+		    (cmds[i] == GTP5G_CMD_GET_FAR && !ops->far) ||
+		    (cmds[i] == GTP5G_CMD_GET_QER && !ops->qer))
+			continue;
+
+		d.cmd = cmds[i];
+		nlh = genl_nlmsg_build_hdr(buf, genl_id, NLM_F_DUMP, ++seq, cmds[i]);
+		if (gtp5g_socket_dump(nl, nlh, seq, gtp5g_view_dump_cb, gtp5g_view_dump_restart,
+				      &d, 0) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(gtp5g_dump_views);
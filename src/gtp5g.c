@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <string.h>
 #include <sys/types.h>
 #include <regex.h>
@@ -38,21 +39,26 @@
 
 #define GTP5G_STRUCT_FUNC_NAME(x) gtp5g_ ##x## _alloc
 #define gtp5g_struct_alloc_exp(__func_name, __ret_type) \
-__ret_type *GTP5G_STRUCT_FUNC_NAME(__func_name)(void) \
+__ret_type *gtp5g_##__func_name##_alloc_with(const struct gtp5g_allocator *a) \
 { \
     __ret_type *ptr; \
-    ptr = calloc(1, sizeof(__ret_type)); \
+    ptr = gtp5g_calloc(a, 1, sizeof(__ret_type)); \
     if (!ptr) \
         return NULL; \
+    ptr->alloc = a; \
     return ptr; \
 } \
+__ret_type *GTP5G_STRUCT_FUNC_NAME(__func_name)(void) \
+{ \
+    return gtp5g_##__func_name##_alloc_with(gtp5g_allocator); \
+} \
 EXPORT_SYMBOL(GTP5G_STRUCT_FUNC_NAME(__func_name))
 
 #define gtp5g_struct_alloc_no_exp(__func_name, __ret_type) \
-static inline __ret_type *GTP5G_STRUCT_FUNC_NAME(__func_name)(void) \
+static inline __ret_type *GTP5G_STRUCT_FUNC_NAME(__func_name)(const struct gtp5g_allocator *a) \
 { \
     __ret_type *ptr; \
-    ptr = calloc(1, sizeof(__ret_type)); \
+    ptr = gtp5g_calloc(a, 1, sizeof(__ret_type)); \
     if (!ptr) \
         return NULL; \
     return ptr; \
@@ -62,10 +68,11 @@ struct gtp5g_dev *gtp5g_dev_alloc(void)
 {
 	struct gtp5g_dev *dev;
 
-	dev = calloc(1, sizeof(struct gtp5g_dev));
+	dev = gtp5g_calloc(gtp5g_allocator, 1, sizeof(struct gtp5g_dev));
 	if (!dev)
 		return NULL;
 
+	dev->alloc = gtp5g_allocator;
 	dev->ifns = -1;
 	return dev;
 }
@@ -85,11 +92,11 @@ gtp5g_struct_alloc_no_exp(pdr_qer_id, uint32_t);
 gtp5g_struct_alloc_no_exp(role_addr_ipv4, struct in_addr);
 
 /* Not in 3GPP spec, just used for buffering */
-static inline char *gtp5g_unix_sock_path_alloc(void)
+static inline char *gtp5g_unix_sock_path_alloc(const struct gtp5g_allocator *a)
 {
 	char *unix_sock_path;
 
-	unix_sock_path = calloc(108, sizeof(char)); // sun_path[108]
+	unix_sock_path = gtp5g_calloc(a, 108, sizeof(char)); // sun_path[108]
 	if (!unix_sock_path)
 		return NULL;
 
@@ -128,220 +135,265 @@ gtp5g_struct_alloc_exp(qer, struct gtp5g_qer);
 
 void gtp5g_dev_free(struct gtp5g_dev *dev)
 {
-    free(dev);
+    gtp5g_free(dev->alloc, dev);
 }
 EXPORT_SYMBOL(gtp5g_dev_free);
 
-static void gtp5g_sdf_filter_description_free(struct ip_filter_rule *rule)
+void gtp5g_sdf_filter_description_free(const struct gtp5g_allocator *a, struct ip_filter_rule *rule)
 {
     if (rule->sport_list)
-        free(rule->sport_list);
+        gtp5g_free(a, rule->sport_list);
     
     if(rule->dport_list)
-        free(rule->dport_list);
+        gtp5g_free(a, rule->dport_list);
 
-    free(rule);
+    gtp5g_free(a, rule);
 }
 
-static void gtp5g_sdf_filter_free(struct sdf_filter *sdf)
+GTP5G_GEN_FREE(gtp5g_sdf_filter_fields_free, struct sdf_filter, GTP5G_SDF_FILTER_SCHEMA)
+GTP5G_GEN_FREE(gtp5g_pdi_fields_free, struct gtp5g_pdi, GTP5G_PDI_SCHEMA)
+GTP5G_GEN_FREE(gtp5g_pdr_fields_free, struct gtp5g_pdr, GTP5G_PDR_SCHEMA)
+
+void gtp5g_sdf_filter_free(const struct gtp5g_allocator *a, struct sdf_filter *sdf)
 {
     if (sdf->rule)
-        gtp5g_sdf_filter_description_free(sdf->rule);
-
-    if (sdf->tos_traffic_class)
-        free(sdf->tos_traffic_class);
+        gtp5g_sdf_filter_description_free(a, sdf->rule);
 
-    if (sdf->security_param_idx)
-        free(sdf->security_param_idx);
-
-    if (sdf->flow_label)
-        free(sdf->flow_label);
-
-    if (sdf->bi_id)
-        free(sdf->bi_id);
+    gtp5g_sdf_filter_fields_free(a, sdf);
+    gtp5g_free(a, sdf);
 }
 
-static void gtp5g_pdi_free(struct gtp5g_pdi *pdi)
+void gtp5g_pdi_free(const struct gtp5g_allocator *a, struct gtp5g_pdi *pdi)
 {
-    if (pdi->ue_addr_ipv4)
-        free(pdi->ue_addr_ipv4);
+    struct sdf_filter *sdf;
+
+    gtp5g_pdi_fields_free(a, pdi);
 
     if (pdi->f_teid)
-        free(pdi->f_teid);
+        gtp5g_free(a, pdi->f_teid);
 
-    if (pdi->sdf)
-        gtp5g_sdf_filter_free(pdi->sdf);
+    while (pdi->sdf) {
+        sdf = pdi->sdf->next;
+        gtp5g_sdf_filter_free(a, pdi->sdf);
+        pdi->sdf = sdf;
+    }
 
-    free(pdi);
+    gtp5g_free(a, pdi);
 }
 
 void gtp5g_pdr_free(struct gtp5g_pdr *pdr)
 {
-    if (pdr->precedence)
-        free(pdr->precedence);
-    
-    if (pdr->pdi)
-        gtp5g_pdi_free(pdr->pdi);
-
-    if (pdr->outer_hdr_removal)
-        free(pdr->outer_hdr_removal);
-
-    if (pdr->far_id)
-        free(pdr->far_id);
+    const struct gtp5g_allocator *a = pdr->alloc;
 
-    if (pdr->qer_id)
-        free(pdr->qer_id);
+    gtp5g_pdr_fields_free(a, pdr);
 
-    /* Not in 3GPP spec, just used for routing */
-    if (pdr->role_addr_ipv4)
-        free(pdr->role_addr_ipv4);
+    if (pdr->pdi)
+        gtp5g_pdi_free(a, pdr->pdi);
 
     if (pdr->unix_sock_path)
-        free(pdr->unix_sock_path);
+        gtp5g_free(a, pdr->unix_sock_path);
 
-    free(pdr);
+    gtp5g_free(a, pdr);
 }
 EXPORT_SYMBOL(gtp5g_pdr_free);
 
-static void gtp5g_forwarding_parameter_free(struct gtp5g_forwarding_parameter *fwd_param)
+void gtp5g_forwarding_parameter_free(const struct gtp5g_allocator *a,
+                                     struct gtp5g_forwarding_parameter *fwd_param)
 {
     if (fwd_param->hdr_creation)
-        free(fwd_param->hdr_creation);
+        gtp5g_free(a, fwd_param->hdr_creation);
+
+    if (fwd_param->fwd_policy)
+        gtp5g_free(a, fwd_param->fwd_policy);
 
-    free(fwd_param);
+    gtp5g_free(a, fwd_param);
 }
 
 void gtp5g_far_free(struct gtp5g_far *far)
 {
     if (far->fwd_param)
-        gtp5g_forwarding_parameter_free(far->fwd_param);
+        gtp5g_forwarding_parameter_free(far->alloc, far->fwd_param);
 
     if (far->related_pdr_list)
-        free(far->related_pdr_list);
+        gtp5g_free(far->alloc, far->related_pdr_list);
 
-    free(far);
+    gtp5g_free(far->alloc, far);
 }
 EXPORT_SYMBOL(gtp5g_far_free);
 
+/* Copies the len bytes of entries at p over list, whose buffer is kept when
+ * it holds *num entries of size elem or more. Returns the list, NULL when
+ * len is 0 or on failure, with list freed. */
+void *gtp5g_list_copy(const struct gtp5g_allocator *a, void *list, int *num, size_t elem,
+                      const void *p, size_t len)
+{
+    void *tmp;
+
+    if (!len) {
+        gtp5g_free(a, list);
+        *num = 0;
+        return NULL;
+    }
+
+    if (!list || len > *num * elem) {
+        tmp = gtp5g_realloc(a, list, len);
+        if (!tmp) {
+            gtp5g_free(a, list);
+            *num = 0;
+            return NULL;
+        }
+        list = tmp;
+    }
+
+    memcpy(list, p, len);
+    *num = len / elem;
+    return list;
+}
+
 /* Not in 3GPP spec, just used for routing */
 static inline void role_addr_ipv4_may_alloc(struct gtp5g_pdr *pdr)
 {
     if (!pdr->role_addr_ipv4)
-        pdr->role_addr_ipv4 = gtp5g_role_addr_ipv4_alloc();
+        pdr->role_addr_ipv4 = gtp5g_role_addr_ipv4_alloc(pdr->alloc);
 }
 
 /* Not in 3GPP spec, just used for buffering */
 static inline void unix_sock_path_may_alloc(struct gtp5g_pdr *pdr)
 {
     if (!pdr->unix_sock_path)
-        pdr->unix_sock_path = gtp5g_unix_sock_path_alloc();
+        pdr->unix_sock_path = gtp5g_unix_sock_path_alloc(pdr->alloc);
 }
 
 static inline void precedence_may_alloc(struct gtp5g_pdr *pdr)
 {
     if (!pdr->precedence)
-        pdr->precedence = gtp5g_precedence_alloc();
+        pdr->precedence = gtp5g_precedence_alloc(pdr->alloc);
 }
 
 static inline void pdi_may_alloc(struct gtp5g_pdr *pdr)
 {
     if (!pdr->pdi)
-        pdr->pdi = gtp5g_pdi_alloc();
+        pdr->pdi = gtp5g_pdi_alloc(pdr->alloc);
 }
 
 static inline void outer_hdr_removal_may_alloc(struct gtp5g_pdr *pdr)
 {
     if (!pdr->outer_hdr_removal)
-        pdr->outer_hdr_removal = gtp5g_pdr_outer_header_removal_alloc();
+        pdr->outer_hdr_removal = gtp5g_pdr_outer_header_removal_alloc(pdr->alloc);
 }
 
 static inline void far_id_may_alloc(struct gtp5g_pdr *pdr)
 {
     if (!pdr->far_id)
-        pdr->far_id = gtp5g_pdr_far_id_alloc();
+        pdr->far_id = gtp5g_pdr_far_id_alloc(pdr->alloc);
 }
 
 /* NOTE: gtp5g_struct_alloc_no_exp() */
 static inline void qer_id_may_alloc(struct gtp5g_pdr *pdr)
 {
     if (!pdr->qer_id)
-        pdr->qer_id = gtp5g_pdr_qer_id_alloc();
+        pdr->qer_id = gtp5g_pdr_qer_id_alloc(pdr->alloc);
 }
 
 static inline void ue_addr_ipv4_may_alloc(struct gtp5g_pdr *pdr)
 {
     pdi_may_alloc(pdr);
     if(!pdr->pdi->ue_addr_ipv4)
-        pdr->pdi->ue_addr_ipv4 = gtp5g_pdi_ue_addr_ipv4_alloc();
+        pdr->pdi->ue_addr_ipv4 = gtp5g_pdi_ue_addr_ipv4_alloc(pdr->alloc);
 }
 
 static inline void local_f_teid_may_alloc(struct gtp5g_pdr *pdr)
 {
     pdi_may_alloc(pdr);
     if (!pdr->pdi->f_teid)
-        pdr->pdi->f_teid = gtp5g_pdi_local_f_teid_alloc();
+        pdr->pdi->f_teid = gtp5g_pdi_local_f_teid_alloc(pdr->alloc);
 }
 
-static inline void sdf_filter_may_alloc(struct gtp5g_pdr *pdr)
+/* The link to the last SDF filter of pdi, to pdi->sdf when there is none */
+static struct sdf_filter **sdf_filter_last(struct gtp5g_pdi *pdi)
 {
+    struct sdf_filter **sdf = &pdi->sdf;
+
+    while (*sdf && (*sdf)->next)
+        sdf = &(*sdf)->next;
+    return sdf;
+}
+
+/* The SDF filter setters fill the last filter of the PDI */
+static inline struct sdf_filter *sdf_filter_may_alloc(struct gtp5g_pdr *pdr)
+{
+    struct sdf_filter **sdf;
+
     pdi_may_alloc(pdr);
-    if (!pdr->pdi->sdf)
-        pdr->pdi->sdf = gtp5g_pdi_sdf_filter_alloc();
+    sdf = sdf_filter_last(pdr->pdi);
+    if (!*sdf)
+        *sdf = gtp5g_pdi_sdf_filter_alloc(pdr->alloc);
+    return *sdf;
 }
 
-static inline void sdf_filter_description_may_alloc(struct gtp5g_pdr *pdr)
+static inline struct sdf_filter *sdf_filter_description_may_alloc(struct gtp5g_pdr *pdr)
 {
-    sdf_filter_may_alloc(pdr);
-    if (!pdr->pdi->sdf->rule)
-        pdr->pdi->sdf->rule = gtp5g_sdf_filter_description_alloc();
+    struct sdf_filter *sdf = sdf_filter_may_alloc(pdr);
+
+    if (!sdf->rule)
+        sdf->rule = gtp5g_sdf_filter_description_alloc(pdr->alloc);
+    return sdf;
 }
 
-static inline void sdf_filter_tos_traffic_class_may_alloc(struct gtp5g_pdr *pdr)
+static inline struct sdf_filter *sdf_filter_tos_traffic_class_may_alloc(struct gtp5g_pdr *pdr)
 {
-    sdf_filter_may_alloc(pdr);
-    if (!pdr->pdi->sdf->tos_traffic_class)
-        pdr->pdi->sdf->tos_traffic_class = gtp5g_sdf_filter_tos_traffic_class_alloc();
+    struct sdf_filter *sdf = sdf_filter_may_alloc(pdr);
+
+    if (!sdf->tos_traffic_class)
+        sdf->tos_traffic_class = gtp5g_sdf_filter_tos_traffic_class_alloc(pdr->alloc);
+    return sdf;
 }
 
-static inline void sdf_filter_security_param_idx_may_alloc(struct gtp5g_pdr *pdr)
+static inline struct sdf_filter *sdf_filter_security_param_idx_may_alloc(struct gtp5g_pdr *pdr)
 {
-    sdf_filter_may_alloc(pdr);
-    if (!pdr->pdi->sdf->security_param_idx)
-        pdr->pdi->sdf->security_param_idx = gtp5g_sdf_filter_security_param_idx_alloc();
+    struct sdf_filter *sdf = sdf_filter_may_alloc(pdr);
+
+    if (!sdf->security_param_idx)
+        sdf->security_param_idx = gtp5g_sdf_filter_security_param_idx_alloc(pdr->alloc);
+    return sdf;
 }
 
-static inline void sdf_filter_flow_label_may_alloc(struct gtp5g_pdr *pdr)
+static inline struct sdf_filter *sdf_filter_flow_label_may_alloc(struct gtp5g_pdr *pdr)
 {
-    sdf_filter_may_alloc(pdr);
-    if (!pdr->pdi->sdf->flow_label)
-        pdr->pdi->sdf->flow_label = gtp5g_sdf_filter_flow_label_alloc();
+    struct sdf_filter *sdf = sdf_filter_may_alloc(pdr);
+
+    if (!sdf->flow_label)
+        sdf->flow_label = gtp5g_sdf_filter_flow_label_alloc(pdr->alloc);
+    return sdf;
 }
 
-static inline void sdf_filter_id_may_alloc(struct gtp5g_pdr *pdr)
+static inline struct sdf_filter *sdf_filter_id_may_alloc(struct gtp5g_pdr *pdr)
 {
-    sdf_filter_may_alloc(pdr);
-    if (!pdr->pdi->sdf->bi_id)
-        pdr->pdi->sdf->bi_id = gtp5g_sdf_filter_id_alloc();
+    struct sdf_filter *sdf = sdf_filter_may_alloc(pdr);
+
+    if (!sdf->bi_id)
+        sdf->bi_id = gtp5g_sdf_filter_id_alloc(pdr->alloc);
+    return sdf;
 }
 
 static inline void fwd_param_may_alloc(struct gtp5g_far *far)
 {
     if (!far->fwd_param)
-        far->fwd_param = gtp5g_forwarding_parameter_alloc();
+        far->fwd_param = gtp5g_forwarding_parameter_alloc(far->alloc);
 }
 
 static inline void outer_hdr_creation_may_alloc(struct gtp5g_far *far)
 {
     fwd_param_may_alloc(far);
     if (!far->fwd_param->hdr_creation)
-        far->fwd_param->hdr_creation = gtp5g_outer_header_creation_alloc();
+        far->fwd_param->hdr_creation = gtp5g_outer_header_creation_alloc(far->alloc);
 }
 
 static inline void fwd_policy_may_alloc(struct gtp5g_far *far)
 {
     fwd_param_may_alloc(far);
     if (!far->fwd_param->fwd_policy)
-        far->fwd_param->fwd_policy = gtp5g_forwarding_policy_alloc();
+        far->fwd_param->fwd_policy = gtp5g_forwarding_policy_alloc(far->alloc);
 }
 
 
@@ -416,8 +468,8 @@ EXPORT_SYMBOL(gtp5g_pdr_set_local_f_teid);
 
 void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rule_str)
 {
-    sdf_filter_description_may_alloc(pdr);
-    struct ip_filter_rule *rule = pdr->pdi->sdf->rule;
+    struct ip_filter_rule *rule = sdf_filter_description_may_alloc(pdr)->rule;
+    struct sdf_filter **sdf;
 
     char reg_act[] = "(permit)";
     char reg_direction[] = "(in|out)";
@@ -437,13 +489,15 @@ void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rul
     int cflags = REG_EXTENDED | REG_ICASE;
 
     if (regcomp(&preg, reg, cflags) != 0) {
-        perror("Regex string for SDF filter description format error");
+        gtp5g_err_fail(EINVAL, 0, pdr->id, "Regex string for SDF filter description format error");
         goto err;
     }
     if (regexec(&preg, rule_str, nmatch, pmatch, 0) != 0) {
-        perror("SDF filter description format error");
+        regfree(&preg);
+        gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description format error");
         goto err;
     }
+    regfree(&preg);
 
     int len;
     char buf[0xff];
@@ -455,7 +509,7 @@ void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rul
         rule->action = GTP5G_SDF_FILTER_PERMIT;
     }
     else {
-        perror("SDF filter description action not support");
+        gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description action not support");
         goto err;
     }
 
@@ -467,7 +521,7 @@ void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rul
     else if (strcmp(buf, "out") == 0)
         rule->direction = GTP5G_SDF_FILTER_OUT;
     else {
-        perror("SDF filter description direction not support");
+        gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description direction not support");
         goto err;
     }
 
@@ -479,7 +533,7 @@ void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rul
     else {
         int tmp = atoi(buf);
         if (tmp > 0xff) {
-            perror("SDF filter description protocol not support");
+            gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description protocol not support");
             goto err;
         }
         rule->proto = tmp;
@@ -491,7 +545,7 @@ void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rul
         strncpy(buf, rule_str + pmatch[5].rm_so + 1, len - 1); buf[len - 1] = '\0';
         int smask = atoi(buf);
         if (smask > 32) {
-            perror("SDF filter description SRC mask is invalid");
+            gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description SRC mask is invalid");
             goto err;
         }
         rule->smask.s_addr = decimal_to_netmask(smask);
@@ -507,22 +561,22 @@ void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rul
         rule->smask.s_addr = 0;
     }
     else if (strcmp(buf, "assigned") == 0) {
-        perror("SDF filter description dest ip do NOT support assigned yet");
+        gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description dest ip do NOT support assigned yet");
         goto err;
     }
     else if(inet_pton(AF_INET, buf, &rule->src) != 1) {
-        perror("SDF filter description src ip is invalid");
+        gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description src ip is invalid");
         goto err;
     }
 
     // Get SRC Port
+    gtp5g_drop(pdr->alloc, rule->sport_list);
+    rule->sport_num = 0;
     len = pmatch[6].rm_eo - pmatch[6].rm_so;
     if (len) {
         strncpy(buf, rule_str + pmatch[6].rm_so + 1, len - 1); buf[len - 1] = '\0';
-        rule->sport_list = port_list_create(buf);
+        rule->sport_list = port_list_create(pdr->alloc, buf, &rule->sport_num);
     }
-    else
-        rule->sport_list = NULL;
 
     // Get Dest Mask
     len = pmatch[9].rm_eo - pmatch[9].rm_so;
@@ -530,7 +584,7 @@ void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rul
         strncpy(buf, rule_str + pmatch[9].rm_so + 1, len - 1); buf[len - 1] = '\0';
         int dmask = atoi(buf);
         if (dmask > 32) {
-            perror("SDF filter description Dest mask is invalid");
+            gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description Dest mask is invalid");
             goto err;
         }
         rule->dmask.s_addr = decimal_to_netmask(dmask);
@@ -546,58 +600,68 @@ void gtp5g_pdr_set_sdf_filter_description(struct gtp5g_pdr *pdr, const char *rul
         rule->dmask.s_addr = 0;
     }
     else if (strcmp(buf, "assigned") == 0) {
-        perror("SDF filter description dest ip do NOT support assigned yet");
+        gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description dest ip do NOT support assigned yet");
         goto err;
     }
     else if(inet_pton(AF_INET, buf, &rule->dest) != 1) {
-        perror("SDF filter description dest ip is invalid");
+        gtp5g_err_fail(EINVAL, 0, pdr->id, "SDF filter description dest ip is invalid");
         goto err;
     }
 
     // Get Dest Port
+    gtp5g_drop(pdr->alloc, rule->dport_list);
+    rule->dport_num = 0;
     len = pmatch[10].rm_eo - pmatch[10].rm_so;
     if (len) {
         strncpy(buf, rule_str + pmatch[10].rm_so + 1, len - 1); buf[len - 1] = '\0';
-        rule->dport_list = port_list_create(buf);
+        rule->dport_list = port_list_create(pdr->alloc, buf, &rule->dport_num);
     }
-    else
-        rule->dport_list = NULL;
 
     return;
 err:
-    gtp5g_sdf_filter_free(pdr->pdi->sdf);
+    sdf = sdf_filter_last(pdr->pdi);
+    gtp5g_sdf_filter_free(pdr->alloc, *sdf);
+    *sdf = NULL;
     return;
 }
 EXPORT_SYMBOL(gtp5g_pdr_set_sdf_filter_description);
 
 void gtp5g_pdr_set_tos_traffic_class(struct gtp5g_pdr *pdr, uint16_t tos_traffic_class)
 {
-    sdf_filter_tos_traffic_class_may_alloc(pdr);
-    *pdr->pdi->sdf->tos_traffic_class = tos_traffic_class;
+    *sdf_filter_tos_traffic_class_may_alloc(pdr)->tos_traffic_class = tos_traffic_class;
 }
 EXPORT_SYMBOL(gtp5g_pdr_set_tos_traffic_class);
 
 void gtp5g_pdr_set_security_param_idx(struct gtp5g_pdr *pdr, uint32_t security_param_idx)
 {
-    sdf_filter_security_param_idx_may_alloc(pdr);
-    *pdr->pdi->sdf->security_param_idx = security_param_idx;
+    *sdf_filter_security_param_idx_may_alloc(pdr)->security_param_idx = security_param_idx;
 }
 EXPORT_SYMBOL(gtp5g_pdr_set_security_param_idx);
 
 void gtp5g_pdr_set_flow_label(struct gtp5g_pdr *pdr, uint32_t flow_label)
 {
-    sdf_filter_flow_label_may_alloc(pdr);
-    *pdr->pdi->sdf->flow_label = flow_label;
+    *sdf_filter_flow_label_may_alloc(pdr)->flow_label = flow_label;
 }
 EXPORT_SYMBOL(gtp5g_pdr_set_flow_label);
 
 void gtp5g_pdr_set_sdf_filter_id(struct gtp5g_pdr *pdr, uint32_t id)
 {
-    sdf_filter_id_may_alloc(pdr);
-    *pdr->pdi->sdf->bi_id = id;
+    *sdf_filter_id_may_alloc(pdr)->bi_id = id;
 }
 EXPORT_SYMBOL(gtp5g_pdr_set_sdf_filter_id);
 
+void gtp5g_pdr_add_sdf_filter(struct gtp5g_pdr *pdr)
+{
+    struct sdf_filter **sdf;
+
+    pdi_may_alloc(pdr);
+    sdf = sdf_filter_last(pdr->pdi);
+    if (*sdf)
+        sdf = &(*sdf)->next;
+    *sdf = gtp5g_pdi_sdf_filter_alloc(pdr->alloc);
+}
+EXPORT_SYMBOL(gtp5g_pdr_add_sdf_filter);
+
 uint16_t *gtp5g_pdr_get_id(struct gtp5g_pdr *pdr)
 {
     return &pdr->id;
@@ -677,7 +741,7 @@ EXPORT_SYMBOL(gtp5g_far_set_outer_header_creation);
 void gtp5g_far_set_fwd_policy(struct gtp5g_far *far, char *str)
 {
     if (strlen(str) > MAX_LEN_OF_FORWARDING_POLICY_IDENTIFIER) {
-        perror("Forwarding parameters is too long");
+        gtp5g_err_fail(EINVAL, 0, far->id, "Forwarding parameters is too long");
         return;
     }
 
@@ -915,7 +979,11 @@ EXPORT_SYMBOL(gtp5g_qer_get_id);
 
 void gtp5g_qer_free(struct gtp5g_qer *qer)
 {
-	free(qer);
+	if (!qer)
+		return;
+
+	gtp5g_free(qer->alloc, qer->related_pdr_list);
+	gtp5g_free(qer->alloc, qer);
 }
 EXPORT_SYMBOL(gtp5g_qer_free);
 
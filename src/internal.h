@@ -10,9 +10,608 @@
 #endif
 
 #include <stdint.h>
+#include <sys/types.h>
 #include <netinet/in.h>
 
+#include <libgtp5gnl/gtp5gnl.h>
+#include <linux/gtp5g.h>
+
+struct mnl_socket;
+struct nlmsghdr;
+struct nlattr;
+
+/* gtp5g-err.c */
+void gtp5g_err_reset(void);
+void gtp5g_err_set(int err, uint32_t attr_offset, const char *msg);
+void gtp5g_err_report(uint8_t cmd, uint32_t id);
+void gtp5g_err_fail(int err, uint8_t cmd, uint32_t id, const char *msg);
+void gtp5g_err_copy(const struct gtp5g_err *err);
+
+/* A callback with its data, see gtp5g_set_err_cb(). gtp5g_err_hook_set()
+ * publishes a new one at *hook, from a or libc's malloc() when NULL; the
+ * chain is freed with gtp5g_err_hook_free(). Between gtp5g_err_enter() and
+ * gtp5g_err_leave(), the calling thread reports to *hook when it has a
+ * callback, as handles do. */
+struct gtp5g_err_hook {
+	gtp5g_err_cb_t			cb;
+	void				*data;
+	const struct gtp5g_err_hook	*prev;
+};
+
+int gtp5g_err_hook_set(const struct gtp5g_err_hook **hook, gtp5g_err_cb_t cb, void *data,
+		       const struct gtp5g_allocator *a);
+void gtp5g_err_hook_free(const struct gtp5g_err_hook *hook, const struct gtp5g_allocator *a);
+const struct gtp5g_err_hook *gtp5g_err_enter(const struct gtp5g_err_hook *const *hook);
+void gtp5g_err_leave(const struct gtp5g_err_hook *saved);
+
+/* gtp5g-alloc.c: the allocator new memory comes from. What keeps memory
+ * past the call allocating it records the allocator, the memory goes back
+ * to that one. */
+extern const struct gtp5g_allocator gtp5g_allocator_libc;
+extern const struct gtp5g_allocator *gtp5g_allocator;
+
+const struct gtp5g_allocator *gtp5g_allocator_check(const struct gtp5g_allocator *a);
+char *gtp5g_strdup(const struct gtp5g_allocator *a, const char *s);
+
+static inline void *gtp5g_malloc(const struct gtp5g_allocator *a, size_t size)
+{
+	return a->malloc(size, a->ctx);
+}
+
+static inline void *gtp5g_calloc(const struct gtp5g_allocator *a, size_t nmemb, size_t size)
+{
+	return a->calloc(nmemb, size, a->ctx);
+}
+
+static inline void *gtp5g_realloc(const struct gtp5g_allocator *a, void *ptr, size_t size)
+{
+	return a->realloc(ptr, size, a->ctx);
+}
+
+/* NULL is fine, as with free() */
+static inline void gtp5g_free(const struct gtp5g_allocator *a, void *ptr)
+{
+	if (ptr)
+		a->free(ptr, a->ctx);
+}
+
+/* genl.c: whether len more bytes of payload fit the request nlh, built in
+ * a buffer of size bytes. Fails with EMSGSIZE against rule @id when not. */
+int gtp5g_msg_fits(const struct nlmsghdr *nlh, size_t size, size_t len, uint32_t id);
+
+/* genl.c: genl_socket_talk() which reports failures against rule @id */
+int gtp5g_socket_talk(struct mnl_socket *nl, struct nlmsghdr *nlh, uint32_t seq,
+		      int (*cb)(const struct nlmsghdr *nlh, void *data),
+		      void *data, uint32_t id);
+/* genl.c: the same, calling restart before a dump starts over */
+int gtp5g_socket_dump(struct mnl_socket *nl, struct nlmsghdr *nlh, uint32_t seq,
+		      int (*cb)(const struct nlmsghdr *nlh, void *data),
+		      void (*restart)(void *data), void *data, uint32_t id);
+
+extern const struct genl_transport_ops gtp5g_transport_socket;
+
+/* genl.c: whether the gtp5g module of family genl_id takes several SDF
+ * filters per PDI, 1 or 0, asked once through a policy dump. -1 on failure. */
+int gtp5g_sdf_filter_list_supported(int genl_id);
+/* genl.c: asks again on the next call, once the module is gone */
+void gtp5g_sdf_filter_list_forget(void);
+
+/* genl.c: transport selected for the calling thread */
+const struct genl_transport_ops *genl_transport_get(void **data);
+/* genl.c: whether t reads replies from the socket itself, so that
+ * recvmmsg() can take several at once */
+int genl_transport_reads_socket(const struct genl_transport_ops *t);
+/* genl.c: NLMSG_ERROR handler, records the cause and extended ACK of a
+ * failure and returns MNL_CB_ERROR, MNL_CB_STOP for a positive ACK */
+int genl_cb_error(const struct nlmsghdr *nlh, void *data);
+
+/* Schema of the gtp5g attributes, one list per nest of
+ * X(attr, type, kind, field, label):
+ *	type	U8, U16, U32, NESTED, or STRING and BINARY of any length
+ *	kind	how the rule object holds it in field:
+ *		VAL		the value
+ *		OPT		a pointer to the value, NULL when absent
+ *		ADDR		a struct in_addr
+ *		OPT_ADDR	a pointer to a struct in_addr, NULL when absent
+ *		NONE		nests, lists and strings, left to the callers
+ *	label	of the field in the text form, NULL when printed otherwise
+ * The same lists give the policy tables of the parsers, the width the
+ * builders put each attribute with and the GTP5G_GEN_*() code below, so
+ * these cannot disagree. Attributes missing from a list are taken
+ * unchecked, rows are in the order of the text form. */
+#define GTP5G_DEVICE_SCHEMA(X)						\
+	X(GTP5G_LINK,					U32,	NONE,		ifidx,			NULL)	\
+	X(GTP5G_NET_NS_FD,				U32,	NONE,		ifns,			NULL)
+
+#define GTP5G_PDR_SCHEMA(X)						\
+	X(GTP5G_PDR_ID,					U16,	VAL,		id,			NULL)	\
+	X(GTP5G_PDR_PRECEDENCE,				U32,	OPT,		precedence,		"  - Precedence: ")	\
+	X(GTP5G_OUTER_HEADER_REMOVAL,			U8,	OPT,		outer_hdr_removal,	"  - Outer Header Removal: ")	\
+	X(GTP5G_PDR_PDI,				NESTED,	NONE,		pdi,			NULL)	\
+	X(GTP5G_PDR_FAR_ID,				U32,	OPT,		far_id,			"  - FAR ID: ")	\
+	X(GTP5G_PDR_QER_ID,				U32,	OPT,		qer_id,			"  - QER ID: ")	\
+	X(GTP5G_PDR_ROLE_ADDR_IPV4,			U32,	OPT_ADDR,	role_addr_ipv4,		NULL)	\
+	X(GTP5G_PDR_UNIX_SOCKET_PATH,			STRING,	NONE,		unix_sock_path,		NULL)
+
+#define GTP5G_PDI_SCHEMA(X)						\
+	X(GTP5G_PDI_UE_ADDR_IPV4,			U32,	OPT_ADDR,	ue_addr_ipv4,		"    - UE IPv4: ")	\
+	X(GTP5G_PDI_F_TEID,				NESTED,	NONE,		f_teid,			NULL)	\
+	X(GTP5G_PDI_SDF_FILTER,				NESTED,	NONE,		sdf,			NULL)	\
+	X(GTP5G_PDI_SDF_FILTER_LIST,			NESTED,	NONE,		sdf,			NULL)
+
+#define GTP5G_F_TEID_SCHEMA(X)						\
+	X(GTP5G_F_TEID_I_TEID,				U32,	VAL,		teid,			"      - In Teid: ")	\
+	X(GTP5G_F_TEID_GTPU_ADDR_IPV4,			U32,	ADDR,		gtpu_addr_ipv4,		"      - Local GTP-U IPv4: ")
+
+#define GTP5G_SDF_FILTER_SCHEMA(X)					\
+	X(GTP5G_SDF_FILTER_FLOW_DESCRIPTION,		NESTED,	NONE,		rule,			NULL)	\
+	X(GTP5G_SDF_FILTER_TOS_TRAFFIC_CLASS,		U16,	OPT,		tos_traffic_class,	"      - ToS Traffic Class: ")	\
+	X(GTP5G_SDF_FILTER_SECURITY_PARAMETER_INDEX,	U32,	OPT,		security_param_idx,	"      - Security Parameter Index: ")	\
+	X(GTP5G_SDF_FILTER_FLOW_LABEL,			U32,	OPT,		flow_label,		"      - Flow Label: ")	\
+	X(GTP5G_SDF_FILTER_SDF_FILTER_ID,		U32,	OPT,		bi_id,			"      - SDF Filter ID: ")
+
+#define GTP5G_FLOW_DESCRIPTION_SCHEMA(X)				\
+	X(GTP5G_FLOW_DESCRIPTION_ACTION,		U8,	VAL,		action,			NULL)	\
+	X(GTP5G_FLOW_DESCRIPTION_DIRECTION,		U8,	VAL,		direction,		NULL)	\
+	X(GTP5G_FLOW_DESCRIPTION_PROTOCOL,		U8,	VAL,		proto,			NULL)	\
+	X(GTP5G_FLOW_DESCRIPTION_SRC_IPV4,		U32,	ADDR,		src,			NULL)	\
+	X(GTP5G_FLOW_DESCRIPTION_SRC_MASK,		U32,	ADDR,		smask,			NULL)	\
+	X(GTP5G_FLOW_DESCRIPTION_DEST_IPV4,		U32,	ADDR,		dest,			NULL)	\
+	X(GTP5G_FLOW_DESCRIPTION_DEST_MASK,		U32,	ADDR,		dmask,			NULL)	\
+	X(GTP5G_FLOW_DESCRIPTION_SRC_PORT,		BINARY,	NONE,		sport_list,		NULL)	\
+	X(GTP5G_FLOW_DESCRIPTION_DEST_PORT,		BINARY,	NONE,		dport_list,		NULL)
+
+#define GTP5G_FAR_SCHEMA(X)						\
+	X(GTP5G_FAR_ID,					U32,	VAL,		id,			NULL)	\
+	X(GTP5G_FAR_APPLY_ACTION,			U8,	VAL,		apply_action,		"  - Apply Action: ")	\
+	X(GTP5G_FAR_FORWARDING_PARAMETER,		NESTED,	NONE,		fwd_param,		NULL)	\
+	X(GTP5G_FAR_RELATED_TO_PDR,			BINARY,	NONE,		related_pdr_list,	NULL)
+
+#define GTP5G_FORWARDING_PARAMETER_SCHEMA(X)				\
+	X(GTP5G_FORWARDING_PARAMETER_OUTER_HEADER_CREATION, NESTED, NONE,	hdr_creation,		NULL)	\
+	X(GTP5G_FORWARDING_PARAMETER_FORWARDING_POLICY,	BINARY,	NONE,		fwd_policy,		NULL)
+
+#define GTP5G_OUTER_HEADER_CREATION_SCHEMA(X)				\
+	X(GTP5G_OUTER_HEADER_CREATION_DESCRIPTION,	U16,	VAL,		desp,			"      - Description: ")	\
+	X(GTP5G_OUTER_HEADER_CREATION_O_TEID,		U32,	VAL,		teid,			"      - Out Teid: ")	\
+	X(GTP5G_OUTER_HEADER_CREATION_PEER_ADDR_IPV4,	U32,	ADDR,		peer_addr_ipv4,		"      - Next GTP-U IPv4: ")	\
+	X(GTP5G_OUTER_HEADER_CREATION_PORT,		U16,	VAL,		port,			"      - Port: ")
+
+#define GTP5G_QER_SCHEMA(X)						\
+	X(GTP5G_QER_ID,					U32,	VAL,		id,			NULL)	\
+	X(GTP5G_QER_GATE,				U8,	VAL,		ul_dl_gate,		"\t Gate Status: ")	\
+	X(GTP5G_QER_MBR,				NESTED,	NONE,		mbr,			NULL)	\
+	X(GTP5G_QER_GBR,				NESTED,	NONE,		gbr,			NULL)	\
+	X(GTP5G_QER_CORR_ID,				U32,	VAL,		qer_corr_id,		"\t Correlation ID: ")	\
+	X(GTP5G_QER_RQI,				U8,	VAL,		rqi,			"\t RQI: ")	\
+	X(GTP5G_QER_QFI,				U8,	VAL,		qfi,			"\t QFI: ")	\
+	X(GTP5G_QER_PPI,				U8,	VAL,		ppi,			"\t PPI: ")	\
+	X(GTP5G_QER_RCSR,				U8,	VAL,		rcsr,			"\t RCSR: ")	\
+	X(GTP5G_QER_RELATED_TO_PDR,			BINARY,	NONE,		related_pdr_list,	NULL)
+
+#define GTP5G_QER_MBR_SCHEMA(X)						\
+	X(GTP5G_QER_MBR_UL_HIGH32,			U32,	VAL,		mbr.ul_high,		"\t\t UL High: ")	\
+	X(GTP5G_QER_MBR_UL_LOW8,			U8,	VAL,		mbr.ul_low,		"\t\t UL Low: ")	\
+	X(GTP5G_QER_MBR_DL_HIGH32,			U32,	VAL,		mbr.dl_high,		"\t\t DL High: ")	\
+	X(GTP5G_QER_MBR_DL_LOW8,			U8,	VAL,		mbr.dl_low,		"\t\t DL Low: ")
+
+#define GTP5G_QER_GBR_SCHEMA(X)						\
+	X(GTP5G_QER_GBR_UL_HIGH32,			U32,	VAL,		gbr.ul_high,		"\t\t UL High: ")	\
+	X(GTP5G_QER_GBR_UL_LOW8,			U8,	VAL,		gbr.ul_low,		"\t\t UL Low: ")	\
+	X(GTP5G_QER_GBR_DL_HIGH32,			U32,	VAL,		gbr.dl_high,		"\t\t DL High: ")	\
+	X(GTP5G_QER_GBR_DL_LOW8,			U8,	VAL,		gbr.dl_low,		"\t\t DL Low: ")
+
+/* Payload length of each type, 0 when it varies */
+#define GTP5G_SCHEMA_LEN_U8		1
+#define GTP5G_SCHEMA_LEN_U16		2
+#define GTP5G_SCHEMA_LEN_U32		4
+#define GTP5G_SCHEMA_LEN_NESTED		0
+#define GTP5G_SCHEMA_LEN_STRING		0
+#define GTP5G_SCHEMA_LEN_BINARY		0
+
+/* <attr>_LEN, the width of each attribute */
+#define GTP5G_SCHEMA_LEN(attr, type, ...)	attr##_LEN = GTP5G_SCHEMA_LEN_##type,
+
+enum {
+	GTP5G_DEVICE_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_PDR_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_PDI_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_F_TEID_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_SDF_FILTER_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_FLOW_DESCRIPTION_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_FAR_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_FORWARDING_PARAMETER_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_OUTER_HEADER_CREATION_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_QER_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_QER_MBR_SCHEMA(GTP5G_SCHEMA_LEN)
+	GTP5G_QER_GBR_SCHEMA(GTP5G_SCHEMA_LEN)
+};
+
+/* Room an attribute with len bytes of payload takes in a message, and the
+ * headers genl_nlmsg_build_hdr() puts */
+#define GTP5G_ATTR_SIZE(len)	(MNL_ATTR_HDRLEN + MNL_ALIGN(len))
+#define GTP5G_MSG_HDR_SIZE	(MNL_NLMSG_HDRLEN + MNL_ALIGN(sizeof(struct genlmsghdr)))
+
+/* Of the device attributes leading every request on a rule */
+#define GTP5G_DEV_SIZE(dev)						\
+	(((dev)->ifns >= 0 ? GTP5G_ATTR_SIZE(GTP5G_NET_NS_FD_LEN) : 0) +	\
+	 GTP5G_ATTR_SIZE(GTP5G_LINK_LEN))
+
+/* Puts the fixed-width attribute attr holding v, which must have the width
+ * of the schema */
+#define GTP5G_PUT(nlh, attr, v) do {					\
+	__typeof__(v) __put = (v);					\
+	_Static_assert(sizeof(__put) == attr##_LEN,			\
+		       #attr " has another width in the schema");	\
+	mnl_attr_put(nlh, attr, sizeof(__put), &__put);			\
+} while (0)
+
+/* Code generated from the schema of one nest, static functions fn over the
+ * rule object type holding the fields of its rows:
+ *	GTP5G_GEN_PUT	void fn(struct nlmsghdr *nlh, const type *obj)
+ *			puts the fields present
+ *	GTP5G_GEN_SIZE	size_t fn(const type *obj)
+ *			the room GTP5G_GEN_PUT takes, to the byte
+ *	GTP5G_GEN_GET	int fn(type *obj, const struct nlattr **tb)
+ *			sets the fields from the parsed nest tb, to 0 or
+ *			dropped when absent, reusing what OPT ones point to.
+ *			Returns -1 when out of memory.
+ *	GTP5G_GEN_TEXT	void fn(struct gtp5g_out *o, const struct nlattr **tb,
+ *				void (*nest)(o, attr, tb[attr]))
+ *	GTP5G_GEN_PRINT	void fn(struct gtp5g_out *o, const type *obj,
+ *				void (*nest)(o, attr, obj))
+ *			the text form of the fields with a label, nest (if
+ *			any) is called at the place of the NONE rows, the
+ *			present ones for GTP5G_GEN_TEXT
+ *	GTP5G_GEN_FREE	void fn(type *obj)
+ *			frees what the OPT fields point to
+ * NONE rows are otherwise left to the caller. */
+#define GTP5G_SCHEMA_GET_U8		mnl_attr_get_u8
+#define GTP5G_SCHEMA_GET_U16		mnl_attr_get_u16
+#define GTP5G_SCHEMA_GET_U32		mnl_attr_get_u32
+
+#define GTP5G_GEN_PUT(fn, type, SCHEMA)					\
+static void fn(struct nlmsghdr *nlh, const type *obj)			\
+{									\
+	SCHEMA(GTP5G_GEN_PUT_ROW)					\
+}
+#define GTP5G_GEN_PUT_ROW(attr, type, kind, field, label)		\
+	GTP5G_GEN_PUT_##kind(attr, field)
+#define GTP5G_GEN_PUT_VAL(attr, field)					\
+	GTP5G_PUT(nlh, attr, obj->field);
+#define GTP5G_GEN_PUT_OPT(attr, field)					\
+	if (obj->field)							\
+		GTP5G_PUT(nlh, attr, *obj->field);
+#define GTP5G_GEN_PUT_ADDR(attr, field)					\
+	GTP5G_PUT(nlh, attr, obj->field.s_addr);
+#define GTP5G_GEN_PUT_OPT_ADDR(attr, field)				\
+	if (obj->field)							\
+		GTP5G_PUT(nlh, attr, obj->field->s_addr);
+#define GTP5G_GEN_PUT_NONE(attr, field)
+
+#define GTP5G_GEN_SIZE(fn, type, SCHEMA)				\
+static size_t fn(const type *obj)					\
+{									\
+	size_t size = 0;						\
+									\
+	SCHEMA(GTP5G_GEN_SIZE_ROW)					\
+	return size;							\
+}
+#define GTP5G_GEN_SIZE_ROW(attr, type, kind, field, label)		\
+	GTP5G_GEN_SIZE_##kind(attr, field)
+#define GTP5G_GEN_SIZE_VAL(attr, field)					\
+	size += GTP5G_ATTR_SIZE(attr##_LEN);
+#define GTP5G_GEN_SIZE_OPT(attr, field)					\
+	if (obj->field)							\
+		size += GTP5G_ATTR_SIZE(attr##_LEN);
+#define GTP5G_GEN_SIZE_ADDR(attr, field)				\
+	GTP5G_GEN_SIZE_VAL(attr, field)
+#define GTP5G_GEN_SIZE_OPT_ADDR(attr, field)				\
+	GTP5G_GEN_SIZE_OPT(attr, field)
+#define GTP5G_GEN_SIZE_NONE(attr, field)
+
+#define GTP5G_GEN_GET(fn, type, SCHEMA)					\
+static int fn(const struct gtp5g_allocator *a, type *obj,		\
+	      const struct nlattr **tb)					\
+{									\
+	SCHEMA(GTP5G_GEN_GET_ROW)					\
+	return 0;							\
+}
+#define GTP5G_GEN_GET_ROW(attr, type, kind, field, label)		\
+	GTP5G_GEN_GET_##kind(attr, GTP5G_SCHEMA_GET_##type, field)
+#define GTP5G_GEN_GET_VAL(attr, get, field)				\
+	obj->field = tb[attr] ? get(tb[attr]) : 0;
+#define GTP5G_GEN_GET_OPT(attr, get, field)				\
+	if (!tb[attr])							\
+		gtp5g_drop(a, obj->field);				\
+	else if (obj->field || (obj->field = gtp5g_malloc(a, sizeof(*obj->field))))	\
+		*obj->field = get(tb[attr]);				\
+	else								\
+		return -1;
+#define GTP5G_GEN_GET_ADDR(attr, get, field)				\
+	obj->field.s_addr = tb[attr] ? get(tb[attr]) : 0;
+#define GTP5G_GEN_GET_OPT_ADDR(attr, get, field)			\
+	if (!tb[attr])							\
+		gtp5g_drop(a, obj->field);				\
+	else if (obj->field || (obj->field = gtp5g_malloc(a, sizeof(*obj->field))))	\
+		obj->field->s_addr = get(tb[attr]);			\
+	else								\
+		return -1;
+#define GTP5G_GEN_GET_NONE(attr, get, field)
+
+#define GTP5G_GEN_TEXT(fn, SCHEMA)					\
+static void fn(struct gtp5g_out *o, const struct nlattr **tb,		\
+	       void (*nest)(struct gtp5g_out *, uint16_t,		\
+			    const struct nlattr *))			\
+{									\
+	SCHEMA(GTP5G_GEN_TEXT_ROW)					\
+}
+#define GTP5G_GEN_TEXT_ROW(attr, type, kind, field, label)		\
+	GTP5G_GEN_TEXT_##kind(attr, GTP5G_SCHEMA_GET_##type, label)
+#define GTP5G_GEN_TEXT_VAL(attr, get, label)				\
+	if (tb[attr] && label)						\
+		gtp5g_out_field(o, label, get(tb[attr]));
+#define GTP5G_GEN_TEXT_OPT(attr, get, label)				\
+	GTP5G_GEN_TEXT_VAL(attr, get, label)
+#define GTP5G_GEN_TEXT_ADDR(attr, get, label)				\
+	if (tb[attr] && label)						\
+		gtp5g_out_ipv4_field(o, label,				\
+				     &(struct in_addr){ get(tb[attr]) });
+#define GTP5G_GEN_TEXT_OPT_ADDR(attr, get, label)			\
+	GTP5G_GEN_TEXT_ADDR(attr, get, label)
+#define GTP5G_GEN_TEXT_NONE(attr, get, label)				\
+	if (tb[attr] && nest)						\
+		nest(o, attr, tb[attr]);
+
+#define GTP5G_GEN_PRINT(fn, type, SCHEMA)				\
+static void fn(struct gtp5g_out *o, const type *obj,			\
+	       void (*nest)(struct gtp5g_out *, uint16_t, const type *))	\
+{									\
+	SCHEMA(GTP5G_GEN_PRINT_ROW)					\
+}
+#define GTP5G_GEN_PRINT_ROW(attr, type, kind, field, label)		\
+	GTP5G_GEN_PRINT_##kind(attr, field, label)
+#define GTP5G_GEN_PRINT_VAL(attr, field, label)				\
+	if (label)							\
+		gtp5g_out_field(o, label, obj->field);
+#define GTP5G_GEN_PRINT_OPT(attr, field, label)				\
+	if (obj->field && label)					\
+		gtp5g_out_field(o, label, *obj->field);
+#define GTP5G_GEN_PRINT_ADDR(attr, field, label)			\
+	if (label)							\
+		gtp5g_out_ipv4_field(o, label, &obj->field);
+#define GTP5G_GEN_PRINT_OPT_ADDR(attr, field, label)			\
+	if (obj->field && label)					\
+		gtp5g_out_ipv4_field(o, label, obj->field);
+#define GTP5G_GEN_PRINT_NONE(attr, field, label)			\
+	if (nest)							\
+		nest(o, attr, obj);
+
+#define GTP5G_GEN_FREE(fn, type, SCHEMA)				\
+static void fn(const struct gtp5g_allocator *a, type *obj)		\
+{									\
+	SCHEMA(GTP5G_GEN_FREE_ROW)					\
+}
+#define GTP5G_GEN_FREE_ROW(attr, type, kind, field, label)		\
+	GTP5G_GEN_FREE_##kind(field)
+#define GTP5G_GEN_FREE_VAL(field)
+#define GTP5G_GEN_FREE_OPT(field)	gtp5g_free(a, obj->field);
+#define GTP5G_GEN_FREE_ADDR(field)
+#define GTP5G_GEN_FREE_OPT_ADDR(field)	gtp5g_free(a, obj->field);
+#define GTP5G_GEN_FREE_NONE(field)
+
+/* genl.c: policy of a nest, attrs has max + 1 entries of the type and the
+ * exact payload length (0: any) of each attribute */
+struct gtp5g_attr_policy {
+	uint8_t		type;		/* enum mnl_attr_data_type */
+	uint8_t		len;
+};
+
+struct gtp5g_policy {
+	const char			*name;
+	uint16_t			max;
+	const struct gtp5g_attr_policy	*attrs;
+};
+
+#define GTP5G_POLICY_ATTR(attr, type, ...)					\
+	[attr] = { MNL_TYPE_##type, GTP5G_SCHEMA_LEN_##type },
+
+/* static const struct gtp5g_policy var, from the schema of one nest, the
+ * device attributes are part of the numbering of the top level ones */
+#define GTP5G_POLICY(var, desc, max_attr, ...)				\
+static const struct gtp5g_attr_policy var##_attrs[(max_attr) + 1] = {	\
+	__VA_ARGS__							\
+};									\
+static const struct gtp5g_policy var = {				\
+	.name	= desc,							\
+	.max	= (max_attr),						\
+	.attrs	= var##_attrs,						\
+}
+
+/* genl.c: fill tb, indexed by attribute type, from the attributes of a
+ * gtp5g message or of a nest. Attributes above the policy's max are
+ * skipped. Returns -1 with ERANGE recorded at the first one failing the
+ * policy, tb then holds the attributes before it. */
+int gtp5g_attr_parse(const struct nlmsghdr *nlh, const struct gtp5g_policy *p,
+		     const struct nlattr **tb);
+int gtp5g_attr_parse_nested(const struct nlattr *nest, const struct gtp5g_policy *p,
+			    const struct nlattr **tb);
+/* The same for views, which leave out only the attributes failing the
+ * policy and record nothing */
+void gtp5g_attr_parse_view(const struct nlmsghdr *nlh, const struct gtp5g_policy *p,
+			   const struct nlattr **tb);
+void gtp5g_attr_parse_nested_view(const struct nlattr *nest, const struct gtp5g_policy *p,
+				  const struct nlattr **tb);
+
+/* gtp5g-batch.c, gtp5g-async.c: the kernel queues one ACK per request on
+ * the socket before we get to read any of them, each costing about a
+ * kilobyte of the receive buffer. Sending at most this many requests per
+ * datagram keeps a default sized buffer from overflowing. */
+#define GTP5G_BATCH_DGRAM_MSGS	64
+#define GTP5G_BATCH_DGRAM_SIZE	16384
+
+/* Room an ACK takes beyond the request it echoes: its own headers and the
+ * extended ACK attributes */
+#define GTP5G_BATCH_ACK_ROOM	1024
+
+/* gtp5g-batch.c, gtp5g-async.c: allocating from a, the async one closing nl
+ * when freed */
+struct gtp5g_batch *gtp5g_batch_alloc_with(const struct gtp5g_allocator *a,
+					   int genl_id, struct mnl_socket *nl);
+struct gtp5g_async *gtp5g_async_alloc_own(const struct gtp5g_allocator *a,
+					  int genl_id, struct mnl_socket *nl);
+
+/* gtp5g-genl-*.c: request builders and reply parsers, also used by the
+ * micro-benchmarks in bench/. The builders put the payload of a rule into
+ * the request nlh, held by a buffer of size bytes, and fail with EMSGSIZE
+ * rather than write past it. */
+struct gtp5g_dev;
+struct gtp5g_pdr;
+struct gtp5g_far;
+struct gtp5g_qer;
+
+int gtp5g_build_pdr_payload(struct nlmsghdr *nlh, size_t size, struct gtp5g_dev *dev,
+			    struct gtp5g_pdr *pdr);
+int gtp5g_build_far_payload(struct nlmsghdr *nlh, size_t size, struct gtp5g_dev *dev,
+			    struct gtp5g_far *far);
+int gtp5g_build_qer_payload(struct nlmsghdr *nlh, size_t size, struct gtp5g_dev *dev,
+			    struct gtp5g_qer *qer);
+
+int genl_gtp5g_pdr_attr_cb(const struct nlmsghdr *nlh, void *data);
+int genl_gtp5g_far_attr_cb(const struct nlmsghdr *nlh, void *data);
+int genl_gtp5g_qer_attr_cb(const struct nlmsghdr *nlh, void *data);
+/* As above, into the rule object data rather than a new one: what the reply
+ * carries reuses the memory the object has for it, what it lacks is dropped */
+int genl_gtp5g_pdr_attr_into_cb(const struct nlmsghdr *nlh, void *data);
+int genl_gtp5g_far_attr_into_cb(const struct nlmsghdr *nlh, void *data);
+int genl_gtp5g_qer_attr_into_cb(const struct nlmsghdr *nlh, void *data);
+
+/* gtp5g-view.c: the attribute tables of one reply, filled by the parsers of
+ * gtp5g-genl-*.c, absent attributes are NULL */
+struct gtp5g_pdr_view {
+	const struct nlattr	*pdr[GTP5G_PDR_ATTR_MAX + 1];
+	const struct nlattr	*pdi[GTP5G_PDI_ATTR_MAX + 1];
+	const struct nlattr	*f_teid[GTP5G_F_TEID_ATTR_MAX + 1];
+	const struct nlattr	*sdf[GTP5G_SDF_FILTER_ATTR_MAX + 1];
+	const struct nlattr	*rule[GTP5G_FLOW_DESCRIPTION_ATTR_MAX + 1];
+};
+
+struct gtp5g_far_view {
+	const struct nlattr	*far[GTP5G_FAR_ATTR_MAX + 1];
+	const struct nlattr	*fwd_param[GTP5G_FORWARDING_PARAMETER_ATTR_MAX + 1];
+	const struct nlattr	*hdr_creation[GTP5G_OUTER_HEADER_CREATION_ATTR_MAX + 1];
+};
+
+struct gtp5g_qer_view {
+	const struct nlattr	*qer[GTP5G_QER_ATTR_MAX + 1];
+	const struct nlattr	*mbr[GTP5G_QER_MBR_ATTR_MAX + 1];
+	const struct nlattr	*gbr[GTP5G_QER_GBR_ATTR_MAX + 1];
+};
+
+void genl_gtp5g_pdr_view_parse(const struct nlmsghdr *nlh, struct gtp5g_pdr_view *v);
+/* Point the SDF filter getters of v at filter nest sdf */
+void genl_gtp5g_pdr_view_sdf(struct gtp5g_pdr_view *v, const struct nlattr *sdf);
+void genl_gtp5g_far_view_parse(const struct nlmsghdr *nlh, struct gtp5g_far_view *v);
+void genl_gtp5g_qer_view_parse(const struct nlmsghdr *nlh, struct gtp5g_qer_view *v);
+
+/* gtp5g-out.c: buffered writer of the list and print functions, output
+ * goes to the sink in writes of up to GTP5G_OUT_SIZE bytes */
+#define GTP5G_OUT_SIZE	65536
+
+struct gtp5g_out {
+	const struct gtp5g_allocator *alloc;	/* of gtp5g_out_new() */
+	struct gtp5g_sink	sink;
+	int			err;		/* errno of the first failed write or
+						 * bad attribute, drops the rest */
+	size_t			len;
+	char			buf[GTP5G_OUT_SIZE];
+};
+
+extern const struct gtp5g_sink gtp5g_sink_stdout;
+
+void gtp5g_out_init(struct gtp5g_out *o, const struct gtp5g_sink *sink);
+/* gtp5g_out_free() flushes, both report failures through gtp5g_err */
+struct gtp5g_out *gtp5g_out_new(const struct gtp5g_sink *sink);
+int gtp5g_out_free(struct gtp5g_out *o);
+int gtp5g_out_flush(struct gtp5g_out *o);
+void gtp5g_out_mem(struct gtp5g_out *o, const void *p, size_t len);
+void gtp5g_out_str(struct gtp5g_out *o, const char *s);
+void gtp5g_out_char(struct gtp5g_out *o, char c);
+void gtp5g_out_u32(struct gtp5g_out *o, uint32_t v);
+void gtp5g_out_field(struct gtp5g_out *o, const char *label, uint32_t v);
+void gtp5g_out_ports(struct gtp5g_out *o, const uint32_t *list, int num);
+void gtp5g_out_ids(struct gtp5g_out *o, const uint16_t *list, int num, const char *sep);
+void gtp5g_out_ipv4(struct gtp5g_out *o, const struct in_addr *addr);
+void gtp5g_out_ipv4_field(struct gtp5g_out *o, const char *label, const struct in_addr *addr);
+void gtp5g_out_json_str(struct gtp5g_out *o, const char *s);
+void gtp5g_out_csv_str(struct gtp5g_out *o, const char *s);
+
+/* gtp5g-genl-*.c: text form of the rules, the list callbacks take the
+ * struct gtp5g_out to write to as data */
+int genl_gtp5g_pdr_attr_list_cb(const struct nlmsghdr *nlh, void *data);
+int genl_gtp5g_far_attr_list_cb(const struct nlmsghdr *nlh, void *data);
+int genl_gtp5g_qer_attr_list_cb(const struct nlmsghdr *nlh, void *data);
+
+void gtp5g_text_pdr(struct gtp5g_out *o, struct gtp5g_pdr *pdr);
+void gtp5g_text_far(struct gtp5g_out *o, struct gtp5g_far *far);
+void gtp5g_text_qer(struct gtp5g_out *o, struct gtp5g_qer *qer);
+
+/* gtp5g-format.c: JSON and CSV forms of the rules */
+void gtp5g_format_header(struct gtp5g_out *o, uint8_t cmd, enum gtp5g_format format);
+void gtp5g_format_pdr(struct gtp5g_out *o, struct gtp5g_pdr *pdr, enum gtp5g_format format);
+void gtp5g_format_far(struct gtp5g_out *o, struct gtp5g_far *far, enum gtp5g_format format);
+void gtp5g_format_qer(struct gtp5g_out *o, struct gtp5g_qer *qer, enum gtp5g_format format);
+/* "permit out ip from any to 10.0.0.1/24 80", as it is parsed */
+struct ip_filter_rule;
+void gtp5g_out_flow_desc(struct gtp5g_out *o, const struct ip_filter_rule *rule);
+
+/* gtp5g-uring.c: the io_uring transport of the calling thread, NULL when
+ * the kernel does not provide io_uring */
+const struct genl_transport_ops *gtp5g_uring_transport(void);
+extern const struct genl_transport_ops gtp5g_transport_uring;
+
+/* gtp5g-uring.c: nsend sendmsg() then nrecv recvmsg() calls on the socket
+ * of nl, one datagram each and all with flags, in a single io_uring_enter().
+ * The calls are linked in order, the first failing one cancels those after
+ * it. res gets the result of each, -errno on failure; gtp5g_uring_recv_res()
+ * turns the one of a receive into what mnl_socket_recvfrom() would return.
+ * Fails with EINVAL beyond GTP5G_URING_ENTRIES calls. */
+struct iovec;
+
+/* A datagram of a batch and the ACKs of its requests fit */
+#define GTP5G_URING_ENTRIES	128
+
+int gtp5g_uring_xfer(struct mnl_socket *nl, const struct iovec *send,
+		     unsigned int nsend, struct iovec *recv, unsigned int nrecv,
+		     int flags, int32_t *res);
+ssize_t gtp5g_uring_recv_res(int32_t res, size_t len);
+
+/* gtp5g.c: parts of the rule objects, for the reply parsers */
+struct sdf_filter;
+struct gtp5g_pdi;
+struct gtp5g_forwarding_parameter;
+void gtp5g_sdf_filter_description_free(const struct gtp5g_allocator *a, struct ip_filter_rule *rule);
+void gtp5g_sdf_filter_free(const struct gtp5g_allocator *a, struct sdf_filter *sdf);
+void gtp5g_pdi_free(const struct gtp5g_allocator *a, struct gtp5g_pdi *pdi);
+void gtp5g_forwarding_parameter_free(const struct gtp5g_allocator *a,
+				     struct gtp5g_forwarding_parameter *fwd_param);
+void *gtp5g_list_copy(const struct gtp5g_allocator *a, void *list, int *num, size_t elem,
+		      const void *p, size_t len);
+
+/* gtp5g.c: rule objects allocating from a, for the handle dumps */
+struct gtp5g_pdr *gtp5g_pdr_alloc_with(const struct gtp5g_allocator *a);
+struct gtp5g_far *gtp5g_far_alloc_with(const struct gtp5g_allocator *a);
+struct gtp5g_qer *gtp5g_qer_alloc_with(const struct gtp5g_allocator *a);
+
+#define gtp5g_drop(a, ptr)		\
+	do {				\
+		gtp5g_free(a, ptr);	\
+		(ptr) = NULL;		\
+	} while (0)
+
+/* The rule objects keep the allocator of their parts in alloc */
 struct gtp5g_dev {
+    const struct gtp5g_allocator *alloc;
     int ifns;
     uint32_t ifidx;
 };
@@ -22,6 +621,7 @@ struct gtp5g_dev {
  *		For IE Types, 3GPP TS 29.244 v16.4.0 (2020-06)
  * */
 struct gtp5g_qer {
+	const struct gtp5g_allocator *alloc;
 	uint32_t 	id; 					/* 8.2.75 QER_ID */
 	uint8_t		ul_dl_gate;				/* 8.2.7 Gate Status */
 	struct {
@@ -77,6 +677,7 @@ struct gtp5g_forwarding_parameter {
 };
 
 struct gtp5g_far {
+    const struct gtp5g_allocator *alloc;
     uint32_t id;								/* FAR_ID */
     uint8_t apply_action; 						/* Apply Action */
     
@@ -99,9 +700,9 @@ struct ip_filter_rule {
     struct in_addr src, smask;          // ip addr or "any" -> 0.0.0.0
     struct in_addr dest, dmask;         // ip addr or "any" -> 0.0.0.0
     int sport_num;
-    uint32_t *sport_list;               // one value, range or not existed -> [0, 0]
+    uint32_t *sport_list;               // sport_num of port1 + (port2 << 16), NULL when none
     int dport_num;
-    uint32_t *dport_list;               // one value, range or not existed -> [0, 0]
+    uint32_t *dport_list;               // dport_num of port1 + (port2 << 16), NULL when none
 };
 
 struct sdf_filter {
@@ -110,6 +711,7 @@ struct sdf_filter {
     uint32_t *security_param_idx;
     uint32_t *flow_label;               // exactly 3 Octets
     uint32_t *bi_id;
+    struct sdf_filter *next;            // of the same PDI, in the order set
 };
 
 struct gtp5g_pdi {
@@ -119,10 +721,11 @@ struct gtp5g_pdi {
 
 	/* Local F-TEID */
     struct local_f_teid *f_teid;
-    struct sdf_filter *sdf;
+    struct sdf_filter *sdf;             // first of the list
 };
 
 struct gtp5g_pdr {
+    const struct gtp5g_allocator *alloc;
     uint16_t id;
     uint32_t *precedence;
     struct gtp5g_pdi *pdi;
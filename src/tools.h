@@ -18,9 +18,18 @@ static inline uint32_t decimal_to_netmask(uint32_t mask) {
     return ret;
 }
 
-static inline uint32_t *port_list_create(char *port_list) {
-    uint32_t *ret = calloc(0xff, sizeof(uint32_t));
-    uint32_t port1, port2, cnt = 0;
+/* The ports of "80,90-100" as port1 + (port2 << 16) each, *num of them */
+static inline uint32_t *port_list_create(const struct gtp5g_allocator *a, char *port_list, int *num) {
+    uint32_t port1, port2, cnt = 1;
+    uint32_t *ret;
+
+    for (char *p = port_list; *p; p++)
+        cnt += *p == ',';
+    ret = gtp5g_calloc(a, cnt, sizeof(uint32_t));
+    *num = 0;
+    if (!ret)
+        return NULL;
+    cnt = 0;
 
     char *tok_ptr = strtok(port_list, ","), *chr_ptr;
     while (tok_ptr != NULL)  {
@@ -28,45 +37,17 @@ static inline uint32_t *port_list_create(char *port_list) {
         if (chr_ptr) {
             *chr_ptr = '\0'; port1 = atoi(tok_ptr); port2 = atoi(chr_ptr + 1);
             if (port1 <= port2)
-                ret[++cnt] = port1 + (port2 << 16);
+                ret[cnt++] = port1 + (port2 << 16);
             else
-                ret[++cnt] = port2 + (port1 << 16);
+                ret[cnt++] = port2 + (port1 << 16);
         }
         else {
             port1 = atoi(tok_ptr);
-            ret[++cnt] = port1 + (port1 << 16);
+            ret[cnt++] = port1 + (port1 << 16);
         }
         tok_ptr = strtok(NULL, ",");
     }
-    ret[0] = cnt;
+    *num = cnt;
 
     return ret;
 }
-
-static inline void port_list_from_kernel_print(uint32_t *port_list, int len) {
-    if (!port_list || len <= 0)
-        return;
-
-    int port1, port2;
-    for (int i = 0; i < len; i++) {
-        port1 = (port_list[i] & 0xFFFF);
-        port2 = (port_list[i] >> 16);
-        
-        if (i)
-            printf(",");
-        
-        if (port1 == port2)
-            printf("%d", port1);
-        else
-            printf("%d-%d", port1, port2);
-    }
-}
-
-static inline void u16_id_list_from_kernel_space_print(uint16_t *u16_id_list, int len) {
-    if (!u16_id_list || len <= 0)
-        return;
-
-    printf("%d", u16_id_list[0]);
-    for (int i = 1; i < len; i++)
-        printf(", %d", u16_id_list[i]);
-}
\ No newline at end of file
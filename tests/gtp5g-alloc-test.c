@@ -0,0 +1,300 @@
+/* Allocators: what the library takes is given back to the one it came from */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "gtp5g-test.h"
+
+#define TEST_RULES  50
+
+/* Each block starts with the allocator it came from */
+struct count_block {
+    struct count_alloc *owner;
+    max_align_t align[];
+};
+
+struct count_alloc {
+    struct gtp5g_allocator ops;
+    long live;
+    unsigned long calls;
+};
+
+static struct count_block *count_block(void *ptr, void *ctx)
+{
+    struct count_block *b = (struct count_block *)ptr - 1;
+
+    /* Freed by the allocator it came from, which got its own ctx */
+    test_assert(b->owner == ctx);
+    return b;
+}
+
+static void *count_malloc(size_t size, void *ctx)
+{
+    struct count_alloc *c = ctx;
+    struct count_block *b = malloc(sizeof(*b) + size);
+
+    if (!b)
+        return NULL;
+    b->owner = c;
+    c->live++;
+    c->calls++;
+    return b + 1;
+}
+
+static void *count_calloc(size_t nmemb, size_t size, void *ctx)
+{
+    void *p = count_malloc(nmemb * size, ctx);
+
+    if (p)
+        memset(p, 0, nmemb * size);
+    return p;
+}
+
+static void *count_realloc(void *ptr, size_t size, void *ctx)
+{
+    struct count_alloc *c = ctx;
+    struct count_block *b;
+
+    if (!ptr)
+        return count_malloc(size, ctx);
+
+    b = realloc(count_block(ptr, ctx), sizeof(*b) + size);
+    if (!b)
+        return NULL;
+    c->calls++;
+    return b + 1;
+}
+
+static void count_free(void *ptr, void *ctx)
+{
+    struct count_alloc *c = ctx;
+
+    if (!ptr)
+        return;
+    free(count_block(ptr, ctx));
+    c->live--;
+}
+
+#define COUNT_ALLOC(var)                                                    \
+    struct count_alloc var = {                                              \
+        .ops = {                                                            \
+            .malloc     = count_malloc,                                     \
+            .calloc     = count_calloc,                                     \
+            .realloc    = count_realloc,                                    \
+            .free       = count_free,                                       \
+            .ctx        = &var,                                             \
+        },                                                                  \
+    }
+
+static ssize_t null_write(const void *buf, size_t len, void *data)
+{
+    return len;
+}
+
+static struct gtp5g_pdr *test_full_pdr(uint16_t id)
+{
+    struct gtp5g_pdr *pdr = test_pdr_alloc(id, id);
+    struct in_addr addr = { .s_addr = inet_addr("10.60.0.1") };
+
+    gtp5g_pdr_set_ue_addr_ipv4(pdr, &addr);
+    gtp5g_pdr_set_local_f_teid(pdr, id, &addr);
+    gtp5g_pdr_set_unix_sock_path(pdr, "/tmp/gtp5g.sock");
+    gtp5g_pdr_set_sdf_filter_description(pdr, "permit out ip from any 80-90 to 10.60.0.1 443");
+    return pdr;
+}
+
+/* Rules added, looked up and listed */
+static void test_alloc_parse(struct test_env *env)
+{
+    struct gtp5g_sink sink = { .fd = -1, .write = null_write };
+    struct gtp5g_pdr *pdr, *got;
+    struct gtp5g_far *far;
+    unsigned int i;
+
+    for (i = 1; i <= TEST_RULES; i++) {
+        far = test_far_alloc(i);
+        gtp5g_far_set_fwd_policy(far, "policy");
+        test_ok(gtp5g_add_far(env->genl_id, env->nl, env->dev, far));
+        gtp5g_far_free(far);
+
+        pdr = test_full_pdr(i);
+        test_ok(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr));
+        got = gtp5g_pdr_find_by_id(env->genl_id, env->nl, env->dev, pdr);
+        test_assert(got);
+        test_assert(*gtp5g_pdr_get_far_id(got) == i);
+        test_ok(gtp5g_pdr_find_by_id_into(env->genl_id, env->nl, env->dev, pdr, got));
+        gtp5g_pdr_free(got);
+        gtp5g_pdr_free(pdr);
+    }
+
+    test_ok(gtp5g_list_pdr_to(env->genl_id, env->nl, &sink, GTP5G_FORMAT_JSON));
+    test_ok(gtp5g_list_far_to(env->genl_id, env->nl, &sink, GTP5G_FORMAT_CSV));
+    test_ok(gtp5g_list_pdr_to(env->genl_id, env->nl, &sink, GTP5G_FORMAT_TEXT));
+}
+
+static void test_async_far(struct gtp5g_async *a, uint8_t cmd, uint16_t flags)
+{
+    struct nlmsghdr *nlh;
+    unsigned int i;
+
+    for (i = 1; i <= TEST_RULES; i++) {
+        nlh = gtp5g_async_put(a, flags, cmd, i);
+        test_assert(nlh);
+        mnl_attr_put_u32(nlh, GTP5G_LINK, 1);
+        mnl_attr_put_u32(nlh, GTP5G_FAR_ID, i);
+        if (cmd == GTP5G_CMD_ADD_FAR)
+            mnl_attr_put_u8(nlh, GTP5G_FAR_APPLY_ACTION, 2);
+        gtp5g_async_commit(a, nlh, NULL, NULL);
+    }
+    test_assert(gtp5g_async_run(a) == TEST_RULES);
+}
+
+/* A batch deleting the rules, an async context adding the FARs back and
+ * deleting them again */
+static void test_alloc_requests(struct test_env *env)
+{
+    struct gtp5g_batch *b = gtp5g_batch_alloc(env->genl_id, env->nl);
+    struct mnl_socket *nl = genl_socket_open();
+    struct gtp5g_async *a;
+    struct gtp5g_pdr *pdr;
+    struct gtp5g_far *far;
+    unsigned int i;
+
+    test_assert(b);
+    for (i = 1; i <= TEST_RULES; i++) {
+        pdr = test_pdr_alloc(i, i);
+        test_ok(gtp5g_batch_del_pdr(b, env->dev, pdr));
+        gtp5g_pdr_free(pdr);
+        far = test_far_alloc(i);
+        test_ok(gtp5g_batch_del_far(b, env->dev, far));
+        gtp5g_far_free(far);
+    }
+    test_assert(gtp5g_batch_send(b, NULL, NULL) == 0);
+    gtp5g_batch_free(b);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_PDR) == 0);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_FAR) == 0);
+
+    test_assert(nl);
+    a = gtp5g_async_alloc(env->genl_id, nl);
+    test_assert(a);
+    test_async_far(a, GTP5G_CMD_ADD_FAR, NLM_F_EXCL);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_FAR) == TEST_RULES);
+    test_async_far(a, GTP5G_CMD_DEL_FAR, 0);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_FAR) == 0);
+    gtp5g_async_free(a);
+    genl_socket_close(nl);
+}
+
+/* Saved, then restored over a table emptied in between, and mapped */
+static void test_alloc_snapshots(struct test_env *env)
+{
+    struct gtp5g_snapshot_stats stats;
+    char path[] = "/tmp/gtp5g-alloc-test-XXXXXX";
+    struct gtp5g_snapmap *m;
+    struct gtp5g_pdr *pdr;
+    FILE *f = tmpfile();
+    unsigned int i;
+    int fd;
+
+    test_assert(f);
+    test_ok(gtp5g_snapshot_save(env->genl_id, env->nl, fileno(f), &stats));
+    test_assert(stats.pdr == TEST_RULES && stats.far == TEST_RULES);
+
+    for (i = 1; i <= TEST_RULES; i++) {
+        pdr = test_pdr_alloc(i, i);
+        test_ok(gtp5g_del_pdr(env->genl_id, env->nl, env->dev, pdr));
+        gtp5g_pdr_free(pdr);
+    }
+    test_assert(lseek(fileno(f), 0, SEEK_SET) == 0);
+    /* The FARs are still there */
+    test_assert(gtp5g_snapshot_restore(env->genl_id, env->nl, env->dev, fileno(f),
+                                       &stats, NULL, NULL) == TEST_RULES);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_PDR) == TEST_RULES);
+    fclose(f);
+
+    fd = mkstemp(path);
+    test_assert(fd >= 0);
+    test_ok(gtp5g_snapmap_save(env->genl_id, env->nl, fd, &stats));
+    close(fd);
+    m = gtp5g_snapmap_open(path);
+    test_assert(m);
+    test_assert(gtp5g_snapmap_find_pdr(m, TEST_RULES));
+    gtp5g_snapmap_close(m);
+    unlink(path);
+}
+
+/* Everything the library does, each round leaves the tables empty */
+static void test_alloc_round(struct test_env *env)
+{
+    test_alloc_parse(env);
+    test_alloc_snapshots(env);
+    test_alloc_requests(env);
+}
+
+int main(void)
+{
+    COUNT_ALLOC(first);
+    COUNT_ALLOC(second);
+    struct test_env env;
+    struct gtp5g_pdr *pdr;
+    struct gtp5g_batch *b;
+    struct gtp5g_far *far;
+
+    test_env_init(&env);
+
+    test_ok(gtp5g_set_allocator(&first.ops));
+    test_alloc_round(&env);
+    test_assert(first.calls && first.live == 0);
+
+    /* Objects made before the switch grow and go with the first one */
+    pdr = test_pdr_alloc(1, 1);
+    far = test_far_alloc(1);
+    b = gtp5g_batch_alloc(env.genl_id, env.nl);
+    test_assert(b);
+    test_assert(first.live > 0);
+
+    test_ok(gtp5g_set_allocator(&second.ops));
+    gtp5g_pdr_set_unix_sock_path(pdr, "/tmp/gtp5g.sock");
+    gtp5g_pdr_set_sdf_filter_description(pdr, "permit out ip from any to 10.60.0.1 443");
+    gtp5g_far_set_fwd_policy(far, "policy");
+    test_ok(gtp5g_batch_add_far(b, env.dev, far));
+    test_ok(gtp5g_batch_add_pdr(b, env.dev, pdr));
+    test_ok(gtp5g_batch_del_pdr(b, env.dev, pdr));
+    test_ok(gtp5g_batch_del_far(b, env.dev, far));
+    test_assert(gtp5g_batch_send(b, NULL, NULL) == 0);
+    gtp5g_batch_free(b);
+    gtp5g_pdr_free(pdr);
+    gtp5g_far_free(far);
+    test_assert(first.live == 0);
+
+    /* And what is made afterwards with the second one */
+    test_alloc_round(&env);
+    test_assert(second.calls && second.live == 0);
+    test_assert(first.live == 0);
+
+    test_ok(gtp5g_set_allocator(NULL));
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+/* gtp5g::Async: coroutines awaiting Pdr, FixedPdr and Far requests */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <coroutine>
+
+#include <libgtp5gnl/gtp5g.hpp>
+
+#include "gtp5g-test.h"
+
+#define TEST_SESSIONS   100
+
+using UplinkPdr = gtp5g::FixedPdr<gtp5g::ie::Precedence, gtp5g::ie::FarId, gtp5g::ie::FTeid>;
+
+/* Runs until its first co_await, and frees itself at its end */
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::abort(); }
+    };
+};
+
+struct Results {
+    unsigned int ok;
+    unsigned int failed;
+    unsigned int finished;
+    int err;
+};
+
+static void count(Results &r, int ret)
+{
+    if (ret < 0) {
+        r.failed++;
+        r.err = gtp5g_get_err()->err;
+    } else {
+        r.ok++;
+    }
+}
+
+/* Seven requests, the PDR added twice fails */
+static Task session(gtp5g::Async &a, gtp5g::Device dev, uint32_t id, Results &r)
+{
+    gtp5g::Far far;
+    gtp5g::Pdr pdr, fixed;
+
+    far.id = id;
+    far.apply_action = 2;
+    pdr.id = id;
+    pdr.precedence = 255;
+    pdr.far_id = id;
+    fixed = pdr;
+    fixed.id = id + TEST_SESSIONS;
+    fixed.pdi.emplace();
+    fixed.pdi->f_teid = gtp5g::FTeid{id, {}};
+
+    count(r, co_await a.add(dev, far));
+    count(r, co_await a.add(dev, pdr));
+    count(r, co_await a.add(dev, UplinkPdr(fixed)));
+    count(r, co_await a.add(dev, pdr));
+    count(r, co_await a.del(dev, pdr));
+    count(r, co_await a.del(dev, UplinkPdr(fixed)));
+    count(r, co_await a.del(dev, far));
+    r.finished++;
+}
+
+static void test_async_sessions(struct test_env *env, const gtp5g::Socket &s)
+{
+    gtp5g::Async a = gtp5g::Async::alloc(s);
+    gtp5g::Device dev{-1, 1};
+    Results r = {};
+    uint32_t id;
+
+    test_assert(a);
+    for (id = 1; id <= TEST_SESSIONS; id++)
+        session(a, dev, id, r);
+    test_assert(a.pending() == TEST_SESSIONS);
+
+    test_assert(a.run() == 7 * TEST_SESSIONS);
+    test_assert(a.pending() == 0);
+    test_assert(r.finished == TEST_SESSIONS);
+    test_assert(r.ok == 6 * TEST_SESSIONS && r.failed == TEST_SESSIONS);
+    test_assert(r.err == EEXIST);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_PDR) == 0);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_FAR) == 0);
+}
+
+/* Freeing the Async resumes what waits with ECANCELED, what the session
+ * awaits afterwards fails at once */
+static void test_async_cancel(const gtp5g::Socket &s)
+{
+    gtp5g::Device dev{-1, 1};
+    Results r = {};
+
+    {
+        gtp5g::Async a = gtp5g::Async::alloc(s);
+
+        test_assert(a);
+        session(a, dev, 1, r);
+        test_assert(a.pending() == 1 && r.finished == 0);
+    }
+    test_assert(r.finished == 1);
+    test_assert(r.ok == 0 && r.failed == 7);
+    test_assert(r.err == ECANCELED);
+}
+
+int main(void)
+{
+    struct test_env env;
+
+    test_env_init(&env);
+    {
+        gtp5g::Socket s = gtp5g::Socket::open();
+
+        test_assert(s);
+        test_async_sessions(&env, s);
+        test_async_cancel(s);
+    }
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
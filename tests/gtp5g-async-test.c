@@ -0,0 +1,177 @@
+/* Asynchronous requests: several in flight, a failing one, and those
+ * cancelled by gtp5g_async_free() */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+
+#include "gtp5g-test.h"
+
+/* More than a datagram's worth of ACKs */
+#define TEST_RULES  300
+
+struct async_done {
+    struct gtp5g_async *a;
+    unsigned int ok;
+    unsigned int failed;
+    unsigned int last;          /* of the requests, in completion order */
+    int err;
+    uint8_t cmd;
+    uint32_t id;
+    int requeue;                /* queue another request from the callback */
+};
+
+struct async_req {
+    struct async_done *done;
+    unsigned int index;
+};
+
+static void async_cb(const struct gtp5g_err *err, void *data)
+{
+    struct async_req *r = data;
+    struct async_done *d = r->done;
+
+    /* Each is called once, in the order of the requests */
+    test_assert(r->index == d->last);
+    d->last++;
+
+    if (!err) {
+        d->ok++;
+        return;
+    }
+    d->failed++;
+    d->err = err->err;
+    d->cmd = err->cmd;
+    d->id = err->id;
+
+    if (d->requeue) {
+        test_assert(!gtp5g_async_put(d->a, 0, GTP5G_CMD_DEL_FAR, 1));
+        test_assert(gtp5g_get_err()->err == ECANCELED);
+    }
+}
+
+/* The builders are not exported, the requests are put by hand on the
+ * device of test_env_init() */
+static void async_add_far(struct gtp5g_async *a, uint32_t id, struct async_req *r)
+{
+    struct nlmsghdr *nlh;
+
+    nlh = gtp5g_async_put(a, NLM_F_EXCL, GTP5G_CMD_ADD_FAR, id);
+    test_assert(nlh);
+    mnl_attr_put_u32(nlh, GTP5G_LINK, 1);
+    mnl_attr_put_u32(nlh, GTP5G_FAR_ID, id);
+    mnl_attr_put_u8(nlh, GTP5G_FAR_APPLY_ACTION, 2);
+    gtp5g_async_commit(a, nlh, async_cb, r);
+}
+
+static void async_del_far(struct gtp5g_async *a, uint32_t id, struct async_req *r)
+{
+    struct nlmsghdr *nlh;
+
+    nlh = gtp5g_async_put(a, 0, GTP5G_CMD_DEL_FAR, id);
+    test_assert(nlh);
+    mnl_attr_put_u32(nlh, GTP5G_LINK, 1);
+    mnl_attr_put_u32(nlh, GTP5G_FAR_ID, id);
+    gtp5g_async_commit(a, nlh, async_cb, r);
+}
+
+/* All in flight at once, the FAR added twice fails on its own */
+static void test_async_adds(struct test_env *env)
+{
+    static struct async_req reqs[TEST_RULES + 1];
+    struct async_done d = {};
+    struct mnl_socket *nl = genl_socket_open();
+    struct gtp5g_async *a;
+    unsigned int i;
+
+    test_assert(nl);
+    a = gtp5g_async_alloc(env->genl_id, nl);
+    test_assert(a);
+    d.a = a;
+
+    for (i = 0; i < TEST_RULES; i++) {
+        reqs[i] = (struct async_req) { &d, i };
+        async_add_far(a, i + 1, &reqs[i]);
+    }
+    reqs[i] = (struct async_req) { &d, i };
+    async_add_far(a, 7, &reqs[i]);
+    test_assert(gtp5g_async_pending(a) == TEST_RULES + 1);
+
+    test_assert(gtp5g_async_run(a) == TEST_RULES + 1);
+    test_assert(gtp5g_async_pending(a) == 0);
+    test_assert(d.ok == TEST_RULES && d.failed == 1);
+    test_assert(d.err == EEXIST && d.cmd == GTP5G_CMD_ADD_FAR && d.id == 7);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_FAR) == TEST_RULES);
+
+    d = (struct async_done) { .a = a };
+    for (i = 0; i < TEST_RULES; i++) {
+        reqs[i] = (struct async_req) { &d, i };
+        async_del_far(a, i + 1, &reqs[i]);
+    }
+    test_assert(gtp5g_async_run(a) == TEST_RULES);
+    test_assert(d.ok == TEST_RULES && d.failed == 0);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_FAR) == 0);
+
+    gtp5g_async_free(a);
+    genl_socket_close(nl);
+}
+
+/* Requests sent and not yet acknowledged, and those not sent at all, are
+ * cancelled alike, and their callbacks cannot queue more */
+static void test_async_free(struct test_env *env)
+{
+    struct async_req reqs[3];
+    struct async_done d = { .requeue = 1 };
+    struct mnl_socket *nl = genl_socket_open();
+    struct gtp5g_async *a;
+    unsigned int i;
+
+    test_assert(nl);
+    a = gtp5g_async_alloc(env->genl_id, nl);
+    test_assert(a);
+    d.a = a;
+
+    for (i = 0; i < 3; i++)
+        reqs[i] = (struct async_req) { &d, i };
+    async_add_far(a, 1, &reqs[0]);
+    async_add_far(a, 2, &reqs[1]);
+    test_assert(gtp5g_async_flush(a) == 0);
+    async_add_far(a, 3, &reqs[2]);
+    test_assert(gtp5g_async_pending(a) == 3);
+
+    gtp5g_async_free(a);
+    test_assert(d.ok == 0 && d.failed == 3);
+    test_assert(d.err == ECANCELED && d.cmd == GTP5G_CMD_ADD_FAR && d.id == 3);
+
+    /* The two sent went through, their ACKs are left to the socket */
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_FAR) == 2);
+    genl_socket_close(nl);
+}
+
+int main(void)
+{
+    struct test_env env;
+
+    test_env_init(&env);
+    test_async_adds(&env);
+    test_async_free(&env);
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/* Batches go on past failed requests and report each of them */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+
+#include "gtp5g-test.h"
+
+#define TEST_RULES  200
+
+struct batch_failures {
+    unsigned int num;
+    unsigned int index[8];
+    int err[8];
+};
+
+static void batch_err_cb(unsigned int index, const struct gtp5g_err *err, void *data)
+{
+    struct batch_failures *f = data;
+
+    if (f->num < 8) {
+        f->index[f->num] = index;
+        f->err[f->num] = err->err;
+    }
+    f->num++;
+}
+
+int main(void)
+{
+    struct batch_failures f = {};
+    struct test_env env;
+    struct gtp5g_batch *b;
+    struct gtp5g_pdr *pdr;
+    struct gtp5g_far *far;
+    unsigned int i;
+
+    test_env_init(&env);
+    b = gtp5g_batch_alloc(env.genl_id, env.nl);
+    test_assert(b);
+
+    /* More requests than one datagram takes, two of them failing: a FAR
+     * modified before it exists and one added twice */
+    for (i = 1; i <= TEST_RULES; i++) {
+        far = test_far_alloc(i);
+        test_ok(gtp5g_batch_add_far(b, env.dev, far));
+        gtp5g_far_free(far);
+    }
+    far = test_far_alloc(TEST_RULES + 1);
+    test_ok(gtp5g_batch_mod_far(b, env.dev, far));
+    gtp5g_far_free(far);
+    far = test_far_alloc(1);
+    test_ok(gtp5g_batch_add_far(b, env.dev, far));
+    gtp5g_far_free(far);
+    pdr = test_pdr_alloc(2, 2);
+    test_ok(gtp5g_batch_add_pdr(b, env.dev, pdr));
+    gtp5g_pdr_free(pdr);
+    test_assert(gtp5g_batch_count(b) == TEST_RULES + 3);
+
+    test_assert(gtp5g_batch_send(b, batch_err_cb, &f) == 2);
+    test_assert(f.num == 2);
+    test_assert(f.index[0] == TEST_RULES && f.err[0] == ENOENT);
+    test_assert(f.index[1] == TEST_RULES + 1 && f.err[1] == EEXIST);
+    test_assert(gtp5g_batch_count(b) == 0);
+    test_assert(gtp5g_fake_count(env.fake, GTP5G_FAKE_FAR) == TEST_RULES);
+    test_assert(gtp5g_fake_count(env.fake, GTP5G_FAKE_PDR) == 1);
+
+    /* Refused while queueing, nothing is queued */
+    pdr = gtp5g_pdr_alloc();
+    gtp5g_pdr_set_id(pdr, 3);
+    test_assert(gtp5g_batch_add_pdr(b, env.dev, pdr) < 0);
+    test_assert(gtp5g_batch_count(b) == 0);
+    gtp5g_pdr_free(pdr);
+
+    /* The batch is reusable once sent */
+    f = (struct batch_failures){};
+    far = test_far_alloc(1);
+    test_ok(gtp5g_batch_del_far(b, env.dev, far));
+    gtp5g_far_free(far);
+    test_assert(gtp5g_batch_send(b, batch_err_cb, &f) == 0);
+    test_assert(f.num == 0);
+    test_assert(gtp5g_fake_count(env.fake, GTP5G_FAKE_FAR) == TEST_RULES - 1);
+
+    gtp5g_batch_free(b);
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
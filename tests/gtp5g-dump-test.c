@@ -0,0 +1,102 @@
+/* Dumps interrupted by table changes are started over */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "gtp5g-test.h"
+
+#define TEST_RULES  300
+
+struct dump_count {
+    unsigned int far;
+    unsigned int pdr;
+    unsigned int restarts;
+    uint8_t restart_cmd;
+};
+
+static int far_cb(const struct gtp5g_far_view *v, void *data)
+{
+    struct dump_count *c = data;
+
+    c->far++;
+    return 0;
+}
+
+static int pdr_cb(const struct gtp5g_pdr_view *v, void *data)
+{
+    struct dump_count *c = data;
+
+    c->pdr++;
+    return 0;
+}
+
+static void restart_cb(uint8_t cmd, void *data)
+{
+    struct dump_count *c = data;
+
+    c->restarts++;
+    c->restart_cmd = cmd;
+    if (cmd == GTP5G_CMD_GET_FAR)
+        c->far = 0;
+    else if (cmd == GTP5G_CMD_GET_PDR)
+        c->pdr = 0;
+}
+
+int main(void)
+{
+    struct gtp5g_view_ops ops = { .far = far_cb, .pdr = pdr_cb, .restart = restart_cb };
+    struct gtp5g_view_ops no_restart = { .far = far_cb };
+    struct dump_count c = {};
+    struct test_env env;
+    unsigned int i;
+
+    test_env_init(&env);
+    for (i = 1; i <= TEST_RULES; i++) {
+        struct gtp5g_far *far = test_far_alloc(i);
+        struct gtp5g_pdr *pdr = test_pdr_alloc(i, i);
+
+        test_ok(gtp5g_add_far(env.genl_id, env.nl, env.dev, far));
+        test_ok(gtp5g_add_pdr(env.genl_id, env.nl, env.dev, pdr));
+        gtp5g_pdr_free(pdr);
+        gtp5g_far_free(far);
+    }
+
+    test_ok(gtp5g_dump_views(env.genl_id, env.nl, &ops, &c));
+    test_assert(c.far == TEST_RULES && c.pdr == TEST_RULES);
+    test_assert(c.restarts == 0);
+
+    /* The first dump, of the PDRs, is interrupted once */
+    c = (struct dump_count){};
+    gtp5g_fake_set_dump_intr(env.fake, 1);
+    test_ok(gtp5g_dump_views(env.genl_id, env.nl, &ops, &c));
+    test_assert(c.restarts == 1);
+    test_assert(c.restart_cmd == GTP5G_CMD_GET_PDR);
+    test_assert(c.far == TEST_RULES && c.pdr == TEST_RULES);
+
+    /* Without a restart callback the dump still completes, rules seen
+     * before the restart are passed again */
+    c = (struct dump_count){};
+    gtp5g_fake_set_dump_intr(env.fake, 1);
+    test_ok(gtp5g_dump_views(env.genl_id, env.nl, &no_restart, &c));
+    test_assert(c.far >= TEST_RULES);
+    test_assert(c.restarts == 0);
+
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/* JSON and CSV output of listed rules, down to the byte */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "gtp5g-test.h"
+
+/* Takes a few bytes per call, so that output is handed over in pieces */
+#define TEST_SINK_CHUNK 7
+
+struct test_mem {
+    char buf[4096];
+    size_t len;
+};
+
+static ssize_t test_mem_write(const void *buf, size_t len, void *data)
+{
+    struct test_mem *m = data;
+
+    if (len > TEST_SINK_CHUNK)
+        len = TEST_SINK_CHUNK;
+    test_assert(m->len + len < sizeof(m->buf));
+    memcpy(m->buf + m->len, buf, len);
+    m->len += len;
+    m->buf[m->len] = '\0';
+    return len;
+}
+
+static void test_list(struct test_env *env,
+                      int (*list)(int genl_id, struct mnl_socket *nl,
+                                  const struct gtp5g_sink *sink, enum gtp5g_format format),
+                      enum gtp5g_format format, const char *expect)
+{
+    struct test_mem m = {};
+    struct gtp5g_sink sink = { .write = test_mem_write, .data = &m };
+
+    test_ok(list(env->genl_id, env->nl, &sink, format));
+    if (strcmp(m.buf, expect)) {
+        fprintf(stderr, "expected:\n%sgot:\n%s", expect, m.buf);
+        test_assert(0);
+    }
+}
+
+static void test_rules(struct test_env *env)
+{
+    char policy[] = "a\"b,c\x01" "d\\e";
+    struct in_addr peer = { inet_addr("10.0.0.2") }, gtpu = { inet_addr("10.0.0.1") };
+    struct in_addr ue = { inet_addr("10.60.0.1") };
+    struct gtp5g_qer *qer = gtp5g_qer_alloc();
+    struct gtp5g_far *far;
+    struct gtp5g_pdr *pdr;
+
+    test_assert(qer);
+    gtp5g_qer_set_id(qer, 1);
+    gtp5g_qer_set_qfi(qer, 9);
+    test_ok(gtp5g_add_qer(env->genl_id, env->nl, env->dev, qer));
+    gtp5g_qer_free(qer);
+
+    far = test_far_alloc(1);
+    gtp5g_far_set_outer_header_creation(far, 256, 87, &peer, 2152);
+    gtp5g_far_set_fwd_policy(far, policy);
+    test_ok(gtp5g_add_far(env->genl_id, env->nl, env->dev, far));
+    gtp5g_far_free(far);
+    far = test_far_alloc(2);
+    test_ok(gtp5g_add_far(env->genl_id, env->nl, env->dev, far));
+    gtp5g_far_free(far);
+
+    pdr = test_pdr_alloc(1, 1);
+    gtp5g_pdr_set_qer_id(pdr, 1);
+    gtp5g_pdr_set_ue_addr_ipv4(pdr, &ue);
+    gtp5g_pdr_set_local_f_teid(pdr, 78, &gtpu);
+    gtp5g_pdr_set_sdf_filter_description(pdr, "permit out ip from any to 10.60.0.1 443");
+    gtp5g_pdr_set_sdf_filter_id(pdr, 5);
+    gtp5g_pdr_add_sdf_filter(pdr);
+    gtp5g_pdr_set_sdf_filter_description(pdr, "permit out ip from 10.0.0.0/8 to 10.60.0.1");
+    gtp5g_pdr_set_flow_label(pdr, 7);
+    gtp5g_pdr_set_unix_sock_path(pdr, "/tmp/s,1");
+    test_ok(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr));
+    gtp5g_pdr_free(pdr);
+    pdr = test_pdr_alloc(2, 2);
+    test_ok(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr));
+    gtp5g_pdr_free(pdr);
+    pdr = test_pdr_alloc(3, 1);
+    test_ok(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr));
+    gtp5g_pdr_free(pdr);
+}
+
+int main(void)
+{
+    struct test_env env;
+
+    test_env_init(&env);
+    gtp5g_fake_set_sdf_filter_list(env.fake, 1);
+    test_ok(gtp5g_fake_install(env.fake));
+    test_rules(&env);
+
+    test_list(&env, gtp5g_list_far_to, GTP5G_FORMAT_JSON,
+        "{\"id\":1,\"apply_action\":2,\"outer_header_creation\":{\"description\":256,"
+        "\"teid\":87,\"peer_ipv4\":\"10.0.0.2\",\"port\":2152},"
+        "\"forwarding_policy\":\"a\\\"b,c\\u0001d\\\\e\",\"related_pdrs\":[1,3]}\n"
+        "{\"id\":2,\"apply_action\":2,\"related_pdrs\":[2]}\n");
+    test_list(&env, gtp5g_list_far_to, GTP5G_FORMAT_CSV,
+        "id,apply_action,ohc_description,ohc_teid,ohc_peer_ipv4,ohc_port,"
+        "forwarding_policy,related_pdrs\n"
+        "1,2,256,87,10.0.0.2,2152,\"a\"\"b,c\x01" "d\\e\",1;3\n"
+        "2,2,,,,,,2\n");
+
+    /* Two SDF filters, the second without an ID and the first without a
+     * flow label */
+    test_list(&env, gtp5g_list_pdr_to, GTP5G_FORMAT_JSON,
+        "{\"id\":1,\"precedence\":255,\"far_id\":1,\"qer_id\":1,"
+        "\"pdi\":{\"ue_ipv4\":\"10.60.0.1\",\"f_teid\":{\"teid\":78,\"gtpu_ipv4\":\"10.0.0.1\"},"
+        "\"sdf\":[{\"flow_description\":\"permit out ip from any to 10.60.0.1 443\","
+        "\"sdf_filter_id\":5},"
+        "{\"flow_description\":\"permit out ip from 10.0.0.0/8 to 10.60.0.1\","
+        "\"flow_label\":7}]},\"unix_sock_path\":\"/tmp/s,1\"}\n"
+        "{\"id\":2,\"precedence\":255,\"far_id\":2}\n"
+        "{\"id\":3,\"precedence\":255,\"far_id\":1}\n");
+    test_list(&env, gtp5g_list_pdr_to, GTP5G_FORMAT_CSV,
+        "id,precedence,outer_header_removal,far_id,qer_id,ue_ipv4,teid,gtpu_ipv4,"
+        "flow_description,tos_traffic_class,security_param_idx,flow_label,"
+        "sdf_filter_id,role_ipv4,unix_sock_path\n"
+        "1,255,,1,1,10.60.0.1,78,10.0.0.1,"
+        "\"permit out ip from any to 10.60.0.1 443;permit out ip from 10.0.0.0/8 to 10.60.0.1\","
+        ";,;,;7,5;,,\"/tmp/s,1\"\n"
+        "2,255,,2,,,,,,,,,,,\n"
+        "3,255,,1,,,,,,,,,,,\n");
+
+    test_list(&env, gtp5g_list_qer_to, GTP5G_FORMAT_JSON,
+        "{\"id\":1,\"gate_status\":0,"
+        "\"mbr\":{\"ul_high\":0,\"ul_low\":0,\"dl_high\":0,\"dl_low\":0},"
+        "\"gbr\":{\"ul_high\":0,\"ul_low\":0,\"dl_high\":0,\"dl_low\":0},"
+        "\"qer_corr_id\":0,\"rqi\":0,\"qfi\":9,\"ppi\":0,\"rcsr\":0,\"related_pdrs\":[1]}\n");
+    test_list(&env, gtp5g_list_qer_to, GTP5G_FORMAT_CSV,
+        "id,gate_status,mbr_ul_high,mbr_ul_low,mbr_dl_high,mbr_dl_low,gbr_ul_high,"
+        "gbr_ul_low,gbr_dl_high,gbr_dl_low,qer_corr_id,rqi,qfi,ppi,rcsr,related_pdrs\n"
+        "1,0,0,0,0,0,0,0,0,0,0,0,9,0,0,1\n");
+
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+/* Handles: their error callbacks, dumps and threads */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "gtp5g-test.h"
+
+#define TEST_SWAPS  20000
+
+struct err_count {
+    int num;
+    int err;
+};
+
+static void count_err_cb(const struct gtp5g_err *err, void *data)
+{
+    struct err_count *c = data;
+
+    __atomic_add_fetch(&c->num, 1, __ATOMIC_RELAXED);
+    c->err = err->err;
+}
+
+/* A handle reports to its own callback, and to the global one without */
+static void test_handle_err_cb(struct test_env *env)
+{
+    struct err_count global = {}, own = {};
+    struct gtp5g_handle *h = gtp5g_handle_alloc();
+    struct gtp5g_far *far = test_far_alloc(1);
+
+    test_assert(h);
+    test_ok(gtp5g_set_err_cb(count_err_cb, &global));
+    test_ok(gtp5g_handle_set_err_cb(h, count_err_cb, &own));
+
+    test_assert(gtp5g_handle_add_far(h, 3, far) < 0);
+    test_assert(own.num == 1 && own.err == ENODEV && global.num == 0);
+
+    /* Outside of the handle's calls, the global one again */
+    test_assert(gtp5g_del_far(env->genl_id, env->nl, env->dev, far) < 0);
+    test_assert(own.num == 1 && global.num == 1 && global.err == ENOENT);
+
+    test_ok(gtp5g_handle_set_err_cb(h, NULL, NULL));
+    test_assert(gtp5g_handle_add_far(h, 3, far) < 0);
+    test_assert(own.num == 1 && global.num == 2 && global.err == ENODEV);
+
+    test_ok(gtp5g_set_err_cb(NULL, NULL));
+    gtp5g_far_free(far);
+    gtp5g_handle_free(h);
+}
+
+/* Each report sees a callback with its own data, never the new callback
+ * with the old data */
+static int pair_a, pair_b;
+
+static void pair_a_cb(const struct gtp5g_err *err, void *data)
+{
+    test_assert(data == &pair_a);
+}
+
+static void pair_b_cb(const struct gtp5g_err *err, void *data)
+{
+    test_assert(data == &pair_b);
+}
+
+static void *swap_thread(void *arg)
+{
+    unsigned int i;
+
+    for (i = 0; i < TEST_SWAPS; i++) {
+        if (i & 1)
+            test_ok(gtp5g_set_err_cb(pair_a_cb, &pair_a));
+        else
+            test_ok(gtp5g_set_err_cb(pair_b_cb, &pair_b));
+    }
+    return NULL;
+}
+
+static void test_err_cb_swap(void)
+{
+    struct gtp5g_handle *h = gtp5g_handle_alloc();
+    struct gtp5g_far *far = test_far_alloc(1);
+    pthread_t t;
+    unsigned int i;
+
+    test_assert(h);
+    test_assert(pthread_create(&t, NULL, swap_thread, NULL) == 0);
+    for (i = 0; i < TEST_SWAPS; i++)
+        test_assert(gtp5g_handle_add_far(h, 0, far) < 0);
+    pthread_join(t, NULL);
+
+    test_ok(gtp5g_set_err_cb(NULL, NULL));
+    gtp5g_far_free(far);
+    gtp5g_handle_free(h);
+}
+
+/* Rules of a namespace come with its number, whichever device they are on */
+struct dump_seen {
+    unsigned int far;
+    int ns;
+};
+
+static int dump_far_cb(struct gtp5g_handle *h, unsigned int ns, struct gtp5g_far *far,
+                       void *data)
+{
+    struct dump_seen *seen = data;
+
+    seen->far++;
+    seen->ns = ns;
+    return seen->far == 2 ? -1 : 0;
+}
+
+static void test_handle_dump(struct test_env *env)
+{
+    struct gtp5g_handle_dump_ops ops = { .far = dump_far_cb };
+    struct gtp5g_handle *h = gtp5g_handle_alloc();
+    struct dump_seen seen = { .ns = -1 };
+    struct gtp5g_far *far;
+    unsigned int i;
+
+    test_assert(h);
+    test_assert(gtp5g_handle_add_dev(h, NULL, "lo") == 0);
+    test_assert(gtp5g_handle_netns_index(h, 0) == 0);
+    test_assert(gtp5g_handle_netns_index(h, 1) == -1);
+    for (i = 1; i <= 3; i++) {
+        far = test_far_alloc(i);
+        test_ok(gtp5g_handle_add_far(h, 0, far));
+        gtp5g_far_free(far);
+    }
+
+    /* Stopped by the callback at the second FAR */
+    test_assert(gtp5g_handle_dump(h, &ops, &seen) == 1);
+    test_assert(seen.far == 2 && seen.ns == 0);
+    test_assert(gtp5g_get_err()->err == ECANCELED);
+
+    for (i = 1; i <= 3; i++) {
+        far = test_far_alloc(i);
+        test_ok(gtp5g_handle_del_far(h, 0, far));
+        gtp5g_far_free(far);
+    }
+    gtp5g_handle_free(h);
+}
+
+/* Fails for the devices of the second namespace only, from their thread */
+static int run_fn(struct gtp5g_handle *h, unsigned int dev, void *data)
+{
+    struct gtp5g_far *far;
+    int ret;
+
+    if (gtp5g_handle_netns_index(h, dev) == 0)
+        return 0;
+
+    far = test_far_alloc(1);
+    ret = gtp5g_handle_add_far(h, 99, far);
+    gtp5g_far_free(far);
+    return ret;
+}
+
+/* A failure in another thread is handed back to the caller */
+static void test_handle_run_err(void)
+{
+    struct gtp5g_handle *h = gtp5g_handle_alloc();
+
+    test_assert(h);
+    test_assert(gtp5g_handle_add_dev(h, NULL, "lo") == 0);
+
+    /* Entering a namespace, even the own one, takes CAP_SYS_ADMIN */
+    if (gtp5g_handle_add_dev(h, "/proc/self/ns/net", "lo") < 0) {
+        test_assert(gtp5g_get_err()->err == EPERM);
+        gtp5g_handle_free(h);
+        return;
+    }
+    test_assert(gtp5g_handle_netns_index(h, 1) == 1);
+
+    gtp5g_clear_err();
+    test_assert(gtp5g_handle_run(h, run_fn, NULL) == 1);
+    test_assert(gtp5g_get_err()->err == ENODEV);
+    test_assert(strcmp(gtp5g_get_err()->msg, "no such device in handle") == 0);
+    gtp5g_handle_free(h);
+}
+
+int main(void)
+{
+    struct test_env env;
+
+    test_env_init(&env);
+    test_handle_err_cb(&env);
+    test_err_cb_swap();
+    test_handle_dump(&env);
+    test_handle_run_err();
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,237 @@
+/* Add, get, modify and delete round trips of PDRs, FARs and QERs */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "gtp5g-test.h"
+#include "internal.h"
+
+static void test_far(struct test_env *env)
+{
+    struct gtp5g_far *far = test_far_alloc(1), *got;
+    struct in_addr peer = { .s_addr = inet_addr("192.0.2.1") };
+    char policy[] = "policy1";
+
+    gtp5g_far_set_outer_header_creation(far, 0x100, 0x1234, &peer, 2152);
+    gtp5g_far_set_fwd_policy(far, policy);
+    test_ok(gtp5g_add_far(env->genl_id, env->nl, env->dev, far));
+
+    got = gtp5g_far_find_by_id(env->genl_id, env->nl, env->dev, far);
+    test_assert(got);
+    test_assert(*gtp5g_far_get_id(got) == 1);
+    test_assert(*gtp5g_far_get_apply_action(got) == 2);
+    test_assert(*gtp5g_far_get_outer_header_creation_description(got) == 0x100);
+    test_assert(*gtp5g_far_get_outer_header_creation_teid(got) == 0x1234);
+    test_assert(gtp5g_far_get_outer_header_creation_peer_addr_ipv4(got)->s_addr == peer.s_addr);
+    test_assert(*gtp5g_far_get_outer_header_creation_port(got) == 2152);
+    test_assert(!strcmp(gtp5g_far_get_fwd_policy(got), policy));
+
+    /* The decoded object goes back as it came */
+    gtp5g_far_set_apply_action(got, 1);
+    test_ok(gtp5g_mod_far(env->genl_id, env->nl, env->dev, got));
+    test_ok(gtp5g_far_find_by_id_into(env->genl_id, env->nl, env->dev, far, got));
+    test_assert(*gtp5g_far_get_apply_action(got) == 1);
+    test_assert(*gtp5g_far_get_outer_header_creation_teid(got) == 0x1234);
+
+    gtp5g_far_free(got);
+    gtp5g_far_free(far);
+}
+
+static void test_qer(struct test_env *env)
+{
+    struct gtp5g_qer *qer = gtp5g_qer_alloc(), *got;
+
+    test_assert(qer);
+    gtp5g_qer_set_id(qer, 7);
+    gtp5g_qer_set_gate_status(qer, 0);
+    gtp5g_qer_set_mbr_uhigh(qer, 100);
+    gtp5g_qer_set_qfi(qer, 9);
+    test_ok(gtp5g_add_qer(env->genl_id, env->nl, env->dev, qer));
+
+    got = gtp5g_qer_find_by_id(env->genl_id, env->nl, env->dev, qer);
+    test_assert(got);
+    test_assert(*gtp5g_qer_get_id(got) == 7);
+    test_assert(gtp5g_qer_msg_size(env->dev, got) == gtp5g_qer_msg_size(env->dev, qer));
+
+    gtp5g_qer_set_qfi(got, 5);
+    test_ok(gtp5g_mod_qer(env->genl_id, env->nl, env->dev, got));
+
+    gtp5g_qer_free(got);
+    gtp5g_qer_free(qer);
+}
+
+static void test_pdr(struct test_env *env)
+{
+    struct gtp5g_pdr *pdr = test_pdr_alloc(3, 1), *got;
+    struct in_addr ue = { .s_addr = inet_addr("10.60.0.1") };
+    struct in_addr gtpu = { .s_addr = inet_addr("192.0.2.2") };
+
+    gtp5g_pdr_set_qer_id(pdr, 7);
+    gtp5g_pdr_set_outer_header_removal(pdr, 0);
+    gtp5g_pdr_set_ue_addr_ipv4(pdr, &ue);
+    gtp5g_pdr_set_local_f_teid(pdr, 0x78, &gtpu);
+    gtp5g_pdr_set_unix_sock_path(pdr, "/tmp/gtp5g.sock");
+    gtp5g_pdr_set_sdf_filter_description(pdr,
+        "permit out ip from 10.0.0.0/8 80,90-100 to 10.60.0.1 443");
+    gtp5g_pdr_set_sdf_filter_id(pdr, 4);
+    test_ok(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr));
+
+    got = gtp5g_pdr_find_by_id(env->genl_id, env->nl, env->dev, pdr);
+    test_assert(got);
+    test_assert(*gtp5g_pdr_get_id(got) == 3);
+    test_assert(*gtp5g_pdr_get_precedence(got) == 255);
+    test_assert(*gtp5g_pdr_get_far_id(got) == 1);
+    test_assert(*gtp5g_pdr_get_qer_id(got) == 7);
+    test_assert(*gtp5g_pdr_get_outer_header_removal(got) == 0);
+    test_assert(gtp5g_pdr_get_ue_addr_ipv4(got)->s_addr == ue.s_addr);
+    test_assert(*gtp5g_pdr_get_local_f_teid_teid(got) == 0x78);
+    test_assert(gtp5g_pdr_get_local_f_teid_gtpu_addr_ipv4(got)->s_addr == gtpu.s_addr);
+    test_assert(gtp5g_pdr_msg_size(env->dev, got) == gtp5g_pdr_msg_size(env->dev, pdr));
+
+    /* Port lists included, a decoded PDR is modified as is */
+    gtp5g_pdr_set_precedence(got, 16);
+    test_ok(gtp5g_mod_pdr(env->genl_id, env->nl, env->dev, got));
+    test_ok(gtp5g_pdr_find_by_id_into(env->genl_id, env->nl, env->dev, pdr, got));
+    test_assert(*gtp5g_pdr_get_precedence(got) == 16);
+    test_assert(gtp5g_pdr_msg_size(env->dev, got) == gtp5g_pdr_msg_size(env->dev, pdr));
+
+    /* Modifying or adding what is not there fails */
+    gtp5g_pdr_set_id(got, 4);
+    test_assert(gtp5g_mod_pdr(env->genl_id, env->nl, env->dev, got) < 0);
+    test_assert(gtp5g_get_err()->err == ENOENT);
+    test_assert(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr) < 0);
+    test_assert(gtp5g_get_err()->err == EEXIST);
+
+    test_ok(gtp5g_del_pdr(env->genl_id, env->nl, env->dev, pdr));
+    test_assert(!gtp5g_pdr_find_by_id(env->genl_id, env->nl, env->dev, pdr));
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_PDR) == 0);
+
+    gtp5g_pdr_free(got);
+    gtp5g_pdr_free(pdr);
+}
+
+/* A UNIX socket path filling its attribute without a NUL, which the
+ * library never sends, is dropped rather than read past */
+static void test_pdr_unterminated_path(struct test_env *env)
+{
+    struct gtp5g_pdr *pdr = test_pdr_alloc(5, 1), *got;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    struct nlmsghdr *nlh;
+
+    nlh = genl_nlmsg_build_hdr(buf, env->genl_id, NLM_F_EXCL | NLM_F_ACK, 1,
+                               GTP5G_CMD_ADD_PDR);
+    mnl_attr_put_u32(nlh, GTP5G_LINK, 1);
+    mnl_attr_put_u16(nlh, GTP5G_PDR_ID, 5);
+    mnl_attr_put_u32(nlh, GTP5G_PDR_PRECEDENCE, 255);
+    mnl_attr_put(nlh, GTP5G_PDR_UNIX_SOCKET_PATH, 4, "/tmp");
+    mnl_attr_put_u32(nlh, GTP5G_PDR_FAR_ID, 1);
+    test_ok(genl_socket_talk(env->nl, nlh, 1, NULL, NULL));
+
+    got = gtp5g_pdr_find_by_id(env->genl_id, env->nl, env->dev, pdr);
+    test_assert(got);
+    test_assert(*gtp5g_pdr_get_far_id(got) == 1);
+    test_assert(!got->unix_sock_path);
+
+    test_ok(gtp5g_del_pdr(env->genl_id, env->nl, env->dev, pdr));
+    gtp5g_pdr_free(got);
+    gtp5g_pdr_free(pdr);
+}
+
+static ssize_t null_write(const void *buf, size_t len, void *data)
+{
+    return len;
+}
+
+static int bad_qer_view(const struct gtp5g_qer_view *v, void *data)
+{
+    int *seen = data;
+
+    /* The QER of test_qer() is still there */
+    if (*gtp5g_qer_view_get_id(v) != 8)
+        return 0;
+    test_assert(*gtp5g_qer_view_get_gate_status(v) == 1);
+    test_assert(!gtp5g_qer_view_get_qfi(v));
+    test_assert(!gtp5g_qer_view_get_mbr_uhigh(v));
+    test_assert(*gtp5g_qer_view_get_mbr_dhigh(v) == 200);
+    (*seen)++;
+    return 0;
+}
+
+/* An attribute of the wrong length fails the decoding and the listings,
+ * views only go without it */
+static void test_qer_bad_length(struct test_env *env)
+{
+    struct gtp5g_sink sink = { .fd = -1, .write = null_write };
+    struct gtp5g_view_ops ops = { .qer = bad_qer_view };
+    struct gtp5g_qer *qer = gtp5g_qer_alloc();
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    struct nlmsghdr *nlh;
+    struct nlattr *mbr;
+    int seen = 0;
+
+    test_assert(qer);
+    gtp5g_qer_set_id(qer, 8);
+
+    nlh = genl_nlmsg_build_hdr(buf, env->genl_id, NLM_F_EXCL | NLM_F_ACK, 1,
+                               GTP5G_CMD_ADD_QER);
+    mnl_attr_put_u32(nlh, GTP5G_LINK, 1);
+    mnl_attr_put_u32(nlh, GTP5G_QER_ID, 8);
+    mnl_attr_put_u8(nlh, GTP5G_QER_GATE, 1);
+    mnl_attr_put_u32(nlh, GTP5G_QER_QFI, 9);
+    mbr = mnl_attr_nest_start(nlh, GTP5G_QER_MBR);
+    mnl_attr_put_u16(nlh, GTP5G_QER_MBR_UL_HIGH32, 100);
+    mnl_attr_put_u32(nlh, GTP5G_QER_MBR_DL_HIGH32, 200);
+    mnl_attr_nest_end(nlh, mbr);
+    test_ok(genl_socket_talk(env->nl, nlh, 1, NULL, NULL));
+
+    test_assert(!gtp5g_qer_find_by_id(env->genl_id, env->nl, env->dev, qer));
+    test_assert(gtp5g_get_err()->err == ERANGE);
+    gtp5g_clear_err();
+    test_assert(gtp5g_list_qer_to(env->genl_id, env->nl, &sink, GTP5G_FORMAT_TEXT) < 0);
+    test_assert(gtp5g_get_err()->err == ERANGE);
+    gtp5g_clear_err();
+    test_assert(gtp5g_list_qer_to(env->genl_id, env->nl, &sink, GTP5G_FORMAT_JSON) < 0);
+    test_assert(gtp5g_get_err()->err == ERANGE);
+    gtp5g_clear_err();
+
+    test_ok(gtp5g_dump_views(env->genl_id, env->nl, &ops, &seen));
+    test_assert(seen == 1);
+    test_assert(!gtp5g_get_err()->err);
+
+    test_ok(gtp5g_del_qer(env->genl_id, env->nl, env->dev, qer));
+    gtp5g_qer_free(qer);
+}
+
+int main(void)
+{
+    struct test_env env;
+
+    test_env_init(&env);
+    test_far(&env);
+    test_qer(&env);
+    test_pdr(&env);
+    test_pdr_unterminated_path(&env);
+    test_qer_bad_length(&env);
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,217 @@
+/* SDF filters through the description parser and the reply parser */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "gtp5g-test.h"
+#include "internal.h"
+
+/* A reply decoded into a PDR which has no PDI yet */
+static void test_sdf_decode_into_empty(struct test_env *env)
+{
+    struct gtp5g_pdr *pdr = test_pdr_alloc(1, 1), *out = gtp5g_pdr_alloc();
+    struct ip_filter_rule *rule;
+
+    gtp5g_pdr_set_sdf_filter_description(pdr,
+        "permit out ip from 10.0.0.0/8 80 to 10.60.0.0/16 443");
+    test_ok(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr));
+
+    test_assert(out && !out->pdi);
+    test_ok(gtp5g_pdr_find_by_id_into(env->genl_id, env->nl, env->dev, pdr, out));
+    test_assert(out->pdi && out->pdi->sdf && out->pdi->sdf->rule);
+
+    /* DEST_MASK goes to the mask, not over the address */
+    rule = out->pdi->sdf->rule;
+    test_assert(rule->src.s_addr == inet_addr("10.0.0.0"));
+    test_assert(rule->smask.s_addr == inet_addr("255.0.0.0"));
+    test_assert(rule->dest.s_addr == inet_addr("10.60.0.0"));
+    test_assert(rule->dmask.s_addr == inet_addr("255.255.0.0"));
+
+    gtp5g_pdr_free(out);
+    gtp5g_pdr_free(pdr);
+}
+
+/* A description that does not parse leaves no filter behind. Run under a
+ * leak checker, this also covers the regex and the filter being freed. */
+static void test_sdf_bad_description(void)
+{
+    struct gtp5g_pdr *pdr = test_pdr_alloc(2, 1);
+    unsigned int i;
+
+    for (i = 0; i < 100; i++) {
+        gtp5g_pdr_set_sdf_filter_description(pdr, "permit sideways ip from any to any");
+        test_assert(gtp5g_get_err()->err == EINVAL);
+        test_assert(pdr->pdi && !pdr->pdi->sdf);
+    }
+
+    gtp5g_clear_err();
+    gtp5g_pdr_set_sdf_filter_description(pdr, "permit out ip from any to 10.60.0.1");
+    test_assert(!gtp5g_get_err()->err);
+    test_assert(pdr->pdi->sdf && pdr->pdi->sdf->rule);
+
+    gtp5g_pdr_free(pdr);
+}
+
+static struct gtp5g_pdr *test_pdr_two_sdf(uint16_t id)
+{
+    struct gtp5g_pdr *pdr = test_pdr_alloc(id, 1);
+
+    gtp5g_pdr_set_sdf_filter_description(pdr, "permit out ip from any to 10.60.0.1 443");
+    gtp5g_pdr_add_sdf_filter(pdr);
+    gtp5g_pdr_set_sdf_filter_description(pdr, "permit out ip from 10.0.0.0/8 to 10.60.0.1");
+    gtp5g_pdr_set_flow_label(pdr, 7);
+    return pdr;
+}
+
+static void count_err_cb(const struct gtp5g_err *err, void *data)
+{
+    (*(int *)data)++;
+}
+
+/* free5GC's gtp5g takes one filter, the fake does not advertise the list
+ * until told to. Neither that nor a kernel refusing the policy dump is
+ * reported, only the PDR refused. */
+static void test_sdf_list_refused(struct test_env *env)
+{
+    struct gtp5g_pdr *pdr = test_pdr_two_sdf(3);
+    uint32_t count = gtp5g_fake_count(env->fake, GTP5G_FAKE_PDR);
+    int reported = 0;
+
+    test_ok(gtp5g_set_err_cb(count_err_cb, &reported));
+    test_assert(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr) < 0);
+    test_assert(gtp5g_get_err()->err == EOPNOTSUPP);
+    test_assert(reported == 1);
+
+    gtp5g_fake_set_sdf_filter_list(env->fake, -1);
+    test_ok(gtp5g_fake_install(env->fake));
+    test_assert(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr) < 0);
+    test_assert(gtp5g_get_err()->err == EOPNOTSUPP);
+    test_assert(gtp5g_get_err()->cmd == GTP5G_CMD_ADD_PDR && gtp5g_get_err()->id == 3);
+    test_assert(reported == 2);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_PDR) == count);
+
+    test_ok(gtp5g_set_err_cb(NULL, NULL));
+    gtp5g_pdr_free(pdr);
+}
+
+static int test_sdf_view_cb(const struct gtp5g_pdr_view *sdf, void *data)
+{
+    const uint32_t *label = gtp5g_pdr_view_get_flow_label(sdf);
+    const struct in_addr *src = gtp5g_pdr_view_get_sdf_src_ipv4(sdf);
+    int *n = data;
+
+    test_assert(*n ? src && src->s_addr == inet_addr("10.0.0.0") : !src || !src->s_addr);
+    test_assert(*n ? label && *label == 7 : !label);
+    (*n)++;
+    return 0;
+}
+
+static int test_sdf_view_pdr(const struct gtp5g_pdr_view *v, void *data)
+{
+    const uint16_t *id = gtp5g_pdr_view_get_id(v);
+    int n = 0;
+
+    if (*id == 3) {
+        test_assert(gtp5g_pdr_view_for_each_sdf_filter(v, test_sdf_view_cb, &n) == 2);
+        test_assert(n == 2);
+        (*(int *)data)++;
+    }
+    return 0;
+}
+
+static int test_sdf_view_far(const struct gtp5g_far_view *v, void *data)
+{
+    return 0;
+}
+
+static int test_sdf_view_qer(const struct gtp5g_qer_view *v, void *data)
+{
+    return 0;
+}
+
+/* Once advertised, all filters make it through the module and back, into
+ * objects, views, JSON and CSV */
+static void test_sdf_list(struct test_env *env)
+{
+    struct gtp5g_view_ops ops = {
+        .pdr    = test_sdf_view_pdr,
+        .far    = test_sdf_view_far,
+        .qer    = test_sdf_view_qer,
+    };
+    struct gtp5g_pdr *pdr = test_pdr_two_sdf(3), *out = gtp5g_pdr_alloc();
+    struct gtp5g_sink sink = { .write = gtp5g_sink_fwrite };
+    struct sdf_filter *sdf;
+    char *text;
+    size_t len;
+    FILE *f;
+    int seen = 0;
+
+    gtp5g_fake_set_sdf_filter_list(env->fake, 1);
+    test_ok(gtp5g_fake_install(env->fake));
+    test_ok(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr));
+
+    test_ok(gtp5g_pdr_find_by_id_into(env->genl_id, env->nl, env->dev, pdr, out));
+    sdf = out->pdi->sdf;
+    test_assert(sdf && sdf->rule && !sdf->rule->src.s_addr && !sdf->flow_label);
+    sdf = sdf->next;
+    test_assert(sdf && sdf->rule && sdf->rule->src.s_addr == inet_addr("10.0.0.0"));
+    test_assert(sdf->flow_label && *sdf->flow_label == 7 && !sdf->next);
+
+    test_ok(gtp5g_dump_views(env->genl_id, env->nl, &ops, &seen));
+    test_assert(seen == 1);
+
+    f = open_memstream(&text, &len);
+    test_assert(f);
+    sink.data = f;
+    gtp5g_print_pdr_to(out, &sink, GTP5G_FORMAT_JSON);
+    gtp5g_print_pdr_to(out, &sink, GTP5G_FORMAT_CSV);
+    fclose(f);
+    test_assert(strstr(text, "\"sdf\":[{\"flow_description\":"
+                       "\"permit out ip from any to 10.60.0.1 443\"},"
+                       "{\"flow_description\":\"permit out ip from 10.0.0.0/8 to 10.60.0.1\","
+                       "\"flow_label\":7}]"));
+    test_assert(strstr(text, ",\"permit out ip from any to 10.60.0.1 443;"
+                       "permit out ip from 10.0.0.0/8 to 10.60.0.1\",;,;,;7,;,"));
+    free(text);
+
+    gtp5g_pdr_free(out);
+    gtp5g_pdr_free(pdr);
+}
+
+int main(void)
+{
+    struct gtp5g_far *far;
+    struct test_env env;
+
+    test_env_init(&env);
+    far = test_far_alloc(1);
+    test_ok(gtp5g_add_far(env.genl_id, env.nl, env.dev, far));
+    gtp5g_far_free(far);
+
+    test_sdf_decode_into_empty(&env);
+    test_sdf_bad_description();
+    test_sdf_list_refused(&env);
+    test_sdf_list(&env);
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/* gtp5g_*_msg_size() against the requests the builders put */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "gtp5g-test.h"
+#include "internal.h"
+
+/* The request of a rule fits a buffer of exactly its size, one byte less
+ * is refused */
+#define test_size(type, env, rule)                                          \
+    do {                                                                    \
+        size_t size = gtp5g_##type##_msg_size((env)->dev, rule);            \
+        char *buf = malloc(size);                                           \
+        struct nlmsghdr *nlh;                                               \
+                                                                            \
+        test_assert(buf);                                                   \
+        nlh = genl_nlmsg_build_hdr(buf, (env)->genl_id, NLM_F_ACK, 1, 0);   \
+        test_assert(gtp5g_build_##type##_payload(nlh, size - 1, (env)->dev, rule) < 0); \
+        test_assert(gtp5g_get_err()->err == EMSGSIZE);                      \
+        test_ok(gtp5g_build_##type##_payload(nlh, size, (env)->dev, rule)); \
+        test_assert(nlh->nlmsg_len == size);                                \
+        free(buf);                                                          \
+    } while (0)
+
+static void test_far_size(struct test_env *env)
+{
+    struct gtp5g_far *far = test_far_alloc(1), *got;
+    struct in_addr peer = { .s_addr = inet_addr("192.0.2.1") };
+    char policy[] = "p";
+
+    test_size(far, env, far);
+    gtp5g_far_set_outer_header_creation(far, 0x100, 0x1234, &peer, 2152);
+    gtp5g_far_set_fwd_policy(far, policy);
+    test_size(far, env, far);
+    test_ok(gtp5g_add_far(env->genl_id, env->nl, env->dev, far));
+
+    got = gtp5g_far_find_by_id(env->genl_id, env->nl, env->dev, far);
+    test_assert(got);
+    test_size(far, env, got);
+
+    gtp5g_far_free(got);
+    gtp5g_far_free(far);
+}
+
+static void test_qer_size(struct test_env *env)
+{
+    struct gtp5g_qer *qer = gtp5g_qer_alloc(), *got;
+
+    test_assert(qer);
+    gtp5g_qer_set_id(qer, 7);
+    test_size(qer, env, qer);
+    gtp5g_qer_set_mbr_uhigh(qer, 100);
+    gtp5g_qer_set_mbr_ulow(qer, 1);
+    gtp5g_qer_set_gbr_dhigh(qer, 50);
+    gtp5g_qer_set_qfi(qer, 9);
+    test_size(qer, env, qer);
+    test_ok(gtp5g_add_qer(env->genl_id, env->nl, env->dev, qer));
+
+    got = gtp5g_qer_find_by_id(env->genl_id, env->nl, env->dev, qer);
+    test_assert(got);
+    test_size(qer, env, got);
+
+    gtp5g_qer_free(got);
+    gtp5g_qer_free(qer);
+}
+
+static void test_pdr_size(struct test_env *env)
+{
+    static const char *const filters[] = {
+        "permit out ip from any to assigned",
+        "permit out ip from 10.0.0.0/8 80 to 10.60.0.1",
+        "permit out ip from 10.0.0.0/8 80,90-100 to 10.60.0.1 443,8000-8080,22",
+    };
+    struct in_addr ue = { .s_addr = inet_addr("10.60.0.1") };
+    const unsigned int num = sizeof(filters) / sizeof(filters[0]);
+    struct gtp5g_pdr *pdr, *got;
+    unsigned int i;
+
+    for (i = 0; i < num; i++) {
+        pdr = test_pdr_alloc(10 + i, 1);
+        test_size(pdr, env, pdr);
+        gtp5g_pdr_set_ue_addr_ipv4(pdr, &ue);
+        gtp5g_pdr_set_unix_sock_path(pdr, "/tmp/gtp5g.sock");
+        gtp5g_pdr_set_sdf_filter_description(pdr, filters[i]);
+        test_size(pdr, env, pdr);
+
+        /* Setting the description again replaces the port lists */
+        gtp5g_pdr_set_sdf_filter_description(pdr, filters[i]);
+        test_size(pdr, env, pdr);
+
+        test_ok(gtp5g_add_pdr(env->genl_id, env->nl, env->dev, pdr));
+        got = gtp5g_pdr_find_by_id(env->genl_id, env->nl, env->dev, pdr);
+        test_assert(got);
+        test_size(pdr, env, got);
+        test_assert(gtp5g_pdr_msg_size(env->dev, got) == gtp5g_pdr_msg_size(env->dev, pdr));
+
+        /* Port lists of a reply are laid out as the setter lays them out,
+         * and replaced the same way */
+        gtp5g_pdr_set_sdf_filter_description(got, filters[num - 1]);
+        test_size(pdr, env, got);
+        test_ok(gtp5g_mod_pdr(env->genl_id, env->nl, env->dev, got));
+        test_ok(gtp5g_pdr_find_by_id_into(env->genl_id, env->nl, env->dev, got, got));
+        test_size(pdr, env, got);
+
+        gtp5g_pdr_free(got);
+        gtp5g_pdr_free(pdr);
+    }
+}
+
+int main(void)
+{
+    struct test_env env;
+
+    test_env_init(&env);
+    test_far_size(&env);
+    test_qer_size(&env);
+    /* PDRs point at FAR 1 added above */
+    test_pdr_size(&env);
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+/* Mapped snapshots answer lookups in place and refuse foreign files */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+
+#include "gtp5g-test.h"
+
+#define TEST_RULES  20
+
+/* Two PDRs per TEID and per UE address, uplink and downlink */
+#define TEST_TEID(i)    (0x1000 + ((i) + 1) / 2)
+#define TEST_UE(i)      htonl(0x0a000000 + ((i) + 1) / 2)
+
+/* The header of gtp5g-snapmap.c starts with a 4 byte magic and a version */
+#define TEST_HDR_VERSION    4
+
+static void test_save(struct test_env *env, const char *path)
+{
+    struct gtp5g_snapshot_stats st;
+    int fd;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    test_assert(fd >= 0);
+    test_ok(gtp5g_snapmap_save(env->genl_id, env->nl, fd, &st));
+    test_assert(st.pdr == TEST_RULES && st.far == TEST_RULES && st.qer == 1);
+    test_assert(close(fd) == 0);
+}
+
+static void test_lookup(const struct gtp5g_snapmap *m)
+{
+    const struct gtp5g_snapmap_pdr *pdrs, *pdr;
+    const struct gtp5g_snapmap_far *far;
+    const struct gtp5g_snapmap_qer *qer;
+    const struct gtp5g_snapmap_idx *idx;
+    const char *policy;
+    uint32_t num, i;
+
+    pdrs = gtp5g_snapmap_pdrs(m, &num);
+    test_assert(pdrs && num == TEST_RULES);
+    test_assert(gtp5g_snapmap_fars(m, &num) && num == TEST_RULES);
+    test_assert(gtp5g_snapmap_qers(m, &num) && num == 1);
+
+    pdr = gtp5g_snapmap_find_pdr(m, 7);
+    test_assert(pdr && pdr->id == 7 && pdr->far_id == 7);
+    test_assert(pdr->flags & GTP5G_SNAPMAP_PDR_F_TEID);
+    test_assert(pdr->teid == TEST_TEID(7));
+    test_assert(gtp5g_snapmap_find_pdr(m, TEST_RULES + 1) == NULL);
+
+    far = gtp5g_snapmap_find_far(m, 3);
+    test_assert(far && far->id == 3 && far->apply_action == 2);
+    policy = gtp5g_snapmap_get_data(m, &far->fwd_policy);
+    test_assert(policy && strcmp(policy, "policy3") == 0);
+    test_assert(gtp5g_snapmap_find_far(m, 0) == NULL);
+
+    qer = gtp5g_snapmap_find_qer(m, 9);
+    test_assert(qer && qer->id == 9 && qer->qfi == 5);
+    test_assert(gtp5g_snapmap_find_qer(m, 10) == NULL);
+
+    idx = gtp5g_snapmap_pdrs_by_teid(m, TEST_TEID(5), &num);
+    test_assert(idx && num == 2);
+    for (i = 0; i < num; i++) {
+        test_assert(idx[i].key == TEST_TEID(5));
+        pdr = &pdrs[idx[i].pdr];
+        test_assert(pdr->id == 5 || pdr->id == 6);
+    }
+    idx = gtp5g_snapmap_pdrs_by_ue_addr(m, TEST_UE(TEST_RULES), &num);
+    test_assert(idx && num == 2);
+    test_assert(pdrs[idx[0].pdr].ue_addr == TEST_UE(TEST_RULES));
+    idx = gtp5g_snapmap_pdrs_by_teid(m, 0xdead, &num);
+    test_assert(num == 0);
+}
+
+/* A copy of the file at path, patched at off */
+static void test_copy(const char *path, const char *copy, size_t off,
+                      const void *val, size_t len)
+{
+    char buf[4096];
+    int in, out;
+    ssize_t n;
+
+    in = open(path, O_RDONLY);
+    out = open(copy, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    test_assert(in >= 0 && out >= 0);
+    while ((n = read(in, buf, sizeof(buf))) > 0)
+        test_assert(write(out, buf, n) == n);
+    test_assert(n == 0);
+    test_assert(pwrite(out, val, len, off) == (ssize_t)len);
+    close(in);
+    close(out);
+}
+
+static void test_refused(const char *copy)
+{
+    test_assert(gtp5g_snapmap_open(copy) == NULL);
+    test_assert(gtp5g_get_err()->err == EINVAL);
+}
+
+int main(void)
+{
+    char path[] = "/tmp/gtp5g-snapmap-XXXXXX";
+    char copy[sizeof(path) + 4];
+    struct gtp5g_snapmap *m, *old;
+    struct in_addr ue, gtpu = { htonl(0xc0a80001) };
+    const struct gtp5g_snapmap_pdr *pdr;
+    struct test_env env;
+    struct gtp5g_pdr *p;
+    struct gtp5g_far *far;
+    struct gtp5g_qer *qer;
+    uint16_t version = 0xffff;
+    struct stat st;
+    char policy[16];
+    unsigned int i;
+    int fd;
+
+    test_env_init(&env);
+    qer = gtp5g_qer_alloc();
+    test_assert(qer);
+    gtp5g_qer_set_id(qer, 9);
+    gtp5g_qer_set_qfi(qer, 5);
+    test_ok(gtp5g_add_qer(env.genl_id, env.nl, env.dev, qer));
+    gtp5g_qer_free(qer);
+
+    for (i = 1; i <= TEST_RULES; i++) {
+        far = test_far_alloc(i);
+        snprintf(policy, sizeof(policy), "policy%u", i);
+        gtp5g_far_set_fwd_policy(far, policy);
+        test_ok(gtp5g_add_far(env.genl_id, env.nl, env.dev, far));
+        gtp5g_far_free(far);
+
+        p = test_pdr_alloc(i, i);
+        ue.s_addr = TEST_UE(i);
+        gtp5g_pdr_set_ue_addr_ipv4(p, &ue);
+        gtp5g_pdr_set_local_f_teid(p, TEST_TEID(i), &gtpu);
+        test_ok(gtp5g_add_pdr(env.genl_id, env.nl, env.dev, p));
+        gtp5g_pdr_free(p);
+    }
+
+    fd = mkstemp(path);
+    test_assert(fd >= 0);
+    close(fd);
+    snprintf(copy, sizeof(copy), "%s.bad", path);
+
+    test_save(&env, path);
+    m = gtp5g_snapmap_open(path);
+    test_assert(m);
+    test_lookup(m);
+
+    /* Replaced by rename() like gtp5g-tunnel save --mapped does, the old
+     * mapping stays whole */
+    old = m;
+    p = test_pdr_alloc(1, 1);
+    test_ok(gtp5g_del_pdr(env.genl_id, env.nl, env.dev, p));
+    gtp5g_pdr_free(p);
+    snprintf(copy, sizeof(copy), "%s.tmp", path);
+    fd = open(copy, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    test_assert(fd >= 0);
+    test_ok(gtp5g_snapmap_save(env.genl_id, env.nl, fd, NULL));
+    test_assert(close(fd) == 0);
+    test_assert(rename(copy, path) == 0);
+    m = gtp5g_snapmap_open(path);
+    test_assert(m);
+    test_assert(gtp5g_snapmap_find_pdr(m, 1) == NULL);
+    pdr = gtp5g_snapmap_find_pdr(old, 1);
+    test_assert(pdr && pdr->id == 1);
+    test_lookup(old);
+    gtp5g_snapmap_close(old);
+    gtp5g_snapmap_close(m);
+
+    /* Another magic, another version, and sections cut short */
+    snprintf(copy, sizeof(copy), "%s.bad", path);
+    test_copy(path, copy, 0, "G5SX", 4);
+    test_refused(copy);
+    test_copy(path, copy, TEST_HDR_VERSION, &version, sizeof(version));
+    test_refused(copy);
+    test_copy(path, copy, 0, "G5SM", 4);
+    test_assert(stat(copy, &st) == 0);
+    test_assert(truncate(copy, st.st_size / 2) == 0);
+    test_refused(copy);
+
+    unlink(copy);
+    unlink(path);
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+/* Snapshots restore every rule they hold, or fail as a whole when cut */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gtp5g-test.h"
+
+#define TEST_RULES  10
+
+/* FAR IDs above what the 16 bits of a PDR ID take */
+#define TEST_FAR_ID(i)  (70000 + (i))
+
+/* Header layout of gtp5g-snapshot.c: the sections of QERs, FARs and PDRs,
+ * each a count, a length and an offset, follow 16 bytes */
+#define TEST_SECT(k)        (16 + 16 * (k))
+#define TEST_SECT_PDR       TEST_SECT(2)
+#define TEST_SECT_COUNT     0
+#define TEST_SECT_LEN       4
+
+struct restore_failures {
+    unsigned int num;
+    uint32_t far_ids;
+    uint32_t pdr_ids;
+};
+
+static void restore_err_cb(unsigned int index, const struct gtp5g_err *err, void *data)
+{
+    struct restore_failures *f = data;
+
+    test_assert(err->err == EEXIST);
+    if (err->cmd == GTP5G_CMD_ADD_FAR && err->id > TEST_FAR_ID(0))
+        f->far_ids++;
+    if (err->cmd == GTP5G_CMD_ADD_PDR && err->id >= 1 && err->id <= TEST_RULES)
+        f->pdr_ids++;
+    f->num++;
+}
+
+/* A copy of the len bytes of snap, patched at off with val */
+static int test_patched(const char *snap, size_t len, size_t off, uint32_t val)
+{
+    FILE *f = tmpfile();
+
+    test_assert(f);
+    test_assert(fwrite(snap, 1, off, f) == off);
+    test_assert(fwrite(&val, 1, sizeof(val), f) == sizeof(val));
+    test_assert(fwrite(snap + off + sizeof(val), 1, len - off - sizeof(val), f) ==
+                len - off - sizeof(val));
+    test_assert(fflush(f) == 0);
+    test_assert(lseek(fileno(f), 0, SEEK_SET) == 0);
+    return dup(fileno(f));
+}
+
+static void test_cut(struct test_env *env, const char *snap, size_t len,
+                     size_t off, uint32_t val)
+{
+    int fd = test_patched(snap, len, off, val);
+
+    test_assert(fd >= 0);
+    test_assert(gtp5g_snapshot_restore(env->genl_id, env->nl, env->dev, fd,
+                                       NULL, NULL, NULL) < 0);
+    test_assert(gtp5g_get_err()->err == EINVAL);
+    close(fd);
+}
+
+int main(void)
+{
+    struct restore_failures f = {};
+    struct gtp5g_snapshot_stats st;
+    struct test_env env;
+    struct gtp5g_pdr *pdr;
+    struct gtp5g_far *far;
+    uint32_t pdr_count, pdr_len;
+    unsigned int i;
+    char *snap;
+    FILE *file;
+    long len;
+
+    test_env_init(&env);
+    for (i = 1; i <= TEST_RULES; i++) {
+        far = test_far_alloc(TEST_FAR_ID(i));
+        test_ok(gtp5g_add_far(env.genl_id, env.nl, env.dev, far));
+        gtp5g_far_free(far);
+        pdr = test_pdr_alloc(i, TEST_FAR_ID(i));
+        test_ok(gtp5g_add_pdr(env.genl_id, env.nl, env.dev, pdr));
+        gtp5g_pdr_free(pdr);
+    }
+
+    file = tmpfile();
+    test_assert(file);
+    test_ok(gtp5g_snapshot_save(env.genl_id, env.nl, fileno(file), &st));
+    test_assert(st.far == TEST_RULES && st.pdr == TEST_RULES && st.qer == 0);
+
+    len = lseek(fileno(file), 0, SEEK_END);
+    test_assert(len > 0);
+    snap = malloc(len);
+    test_assert(snap);
+    test_assert(pread(fileno(file), snap, len, 0) == len);
+    memcpy(&pdr_count, snap + TEST_SECT_PDR + TEST_SECT_COUNT, sizeof(pdr_count));
+    memcpy(&pdr_len, snap + TEST_SECT_PDR + TEST_SECT_LEN, sizeof(pdr_len));
+    test_assert(pdr_count == TEST_RULES);
+
+    /* Onto the same rules, every one of them fails with its own ID */
+    test_assert(lseek(fileno(file), 0, SEEK_SET) == 0);
+    test_assert(gtp5g_snapshot_restore(env.genl_id, env.nl, env.dev, fileno(file),
+                                       &st, restore_err_cb, &f) == 2 * TEST_RULES);
+    test_assert(st.failed == 2 * TEST_RULES);
+    test_assert(f.num == 2 * TEST_RULES);
+    test_assert(f.far_ids == TEST_RULES && f.pdr_ids == TEST_RULES);
+
+    /* The last PDR cut short, and a record fewer than counted */
+    test_cut(&env, snap, len, TEST_SECT_PDR + TEST_SECT_LEN, pdr_len - 4);
+    test_cut(&env, snap, len, TEST_SECT_PDR + TEST_SECT_COUNT, pdr_count + 1);
+
+    free(snap);
+    fclose(file);
+    test_env_fini(&env);
+    return EXIT_SUCCESS;
+}
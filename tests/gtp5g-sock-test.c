@@ -0,0 +1,130 @@
+/* Replies read from the socket: the recvmmsg() paths of dumps and batches */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <errno.h>
+
+#include "gtp5g-test.h"
+
+/* Enough for dumps of several datagrams */
+#define TEST_RULES  1000
+
+struct dump_count {
+    unsigned int far;
+    unsigned int pdr;
+};
+
+static int far_cb(const struct gtp5g_far_view *v, void *data)
+{
+    struct dump_count *c = data;
+
+    c->far++;
+    return 0;
+}
+
+static int pdr_cb(const struct gtp5g_pdr_view *v, void *data)
+{
+    struct dump_count *c = data;
+
+    c->pdr++;
+    return 0;
+}
+
+static void batch_err_cb(unsigned int index, const struct gtp5g_err *err, void *data)
+{
+    unsigned int *failed = data;
+
+    test_assert(index == 2 * TEST_RULES && err->err == EEXIST);
+    (*failed)++;
+}
+
+/* Many ACKs per datagram of requests, one of them failing */
+static void test_batch(struct test_env *env)
+{
+    struct gtp5g_batch *b = gtp5g_batch_alloc(env->genl_id, env->nl);
+    unsigned int i, failed = 0;
+    struct gtp5g_pdr *pdr;
+    struct gtp5g_far *far;
+
+    test_assert(b);
+    for (i = 1; i <= TEST_RULES; i++) {
+        far = test_far_alloc(i);
+        pdr = test_pdr_alloc(i, i);
+        test_ok(gtp5g_batch_add_far(b, env->dev, far));
+        test_ok(gtp5g_batch_add_pdr(b, env->dev, pdr));
+        gtp5g_pdr_free(pdr);
+        gtp5g_far_free(far);
+    }
+    far = test_far_alloc(TEST_RULES);
+    test_ok(gtp5g_batch_add_far(b, env->dev, far));
+    gtp5g_far_free(far);
+
+    /* The index counts requests, the duplicate is the last one */
+    test_assert(gtp5g_batch_send(b, batch_err_cb, &failed) == 1);
+    test_assert(failed == 1);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_FAR) == TEST_RULES);
+    test_assert(gtp5g_fake_count(env->fake, GTP5G_FAKE_PDR) == TEST_RULES);
+    gtp5g_batch_free(b);
+}
+
+/* The same dumps, one datagram and several per syscall */
+static void test_dump(struct test_env *env)
+{
+    struct gtp5g_view_ops ops = { .far = far_cb, .pdr = pdr_cb };
+    unsigned int vlen[] = { 1, 8 }, i;
+    struct dump_count c;
+
+    for (i = 0; i < sizeof(vlen) / sizeof(vlen[0]); i++) {
+        c = (struct dump_count){};
+        genl_set_recv_batch(vlen[i]);
+        test_ok(gtp5g_dump_views(env->genl_id, env->nl, &ops, &c));
+        test_assert(c.far == TEST_RULES && c.pdr == TEST_RULES);
+    }
+    genl_set_recv_batch(0);
+
+    /* Restarted when interrupted, as from the memory queue */
+    c = (struct dump_count){};
+    gtp5g_fake_set_dump_intr(env->fake, 1);
+    test_ok(gtp5g_dump_views(env->genl_id, env->nl, &ops, &c));
+    test_assert(c.far == TEST_RULES && c.pdr >= TEST_RULES);
+}
+
+int main(void)
+{
+    struct gtp5g_far *far;
+    struct test_env env;
+
+    test_env_init(&env);
+    test_ok(gtp5g_fake_install_socket(env.fake));
+
+    test_batch(&env);
+    test_dump(&env);
+
+    /* Single requests with recvfrom() */
+    far = test_far_alloc(1);
+    test_assert(gtp5g_add_far(env.genl_id, env.nl, env.dev, far) < 0);
+    test_assert(gtp5g_get_err()->err == EEXIST);
+    test_ok(gtp5g_del_far(env.genl_id, env.nl, env.dev, far));
+    gtp5g_far_free(far);
+    test_assert(gtp5g_fake_count(env.fake, GTP5G_FAKE_FAR) == TEST_RULES - 1);
+
+    test_env_fini(&env);
+
+    printf("%s: OK\n", __FILE__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/* Shared by the tests, which run against the fake gtp5g module */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GTP5G_TEST_H_
+#define _GTP5G_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "gtp5g-fake.h"
+
+#define test_assert(cond)                                                   \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                             \
+        }                                                                   \
+    } while (0)
+
+/* Requests that are expected to succeed */
+#define test_ok(expr)                                                       \
+    do {                                                                    \
+        if ((expr) < 0) {                                                   \
+            fprintf(stderr, "%s:%d: %s: %s\n", __FILE__, __LINE__, #expr,   \
+                    gtp5g_get_err()->msg);                                  \
+            exit(EXIT_FAILURE);                                             \
+        }                                                                   \
+    } while (0)
+
+struct test_env {
+    struct gtp5g_fake *fake;
+    struct mnl_socket *nl;
+    struct gtp5g_dev *dev;
+    int genl_id;
+};
+
+static inline void test_env_init(struct test_env *env)
+{
+    env->fake = gtp5g_fake_create();
+    test_assert(env->fake);
+    test_ok(gtp5g_fake_install(env->fake));
+
+    env->nl = genl_socket_open();
+    test_assert(env->nl);
+    env->genl_id = genl_lookup_family(env->nl, "gtp5g");
+    test_assert(env->genl_id == GTP5G_FAKE_FAMILY_ID);
+
+    env->dev = gtp5g_dev_alloc();
+    test_assert(env->dev);
+    gtp5g_dev_set_ifidx(env->dev, 1);
+}
+
+static inline void test_env_fini(struct test_env *env)
+{
+    gtp5g_dev_free(env->dev);
+    genl_socket_close(env->nl);
+    gtp5g_fake_uninstall();
+    gtp5g_fake_destroy(env->fake);
+}
+
+static inline struct gtp5g_far *test_far_alloc(uint32_t id)
+{
+    struct gtp5g_far *far = gtp5g_far_alloc();
+
+    test_assert(far);
+    gtp5g_far_set_id(far, id);
+    gtp5g_far_set_apply_action(far, 2);
+    return far;
+}
+
+static inline struct gtp5g_pdr *test_pdr_alloc(uint16_t id, uint32_t far_id)
+{
+    struct gtp5g_pdr *pdr = gtp5g_pdr_alloc();
+
+    test_assert(pdr);
+    gtp5g_pdr_set_id(pdr, id);
+    gtp5g_pdr_set_precedence(pdr, 255);
+    gtp5g_pdr_set_far_id(pdr, far_id);
+    return pdr;
+}
+
+#endif /* _GTP5G_TEST_H_ */
@@ -0,0 +1,601 @@
+/* Session churn load generator for gtp5g */
+
+/* All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/prctl.h>
+
+#include <libmnl/libmnl.h>
+
+#include <linux/gtp5g.h>
+#include <libgtp5gnl/gtp5g.h>
+#include <libgtp5gnl/gtp5gnl.h>
+
+#include "gtp5g-fake.h"
+
+/* PDR IDs are 16 bits wide, more sessions are spread over several devices */
+#define PDR_PER_DEV     65535
+#define MAX_DEV         64
+
+#define GTPU_PORT       2152
+
+enum phase {
+    PHASE_INSTALL,
+    PHASE_HANDOVER,
+    PHASE_DELETE,
+    __PHASE_MAX,
+};
+
+static const char *phase_name[__PHASE_MAX] = {
+    [PHASE_INSTALL]  = "install",
+    [PHASE_HANDOVER] = "handover",
+    [PHASE_DELETE]   = "delete",
+};
+
+struct stats {
+    double          *lat;       /* latency of each rule in seconds */
+    unsigned int    num;
+    unsigned int    size;
+    unsigned int    failed;
+    double          elapsed;
+    struct gtp5g_err last_err;
+};
+
+struct load {
+    int32_t         genl_id;
+    struct mnl_socket *nl;
+    struct gtp5g_dev *dev;
+
+    unsigned int    sessions;
+    unsigned int    num_pdr;    /* rules of each kind per session */
+    unsigned int    num_far;
+    unsigned int    num_qer;
+    double          sdf_ratio;  /* fraction of PDRs with an SDF filter */
+    double          rate;       /* target rules/s, 0 for as fast as possible */
+
+    struct in_addr  ue_base;
+    struct in_addr  gtpu_addr;
+    struct in_addr  ran_addr;
+    uint32_t        teid_base;
+
+    uint32_t        ifidx[MAX_DEV];
+    int             num_dev;
+    unsigned int    sess_per_dev;
+
+    /* rate limiting of the running phase */
+    double          start;
+    unsigned long   sent;
+
+    struct stats    stats[__PHASE_MAX];
+};
+
+static void usage(const char *name)
+{
+    printf("%s [options] <gtp device>[,<gtp device>...]\n", name);
+    printf("%s -F [options]\n\n", name);
+    printf("OPTIONS\n");
+    printf("\t-s <sessions>\t\tsessions to create (default 1000)\n");
+    printf("\t-m <pdr,far,qer>\trules of each kind per session (default 2,2,2)\n");
+    printf("\t-f <ratio>\t\tfraction of PDRs carrying an SDF filter, 0..1 (default 0)\n");
+    printf("\t-r <rules/s>\t\ttarget rate, 0 for as fast as possible (default 0)\n");
+    printf("\t-c <cycles>\t\tinstall/handover/delete cycles (default 1)\n");
+    printf("\t-H <handovers>\t\thandovers of each session per cycle (default 1)\n");
+    printf("\t-u <ue-ipv4>\t\taddress of the first UE (default 10.60.0.1)\n");
+    printf("\t-t <teid>\t\tfirst TEID (default 1)\n");
+    printf("\t-a <gtpu-ipv4>\t\tlocal GTP-U address (default 10.200.200.1)\n");
+    printf("\t-p <ran-ipv4>\t\tRAN address, a handover moves to the next one (default 10.200.200.101)\n");
+    printf("\t-F\t\t\trun against the in-process fake gtp5g instead of the kernel\n\n");
+    printf("Each session has its PDRs alternate between uplink (F-TEID) and downlink\n");
+    printf("(UE address), and its odd FARs create outer headers towards the RAN.\n");
+    printf("A handover modifies those FARs to a new RAN address and TEID.\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int parse_devs(struct load *l, char *list)
+{
+    char *name;
+
+    for (name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        if (l->num_dev == MAX_DEV) {
+            fprintf(stderr, "too many devices\n");
+            return -1;
+        }
+        l->ifidx[l->num_dev] = if_nametoindex(name);
+        if (!l->ifidx[l->num_dev]) {
+            fprintf(stderr, "wrong GTP interface %s\n", name);
+            return -1;
+        }
+        l->num_dev++;
+    }
+
+    return l->num_dev ? 0 : -1;
+}
+
+static int parse_mix(struct load *l, const char *str)
+{
+    if (sscanf(str, "%u,%u,%u", &l->num_pdr, &l->num_far, &l->num_qer) != 3)
+        return -1;
+
+    /* Every PDR needs a FAR */
+    if (!l->num_pdr || !l->num_far || l->num_pdr > PDR_PER_DEV)
+        return -1;
+
+    return 0;
+}
+
+/* Wait for the slot of the next rule when a rate is set, and return the
+ * time latency is measured from. Measuring from the scheduled time rather
+ * than from the call keeps a slow reply from hiding the rules queued
+ * behind it. */
+static double pace(struct load *l)
+{
+    struct timespec ts;
+    double at, t;
+
+    if (!l->rate)
+        return now();
+
+    at = l->start + l->sent++ / l->rate;
+    t = now();
+    if (at > t) {
+        ts.tv_sec = (time_t) at;
+        ts.tv_nsec = (long) ((at - ts.tv_sec) * 1e9);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+
+    return at;
+}
+
+static void account(struct stats *s, double from, int ret)
+{
+    double *lat;
+
+    if (ret < 0) {
+        s->failed++;
+        s->last_err = *gtp5g_get_err();
+        return;
+    }
+
+    if (s->num == s->size) {
+        s->size = s->size ? s->size * 2 : 4096;
+        lat = realloc(s->lat, s->size * sizeof(*lat));
+        if (!lat) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        s->lat = lat;
+    }
+    s->lat[s->num++] = now() - from;
+}
+
+static void session_dev(struct load *l, unsigned int sess)
+{
+    gtp5g_dev_set_ifidx(l->dev, l->ifidx[sess / l->sess_per_dev]);
+}
+
+static uint16_t pdr_id(struct load *l, unsigned int sess, unsigned int k)
+{
+    return (sess % l->sess_per_dev) * l->num_pdr + k + 1;
+}
+
+static uint32_t far_id(struct load *l, unsigned int sess, unsigned int k)
+{
+    return sess * l->num_far + k + 1;
+}
+
+static uint32_t qer_id(struct load *l, unsigned int sess, unsigned int k)
+{
+    return sess * l->num_qer + k + 1;
+}
+
+/* Spread the SDF filters evenly over the PDRs */
+static int pdr_has_sdf(struct load *l, unsigned int sess, unsigned int k)
+{
+    unsigned long i = (unsigned long) sess * l->num_pdr + k;
+
+    return (unsigned long) ((i + 1) * l->sdf_ratio) != (unsigned long) (i * l->sdf_ratio);
+}
+
+static int add_pdr(struct load *l, unsigned int sess, unsigned int k)
+{
+    struct gtp5g_pdr *pdr = gtp5g_pdr_alloc();
+    struct in_addr ue;
+    char sdf[64];
+    int ret;
+
+    ue.s_addr = htonl(ntohl(l->ue_base.s_addr) + sess);
+
+    gtp5g_pdr_set_id(pdr, pdr_id(l, sess, k));
+    gtp5g_pdr_set_precedence(pdr, 255 - k % 256);
+    gtp5g_pdr_set_far_id(pdr, far_id(l, sess, k % l->num_far));
+    if (l->num_qer)
+        gtp5g_pdr_set_qer_id(pdr, qer_id(l, sess, k % l->num_qer));
+    gtp5g_pdr_set_ue_addr_ipv4(pdr, &ue);
+
+    if (k % 2 == 0) {
+        gtp5g_pdr_set_outer_header_removal(pdr, 0);
+        gtp5g_pdr_set_local_f_teid(pdr, l->teid_base + sess * l->num_pdr + k, &l->gtpu_addr);
+    }
+
+    if (pdr_has_sdf(l, sess, k)) {
+        snprintf(sdf, sizeof(sdf), "permit out ip from any %u to assigned", 1024 + k % 64000);
+        gtp5g_pdr_set_sdf_filter_description(pdr, sdf);
+    }
+
+    ret = gtp5g_add_pdr(l->genl_id, l->nl, l->dev, pdr);
+    gtp5g_pdr_free(pdr);
+    return ret;
+}
+
+/* Odd FARs send downlink traffic to the RAN, each handover moves them to
+ * the next RAN address with a fresh TEID */
+static void far_fill(struct load *l, struct gtp5g_far *far, unsigned int sess,
+                     unsigned int k, unsigned int handover)
+{
+    struct in_addr ran;
+
+    gtp5g_far_set_id(far, far_id(l, sess, k));
+    gtp5g_far_set_apply_action(far, 2);
+
+    if (k % 2 == 1) {
+        ran.s_addr = htonl(ntohl(l->ran_addr.s_addr) + handover % 2);
+        gtp5g_far_set_outer_header_creation(far, 1,
+                l->teid_base + (handover * l->sessions + sess) * l->num_far + k,
+                &ran, GTPU_PORT);
+    }
+}
+
+static int add_far(struct load *l, unsigned int sess, unsigned int k)
+{
+    struct gtp5g_far *far = gtp5g_far_alloc();
+    int ret;
+
+    far_fill(l, far, sess, k, 0);
+    ret = gtp5g_add_far(l->genl_id, l->nl, l->dev, far);
+    gtp5g_far_free(far);
+    return ret;
+}
+
+static int add_qer(struct load *l, unsigned int sess, unsigned int k)
+{
+    struct gtp5g_qer *qer = gtp5g_qer_alloc();
+    int ret;
+
+    gtp5g_qer_set_id(qer, qer_id(l, sess, k));
+    gtp5g_qer_set_gate_status(qer, 0);
+    gtp5g_qer_set_mbr_uhigh(qer, 100000);
+    gtp5g_qer_set_mbr_dhigh(qer, 100000);
+    gtp5g_qer_set_qfi(qer, 9);
+
+    ret = gtp5g_add_qer(l->genl_id, l->nl, l->dev, qer);
+    gtp5g_qer_free(qer);
+    return ret;
+}
+
+static void install(struct load *l)
+{
+    struct stats *s = &l->stats[PHASE_INSTALL];
+    unsigned int sess, k;
+    double from;
+
+    /* PDRs refer to FARs and QERs, those go first */
+    for (sess = 0; sess < l->sessions; sess++) {
+        session_dev(l, sess);
+
+        for (k = 0; k < l->num_qer; k++) {
+            from = pace(l);
+            account(s, from, add_qer(l, sess, k));
+        }
+        for (k = 0; k < l->num_far; k++) {
+            from = pace(l);
+            account(s, from, add_far(l, sess, k));
+        }
+        for (k = 0; k < l->num_pdr; k++) {
+            from = pace(l);
+            account(s, from, add_pdr(l, sess, k));
+        }
+    }
+}
+
+static void handover(struct load *l, unsigned int n)
+{
+    struct stats *s = &l->stats[PHASE_HANDOVER];
+    struct gtp5g_far *far;
+    unsigned int sess, k;
+    double from;
+
+    for (sess = 0; sess < l->sessions; sess++) {
+        session_dev(l, sess);
+
+        /* A session without a downlink FAR still gets its only FAR
+         * rewritten, so that every handover costs at least one rule */
+        for (k = l->num_far > 1; k < l->num_far; k += 2) {
+            far = gtp5g_far_alloc();
+            far_fill(l, far, sess, k, n);
+
+            from = pace(l);
+            account(s, from, gtp5g_mod_far(l->genl_id, l->nl, l->dev, far));
+            gtp5g_far_free(far);
+        }
+    }
+}
+
+static void delete(struct load *l)
+{
+    struct stats *s = &l->stats[PHASE_DELETE];
+    struct gtp5g_pdr *pdr = gtp5g_pdr_alloc();
+    struct gtp5g_far *far = gtp5g_far_alloc();
+    struct gtp5g_qer *qer = gtp5g_qer_alloc();
+    unsigned int sess, k;
+    double from;
+
+    for (sess = 0; sess < l->sessions; sess++) {
+        session_dev(l, sess);
+
+        for (k = 0; k < l->num_pdr; k++) {
+            gtp5g_pdr_set_id(pdr, pdr_id(l, sess, k));
+            from = pace(l);
+            account(s, from, gtp5g_del_pdr(l->genl_id, l->nl, l->dev, pdr));
+        }
+        for (k = 0; k < l->num_far; k++) {
+            gtp5g_far_set_id(far, far_id(l, sess, k));
+            from = pace(l);
+            account(s, from, gtp5g_del_far(l->genl_id, l->nl, l->dev, far));
+        }
+        for (k = 0; k < l->num_qer; k++) {
+            gtp5g_qer_set_id(qer, qer_id(l, sess, k));
+            from = pace(l);
+            account(s, from, gtp5g_del_qer(l->genl_id, l->nl, l->dev, qer));
+        }
+    }
+
+    gtp5g_qer_free(qer);
+    gtp5g_far_free(far);
+    gtp5g_pdr_free(pdr);
+}
+
+static void run_phase(struct load *l, enum phase p, unsigned int n)
+{
+    struct stats *s = &l->stats[p];
+
+    l->start = now();
+    l->sent = 0;
+
+    switch (p) {
+    case PHASE_INSTALL:
+        install(l);
+        break;
+    case PHASE_HANDOVER:
+        handover(l, n);
+        break;
+    case PHASE_DELETE:
+        delete(l);
+        break;
+    default:
+        break;
+    }
+
+    s->elapsed += now() - l->start;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+static double percentile(const struct stats *s, double p)
+{
+    unsigned int i = (unsigned int) (p / 100 * s->num);
+
+    if (i >= s->num)
+        i = s->num - 1;
+    return s->lat[i] * 1e6;
+}
+
+static void report(struct load *l)
+{
+    unsigned int total = 0, failed = 0;
+    double elapsed = 0;
+    enum phase p;
+
+    printf("%-9s %9s %7s %10s %11s %9s %9s %9s %9s %9s\n", "phase", "rules", "failed",
+           "time (s)", "rules/s", "p50 (us)", "p90", "p99", "p99.9", "max");
+
+    for (p = 0; p < __PHASE_MAX; p++) {
+        struct stats *s = &l->stats[p];
+
+        total += s->num;
+        failed += s->failed;
+        elapsed += s->elapsed;
+
+        if (!s->num) {
+            printf("%-9s %9u %7u\n", phase_name[p], s->num, s->failed);
+            continue;
+        }
+
+        qsort(s->lat, s->num, sizeof(*s->lat), cmp_double);
+        printf("%-9s %9u %7u %10.3f %11.0f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+               phase_name[p], s->num, s->failed, s->elapsed, s->num / s->elapsed,
+               percentile(s, 50), percentile(s, 90), percentile(s, 99),
+               percentile(s, 99.9), s->lat[s->num - 1] * 1e6);
+    }
+
+    if (elapsed > 0)
+        printf("%-9s %9u %7u %10.3f %11.0f\n", "total", total, failed, elapsed, total / elapsed);
+
+    for (p = 0; p < __PHASE_MAX; p++) {
+        struct stats *s = &l->stats[p];
+
+        if (s->failed)
+            fprintf(stderr, "%s: last failure: %s%s%s\n", phase_name[p],
+                    strerror(s->last_err.err), s->last_err.msg[0] ? ": " : "",
+                    s->last_err.msg);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct gtp5g_fake *fake = NULL;
+    struct load l = {
+        .sessions = 1000,
+        .num_pdr = 2,
+        .num_far = 2,
+        .num_qer = 2,
+        .teid_base = 1,
+    };
+    unsigned int cycles = 1, handovers = 1, c, h;
+    int opt, need;
+
+    inet_pton(AF_INET, "10.60.0.1", &l.ue_base);
+    inet_pton(AF_INET, "10.200.200.1", &l.gtpu_addr);
+    inet_pton(AF_INET, "10.200.200.101", &l.ran_addr);
+
+    while ((opt = getopt(argc, argv, "s:m:f:r:c:H:u:t:a:p:F")) != -1) {
+        switch (opt) {
+        case 's':
+            l.sessions = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            if (parse_mix(&l, optarg) < 0) {
+                fprintf(stderr, "wrong rule mix %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'f':
+            l.sdf_ratio = atof(optarg);
+            break;
+        case 'r':
+            l.rate = atof(optarg);
+            break;
+        case 'c':
+            cycles = strtoul(optarg, NULL, 0);
+            break;
+        case 'H':
+            handovers = strtoul(optarg, NULL, 0);
+            break;
+        case 'u':
+        case 'a':
+        case 'p':
+            if (inet_pton(AF_INET, optarg, opt == 'u' ? &l.ue_base :
+                          opt == 'a' ? &l.gtpu_addr : &l.ran_addr) != 1) {
+                fprintf(stderr, "bad IPv4 address %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 't':
+            l.teid_base = strtoul(optarg, NULL, 0);
+            break;
+        case 'F':
+            fake = gtp5g_fake_create();
+            break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!l.sessions || l.sdf_ratio < 0 || l.sdf_ratio > 1 || l.rate < 0) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    l.sess_per_dev = PDR_PER_DEV / l.num_pdr;
+    need = (l.sessions + l.sess_per_dev - 1) / l.sess_per_dev;
+
+    if (fake) {
+        /* Any ifindex is a gtp5g device to the fake */
+        for (l.num_dev = 0; l.num_dev < need && l.num_dev < MAX_DEV; l.num_dev++)
+            l.ifidx[l.num_dev] = l.num_dev + 1;
+    }
+    else if (optind >= argc || parse_devs(&l, argv[optind]) < 0) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (need > l.num_dev) {
+        fprintf(stderr, "%u sessions of %u PDRs need %d devices\n",
+                l.sessions, l.num_pdr, need);
+        exit(EXIT_FAILURE);
+    }
+
+    l.nl = genl_socket_open();
+    if (l.nl == NULL) {
+        perror("genl_socket_open");
+        exit(EXIT_FAILURE);
+    }
+
+    if (fake)
+        gtp5g_fake_install(fake);
+
+    l.genl_id = genl_lookup_family(l.nl, "gtp5g");
+    if (l.genl_id < 0) {
+        printf("not found gtp genl family\n");
+        exit(EXIT_FAILURE);
+    }
+
+    l.dev = gtp5g_dev_alloc();
+
+    /* The default 50us timer slack would show up in every paced latency */
+    if (l.rate)
+        prctl(PR_SET_TIMERSLACK, 1);
+
+    printf("%u sessions of %u PDR, %u FAR, %u QER on %d device(s), %.0f%% PDRs with SDF, ",
+           l.sessions, l.num_pdr, l.num_far, l.num_qer, need, l.sdf_ratio * 100);
+    if (l.rate)
+        printf("target %.0f rules/s\n", l.rate);
+    else
+        printf("no rate limit\n");
+
+    for (c = 0; c < cycles; c++) {
+        run_phase(&l, PHASE_INSTALL, 0);
+        for (h = 1; h <= handovers; h++)
+            run_phase(&l, PHASE_HANDOVER, h);
+        run_phase(&l, PHASE_DELETE, 0);
+    }
+
+    report(&l);
+
+    if (fake) {
+        gtp5g_fake_uninstall();
+        gtp5g_fake_destroy(fake);
+    }
+
+    for (c = 0; c < __PHASE_MAX; c++)
+        free(l.stats[c].lat);
+    gtp5g_dev_free(l.dev);
+    genl_socket_close(l.nl);
+
+    return l.stats[PHASE_INSTALL].failed || l.stats[PHASE_HANDOVER].failed ||
+           l.stats[PHASE_DELETE].failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -35,6 +35,7 @@
 #include <netinet/in.h>
 #include <net/if.h>
 #include <inttypes.h>
+#include <fcntl.h>
 
 #include <libmnl/libmnl.h>
 #include <linux/genetlink.h>
@@ -44,6 +45,46 @@
 #include <libgtp5gnl/gtp5g.h>
 #include <libgtp5gnl/gtp5gnl.h>
 
+/* In batch mode add/mod/del requests are queued on a gtp5g_batch and sent
+ * BATCH_SIZE at a time, everything else still runs one at a time */
+#define BATCH_SIZE      256
+#define BATCH_MAX_ARGS  64
+
+static struct gtp5g_batch *batch;
+
+/* Devices named in batch mode, so each name is resolved once per batch
+ * rather than once per line */
+static struct gtp5g_handle *handle;
+
+/* Format of list and get, set with -o */
+static enum gtp5g_format output = GTP5G_FORMAT_TEXT;
+
+static uint32_t dev_ifindex(const char *ifname)
+{
+    int idx;
+
+    if (!handle)
+        return if_nametoindex(ifname);
+
+    idx = gtp5g_handle_find_dev(handle, NULL, ifname);
+    if (idx < 0) {
+        /* Unknown names are not worth a trip through the handle */
+        if (!if_nametoindex(ifname))
+            return 0;
+        idx = gtp5g_handle_add_dev(handle, NULL, ifname);
+        if (idx < 0)
+            return if_nametoindex(ifname);
+    }
+    return gtp5g_handle_ifindex(handle, idx);
+}
+
+#define add_request(obj, genl_id, nl, dev, o) \
+    (batch ? gtp5g_batch_add_##obj(batch, dev, o) : gtp5g_add_##obj(genl_id, nl, dev, o))
+#define mod_request(obj, genl_id, nl, dev, o) \
+    (batch ? gtp5g_batch_mod_##obj(batch, dev, o) : gtp5g_mod_##obj(genl_id, nl, dev, o))
+#define del_request(obj, genl_id, nl, dev, o) \
+    (batch ? gtp5g_batch_del_##obj(batch, dev, o) : gtp5g_del_##obj(genl_id, nl, dev, o))
+
 static void add_usage(const char *name)
 {
     printf("%s <add|mod> <pdr|far> <gtp device> <id> [<options,...>]\n", name);
@@ -58,6 +99,8 @@ static void add_usage(const char *name)
     printf("\t--f-teid <i-teid> <local-gtpu-ipv4>\n");
     printf("\t--sdf-desp <description-string>\n");
     printf("\t\tex: --sdf-desp 'permit out ip from 192.168.0.1 22,53,73 to 127.0.0.1/24'\n");
+    printf("\t\teach further --sdf-desp starts a new SDF filter, the --sdf-* after it fill it\n");
+    printf("\t\tthe gtp5g module has to support several SDF filters per PDR\n");
     printf("\t--sdf-tos-traff-cls <tos-traffic-class>\n");
     printf("\t--sdf-scy-param-idx <security-param-idx>\n");
     printf("\t--sdf-flow-label <flow-label>\n");
@@ -119,6 +162,7 @@ static struct gtp5g_pdr *prepare_pdr(int argc, char *argv[])
     int opt;
     int opt_index = 0;
     struct gtp5g_pdr *pdr;
+    int sdf_desp = 0;
 
     int ret;
     struct sockaddr_in sa;
@@ -153,6 +197,8 @@ static struct gtp5g_pdr *prepare_pdr(int argc, char *argv[])
                 gtp5g_pdr_set_local_f_teid(pdr, atoi(optarg), &(sa.sin_addr));
                 break;
             case 'd': // --sdf-desp {description string}
+                if (sdf_desp++)
+                    gtp5g_pdr_add_sdf_filter(pdr);
                 gtp5g_pdr_set_sdf_filter_description(pdr, optarg);
                 break;
             case 't': // --sdf-tos-traff-cls
@@ -199,6 +245,7 @@ static int add_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     uint32_t ifidx;
     struct gtp5g_pdr *pdr;
     int optidx;
+    int ret;
 
     // TODO: Need to modify argc in release version
     if (argc < 5) {
@@ -207,7 +254,7 @@ static int add_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     }
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         return EXIT_FAILURE;
@@ -216,13 +263,17 @@ static int add_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     gtp5g_dev_set_ifidx(dev, ifidx);
 
     pdr = prepare_pdr(argc, argv);
+    if (!pdr) {
+        gtp5g_dev_free(dev);
+        return EXIT_FAILURE;
+    }
 
-    gtp5g_add_pdr(genl_id, nl, dev, pdr);
+    ret = add_request(pdr, genl_id, nl, dev, pdr);
 
     gtp5g_pdr_free(pdr);
     gtp5g_dev_free(dev);
 
-    return 0;
+    return ret;
 }
 
 static int mod_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
@@ -231,6 +282,7 @@ static int mod_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     uint32_t ifidx;
     struct gtp5g_pdr *pdr;
     int optidx;
+    int ret;
 
     // TODO: Need to modify argc in release version
     if (argc < 6) {
@@ -239,7 +291,7 @@ static int mod_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     }
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         return EXIT_FAILURE;
@@ -248,13 +300,17 @@ static int mod_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     gtp5g_dev_set_ifidx(dev, ifidx);
 
     pdr = prepare_pdr(argc, argv);
+    if (!pdr) {
+        gtp5g_dev_free(dev);
+        return EXIT_FAILURE;
+    }
 
-    gtp5g_mod_pdr(genl_id, nl, dev, pdr);
+    ret = mod_request(pdr, genl_id, nl, dev, pdr);
 
     gtp5g_pdr_free(pdr);
     gtp5g_dev_free(dev);
 
-    return 0;
+    return ret;
 }
 
 
@@ -264,6 +320,7 @@ static int del_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     uint32_t ifidx;
     struct gtp5g_pdr *pdr;
     int optidx;
+    int ret;
 
     // TODO: Need to modify argc in release version
     if (argc < 5) {
@@ -272,7 +329,7 @@ static int del_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     }
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         return EXIT_FAILURE;
@@ -283,17 +340,17 @@ static int del_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     pdr = gtp5g_pdr_alloc();
     gtp5g_pdr_set_id(pdr, atoi(argv[++optidx]));
 
-    gtp5g_del_pdr(genl_id, nl, dev, pdr);
+    ret = del_request(pdr, genl_id, nl, dev, pdr);
 
     gtp5g_pdr_free(pdr);
     gtp5g_dev_free(dev);
 
-    return 0;
+    return ret;
 }
 
 static int list_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 {
-    return gtp5g_list_pdr(genl_id, nl);
+    return gtp5g_list_pdr_format(genl_id, nl, output);
 }
 
 static int get_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
@@ -310,7 +367,7 @@ static int get_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     }
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         return EXIT_FAILURE;
@@ -325,7 +382,7 @@ static int get_pdr(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     if (!rt_pdr)
         goto FREE;
 
-    gtp5g_print_pdr(rt_pdr);
+    gtp5g_print_pdr_format(rt_pdr, output);
     gtp5g_pdr_free(rt_pdr);
 
 FREE:
@@ -388,6 +445,7 @@ static int add_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     uint32_t ifidx;
     struct gtp5g_far *far;
     int optidx;
+    int ret;
 
     // TODO: Need to modify argc in release version
     if (argc < 5) {
@@ -396,7 +454,7 @@ static int add_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     }
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         return EXIT_FAILURE;
@@ -405,13 +463,17 @@ static int add_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     gtp5g_dev_set_ifidx(dev, ifidx);
 
     far = prepare_far(argc, argv);
+    if (!far) {
+        gtp5g_dev_free(dev);
+        return EXIT_FAILURE;
+    }
 
-    gtp5g_add_far(genl_id, nl, dev, far);
+    ret = add_request(far, genl_id, nl, dev, far);
 
     gtp5g_far_free(far);
     gtp5g_dev_free(dev);
 
-    return 0;
+    return ret;
 }
 
 static int mod_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
@@ -420,6 +482,7 @@ static int mod_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     uint32_t ifidx;
     struct gtp5g_far *far;
     int optidx;
+    int ret;
 
     // TODO: Need to modify argc in release version
     if (argc < 5) {
@@ -428,7 +491,7 @@ static int mod_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     }
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         return EXIT_FAILURE;
@@ -437,13 +500,17 @@ static int mod_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     gtp5g_dev_set_ifidx(dev, ifidx);
 
     far = prepare_far(argc, argv);
+    if (!far) {
+        gtp5g_dev_free(dev);
+        return EXIT_FAILURE;
+    }
 
-    gtp5g_mod_far(genl_id, nl, dev, far);
+    ret = mod_request(far, genl_id, nl, dev, far);
 
     gtp5g_far_free(far);
     gtp5g_dev_free(dev);
 
-    return 0;
+    return ret;
 }
 
 
@@ -453,6 +520,7 @@ static int del_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     uint32_t ifidx;
     struct gtp5g_far *far;
     int optidx;
+    int ret;
 
     // TODO: Need to modify argc in release version
     if (argc < 5) {
@@ -461,7 +529,7 @@ static int del_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     }
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         return EXIT_FAILURE;
@@ -472,17 +540,17 @@ static int del_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     far = gtp5g_far_alloc();
     gtp5g_far_set_id(far, atoi(argv[++optidx]));
 
-    gtp5g_del_far(genl_id, nl, dev, far);
+    ret = del_request(far, genl_id, nl, dev, far);
 
     gtp5g_far_free(far);
     gtp5g_dev_free(dev);
 
-    return 0;
+    return ret;
 }
 
 static int list_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 {
-    return gtp5g_list_far(genl_id, nl);
+    return gtp5g_list_far_format(genl_id, nl, output);
 }
 
 static int get_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
@@ -499,7 +567,7 @@ static int get_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     }
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         return EXIT_FAILURE;
@@ -514,7 +582,7 @@ static int get_far(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     if (!rt_far)
         goto FREE;
 
-    gtp5g_print_far(rt_far);
+    gtp5g_print_far_format(rt_far, output);
     gtp5g_far_free(rt_far);
 
 FREE:
@@ -680,7 +748,7 @@ static int add_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "%s: wrong 5G GTP interface %s\n", __func__, argv[optidx]);
         ret = EXIT_FAILURE;
@@ -702,7 +770,7 @@ static int add_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 		goto out_dev;	
 	}
 
-    ret = gtp5g_add_qer(genl_id, nl, dev, qer);
+    ret = add_request(qer, genl_id, nl, dev, qer);
 
     gtp5g_qer_free(qer);
 
@@ -728,7 +796,7 @@ static int mod_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
     }
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         ret = EXIT_FAILURE;
@@ -751,7 +819,7 @@ static int mod_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 		goto out_dev;
 	}
 		
-    ret = gtp5g_mod_qer(genl_id, nl, dev, qer);
+    ret = mod_request(qer, genl_id, nl, dev, qer);
 
     gtp5g_qer_free(qer);
 
@@ -778,7 +846,7 @@ static int del_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         ret = EXIT_FAILURE;
@@ -801,7 +869,7 @@ static int del_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 	}
     gtp5g_qer_set_id(qer, atoi(argv[++optidx]));
 
-    ret = gtp5g_del_qer(genl_id, nl, dev, qer);
+    ret = del_request(qer, genl_id, nl, dev, qer);
 
     gtp5g_qer_free(qer);
 
@@ -813,7 +881,7 @@ out:
 
 static int list_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 {
-    return gtp5g_list_qer(genl_id, nl);
+    return gtp5g_list_qer_format(genl_id, nl, output);
 }
 
 static int get_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
@@ -833,7 +901,7 @@ static int get_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 
     optidx = 3;
 
-    ifidx = if_nametoindex(argv[optidx]);
+    ifidx = dev_ifindex(argv[optidx]);
     if (ifidx == 0) {
         fprintf(stderr, "wrong 5G GTP interface %s\n", argv[optidx]);
         ret = EXIT_FAILURE;
@@ -863,7 +931,7 @@ static int get_qer(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 		goto out_qer;
 	}
 
-    gtp5g_print_qer(rt_qer);
+    gtp5g_print_qer_format(rt_qer, output);
 
     gtp5g_qer_free(rt_qer);
 
@@ -875,27 +943,168 @@ out:
     return ret;
 }
 
-int main(int argc, char *argv[])
+static int save_rules(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
 {
-    struct mnl_socket *nl;
-    int32_t genl_id;
-    int ret = 0;
+    struct gtp5g_snapshot_stats stats;
+    int fd = STDOUT_FILENO;
+    const char *file, *path;
+    char *tmp = NULL;
+    int mapped = 0;
+    int ret;
 
-    if (argc < 3) {
-        printf("%s <add|mod|delete|list|get> <pdr|far|qer> [<options,...>]\n", argv[0]);
-        exit(EXIT_FAILURE);
+    if (strcmp(argv[2], "--mapped") == 0) {
+        if (argc < 4) {
+            printf("%s save [--mapped] <file|->\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        mapped = 1;
+    }
+    file = path = argv[2 + mapped];
+
+    if (strcmp(file, "-")) {
+        /* Readers may have the mapped file open, truncating it under them
+         * would fault their accesses. The new one replaces it once whole. */
+        if (mapped) {
+            tmp = malloc(strlen(file) + sizeof(".tmp"));
+            if (!tmp) {
+                perror("malloc");
+                return EXIT_FAILURE;
+            }
+            sprintf(tmp, "%s.tmp", file);
+            path = tmp;
+        }
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            perror(path);
+            free(tmp);
+            return EXIT_FAILURE;
+        }
     }
 
-    nl = genl_socket_open();
-    if (nl == NULL) {
-        perror("mnl_socket_open");
-        exit(EXIT_FAILURE);
+    if (mapped)
+        ret = gtp5g_snapmap_save(genl_id, nl, fd, &stats);
+    else
+        ret = gtp5g_snapshot_save(genl_id, nl, fd, &stats);
+    if (ret == 0 && tmp && fsync(fd) < 0) {
+        perror(path);
+        ret = -1;
     }
+    if (fd != STDOUT_FILENO && close(fd) < 0 && ret == 0) {
+        perror(path);
+        ret = -1;
+    }
+    if (ret == 0 && tmp && rename(tmp, file) < 0) {
+        perror(file);
+        ret = -1;
+    }
+    if (ret < 0 && tmp)
+        unlink(tmp);
+    free(tmp);
+    if (ret < 0)
+        return EXIT_FAILURE;
 
-    genl_id = genl_lookup_family(nl, "gtp5g");
-    if (genl_id < 0) {
-        printf("not found gtp genl family\n");
-        exit(EXIT_FAILURE);
+    fprintf(stderr, "saved %u PDRs, %u FARs, %u QERs\n", stats.pdr, stats.far, stats.qer);
+    return 0;
+}
+
+static int restore_rules(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
+{
+    struct gtp5g_snapshot_stats stats;
+    struct gtp5g_dev *dev;
+    int fd = STDIN_FILENO;
+    uint32_t ifidx;
+    int ret;
+
+    if (argc < 4) {
+        printf("%s restore <gtp device> <file|->\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ifidx = dev_ifindex(argv[2]);
+    if (ifidx == 0) {
+        fprintf(stderr, "wrong 5G GTP interface %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    dev = gtp5g_dev_alloc();
+    if (!dev) {
+        fprintf(stderr, "Failed to alloc gtp5g dev\n");
+        return EXIT_FAILURE;
+    }
+    gtp5g_dev_set_ifidx(dev, ifidx);
+
+    if (strcmp(argv[3], "-")) {
+        fd = open(argv[3], O_RDONLY);
+        if (fd < 0) {
+            perror(argv[3]);
+            gtp5g_dev_free(dev);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ret = gtp5g_snapshot_restore(genl_id, nl, dev, fd, &stats, NULL, NULL);
+    if (fd != STDIN_FILENO)
+        close(fd);
+    gtp5g_dev_free(dev);
+    if (ret < 0)
+        return EXIT_FAILURE;
+
+    fprintf(stderr, "restored %u PDRs, %u FARs, %u QERs, %u failed\n",
+            stats.pdr, stats.far, stats.qer, stats.failed);
+    return ret ? EXIT_FAILURE : 0;
+}
+
+/* Line of the batch file being run, 0 outside of batch mode */
+static unsigned int cur_line;
+/* Failures of a batch being sent are printed by batch_err() instead */
+static int batch_sending;
+static unsigned int batch_lines[BATCH_SIZE];
+
+static void print_err_at(unsigned int line, const struct gtp5g_err *err)
+{
+    if (line)
+        fprintf(stderr, "line %u: ", line);
+    if (err->id)
+        fprintf(stderr, "[ID %u] ", err->id);
+    if (err->msg[0])
+        fprintf(stderr, "%s: ", err->msg);
+    fprintf(stderr, "%s\n", strerror(err->err));
+}
+
+static void print_err(const struct gtp5g_err *err, void *data)
+{
+    if (!batch_sending)
+        print_err_at(cur_line, err);
+}
+
+static void usage(const char *name)
+{
+    printf("%s [-o <text|json|csv>] <add|mod|delete|list|get> <pdr|far|qer> [<options,...>]\n", name);
+    printf("\tlist and get write text, one JSON object per line, or CSV with a\n");
+    printf("\theader line.\n");
+    printf("%s save [--mapped] <file|->\n", name);
+    printf("\tWrite every PDR, FAR and QER of the network namespace to a binary\n");
+    printf("\tsnapshot, to stdout for '-'. With --mapped, write the indexed format\n");
+    printf("\tof gtp5g_snapmap_open() for offline queries instead, to <file>.tmp\n");
+    printf("\tfirst, which then replaces <file>.\n");
+    printf("%s restore <gtp device> <file|->\n", name);
+    printf("\tAdd the rules of a snapshot to <gtp device>.\n");
+    printf("%s [--continue-on-error] -batch <file|->\n", name);
+    printf("\tRun one command per line of <file>, or of stdin for '-'. Lines take\n");
+    printf("\tthe same arguments as the command line, '#' starts a comment.\n");
+    printf("\tAdd, mod and delete are sent to the kernel in batches of up to\n");
+    printf("\t%d lines. Without --continue-on-error, the first failure stops\n", BATCH_SIZE);
+    printf("\treading further lines, but the lines of its batch that follow it\n");
+    printf("\thave already been sent and take effect.\n");
+}
+
+static int run_cmd(int argc, char *argv[], int genl_id, struct mnl_socket *nl)
+{
+    int ret = EXIT_FAILURE;
+
+    if (argc < 3) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
     }
 
     if (strncmp(argv[1], "add", strlen(argv[1])) == 0) {
@@ -933,11 +1142,218 @@ int main(int argc, char *argv[])
             ret = get_far(argc, argv, genl_id, nl);
         if (strncmp(argv[2], "qer", strlen(argv[2])) == 0)
             ret = get_qer(argc, argv, genl_id, nl);
+    } else if (strcmp(argv[1], "save") == 0) {
+        ret = save_rules(argc, argv, genl_id, nl);
+    } else if (strcmp(argv[1], "restore") == 0) {
+        ret = restore_rules(argc, argv, genl_id, nl);
     } else {
         printf("Unknown command `%s'\n", argv[1]);
+    }
+
+    return ret;
+}
+
+/* Split line into words in place, honouring '' and "" quotes and \ escapes */
+static int split_line(char *line, char *argv[], int max)
+{
+    char *in = line, *out = line;
+    int argc = 0;
+    char quote;
+
+    for (;;) {
+        while (*in == ' ' || *in == '\t' || *in == '\n' || *in == '\r')
+            in++;
+        if (!*in || *in == '#')
+            return argc;
+        if (argc == max)
+            return -1;
+
+        argv[argc++] = out;
+        quote = 0;
+        for (; *in; in++) {
+            if (quote) {
+                if (*in == quote)
+                    quote = 0;
+                else
+                    *out++ = *in;
+            }
+            else if (*in == '\'' || *in == '"')
+                quote = *in;
+            else if (*in == '\\' && in[1])
+                *out++ = *++in;
+            else if (*in == ' ' || *in == '\t' || *in == '\n' || *in == '\r')
+                break;
+            else
+                *out++ = *in;
+        }
+        if (quote)
+            return -1;
+        if (*in)
+            in++;
+        *out++ = '\0';
+    }
+}
+
+static void batch_err(unsigned int index, const struct gtp5g_err *err, void *data)
+{
+    print_err_at(batch_lines[index], err);
+}
+
+/* Returns the number of queued requests that failed */
+static unsigned int batch_flush(void)
+{
+    unsigned int num = gtp5g_batch_count(batch);
+    int ret;
+
+    if (!num)
+        return 0;
+
+    batch_sending = 1;
+    ret = gtp5g_batch_send(batch, batch_err, NULL);
+    batch_sending = 0;
+
+    if (ret < 0) {
+        print_err_at(batch_lines[0], gtp5g_get_err());
+        return num;
+    }
+    return ret;
+}
+
+static int run_batch(const char *name, const char *file, int stop_on_error,
+                     int genl_id, struct mnl_socket *nl)
+{
+    unsigned int cmds = 0, failed = 0, num;
+    char *argv[BATCH_MAX_ARGS + 1];
+    char *line = NULL;
+    size_t size = 0;
+    FILE *f = stdin;
+    int argc, ret;
+
+    if (strcmp(file, "-")) {
+        f = fopen(file, "r");
+        if (!f) {
+            perror(file);
+            return EXIT_FAILURE;
+        }
+    }
+
+    batch = gtp5g_batch_alloc(genl_id, nl);
+    if (!batch) {
+        perror("gtp5g_batch_alloc");
+        goto out;
+    }
+    handle = gtp5g_handle_alloc();
+
+    while (!(stop_on_error && failed) && getline(&line, &size, f) != -1) {
+        cur_line++;
+
+        argv[0] = (char *) name;
+        argc = split_line(line, argv + 1, BATCH_MAX_ARGS);
+        if (argc == 0)
+            continue;
+        cmds++;
+        if (argc < 0) {
+            fprintf(stderr, "line %u: unbalanced quotes or too many arguments\n", cur_line);
+            failed++;
+            continue;
+        }
+        argc++;
+
+        /* Whatever is queued goes first, so that list, get and save see it */
+        if (strncmp(argv[1], "list", strlen(argv[1])) == 0 ||
+            strncmp(argv[1], "get", strlen(argv[1])) == 0 ||
+            strcmp(argv[1], "save") == 0 || strcmp(argv[1], "restore") == 0)
+            failed += batch_flush();
+
+        num = gtp5g_batch_count(batch);
+        optind = 0;
+        ret = run_cmd(argc, argv, genl_id, nl);
+        if (gtp5g_batch_count(batch) > num)
+            batch_lines[num] = cur_line;
+        else if (ret)
+            failed++;
+
+        if (gtp5g_batch_count(batch) == BATCH_SIZE || (stop_on_error && failed))
+            failed += batch_flush();
+    }
+    failed += batch_flush();
+    cur_line = 0;
+
+    fprintf(stderr, "%u commands, %u succeeded, %u failed\n", cmds, cmds - failed, failed);
+    if (stop_on_error && failed && getline(&line, &size, f) != -1)
+        fprintf(stderr, "stopped after the first failure, use --continue-on-error to go on\n");
+
+out:
+    gtp5g_batch_free(batch);
+    batch = NULL;
+    gtp5g_handle_free(handle);
+    handle = NULL;
+    free(line);
+    if (f != stdin)
+        fclose(f);
+    return failed ? EXIT_FAILURE : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *batch_file = NULL;
+    int stop_on_error = 1;
+    struct mnl_socket *nl;
+    int32_t genl_id;
+    int ret = 0;
+    int i = 1;
+
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "--continue-on-error") == 0)
+            stop_on_error = 0;
+        else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) &&
+                 i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "text") == 0)
+                output = GTP5G_FORMAT_TEXT;
+            else if (strcmp(argv[i], "json") == 0)
+                output = GTP5G_FORMAT_JSON;
+            else if (strcmp(argv[i], "csv") == 0)
+                output = GTP5G_FORMAT_CSV;
+            else {
+                fprintf(stderr, "unknown output format %s\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if ((strcmp(argv[i], "-batch") == 0 || strcmp(argv[i], "--batch") == 0 ||
+                  strcmp(argv[i], "-f") == 0) && i + 1 < argc)
+            batch_file = argv[++i];
+        else
+            break;
+    }
+
+    if (batch_file ? i != argc : argc - i < 2) {
+        usage(argv[0]);
         exit(EXIT_FAILURE);
     }
 
+    gtp5g_set_err_cb(print_err, NULL);
+
+    nl = genl_socket_open();
+    if (nl == NULL) {
+        perror("mnl_socket_open");
+        exit(EXIT_FAILURE);
+    }
+
+    genl_id = genl_lookup_family(nl, "gtp5g");
+    if (genl_id < 0) {
+        printf("not found gtp genl family\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (batch_file)
+        ret = run_batch(argv[0], batch_file, stop_on_error, genl_id, nl);
+    else {
+        /* Commands see the options before them as skipped */
+        argv[i - 1] = argv[0];
+        ret = run_cmd(argc - i + 1, argv + i - 1, genl_id, nl);
+    }
+
     mnl_socket_close(nl);
 
     return ret;